@@ -27,7 +27,12 @@
 #include <stdlib.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/wait.h>
+#include <poll.h>
 #include <signal.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fftw3.h>
 
 #include "vex.h"                        /* Needed for the VEX root file format */
 #include "mk4_data.h"                   /* Definitions of Mk4 data structures */
@@ -60,6 +65,8 @@ int do_estimation = FALSE;
 int refringe = FALSE;
 int ap_per_seg = 0;
 int reftime_offset = 0;
+int nworkers = 1;                       /* -j: number of scans fringed at once */
+int nsearchthreads = 1;                 /* -J: threads in the search() grid */
 
 //global variables provided for signal handler clean up of lock files
 lockfile_data_struct global_lockfile_data;
@@ -79,20 +86,35 @@ char version_no[] = FF_VER_NO;		// PACKAGE_VERSION from Makefile
 #define FALSE 0
 #define TRUE 1
 
+                                        /* Running totals over root files. ret, */
+                                        /* totpass and npass describe the last */
+                                        /* root whose station data were read, */
+                                        /* as the exit status has always done */
+struct fourfit_totals
+    {
+    int nroots, checked, tried, successes, failures;
+    int ret, totpass, npass;
+    int reset;                          /* ret/totpass/npass were set */
+    int user_ok;
+    int lost;                           /* -j workers that died or whose */
+                                        /* results never arrived */
+    };
+
+static int fringe_root (fstruct *, int, bsgstruct *, struct vex *,
+                        struct freq_corel *, struct fourfit_totals *);
+static void fringe_roots_parallel (fstruct *, bsgstruct *, struct vex *,
+                                   struct freq_corel *, struct fourfit_totals *);
+
 main (int argc, char** argv)
     {
     struct vex root;
     struct freq_corel corel[MAXFREQ];
     /* msg ("MAXFREQ == %d\n", 0, MAXFREQ); */
-    struct type_pass *pass;
-    char *inputname, *check_rflist(), processmsg[512];
-    char oldroot[256], rootname[256];
-    int i, j, k, npass, totpass, ret, nbchecked, nbtried, checked, tried;
-    int successes, failures, nroots, nc, fno, fs_ret;
-    int user_ok = TRUE;
-    fstruct *files, *fs;
-    struct fileset fset;
+    int i;
+    fstruct *files;
     bsgstruct *base_sgrp;
+    struct fourfit_totals tot;
+    extern int displayopt;
 
     //init lockfile data struct
     clear_global_lockfile_data();
@@ -146,186 +168,578 @@ main (int argc, char** argv)
                                         /* all selected files, one by one */
                                         /* All arguments are handled by the two */
                                         /* major data structures */
-    i = 0; successes = 0; failures = 0; nroots = 0; tried = 0;
+    memset (&tot, 0, sizeof (tot));
+    tot.user_ok = TRUE;
     *root.filename = 0;
-    msg ("files[0].order = %d",0, files[i].order);
-    while (files[i].order >= 0 && user_ok)
+    msg ("files[0].order = %d",0, files[0].order);
+                                        /* Interactive displays, accounting and */
+                                        /* estimation all need a single process */
+    if (nworkers > 1 && (displayopt || do_accounting || do_estimation))
         {
-        inputname = files[i++].name;
-        snprintf(processmsg, sizeof(processmsg)-1,
-            "The above errors occurred while processing\n"
-            "%s: %s\n"
-            "%s: the top-level resolution is as follows:",
-                progname, inputname, progname);
-        msg ("%s(Starting loop on files)", 0, processmsg);
-        //msg ("processing %s fileset", 2, inputname); // -1->2 Hotaka
+        msg ("-j is ignored with -a, -d, -e, -p or -x; fringing one scan at a time", 2);
+        nworkers = 1;
+        }
+    if (nworkers > 1)
+        fringe_roots_parallel (files, base_sgrp, &root, corel, &tot);
+    else
+        {
+        i = 0;
+        while (files[i].order >= 0 && tot.user_ok)
+            {
+            fringe_root (files, i, base_sgrp, &root, corel, &tot);
+            i++;
+            }
+        }
+                                        /* Tell user what we did, how it went. */
+                                        /* If it went badly enough, inform the */
+                                        /* shell with non-zero exit status */
+/*    ret = report_actions (i, nroots, checked, tried, successes, failures); */
+                                        /* Complete accounting and exit */
+    if (do_accounting) account ("Report results");
+    if (do_accounting) account ("!REPORT");
+    if (do_estimation) report_wallclock(tot.npass, tot.totpass);
+
+    //free up control buffers
+    free(param.control_file_buff);
+    free(param.set_string_buff);
+
+                                        /* A lost -j worker must not look */
+                                        /* like a clean run */
+    if (tot.lost > 0 && tot.ret == 0) tot.ret = 1;
+    exit(tot.ret);
+    }
+
+                                        /* Fringe all baselines of one root file, */
+                                        /* files[fileno], accumulating statistics */
+                                        /* in tot.  Returns 0 if the root was */
+                                        /* processed, 1 if it had to be skipped */
+static int
+fringe_root (fstruct *files,
+             int fileno,
+             bsgstruct *base_sgrp,
+             struct vex *root,
+             struct freq_corel *corel,
+             struct fourfit_totals *tot)
+    {
+    struct type_pass *pass;
+    char *inputname, *check_rflist(), processmsg[512];
+    char rootname[256];
+    int k, npass, nbchecked, nbtried, fno, fs_ret;
+    fstruct *fs;
+    struct fileset fset;
+
+    inputname = files[fileno].name;
+    snprintf(processmsg, sizeof(processmsg)-1,
+        "The above errors occurred while processing\n"
+        "%s: %s\n"
+        "%s: the top-level resolution is as follows:",
+            progname, inputname, progname);
+    msg ("%s(Starting loop on files)", 0, processmsg);
+    //msg ("processing %s fileset", 2, inputname); // -1->2 Hotaka
                                         /* Performs sanity check on requested file */
                                         /* and reports internally.  Allows for */
                                         /* fringe_all=false, among other things */
                                         /* Fills in absolute pathname of root */
                                         /* we need to read */
-        if (get_abs_path (inputname, rootname) != 0)
-            {
-            msg ("%sUnable to find abspath for %s, skipping", 2,
-                processmsg, rootname);
-            continue;
-            }
-        if (get_vex (rootname, OVEX | EVEX | IVEX | LVEX, "", &root) != 0)
-            {
-            msg ("%sError reading root for file %s, skipping", 2,
-                processmsg, inputname);
-            continue;
-            }
-        nroots++;
-        if (do_accounting) account ("Read root files");
+    if (get_abs_path (inputname, rootname) != 0)
+        {
+        msg ("%sUnable to find abspath for %s, skipping", 2,
+            processmsg, inputname);
+        return (1);
+        }
+    if (get_vex (rootname, OVEX | EVEX | IVEX | LVEX, "", root) != 0)
+        {
+        msg ("%sError reading root for file %s, skipping", 2,
+            processmsg, inputname);
+        return (1);
+        }
+    tot->nroots++;
+    if (do_accounting) account ("Read root files");
                                         /* copy in root filename for later use */
-        strncpy (root.ovex->filename, rootname, 256);
+    strncpy (root->ovex->filename, rootname, 256);
                                         /* Record the accumulation period - the */
                                         /* only information needed from evex */
-        param.acc_period = root.evex->ap_length;
-        param.speedup = root.evex->speedup_factor;
+    param.acc_period = root->evex->ap_length;
+    param.speedup = root->evex->speedup_factor;
                                         /* Find all files belonging to this root */
-        if (fileset (rootname, &fset) != 0)
-            {
-            msg ("%sError getting fileset of '%s'", 2, processmsg, rootname);
-            continue;
-            }
+    if (fileset (rootname, &fset) != 0)
+        {
+        msg ("%sError getting fileset of '%s'", 2, processmsg, rootname);
+        return (1);
+        }
                                         /* Keep track of latest type-2 file number */
-        max_seq_no = fset.maxfile;
+    max_seq_no = fset.maxfile;
                                         /* Read in all the type-3 files */
-        if (read_sdata (&fset, sdata) != 0)
-            {
-            msg ("%sError reading in the sdata files for '%s'", 2,
-                processmsg, rootname);
-            continue;
-            }
-        msg ("Successfully read station data for %s", 0, rootname);
+    if (read_sdata (&fset, sdata) != 0)
+        {
+        msg ("%sError reading in the sdata files for '%s'", 2,
+            processmsg, rootname);
+        return (1);
+        }
+    msg ("Successfully read station data for %s", 0, rootname);
                                         /* Need to loop over all baselines in this */
                                         /* root.  Baseline filtering of data is */
                                         /* taken care of in get_corel_data */
                                         /* and, if refringing, in check_rflist */
-        totpass = 0; ret = 0; nbchecked = 0; nbtried = 0;
-        fno = -1;
-        while (fset.file[++fno].type > 0 && user_ok)
-            {
-            fs = fset.file + fno;
-            msg ("Encountered type %d file:  %s", -1, fs->type, fs->name);
+    tot->totpass = 0; tot->ret = 0; tot->npass = 0; tot->reset = TRUE;
+    nbchecked = 0; nbtried = 0;
+    npass = 0; fs_ret = 0;
+    fno = -1;
+    while (fset.file[++fno].type > 0 && tot->user_ok)
+        {
+        fs = fset.file + fno;
+        msg ("Encountered type %d file:  %s", -1, fs->type, fs->name);
                                         /* Interested only in type 1 files */
-            if (fs->type != 1) continue;
+        if (fs->type != 1) continue;
                                         /* If this is a refringe, proceed only */
                                         /* if this baseline is in the list */
                                         /* rf_fglist is list of frequency */
                                         /* groups requested */
-            param.rf_fglist = NULL;
-            if (refringe)
-                if ((param.rf_fglist =
-                        check_rflist (fs->baseline, i-1, base_sgrp)) == NULL)
-                    continue;
+        param.rf_fglist = NULL;
+        if (refringe)
+            if ((param.rf_fglist =
+                    check_rflist (fs->baseline, fileno, base_sgrp)) == NULL)
+                continue;
                                         /* This reads the relevant corel file */
                                         /* non-zero return generally means this */
                                         /* baseline not required, instead of error */
                                         /* (it looks at control information) */
-            if (get_corel_data (fs, root.ovex, root.filename, &cdata) != 0)
-                {
-                msg ("%sUnable to get correlation data for %s/%s", 1,
-                    processmsg, inputname, fs->name);
-                continue;
-                }
-            if (do_accounting) account ("Read data files");
+        if (get_corel_data (fs, root->ovex, root->filename, &cdata) != 0)
+            {
+            msg ("%sUnable to get correlation data for %s/%s", 1,
+                processmsg, inputname, fs->name);
+            continue;
+            }
+        if (do_accounting) account ("Read data files");
                                         /* Put data in useful form */
                                         /* Also, interpolate sdata info */
-            msg ("Organizing data for file %s", 0, inputname);
-            if (organize_data (&cdata, root.ovex, root.ivex, sdata, corel) != 0)
-                {
-                msg ("%sError organizing data for file %s, skipping", 2,
-                    processmsg, inputname);
-                continue;
-                }
-            if (do_accounting) account ("Organize data");
+        msg ("Organizing data for file %s", 0, inputname);
+        if (organize_data (&cdata, root->ovex, root->ivex, sdata, corel) != 0)
+            {
+            msg ("%sError organizing data for file %s, skipping", 2,
+                processmsg, inputname);
+            continue;
+            }
+        if (do_accounting) account ("Organize data");
                                         /* Figure out multiple passes through data */
                                         /* Put pass-specific parameters in elements */
                                         /* of the pass array */
-            if (make_passes (root.ovex, corel, &param, &pass, &npass) != 0)
-                {
-                msg ("%sError on fringe passes setup for %s, %2s, skipping", 2,
-                         processmsg, inputname, fs->baseline);
-                continue;
-                }
-            if (do_accounting) account ("Make passes");
+        if (make_passes (root->ovex, corel, &param, &pass, &npass) != 0)
+            {
+            msg ("%sError on fringe passes setup for %s, %2s, skipping", 2,
+                     processmsg, inputname, fs->baseline);
+            continue;
+            }
+        tot->npass = npass;
+        if (do_accounting) account ("Make passes");
                                         /* Now do the actual fringe searching. */
                                         /* Loop over all passes, accumulating */
                                         /* errors in ret.  Error reporting is */
                                         /* internal to fringe_search() */
-            nbtried++;
-            for (k=0; k<npass; k++)
+        nbtried++;
+        for (k=0; k<npass; k++)
+            {
+            if (tot->totpass > 0 && do_estimation) fs_ret = -3;
+            else fs_ret = fringe_search (root, pass + k);
+            if (fs_ret < 0) break;
+            tot->ret += fs_ret;
+            }
+        tot->totpass += npass;
+
+        if (fs_ret < 0)                 /* quit request */
+            {
+            /* avoiding num_ap<0 crash: Hotaka 9/28/2017 */
+            if (pass->num_ap < 0)
                 {
-                if (totpass > 0 && do_estimation) fs_ret = -3;
-                else fs_ret = fringe_search (&root, pass + k);
-                if (fs_ret < 0) break;
-                ret += fs_ret;
+                    msg ("%s", 2, processmsg);
+                    msg ("stop_offset < start_offset !!", 2);
+                    msg ("Skipping %s/%s and continuing", 2,
+                        inputname, fs->name);
                 }
-            totpass += npass;
-
-            if (fs_ret < 0)             /* quit request */
+            else if (fs_ret == -2)
                 {
-                /* avoiding num_ap<0 crash: Hotaka 9/28/2017 */
-                if (pass->num_ap < 0)
-                    {
-                        msg ("%s", 2, processmsg);
-                        msg ("stop_offset < start_offset !!", 2);
-                        msg ("Skipping %s/%s and continuing", 2,
-                            inputname, fs->name);
-                    }
-                else if (fs_ret == -2)
-                    {
-                        msg ("quitting by request", 1);
-                        user_ok = FALSE;
-                    }
-                else if (fs_ret == -3)
-                    {
-                        /* just going through the motions */ ;
-                    }
-                else
-                /* still try to continue */
-                    {
-                        msg ("%s", 2, processmsg);
-                        msg ("Failed to find fringe on", 2);
-                        msg ("%s/%s (pol %s) and the user should ask why.", 2,
-                            inputname, fs->name,
-                            (0 <= pass[k].pol && pass[k].pol <= 3)
-                                ? polab[pass[k].pol] : "??");
-                        msg ("continuing", 2);
-                        // break;  continue and pray
-                    }
+                    msg ("quitting by request", 1);
+                    tot->user_ok = FALSE;
+                }
+            else if (fs_ret == -3)
+                {
+                    /* just going through the motions */ ;
+                }
+            else
+            /* still try to continue */
+                {
+                    msg ("%s", 2, processmsg);
+                    msg ("Failed to find fringe on", 2);
+                    msg ("%s/%s (pol %s) and the user should ask why.", 2,
+                        inputname, fs->name,
+                        (0 <= pass[k].pol && pass[k].pol <= 3)
+                            ? polab[pass[k].pol] : "??");
+                    msg ("continuing", 2);
+                    // break;  continue and pray
                 }
+            }
                                         /* Move to next file in fileset */
-            }                           /* End of baseline loop */
+        }                               /* End of baseline loop */
 
                                         /* Successful fringing, update root */
-//      if ((ret < totpass) && (! test_mode))
-//          {
-/*            write_root (&root, rootname);  */
-//          if (do_accounting) account ("Update root files");
-//          }
+//  if ((ret < totpass) && (! test_mode))
+//      {
+/*        write_root (&root, rootname);  */
+//      if (do_accounting) account ("Update root files");
+//      }
                                         /* Keep some statistics */
-        checked += nbchecked;
-        tried += nbtried;
-        successes += totpass - ret;
-        failures += ret;
-                                        /* End of filename loop */
+    tot->checked += nbchecked;
+    tot->tried += nbtried;
+    tot->successes += tot->totpass - tot->ret;
+    tot->failures += tot->ret;
+    return (0);
+    }
+
+/*******************************************************************************/
+/*                                                                             */
+/* Parallel mode (-j N).  Roots are grouped by scan directory, since the roots */
+/* of one scan share type-2 sequence numbers, and each scan is fringed in a    */
+/* forked worker process; at most N run at once.  Fourfit keeps its per-pass   */
+/* state in globals, so separate processes are the safe unit of concurrency,   */
+/* and the type-2 lock files already serialise writers within a directory.     */
+/* A worker's stdout and stderr go to temporary files which are copied out in  */
+/* input order once the worker and all earlier ones are done, so the output    */
+/* matches that of a serial run.  Its totals and its FFTW wisdom come back     */
+/* through a pipe; importing the wisdom means later workers find their plans   */
+/* already measured.                                                           */
+/*                                                                             */
+/* Only scans run concurrently; within a worker the baselines and passes of a  */
+/* root are fringed one after another exactly as in a serial run.  To bound    */
+/* the open temporary files, no more than UNIT_BACKLOG*N scans are started     */
+/* ahead of the oldest one not yet reported.                                   */
+/*                                                                             */
+/*******************************************************************************/
+
+enum { UNIT_WAITING, UNIT_RUNNING, UNIT_DONE, UNIT_REPORTED };
+
+#define UNIT_BACKLOG 4
+
+struct fourfit_unit
+    {
+    char dir[256];                      /* scan directory of the roots */
+    int *fileno;                        /* indices into files[], a slice */
+    int nfile;                          /* of one array shared by all units */
+    int state;
+    int failed;                         /* worker exited abnormally */
+    pid_t pid;
+    int fd;                             /* read end of results pipe */
+    FILE *out, *err;                    /* captured stdout and stderr */
+    char *result;                       /* totals + wisdom read from pipe */
+    int nresult, result_space;
+    };
+
+static int
+write_all (int fd, const void *buf, size_t n)
+    {
+    const char *p = buf;
+    ssize_t nw;
+
+    while (n > 0)
+        {
+        nw = write (fd, p, n);
+        if (nw < 0)
+            {
+            if (errno == EINTR) continue;
+            return (-1);
+            }
+        p += nw;
+        n -= nw;
         }
-                                        /* Tell user what we did, how it went. */
-                                        /* If it went badly enough, inform the */
-                                        /* shell with non-zero exit status */
-/*    ret = report_actions (i, nroots, checked, tried, successes, failures); */
-                                        /* Complete accounting and exit */
-    if (do_accounting) account ("Report results");
-    if (do_accounting) account ("!REPORT");
-    if (do_estimation) report_wallclock(npass, totpass);
+    return (0);
+    }
 
-    //free up control buffers
-    free(param.control_file_buff);
-    free(param.set_string_buff);
+static void
+copy_stream (FILE *from, FILE *to)
+    {
+    char buf[4096];
+    size_t n;
+
+    fflush (from);
+    rewind (from);
+    while ((n = fread (buf, 1, sizeof (buf), from)) > 0)
+        fwrite (buf, 1, n, to);
+    fflush (to);
+    }
+
+static void
+scan_dir (const char *name, char *dir)
+    {
+    char *slash;
+
+    strncpy (dir, name, 255);
+    dir[255] = 0;
+    if ((slash = strrchr (dir, '/')) != NULL) *slash = 0;
+    else strcpy (dir, ".");
+    }
+
+                                        /* Fork a worker for unit u; 0 on success */
+static int
+start_unit (struct fourfit_unit *u,
+            fstruct *files,
+            bsgstruct *base_sgrp,
+            struct vex *root,
+            struct freq_corel *corel)
+    {
+    int pfd[2], n;
+    char *wisdom;
+    struct fourfit_totals utot;
+
+    if ((u->out = tmpfile ()) == NULL || (u->err = tmpfile ()) == NULL)
+        {
+        msg ("Could not create temporary output files for scan %s", 2, u->dir);
+        if (u->out) fclose (u->out);
+        u->out = NULL;
+        return (-1);
+        }
+    if (pipe (pfd) != 0)
+        {
+        msg ("Could not create pipe for scan %s", 2, u->dir);
+        fclose (u->out); fclose (u->err);
+        u->out = u->err = NULL;
+        return (-1);
+        }
+    fflush (stdout);
+    fflush (stderr);
+    u->pid = fork ();
+    if (u->pid < 0)
+        {
+        msg ("Could not fork worker for scan %s", 2, u->dir);
+        close (pfd[0]); close (pfd[1]);
+        fclose (u->out); fclose (u->err);
+        u->out = u->err = NULL;
+        return (-1);
+        }
+    if (u->pid == 0)
+        {                               /* worker */
+        close (pfd[0]);
+        dup2 (fileno (u->out), 1);
+        dup2 (fileno (u->err), 2);
+        memset (&utot, 0, sizeof (utot));
+        utot.user_ok = TRUE;
+        for (n=0; n<u->nfile && utot.user_ok; n++)
+            fringe_root (files, u->fileno[n], base_sgrp, root, corel, &utot);
+        fflush (stdout);
+        fflush (stderr);
+        wisdom = fftw_export_wisdom_to_string ();
+        n = (wisdom == NULL) ? 0 : strlen (wisdom) + 1;
+        if (write_all (pfd[1], &utot, sizeof (utot)) != 0
+                || write_all (pfd[1], &n, sizeof (n)) != 0
+                || (n > 0 && write_all (pfd[1], wisdom, n) != 0))
+            _exit (1);
+        _exit (0);
+        }
+    close (pfd[1]);
+    u->fd = pfd[0];
+    u->state = UNIT_RUNNING;
+    return (0);
+    }
+
+                                        /* Read whatever a running worker has */
+                                        /* sent; on end of file, reap it */
+static void
+read_unit (struct fourfit_unit *u)
+    {
+    ssize_t nr;
+    int status;
+
+    if (u->result_space - u->nresult < 4096)
+        {
+        u->result_space += 65536;
+        u->result = realloc (u->result, u->result_space);
+        if (u->result == NULL)
+            {
+            msg ("Out of memory reading results for scan %s", 3, u->dir);
+            exit (1);
+            }
+        }
+    nr = read (u->fd, u->result + u->nresult, u->result_space - u->nresult);
+    if (nr < 0 && errno == EINTR) return;
+    if (nr > 0)
+        {
+        u->nresult += nr;
+        return;
+        }
+    close (u->fd);
+    while (waitpid (u->pid, &status, 0) < 0 && errno == EINTR)
+        ;
+    if (!WIFEXITED (status) || WEXITSTATUS (status) != 0)
+        {
+        msg ("Worker for scan %s did not finish cleanly", 2, u->dir);
+        u->failed = TRUE;
+        }
+    u->state = UNIT_DONE;
+    }
+
+                                        /* Copy out a finished unit's output and */
+                                        /* fold its totals and wisdom into ours */
+static void
+report_unit (struct fourfit_unit *u, struct fourfit_totals *tot)
+    {
+    struct fourfit_totals utot;
+    int nwisdom;
+
+    copy_stream (u->out, stdout);
+    copy_stream (u->err, stderr);
+    fclose (u->out);
+    fclose (u->err);
+    if (u->nresult >= (int)(sizeof (utot) + sizeof (nwisdom)))
+        {
+        memcpy (&utot, u->result, sizeof (utot));
+        memcpy (&nwisdom, u->result + sizeof (utot), sizeof (nwisdom));
+        tot->nroots += utot.nroots;
+        tot->checked += utot.checked;
+        tot->tried += utot.tried;
+        tot->successes += utot.successes;
+        tot->failures += utot.failures;
+        if (utot.reset)
+            {
+            tot->ret = utot.ret;
+            tot->totpass = utot.totpass;
+            tot->npass = utot.npass;
+            tot->reset = TRUE;
+            }
+        if (! utot.user_ok) tot->user_ok = FALSE;
+        if (nwisdom > 0 && u->nresult == (int)(sizeof (utot) + sizeof (nwisdom)) + nwisdom)
+            fftw_import_wisdom_from_string (u->result + sizeof (utot) + sizeof (nwisdom));
+        }
+    else
+        {                               /* lost worker; make sure exit status shows it */
+        msg ("No results received for scan %s", 2, u->dir);
+        u->failed = TRUE;
+        }
+    if (u->failed) tot->lost++;
+    free (u->result);
+    u->result = NULL;
+    u->state = UNIT_REPORTED;
+    }
+
+static void
+fringe_roots_parallel (fstruct *files,
+                       bsgstruct *base_sgrp,
+                       struct vex *root,
+                       struct freq_corel *corel,
+                       struct fourfit_totals *tot)
+    {
+    struct fourfit_unit *units;
+    struct pollfd *pfds;
+    char dir[256];
+    int *unitof, *order;
+    int i, n, nfiles, nunits, next, reported, running, npoll, backlog;
+
+    for (nfiles=0; files[nfiles].order >= 0; nfiles++)
+        ;
+    if (nfiles == 0) return;
+    units = calloc (nfiles, sizeof (struct fourfit_unit));
+    unitof = malloc (nfiles * sizeof (int));
+    order = malloc (nfiles * sizeof (int));
+    pfds = malloc (nworkers * sizeof (struct pollfd));
+    if (units == NULL || unitof == NULL || order == NULL || pfds == NULL)
+        {
+        msg ("Out of memory setting up -j; fringing serially", 2);
+        free (units); free (unitof); free (order); free (pfds);
+        for (i=0; files[i].order >= 0 && tot->user_ok; i++)
+            fringe_root (files, i, base_sgrp, root, corel, tot);
+        return;
+        }
+                                        /* Group roots by scan directory, in the */
+                                        /* order the scans first appear */
+    nunits = 0;
+    for (i=0; i<nfiles; i++)
+        {
+        scan_dir (files[i].name, dir);
+        for (n=nunits-1; n>=0; n--)     /* roots of a scan are usually adjacent */
+            if (strcmp (units[n].dir, dir) == 0) break;
+        if (n < 0)
+            {
+            n = nunits++;
+            strcpy (units[n].dir, dir);
+            }
+        unitof[i] = n;
+        units[n].nfile++;
+        }
+                                        /* Each unit gets its slice of order[], */
+                                        /* filled in input order */
+    for (n=0, i=0; n<nunits; n++)
+        {
+        units[n].fileno = order + i;
+        i += units[n].nfile;
+        units[n].nfile = 0;
+        }
+    for (i=0; i<nfiles; i++)
+        {
+        n = unitof[i];
+        units[n].fileno[units[n].nfile++] = i;
+        }
+    free (unitof);
+    msg ("Fringing %d scans with up to %d workers", 1, nunits, nworkers);
+
+    backlog = UNIT_BACKLOG * nworkers;
+    next = reported = running = 0;
+    while (reported < nunits)
+        {
+                                        /* Report finished units in input order */
+        while (reported < next && units[reported].state == UNIT_DONE)
+            report_unit (units + reported++, tot);
+        if (reported == nunits) break;
+                                        /* Keep nworkers busy, but do not run */
+                                        /* too far ahead of the report point */
+        while (running < nworkers && next < nunits && next - reported < backlog
+               && tot->user_ok)
+            {
+            if (start_unit (units + next, files, base_sgrp, root, corel) == 0)
+                {
+                running++;
+                next++;
+                }
+            else if (running > 0)
+                break;                  /* retry when a worker finishes */
+            else
+                {                       /* nothing in flight, so run it here */
+                for (n=0; n<units[next].nfile && tot->user_ok; n++)
+                    fringe_root (files, units[next].fileno[n], base_sgrp,
+                                 root, corel, tot);
+                units[next++].state = UNIT_REPORTED;
+                reported++;
+                }
+            }
+        if (running == 0)
+            {
+            if (next == nunits || ! tot->user_ok) break;
+            continue;
+            }
+                                        /* Wait for any worker to send results */
+        npoll = 0;
+        for (n=reported; n<next; n++)
+            if (units[n].state == UNIT_RUNNING)
+                {
+                pfds[npoll].fd = units[n].fd;
+                pfds[npoll].events = POLLIN;
+                pfds[npoll].revents = 0;
+                npoll++;
+                }
+        if (poll (pfds, npoll, -1) < 0)
+            {
+            if (errno == EINTR) continue;
+            msg ("poll() failed waiting for workers", 3);
+            exit (1);
+            }
+        for (n=reported, i=0; n<next; n++)
+            if (units[n].state == UNIT_RUNNING)
+                {
+                if (pfds[i++].revents != 0)
+                    {
+                    read_unit (units + n);
+                    if (units[n].state == UNIT_DONE) running--;
+                    }
+                }
+        }
 
-    exit(ret);
+    free (order);
+    free (pfds);
+    free (units);
     }
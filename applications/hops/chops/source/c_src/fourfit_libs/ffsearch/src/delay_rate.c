@@ -5,6 +5,13 @@
 /*                                              */
 /*      8/2/91          - cmn                   */
 /* 2012.1.4 - rjc - remove pcal rotation here   */
+/*                                              */
+/* delay_rate_setup() must be called once per   */
+/* pass, before any threads are started; after  */
+/* that delay_rate() only reads shared state,   */
+/* so threads may call it for different lags,   */
+/* each with its own X work array (MAXAP*2      */
+/* points, from fftw_malloc)                    */
 /************************************************/
 #include <stdio.h>
 #include <math.h>
@@ -14,37 +21,59 @@
 #include "param_struct.h"
 #include "pass_struct.h"
 
+static int fft_size = 0;
+static fftw_plan fftplan;
+
+int
+delay_rate_setup (void)
+    {
+    int size;
+    static fftw_complex *X = NULL;
+    extern struct type_status status;
+
+    size = status.drsp_size * 4;        /* This is size of FFT */
+                                        /* Smaller delay rate spectrum option */
+    if (size > MAXAP*2) size = MAXAP*2;
+
+    status.f_rate_size = size;
+
+    if (size != fft_size)               // recompute fft quantities when size changes
+        {
+        if (X == NULL)
+            X = fftw_malloc (sizeof (fftw_complex) * MAXAP * 2);
+        if (X == NULL)
+            {
+            msg ("fftw_malloc() failed to allocate memory", 2);
+            return (-1);
+            }
+        if (fft_size != 0)
+            fftw_destroy_plan (fftplan);
+        fft_size = size;
+        fftplan = fftw_plan_dft_1d (fft_size, X, X, FFTW_FORWARD, FFTW_MEASURE);
+        }
+    return (0);
+    }
+
 delay_rate (struct type_pass *pass,
             int fr,
+            int lag,
+            fftw_complex *X,
             complex rate_spectrum[MAXAP])
     {
     complex apval, a;
-    complex fringe_spect[MAXAP*2], X[MAXAP*2];
+    complex fringe_spect[MAXAP*2];
     int fl, L, ap, np, i, j, l_int, l_int2, size;
-    static int fft_size = 0;
     int stnpol[2][4] = {0, 1, 0, 1, 0, 1, 1, 0}; // [stn][pol] = 0:L, 1:R
     double b, l_fp, frac;
     struct freq_corel *pd;
     struct data_corel *datum;
     extern struct type_param param;
     extern struct type_status status;
-    static fftw_plan fftplan;
 
     pd = pass->pass_data + fr;
     
     np = status.drsp_size;              /* np = # of ap's in FFT < MAXAP */
-    
-    size = np * 4;                      /* This is size of FFT */
-                                        /* Smaller delay rate spectrum option */
-    if (size > MAXAP*2) size = MAXAP*2;
-
-    status.f_rate_size = size;
-
-    if (size != fft_size)               // recompute fft quantities when size changes
-        {
-        fft_size = size;
-        fftplan = fftw_plan_dft_1d (fft_size, X, X, FFTW_FORWARD, FFTW_MEASURE);
-        }
+    size = fft_size;                    /* set by delay_rate_setup() */
 
                                         /* Fill data array */
     for (i = 0; i < size; i++) 
@@ -52,7 +81,7 @@ delay_rate (struct type_pass *pass,
     for (ap = 0; ap < pass->num_ap; ap++)
         {
         datum = pd->data + ap + pass->ap_off;
-        apval = datum->sbdelay[status.lag];
+        apval = datum->sbdelay[lag];
                                         /* Weight by fractional AP */
         frac = 0.0;
         if (datum->usbfrac >= 0.0) frac  = datum->usbfrac;
@@ -63,7 +92,7 @@ delay_rate (struct type_pass *pass,
         X[ap] = apval * frac;
         }
      
-    fftw_execute (fftplan);
+    fftw_execute_dft (fftplan, X, X);
 
     for (i = 0; i < size; i++)
         {
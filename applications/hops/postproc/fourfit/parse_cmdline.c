@@ -50,7 +50,8 @@ struct type_param *param)
     extern char *optarg;
     extern int optind, do_only_new, test_mode, do_accounting, do_estimation;
     extern int write_xpower;
-    extern int refringe, msglev, ap_per_seg, reftime_offset;
+    extern int refringe, msglev, ap_per_seg, reftime_offset, nworkers;
+    extern int nsearchthreads;
     int do_parse = FALSE,
         bf_override = FALSE,
         cs_too_big = FALSE;
@@ -64,7 +65,7 @@ struct type_param *param)
     param->first_plot = 0;
     param->nplot_chans = 0;
                                         /* Interpret command line flags */
-    while((c=getopt(argc,argv,"+ab:c:d:ef:m:n:pr:s:tuxP:T:X")) != -1)
+    while((c=getopt(argc,argv,"+ab:c:d:ef:j:m:n:pr:s:tuxJ:P:T:X")) != -1)
         {
         switch(c)
             {
@@ -99,6 +100,14 @@ struct type_param *param)
                 param->first_plot = atoi(optarg);
                 break;
 
+            case 'j':
+                if (sscanf (optarg, "%d", &nworkers) != 1 || nworkers < 1)
+                    {
+                    msg ("Invalid -j flag argument '%s', fringing serially", 2, optarg);
+                    nworkers = 1;
+                    }
+                break;
+
             case 'm':
                 if (sscanf (optarg, "%d", &msglev) != 1)
                     {
@@ -147,6 +156,14 @@ struct type_param *param)
                 strcpy (display_name, "xwindow");
                 break;
 
+            case 'J':
+                if (sscanf (optarg, "%d", &nsearchthreads) != 1 || nsearchthreads < 1)
+                    {
+                    msg ("Invalid -J flag argument '%s', searching with one thread", 2, optarg);
+                    nsearchthreads = 1;
+                    }
+                break;
+
             case 'P':
                 if (parse_polar (optarg, &param->pol))
                     msg ("Bad -P argument, doing all sequentially)", 2);
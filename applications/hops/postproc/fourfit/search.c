@@ -6,8 +6,11 @@
 
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <math.h>
 #include <complex.h>
+#include <pthread.h>
 #include <fftw3.h>
 #include "mk4_data.h"
 #include "param_struct.h"
@@ -15,24 +18,62 @@
 #include "control.h"
 
 #define MBD_GRID_MAX 8192
+#define DR_BATCH 32                     /* delay rate rows per fftw call */
+
+                                        /* The (lag, dr, mbd) grid search is split */
+                                        /* by lag across nsearchthreads threads; */
+                                        /* each evaluates DR_BATCH delay rate rows */
+                                        /* per fft, and keeps the best cell of each */
+                                        /* lag for a serial reduction afterwards */
+struct search_grid
+    {
+    struct type_pass *pass;
+    int ndr;                            /* delay rate rows in window */
+    int nmb;                            /* mbd cells in window */
+    int *mbcell;                        /* ... in search order */
+    int smooth;                         /* # dr cells each side to average, or 0 */
+    int nbatch;                         /* rows per fft, at most DR_BATCH */
+    fftw_plan batchplan, tailplan;      /* nbatch rows, and ndr % nbatch rows */
+    double *max_amp;                    /* outputs, indexed by lag */
+    int *mbdmax, *drmax;
+    double *drcarry;                    /* [MAXAP], read by smoothing outside */
+                                        /* the dr window; see search() */
+    };
+
+struct search_work
+    {
+    struct search_grid *grid;
+    int lag_lo, lag_hi;
+    complex *rate_spectrum;             /* [nfreq][drsp_size] */
+    fftw_complex *X;                    /* delay_rate() work array */
+    fftw_complex *data;                 /* DR_BATCH rows of grid_points */
+    double *amps;                       /* [nmb][ndr] */
+    double *drtemp;                     /* [ndr] */
+    pthread_t thread;
+    };
+
+int delay_rate_setup (void);
+int delay_rate (struct type_pass *, int, int, fftw_complex *, complex *);
+static void *search_lags (void *);
+static int alloc_work (struct search_work *, struct search_grid *);
+static void free_work (struct search_work *);
+
 int search (struct type_pass *pass)
     {
-    fftw_complex *data = NULL; 
-    double mb_delay[MBD_GRID_MAX]; 
-    static complex rate_spectrum[MAXFREQ][MAXAP];
-    static double amps[MBD_GRID_MAX][MAXAP], drtemp[MAXAP];
     int cnt, fr, i, j, station, lag, dr_index, mbd_index, ap, newmax;
     int max_mbd_cell, max_dr_cell, max_lag, drlag;
-    int n, jlo, jhi;
+    int n, nthread, nlag, ntail, perr;
     static int mbdmax[2*MAXLAG], drmax[2*MAXLAG];
     extern struct type_param param;
     extern struct type_status status;
     extern struct type_plot plot;
     double global_max, amp;
     static double max_amp[2*MAXLAG];
+    static double drcarry[MAXAP];
     extern int do_accounting;
-
-    fftw_plan fftplan;
+    extern int nsearchthreads;
+    struct search_grid grid;
+    struct search_work *work;
 
     void pcalibrate (struct type_pass *, int);
 
@@ -43,28 +84,18 @@ int search (struct type_pass *pass)
     status.total_ap_frac = 0.0;
     status.total_usb_frac = 0.0;
     status.total_lsb_frac = 0.0;
-                                        // allocate fftw data array
-    data = fftw_malloc (sizeof (fftw_complex) * MBD_GRID_MAX);
-    if (data == NULL)
-        {
-        msg ("fftw_malloc() failed to allocate memory");
-        return (-1);
-        }
-    
                                         /* Make sure data will fit (note that auto
                                          * correlations use up twice as many lags */
     if (param.nlags*param.num_ap > MAX_APXLAG)
         {
         msg ("Too many lags (%d) and/or aps (%d) for data & plot arrays (%d)",
              2, param.nlags, param.num_ap, MAX_APXLAG);
-        fftw_free (data);
         return (-1);
         }
                                         /* trap for too many lags */
     if (param.nlags > MAXLAG)
         {
         msg ("Too many (%d) lags", 2, param.nlags);
-        fftw_free (data);
         return (-1);
         }
 
@@ -114,7 +145,6 @@ int search (struct type_pass *pass)
     if (status.total_ap == 0)
         {
         msg ("Warning: No valid data for this pass for pol %d", 2, pass->pol);
-        fftw_free (data);   // clean up the malloc'ed data array
         return (1);
         }
     status.epoch_off_cent = -(status.epoch_off_cent / status.total_ap + 0.5)
@@ -126,7 +156,6 @@ int search (struct type_pass *pass)
         {
         msg ("Too many mbd grid points (%d) for array (%d), check freq sequence",
              2, status.grid_points, MBD_GRID_MAX);
-        fftw_free (data);
         return (-1);
         }
 
@@ -145,116 +174,125 @@ int search (struct type_pass *pass)
                                         /* the arrays here, rather than later on */
                                         /* in make_plotdata() */
     memset (&plot, 0, sizeof (plot));
-                                        // set up for later fft's
-    fftplan = fftw_plan_dft_1d (status.grid_points, data, data, FFTW_FORWARD, FFTW_MEASURE);
-
-    for (lag = status.win_sb[0]; lag <= status.win_sb[1]; lag++)
+                                        // make the window's mbd cell list, in the
+                                        // order they have always been searched;
+                                        // note that the window may wrap around 0
+    grid.pass = pass;
+    grid.ndr = status.win_dr[1] - status.win_dr[0] + 1;
+    grid.mbcell = malloc (sizeof (int) * status.grid_points);
+    if (grid.mbcell == NULL)
         {
-        status.lag = lag;
-                                        /* drate spectrum for each freq */
-                                        /* This weighted by fractional AP */
-        for (fr = 0; fr < pass->nfreq; fr++) 
-            delay_rate (pass, fr, rate_spectrum[fr]);
-
-        for (dr_index = status.win_dr[0]; dr_index <= status.win_dr[1]; dr_index++) 
-            {
-            status.dr = dr_index;                       /* Clear data array and */
-                                                /* Fill with delay rate data */
-            for (i = 0; i < status.grid_points; i++)
-                data[i] = 0.0;
-                
-            for (fr = 0; fr < pass->nfreq; fr++)
-                data[status.mb_index[fr]] = rate_spectrum[fr][dr_index];
-
-                                                // FFT to delay resolution function
-            fftw_execute (fftplan);
-                                                /* Copy back, with 0 delay in center */
-                                                /* Note that i might wrap around to 0 */
-            i = status.win_mb[0] - 1;
-            do
-                {
-                i = (i+1) % status.grid_points;
-                j = i-status.grid_points/2;
-                if (j < 0) j += status.grid_points;
-                mb_delay[i] = cabs (data[j]); 
-                }
-            while (i != status.win_mb[1]);
-                                                /* Normalize delay res. value and store */
-            mbd_index = status.win_mb[0] - 1;
-            do
-                {
-                mbd_index = (mbd_index+1) % status.grid_points;
-                status.mbd = mbd_index;
-                                        // mean amplitude
-                amps[mbd_index][dr_index] = mb_delay[mbd_index] / status.total_ap_frac;
-                }  
-            while (mbd_index != status.win_mb[1]);
-            }
-                                        // smooth amplitudes over delay rates, iff incoherent
+        msg ("Could not allocate search grid", 2);
+        return (-1);
+        }
+    grid.nmb = 0;
+    mbd_index = status.win_mb[0] - 1;
+    do
+        {
+        mbd_index = (mbd_index+1) % status.grid_points;
+        grid.mbcell[grid.nmb++] = mbd_index;
+        }
+    while (mbd_index != status.win_mb[1]);
+                                        // smoothing over delay rates, iff incoherent
                                         // averaging is requested
-        if (pass->control.t_cohere > 0.0)
-            {
-            n = status.drsp_size * param.acc_period / (2.0 * pass->control.t_cohere) + 0.5;
-            msg ("convolving rate spectrum over %d resolution elements", -3, n);
-        
-            mbd_index = status.win_mb[0] - 1;
-            do                          // smooth over each of the mbd channels
-                {
-                mbd_index = (mbd_index+1) % status.grid_points;
-                                        // create temporary copy of this delay rate row
-                for (dr_index = status.win_dr[0]; dr_index <= status.win_dr[1]; dr_index++) 
-                    {
-                    drtemp[dr_index] = amps[mbd_index][dr_index];
-                    amps[mbd_index][dr_index] = 0.0;
-                    }
-                                        // average together the surrounding 2n+1 dr cells
-                for (dr_index = status.win_dr[0]; dr_index <= status.win_dr[1]; dr_index++) 
-                    {                   // ensure that array bounds are not exceeded
-                    jlo = dr_index - n;
-                    jlo = (jlo < 0) ? 0 : jlo;
-
-                    jhi = dr_index + n;
-                    jhi = (jhi < MAXAP) ? jhi : MAXAP - 1;
-
-                    for (j=jlo; j<=jhi; j++)
-                        amps[mbd_index][dr_index] += drtemp[j];
-                    amps[mbd_index][dr_index] /= (jhi - jlo + 1.0);
-                    }
-                }  
-            while (mbd_index != status.win_mb[1]);
-            }
-            
-
-                                        // search over mbd and dr for maximum amplitude
-        max_amp[lag] = -1.0;
-        for (dr_index = status.win_dr[0]; dr_index <= status.win_dr[1]; dr_index++) 
-            {
-            status.dr = dr_index;
-
-            mbd_index = status.win_mb[0] - 1;
-            do
-                {
-                mbd_index = (mbd_index+1) % status.grid_points;
-                status.mbd = mbd_index;
-
-                if (amps[mbd_index][dr_index] > max_amp[lag])
-                    {
-                    max_amp[lag] = amps[mbd_index][dr_index];
-                    mbdmax[lag] = mbd_index;                            
-                    drmax[lag] = dr_index;
-                    msg ("search: lag %d dr_index %d mbd_index %d amp %f",-3,
-                              lag,   dr_index,   mbd_index,   max_amp[lag]);
-                    }
+    grid.smooth = 0;
+    if (pass->control.t_cohere > 0.0)
+        {
+        n = status.drsp_size * param.acc_period / (2.0 * pass->control.t_cohere) + 0.5;
+        msg ("convolving rate spectrum over %d resolution elements", -3, n);
+        grid.smooth = n;
+        }
+    grid.max_amp = max_amp;
+    grid.mbdmax = mbdmax;
+    grid.drmax = drmax;
+    grid.drcarry = drcarry;
+                                        // one work area per thread, no more threads
+                                        // than lags; thread 0 is this one
+    nlag = status.win_sb[1] - status.win_sb[0] + 1;
+    nthread = (nsearchthreads < nlag) ? nsearchthreads : nlag;
+    if (nthread < 1) nthread = 1;
+    work = calloc (nthread, sizeof (struct search_work));
+    if (work == NULL || delay_rate_setup () != 0)
+        {
+        msg ("Could not allocate search work areas", 2);
+        free (work);
+        free (grid.mbcell);
+        return (-1);
+        }
+    for (i = 0; i < nthread; i++)
+        {
+        work[i].lag_lo = status.win_sb[0] + (long)nlag * i / nthread;
+        work[i].lag_hi = status.win_sb[0] + (long)nlag * (i+1) / nthread - 1;
+        if (alloc_work (work + i, &grid) != 0)
+            break;
+        }
+    if (i < nthread)
+        {
+        msg ("Could not allocate search work areas", 2);
+        for (j = 0; j <= i; j++)
+            free_work (work + j);
+        free (work);
+        free (grid.mbcell);
+        return (-1);
+        }
+                                        // set up for later fft's; plans are made
+                                        // here, and executed on each thread's own
+                                        // (equally aligned) arrays
+    grid.nbatch = (grid.ndr < DR_BATCH) ? grid.ndr : DR_BATCH;
+    ntail = grid.ndr % grid.nbatch;
+    grid.batchplan = fftw_plan_many_dft (1, &status.grid_points, grid.nbatch,
+                        work[0].data, NULL, 1, status.grid_points,
+                        work[0].data, NULL, 1, status.grid_points,
+                        FFTW_FORWARD, FFTW_MEASURE);
+    if (ntail > 0)
+        grid.tailplan = fftw_plan_many_dft (1, &status.grid_points, ntail,
+                        work[0].data, NULL, 1, status.grid_points,
+                        work[0].data, NULL, 1, status.grid_points,
+                        FFTW_FORWARD, FFTW_MEASURE);
 
-                }  
-            while (mbd_index != status.win_mb[1]);
+    for (i = 1; i < nthread; i++)
+        {
+        perr = pthread_create (&work[i].thread, NULL, search_lags, work + i);
+        if (perr != 0)
+            {                           // do the rest here
+            msg ("Could not start search thread (%d), continuing with %d", 1,
+                  perr, i);
+            break;
             }
-            
-                                        /* Store mbdmax for this lag */
+        }
+    n = i;                              // threads actually started
+    search_lags (work);
+    for (i = 1; i < n; i++)
+        pthread_join (work[i].thread, NULL);
+    for (i = n; i < nthread; i++)
+        search_lags (work + i);
+                                        // Smoothing has always averaged in whatever
+                                        // a previous search left in the dr cells
+                                        // outside the window: the unsmoothed row of
+                                        // its last lag and last mbd cell.  The last
+                                        // work area holds that row now; keep it for
+                                        // the next search, so results are unchanged
+    if (grid.smooth > 0)
+        memcpy (drcarry + status.win_dr[0], work[nthread-1].drtemp,
+                sizeof (double) * grid.ndr);
+                                        // no more fft's to do, delete plans
+    fftw_destroy_plan (grid.batchplan);
+    if (ntail > 0)
+        fftw_destroy_plan (grid.tailplan);
+    for (i = 0; i < nthread; i++)
+        free_work (work + i);
+    free (work);
+    free (grid.mbcell);
+                                        /* Store mbdmax for each lag */
+    for (lag = status.win_sb[0]; lag <= status.win_sb[1]; lag++)
+        {
+        msg ("search: lag %d dr_index %d mbd_index %d amp %f",-3,
+                  lag,   drmax[lag],   mbdmax[lag],   max_amp[lag]);
         update (pass, mbdmax[lag], max_amp[lag], lag, drmax[lag], LAG);
         }
-                                        // no more fft's to do, delete plan
-    fftw_destroy_plan (fftplan);
+    status.lag = status.win_sb[1];
+    status.dr = status.win_dr[1];
+    status.mbd = status.win_mb[1];
                                         /* search over lags for global maximum */
     global_max = -1.0;
     for (lag=status.win_sb[0]; lag <= status.win_sb[1]; lag++)
@@ -273,7 +311,6 @@ int search (struct type_pass *pass)
     if (global_max <= 0.0)
         {
         msg ("Probable internal data selection error, values all zero", 2);
-        fftw_free (data);
         return (-1);
         }
 
@@ -283,7 +320,128 @@ int search (struct type_pass *pass)
     msg ("finished fringe search ", 1);
     if (do_accounting) account ("Grid search");
 
-    fftw_free (data);   // clean up the malloc'ed data array
     return (0);         /* This return should be modified to give some indication */
                         /* of whether the search was successful.                  */
     }   
+
+                                        // Search lags lag_lo..lag_hi of the grid;
+                                        // runs as a thread, touching only its own
+                                        // work area and its own lags' outputs
+static void *
+search_lags (void *arg)
+    {
+    struct search_work *w = arg;
+    struct search_grid *g = w->grid;
+    struct type_pass *pass = g->pass;
+    int lag, fr, dr0, d, nb, row, k, i, j, jlo, jhi, np;
+    double *amp;
+    fftw_complex *rowdata;
+    extern struct type_status status;
+
+    np = status.drsp_size;
+    for (lag = w->lag_lo; lag <= w->lag_hi; lag++)
+        {
+                                        /* drate spectrum for each freq */
+                                        /* This weighted by fractional AP */
+        for (fr = 0; fr < pass->nfreq; fr++) 
+            delay_rate (pass, fr, lag, w->X, w->rate_spectrum + fr * np);
+
+        for (dr0 = 0; dr0 < g->ndr; dr0 += nb)
+            {
+            nb = g->ndr - dr0;          /* Clear data array and */
+            if (nb > g->nbatch)         /* Fill with delay rate data */
+                nb = g->nbatch;
+            memset (w->data, 0, sizeof (fftw_complex) * nb * status.grid_points);
+            for (row = 0; row < nb; row++)
+                {
+                d = status.win_dr[0] + dr0 + row;
+                rowdata = w->data + row * status.grid_points;
+                for (fr = 0; fr < pass->nfreq; fr++)
+                    rowdata[status.mb_index[fr]] = w->rate_spectrum[fr * np + d];
+                }
+                                        // FFT to delay resolution functions
+            fftw_execute_dft ((nb == g->nbatch) ? g->batchplan : g->tailplan,
+                              w->data, w->data);
+                                        /* Normalize delay res. value and store, */
+                                        /* with 0 delay in center */
+            for (row = 0; row < nb; row++)
+                {
+                rowdata = w->data + row * status.grid_points;
+                for (k = 0; k < g->nmb; k++)
+                    {
+                    j = g->mbcell[k] - status.grid_points/2;
+                    if (j < 0) j += status.grid_points;
+                                        // mean amplitude
+                    w->amps[k * g->ndr + dr0 + row] = cabs (rowdata[j]) / status.total_ap_frac;
+                    }
+                }
+            }
+                                        // smooth amplitudes over delay rates, iff incoherent
+                                        // averaging is requested; cells outside
+                                        // the window come from g->drcarry
+        if (g->smooth > 0)
+            {
+            for (k = 0; k < g->nmb; k++)
+                {
+                amp = w->amps + k * g->ndr;
+                memcpy (w->drtemp, amp, sizeof (double) * g->ndr);
+                for (d = 0; d < g->ndr; d++)
+                    {                   // ensure that array bounds are not exceeded
+                    i = status.win_dr[0] + d;
+                    jlo = i - g->smooth;
+                    jlo = (jlo < 0) ? 0 : jlo;
+
+                    jhi = i + g->smooth;
+                    jhi = (jhi < MAXAP) ? jhi : MAXAP - 1;
+
+                    amp[d] = 0.0;
+                    for (j=jlo; j<=jhi; j++)
+                        if (j >= status.win_dr[0] && j <= status.win_dr[1])
+                            amp[d] += w->drtemp[j - status.win_dr[0]];
+                        else
+                            amp[d] += g->drcarry[j];
+                    amp[d] /= (jhi - jlo + 1.0);
+                    }
+                }
+            }
+                                        // search over mbd and dr for maximum amplitude
+        g->max_amp[lag] = -1.0;
+        for (d = 0; d < g->ndr; d++)
+            for (k = 0; k < g->nmb; k++)
+                if (w->amps[k * g->ndr + d] > g->max_amp[lag])
+                    {
+                    g->max_amp[lag] = w->amps[k * g->ndr + d];
+                    g->mbdmax[lag] = g->mbcell[k];
+                    g->drmax[lag] = status.win_dr[0] + d;
+                    }
+        }
+    return (NULL);
+    }
+
+static int
+alloc_work (struct search_work *w,
+            struct search_grid *g)
+    {
+    extern struct type_status status;
+
+    w->grid = g;
+    w->rate_spectrum = malloc (sizeof (complex) * g->pass->nfreq * status.drsp_size);
+    w->X = fftw_malloc (sizeof (fftw_complex) * MAXAP * 2);
+    w->data = fftw_malloc (sizeof (fftw_complex) * DR_BATCH * status.grid_points);
+    w->amps = malloc (sizeof (double) * g->nmb * g->ndr);
+    w->drtemp = malloc (sizeof (double) * g->ndr);
+    if (w->rate_spectrum == NULL || w->X == NULL || w->data == NULL
+            || w->amps == NULL || w->drtemp == NULL)
+        return (-1);
+    return (0);
+    }
+
+static void
+free_work (struct search_work *w)
+    {
+    free (w->rate_spectrum);
+    fftw_free (w->X);
+    fftw_free (w->data);
+    free (w->amps);
+    free (w->drtemp);
+    }
@@ -2026,6 +2026,10 @@ int CorrParams::setkv(const std::string &key, const std::string &value)
 		{
 		  outputFormat = OutputFormatASCII;
 		}
+		else if (s == "INDEXED")
+		{
+		  outputFormat = OutputFormatINDEXED;
+		}
 	}
 	else if(key == "machines")
 	{
@@ -374,7 +374,7 @@ public:
 	int minReadSize;	// Min (Bytes) amount of data to read into datastream at a time
 	unsigned int invalidMask;
 	int visBufferLength;
-	enum OutputFormatType outputFormat; // DIFX or ASCII
+	enum OutputFormatType outputFormat; // DIFX, ASCII or INDEXED
 	std::string v2dComment;
 	std::string outPath;	// If supplied, put the .difx/ output within the supplied directory rather in ./ .
 
@@ -32,6 +32,7 @@
 
 #include <iostream>
 #include <cmath>
+#include <cstdlib>
 
 #include <unistd.h>
 
@@ -50,6 +51,7 @@ int main(int argc, char** argv)
         const double C_LAMBDA = 0.2021;        // default wavelength in test code
 
         const int    N_ITER = 10; // benchmark iterations
+        const int    Nthreads = (argc > 1) ? atoi(argv[1]) : sysconf(_SC_NPROCESSORS_ONLN); // threads for batch decompositions
 
         //////////////////////////////////////////
         // COMPILE INFO
@@ -159,6 +161,23 @@ int main(int argc, char** argv)
            }
         }
 
+        if (1) {
+
+           std::cout << "\nTiming performance of channels/second for time-integrating covariance of " << xyz.Nant << "-element signal in chunks of 256 samples\n";
+
+           arma::Mat<bf::complex> random_chunk;
+
+           int Nch = outDataBlock.N_chan();
+
+           Timing speed(Nch*N_ITER*256);
+           for (int i=0; i<N_ITER; i++) {
+              random_chunk.randn(256, xyz.Nant);
+              for (int cc=0; cc<Nch; cc++) {
+                 outDataBlock.add(cc, random_chunk);
+              }
+           }
+        }
+
         //////////////////////////////////////////
         // DECOMPOSITIONS and RECOMPOSITIONS
         /////////////////////////////////////////
@@ -216,6 +235,28 @@ int main(int argc, char** argv)
               }
            }
 
+           if (Nthreads > 1) {
+              std::cout << "\nTiming performance of SVD and EVD decomposition and recomposition with " << Nthreads << " threads\n";
+              SVDecomposition decSVD(rxxDataBlock);
+              EVDecomposition decEVD(rxxDataBlock);
+              decSVD.set_N_threads(Nthreads);
+              decEVD.set_N_threads(Nthreads);
+              {
+                 Timing speed(Nelem*N_ITER);
+                 for (int i=0; i<N_ITER; i++) {
+                    decSVD.decompose(rxxDataBlock);
+                    decSVD.recompose(outDataBlock);
+                 }
+              }
+              {
+                 Timing speed(Nelem*N_ITER);
+                 for (int i=0; i<N_ITER; i++) {
+                    decEVD.decompose(rxxDataBlock);
+                    decEVD.recompose(outDataBlock);
+                 }
+              }
+           }
+
            if (1) {
               std::cout << "\nTiming performance of QR decomposition and recomposition\n";
               QRDecomposition dec(rxxDataBlock);
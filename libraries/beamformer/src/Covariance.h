@@ -210,6 +210,30 @@ class Covariance {
          }
       }
 
+      /**
+       * Given a chunk of signal vectors, one per row, integrates their
+       * covariances into the current covariance data of the specified channel
+       * with a single Hermitian rank-k update. Same result as calling add(ch, x)
+       * for every row x of X, but done as one BLAS herk instead of k rank-1 updates.
+       * @param[in] ch Target covariance channel 0..Nch-1
+       * @param[in] X  Matrix of Msmp x Nant, each row holding data from Nant elements
+       */
+      void add(const int ch, arma::Mat<bf::complex> const& X) {
+         // X'*X = sum over rows of conj(x)*x.'; Armadillo evaluates a product of a
+         // matrix with its own conjugate transpose with herk
+         _Rxx.slice(ch) += (arma::trans(X) * X);
+      }
+
+      /**
+       * Integrates a chunk of signal vectors of all channels, one rank-k update per channel.
+       * @param[in] X  Cube of Msmp x Nant x Nch; slice ch is passed to add(ch, X.slice(ch))
+       */
+      void add(arma::Cube<bf::complex> const& X) {
+         for (unsigned int cc=0; (cc<X.n_slices) && (cc<_Rxx.n_slices); cc++) {
+            add(cc, X.slice(cc));
+         }
+      }
+
 
    private:
       int _N_ant;
@@ -31,8 +31,24 @@
 
 #include <armadillo>
 
+#include <pthread.h>
+#include <vector>
+
 namespace bf {
 
+/**
+ * Shared state of the threads of one batch_threaded() call.
+ */
+struct Decomposition::BatchJob {
+   Decomposition* deco;
+   arma::Cube<bf::complex> const* in;  // decompose from, or 0
+   arma::Cube<bf::complex>* out;       // recompose into, or 0
+   int nextch;                         // next channel not yet taken
+   int endch;                          // last channel (inclusive)
+   int rc;
+   pthread_mutex_t lock;
+};
+
 /**
  * Allocate output matrices or output cubes.
  * @param[in]  NdecoM  Number of matrices to store decomposition (1 for Eig, 2 for QR, 2 for SVD, etc)
@@ -97,6 +113,10 @@ int Decomposition::decompose(Covariance const& cov, const int startch, const int
    if (allRxx.n_slices == 1) {
       return this->do_decomposition(0, allRxx.slice(0));
    }
+
+   if (_N_threads > 1 && endch > startch) {
+      return batch_threaded(&allRxx, 0, startch, endch);
+   }
    
    for (unsigned int chan=startch; (chan<allRxx.n_slices) && (chan<=unsigned(endch)); chan++) {
       int sliceNr = chan + 1;
@@ -146,6 +166,10 @@ int Decomposition::recompose(Covariance& cov, const int startch, const int endch
       return this->do_recomposition(0, allRxx.slice(0));
    }
 
+   if (_N_threads > 1 && endch > startch) {
+      return batch_threaded(0, &allRxx, startch, endch);
+   }
+
    for (unsigned int chan=startch; (chan<allRxx.n_slices) && (chan<=unsigned(endch)); chan++) {
       int sliceNr = chan + 1;
       int rcs = this->do_recomposition(sliceNr, allRxx.slice(chan));
@@ -158,6 +182,107 @@ int Decomposition::recompose(Covariance& cov, const int startch, const int endch
 }
 
 
+/**
+ * Thread function for batch processing; takes channels from a BatchJob until none are left.
+ * @param[in,out]  job  Pointer to the shared BatchJob
+ */
+void* Decomposition::batch_worker(void* job)
+{
+   BatchJob* J = (BatchJob*)job;
+
+   while (1) {
+      int chan, rcs;
+
+      pthread_mutex_lock(&J->lock);
+      chan = J->nextch++;
+      pthread_mutex_unlock(&J->lock);
+
+      if (chan > J->endch) {
+         break;
+      }
+
+      if (J->in != 0) {
+         rcs = J->deco->do_decomposition(chan + 1, J->in->slice(chan));
+      } else {
+         rcs = J->deco->do_recomposition(chan + 1, J->out->slice(chan));
+      }
+
+      if (rcs != 0) {
+         pthread_mutex_lock(&J->lock);
+         J->rc = rcs;
+         pthread_mutex_unlock(&J->lock);
+      }
+   }
+
+   return 0;
+}
+
+
+/**
+ * Decompose or recompose a range of channels, spread over up to _N_threads threads.
+ * Each channel writes only its own slice of the output cubes, so the threads
+ * share no data other than the channel counter.
+ * @param[in]  in       Covariances to decompose, or 0 when recomposing
+ * @param[out] out      Covariances to recompose into, or 0 when decomposing
+ * @param[in]  startch  First channel
+ * @param[in]  endch    Last channel (inclusive)
+ * @return 0 on success, -1 if startch is out of range
+ */
+int Decomposition::batch_threaded(arma::Cube<bf::complex> const* in, arma::Cube<bf::complex>* out, const int startch, const int endch)
+{
+   BatchJob job;
+   int Nthreads = _N_threads;
+   int lastch = endch;
+   std::vector<pthread_t> threads;
+
+   unsigned int Nslices = (in != 0) ? in->n_slices : out->n_slices;
+   if (unsigned(startch) >= Nslices) {
+      return -1;
+   }
+   if (unsigned(lastch) >= Nslices) {
+      lastch = Nslices - 1;
+   }
+   if (lastch < startch) {
+      return 0;
+   }
+
+   // Starting a thread costs about as much as decomposing a small matrix, so
+   // give each thread a few channels, and do small matrices serially
+   if (N_ant < BATCH_THREADED_MIN_NANT) {
+      Nthreads = 1;
+   } else if (Nthreads > (lastch - startch + 1) / BATCH_THREADED_MIN_CHANNELS) {
+      Nthreads = (lastch - startch + 1) / BATCH_THREADED_MIN_CHANNELS;
+   }
+
+   job.deco = this;
+   job.in = in;
+   job.out = out;
+   job.nextch = startch;
+   job.endch = lastch;
+   job.rc = 0;
+   pthread_mutex_init(&job.lock, NULL);
+
+   // The calling thread is one of the workers
+   int Nstarted = 0;
+   if (Nthreads > 1) {
+      threads.resize(Nthreads - 1);
+   }
+   for (int t=0; t<(Nthreads - 1); t++) {
+      if (pthread_create(&threads[Nstarted], NULL, batch_worker, &job) == 0) {
+         Nstarted++;
+      }
+   }
+   batch_worker(&job);
+   for (int t=0; t<Nstarted; t++) {
+      pthread_join(threads[t], NULL);
+   }
+
+   pthread_mutex_destroy(&job.lock);
+
+   return job.rc;
+}
+
+
 /**   
  * Human-readable data output to stream
  */
@@ -75,7 +75,7 @@ class Decomposition {
        *
        * @param[in] Rxx Reference to covariance class
        */
-      Decomposition(Covariance& Rxx) : N_ant(Rxx.N_ant()), N_chan(Rxx.N_chan()), M_smp(Rxx.M_smp()), _deco_type(Decomposition::None) { 
+      Decomposition(Covariance& Rxx) : N_ant(Rxx.N_ant()), N_chan(Rxx.N_chan()), M_smp(Rxx.M_smp()), _deco_type(Decomposition::None), _N_threads(1) { 
          /*derived should call: cstor_alloc(Rxx.N_ant, Rxx.N_chan, numMat, numVec);*/
       }
 
@@ -88,7 +88,7 @@ class Decomposition {
        *
        * @param[in] Rxx Reference to raw covariance data
        */
-      Decomposition(arma::Mat<bf::complex>& Rxx) : N_ant(Rxx.n_cols), N_chan(1), M_smp(1), _deco_type(Decomposition::None) { 
+      Decomposition(arma::Mat<bf::complex>& Rxx) : N_ant(Rxx.n_cols), N_chan(1), M_smp(1), _deco_type(Decomposition::None), _N_threads(1) { 
          /*derived should call: cstor_alloc(Rxx.n_cols, 1, numMat, numVec);*/ 
       }
 
@@ -102,6 +102,16 @@ class Decomposition {
        */
       void set_M_smp(int M_smp_new) { M_smp = M_smp_new; }
 
+      /**
+       * Set the number of threads used by batch decompose() and recompose() calls.
+       * Channels are handed out one at a time to the threads, each of which runs
+       * its own LAPACK calls. With a multithreaded BLAS/LAPACK (e.g. OpenBLAS)
+       * that library should be limited to one thread (OPENBLAS_NUM_THREADS=1).
+       * @param[in] Nthreads Number of threads, 1 (default) for serial processing
+       */
+      void set_N_threads(int Nthreads) { _N_threads = (Nthreads < 1) ? 1 : Nthreads; }
+      int get_N_threads() const { return _N_threads; }
+
   protected:
 
        /**
@@ -195,6 +205,31 @@ class Decomposition {
        */
       virtual int do_recomposition(const int sliceNr, arma::Mat<bf::complex>& Rxx) = 0;
 
+   private:
+      struct BatchJob;
+
+      /** Smallest matrix size (N_ant) and number of channels per thread worth threading */
+      static const int BATCH_THREADED_MIN_NANT = 8;
+      static const int BATCH_THREADED_MIN_CHANNELS = 2;
+
+      /**
+       * Thread function for batch processing; takes channels from a BatchJob until none are left.
+       * @param[in,out]  job  Pointer to the shared BatchJob
+       */
+      static void* batch_worker(void* job);
+
+      /**
+       * Decompose or recompose a range of channels, spread over up to _N_threads threads.
+       * Small matrices, and ranges of fewer than BATCH_THREADED_MIN_CHANNELS channels
+       * per thread, use fewer threads or just the calling one.
+       * @param[in]  in       Covariances to decompose, or 0 when recomposing
+       * @param[out] out      Covariances to recompose into, or 0 when decomposing
+       * @param[in]  startch  First channel
+       * @param[in]  endch    Last channel (inclusive)
+       * @return 0 on success, -1 if startch is out of range
+       */
+      int batch_threaded(arma::Cube<bf::complex> const* in, arma::Cube<bf::complex>* out, const int startch, const int endch);
+
    protected:
 
       // Storage when processing several decompositions
@@ -212,6 +247,9 @@ class Decomposition {
       int M_smp;
       int _deco_type;
 
+   private:
+      int _N_threads;
+
 };
 
 extern std::ostream &operator<<(std::ostream&, Decomposition const&);
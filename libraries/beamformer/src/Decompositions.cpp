@@ -107,9 +107,10 @@ int EVDecomposition::do_decomposition(const int sliceNr, arma::Mat<bf::complex>
       // Bug: no matching function for call to ‘eig_sym(arma::subview_col<double>, arma::Mat<std::complex<double> >&, const arma::Mat<std::complex<double> >&)’
       // ok = arma::eig_sym(_batch_out_vectors.col(c), _batch_out_matrices[0].slice(c), Rxx); 
 
-      arma::Col<bf::real> eigvals;
+      // Column vector using the memory of the output column directly: no temporary, and
+      // threads working on different channels never share an allocation
+      arma::Col<bf::real> eigvals(_batch_out_vectors.colptr(c), N_ant, false, true);
       ok = arma::eig_sym(eigvals, _batch_out_matrices[0].slice(c), Rxx);
-      _batch_out_vectors.col(c) = eigvals;
 
    }
 
@@ -165,9 +166,8 @@ int SVDecomposition::do_decomposition(const int sliceNr, arma::Mat<bf::complex>
       // Bug: no matching function for call to ‘svd(..., arma::subview_col<double>, ...)'
       // ok = arma::svd(_batch_out_matrices[0].slice(c), _batch_out_vectors.col(c), _batch_out_matrices[1].slice(c), Rxx);
 
-      arma::Col<bf::real> s;
+      arma::Col<bf::real> s(_batch_out_vectors.colptr(c), N_ant, false, true);
       ok = arma::svd(_batch_out_matrices[0].slice(c), s, _batch_out_matrices[1].slice(c), Rxx);
-      _batch_out_vectors.col(c) = s;
 
    }
 
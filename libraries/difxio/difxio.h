@@ -31,6 +31,7 @@
 
 #include "difxio/parsedifx.h"
 #include "difxio/parsevis.h"
+#include "difxio/parsevisindexed.h"
 #include "difxio/difx_input.h"
 #include "difxio/difx_tcal.h"
 #include "difxio/difx_options.h"
@@ -169,6 +169,7 @@ enum OutputFormatType
 {
 	OutputFormatDIFX = 0,
 	OutputFormatASCII = 1,
+	OutputFormatINDEXED = 2,	/* binary, memory mappable; see parsevisindexed.h */
 	NumOutputFormat			/* must remain as last entry */
 };
 
@@ -77,6 +77,10 @@ static int writeCommonSettings(FILE *out, const DifxInput *D)
 	{
 		writeDifxLine(out, "OUTPUT FORMAT", "SWIN");
 	}
+	else if (D->outputFormat==OutputFormatINDEXED)
+	{
+		writeDifxLine(out, "OUTPUT FORMAT", "INDEXED");
+	}
 	else
 	{
 		writeDifxLine(out, "OUTPUT FORMAT", "ASCII");
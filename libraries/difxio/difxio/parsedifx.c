@@ -57,6 +57,180 @@ static void copyrow(DifxRow *dest, const DifxRow *src)
 	dest->value = src->value;
 }
 
+/* FNV-1a */
+static unsigned int hashkey(const char *key)
+{
+	unsigned int h = 2166136261U;
+
+	for(; *key; ++key)
+	{
+		h = (h ^ (unsigned char)(*key)) * 16777619U;
+	}
+
+	return h;
+}
+
+/* return the bucket holding key, or the empty bucket where it would go */
+static int findbucket(const DifxParameters *dp, const char *key)
+{
+	const DifxParametersIndex *index;
+	int b, k;
+
+	index = dp->index;
+	b = hashkey(key) & (index->hash_size - 1);
+	for(;;)
+	{
+		k = index->buckets[b];
+		if(k < 0 || strcmp(key, dp->rows[index->key_rows[index->key_first[k]]].key) == 0)
+		{
+			return b;
+		}
+		b = (b + 1) & (index->hash_size - 1);
+	}
+}
+
+void DifxParametersdeleteindex(DifxParameters *dp)
+{
+	if(dp && dp->index)
+	{
+		free(dp->index->buckets);
+		free(dp->index->key_first);
+		free(dp->index->key_rows);
+		free(dp->index);
+		dp->index = 0;
+	}
+}
+
+int DifxParametersbuildindex(DifxParameters *dp)
+{
+	DifxParametersIndex *index;
+	int *rowkey, *count;
+	int i, b, k;
+
+	if(!dp)
+	{
+		fprintf(stderr, "DifxParametersbuildindex : dp = 0\n");
+
+		return -1;
+	}
+
+	DifxParametersdeleteindex(dp);
+
+	index = (DifxParametersIndex *)calloc(1, sizeof(DifxParametersIndex));
+	rowkey = (int *)malloc((dp->num_rows+1)*sizeof(int));
+	count = (int *)malloc((dp->num_rows+1)*sizeof(int));
+	if(!index || !rowkey || !count)
+	{
+		free(index);
+		free(rowkey);
+		free(count);
+
+		return -1;
+	}
+	dp->index = index;
+
+	/* at most half full, so probe sequences stay short */
+	index->hash_size = 16;
+	while(index->hash_size < 2*dp->num_rows)
+	{
+		index->hash_size *= 2;
+	}
+	index->buckets = (int *)malloc(index->hash_size*sizeof(int));
+	index->key_first = (int *)malloc((dp->num_rows+1)*sizeof(int));
+	index->key_rows = (int *)malloc((dp->num_rows+1)*sizeof(int));
+	if(!index->buckets || !index->key_first || !index->key_rows)
+	{
+		free(rowkey);
+		free(count);
+		DifxParametersdeleteindex(dp);
+
+		return -1;
+	}
+	for(b = 0; b < index->hash_size; ++b)
+	{
+		index->buckets[b] = -1;
+	}
+
+	/* number the distinct keys and count their rows.  Until the rows are placed,
+	 * key_first[k] = k and key_rows[k] is the first row with key k, which is all
+	 * findbucket needs */
+	for(i = 0; i < dp->num_rows; ++i)
+	{
+		rowkey[i] = -1;
+		if(dp->rows[i].key == 0)
+		{
+			continue;
+		}
+		b = findbucket(dp, dp->rows[i].key);
+		k = index->buckets[b];
+		if(k < 0)
+		{
+			k = index->num_keys;
+			++index->num_keys;
+			index->buckets[b] = k;
+			index->key_first[k] = k;
+			index->key_rows[k] = i;
+			count[k] = 0;
+		}
+		rowkey[i] = k;
+		++count[k];
+	}
+
+	/* turn counts into starts, then place the rows, which go in ascending order */
+	index->key_first[0] = 0;
+	for(k = 0; k < index->num_keys; ++k)
+	{
+		index->key_first[k+1] = index->key_first[k] + count[k];
+		count[k] = index->key_first[k];
+	}
+	for(i = 0; i < dp->num_rows; ++i)
+	{
+		if(rowkey[i] >= 0)
+		{
+			index->key_rows[count[rowkey[i]]++] = i;
+		}
+	}
+
+	free(rowkey);
+	free(count);
+
+	return 0;
+}
+
+/* indexed find of first row in [start_row, end_row) with key */
+static int findindexed(const DifxParameters *dp, int start_row, int end_row, const char *key)
+{
+	const DifxParametersIndex *index;
+	int k, lo, hi, mid;
+
+	index = dp->index;
+	k = index->buckets[findbucket(dp, key)];
+	if(k < 0)
+	{
+		return -1;
+	}
+	lo = index->key_first[k];
+	hi = index->key_first[k+1];
+	while(lo < hi)
+	{
+		mid = (lo + hi)/2;
+		if(index->key_rows[mid] < start_row)
+		{
+			lo = mid + 1;
+		}
+		else
+		{
+			hi = mid;
+		}
+	}
+	if(lo < index->key_first[k+1] && index->key_rows[lo] < end_row)
+	{
+		return index->key_rows[lo];
+	}
+
+	return -1;
+}
+
 /* double number of allocated rows */
 void growDifxParameters(DifxParameters *dp)
 {
@@ -113,6 +287,7 @@ void deleteDifxParameters(DifxParameters *dp)
 			}
 			free(dp->rows);
 		}
+		DifxParametersdeleteindex(dp);
 		free(dp);
 	}
 }
@@ -189,6 +364,8 @@ void resetDifxParameters(DifxParameters *dp)
 		return;
 	}
 
+	DifxParametersdeleteindex(dp);
+
 	if(dp->num_rows == 0)
 	{
 		return;
@@ -230,6 +407,9 @@ int DifxParametersaddrow(DifxParameters *dp, const char *line)
 		return -1;
 	}
 
+	/* an index would no longer cover every row */
+	DifxParametersdeleteindex(dp);
+
 	if(dp->num_rows >= dp->alloc_rows)
 	{
 		growDifxParameters(dp);
@@ -275,6 +455,11 @@ DifxParameters *newDifxParametersfromfile(const char *filename)
 	
 	fclose(in);
 
+	if(DifxParametersbuildindex(dp) < 0)
+	{
+		fprintf(stderr, "Warning: cannot index %s; key lookups will be slow\n", filename);
+	}
+
 	return dp;
 }
 
@@ -341,6 +526,11 @@ int DifxParametersfind_limited(const DifxParameters *dp, int start_row, int max_
 		return -1;
 	}
 
+	if(dp->index)
+	{
+		return findindexed(dp, start_row, max_r, key);
+	}
+
 	for(i = start_row; i < max_r; ++i)
 	{
 		if(dp->rows[i].key == 0)
@@ -379,6 +569,11 @@ int DifxParametersfind(const DifxParameters *dp, int start_row, const char *key)
 		return -1;
 	}
 
+	if(dp->index)
+	{
+		return findindexed(dp, start_row, dp->num_rows, key);
+	}
+
 	for(i = start_row; i < dp->num_rows; ++i)
 	{
 		if(dp->rows[i].key == 0)
@@ -52,11 +52,24 @@ typedef struct
 			/* NULL pointer if no colon on row */
 } DifxRow;
 
+/* Hash index of the keys of a DifxParameters, so finds need not scan the rows.
+ * The rows holding each distinct key are kept in ascending order, so a find
+ * from start_row is a binary search among the rows with that key. */
+typedef struct
+{
+	int hash_size;		/* number of hash buckets; a power of 2 */
+	int *buckets;		/* [hash_size] distinct key number, or -1 if empty */
+	int num_keys;		/* number of distinct keys */
+	int *key_first;		/* [num_keys+1] start of each key's rows in key_rows */
+	int *key_rows;		/* rows grouped by key, ascending within each key */
+} DifxParametersIndex;
+
 typedef struct
 {
 	int num_rows;	/* number of rows populated */
 	int alloc_rows;	/* number of rows allocated; not to be updated by users */
 	DifxRow *rows;	/* pointer to allocated row structures */
+	DifxParametersIndex *index;	/* 0 unless built; not to be updated by users */
 } DifxParameters;
 
 typedef struct
@@ -81,6 +94,13 @@ DifxParameters *newDifxParametersfromfile(const char *filename);
 /* Delete all the parameters */
 void resetDifxParameters(DifxParameters *dp);
 
+/* Build the key index used by the find functions; done by newDifxParametersfromfile.
+ * Adding rows afterwards discards it.  Returns 0 on success, -1 on allocation failure */
+int DifxParametersbuildindex(DifxParameters *dp);
+
+/* Discard the key index; finds then scan the rows */
+void DifxParametersdeleteindex(DifxParameters *dp);
+
 /* Mainly used internally -- used to double the number of allocated rows */
 void growDifxParameters(DifxParameters *dp);
 
@@ -0,0 +1,309 @@
+/***************************************************************************
+ *   Copyright (C) 2007-2020 by Walter Brisken & Adam Deller               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+//===========================================================================
+// SVN properties (DO NOT CHANGE)
+//
+// $Id$
+// $HeadURL$
+// $LastChangedRevision$
+// $Author$
+// $LastChangedDate$
+//
+//============================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "difxio/difx_input.h"
+#include "difxio/parsevisindexed.h"
+
+/* check that a block claimed to be at offset really is an integration of this file */
+static int isValidBlock(const DifxVisIndexedFile *vf, uint64_t offset)
+{
+	const DifxVisIndexedIntegration *integration;
+	uint64_t tableBytes;
+
+	if(offset % vf->header->alignment != 0 || offset + sizeof(DifxVisIndexedIntegration) > vf->mapLength)
+	{
+		return 0;
+	}
+	integration = (const DifxVisIndexedIntegration *)(vf->map + offset);
+	tableBytes = (uint64_t)integration->nRecord*sizeof(DifxVisIndexedRecord);
+	if(integration->sync != VISINDEXED_INTEGRATION_SYNC_WORD || integration->nRecord < 0 ||
+	   integration->blockBytes < sizeof(DifxVisIndexedIntegration) + tableBytes ||
+	   offset + integration->blockBytes > vf->mapLength)
+	{
+		return 0;
+	}
+
+	return 1;
+}
+
+static int appendIndexEntry(DifxVisIndexedFile *vf, int *nAlloc, const DifxVisIndexedEntry *entry)
+{
+	DifxVisIndexedEntry *index;
+
+	if(vf->nIntegration >= *nAlloc)
+	{
+		*nAlloc = (*nAlloc > 0) ? 2*(*nAlloc) : 1024;
+		index = (DifxVisIndexedEntry *)realloc(vf->index, (*nAlloc)*sizeof(DifxVisIndexedEntry));
+		if(index == 0)
+		{
+			return -1;
+		}
+		vf->index = index;
+	}
+	vf->index[vf->nIntegration] = *entry;
+	++vf->nIntegration;
+
+	return 0;
+}
+
+/* load the .idx file, keeping only entries that agree with the data, then walk any blocks it does not cover */
+static int loadIndex(DifxVisIndexedFile *vf, const char *filename)
+{
+	char indexFilename[DIFXIO_FILENAME_LENGTH];
+	DifxVisIndexedEntry entry;
+	const DifxVisIndexedIntegration *integration;
+	uint64_t offset;
+	int nAlloc = 0;
+	FILE *in;
+	int v;
+
+	offset = sizeof(DifxVisIndexedFileHeader);
+
+	v = snprintf(indexFilename, DIFXIO_FILENAME_LENGTH, "%s.idx", filename);
+	if(v < DIFXIO_FILENAME_LENGTH)
+	{
+		in = fopen(indexFilename, "r");
+		if(in)
+		{
+			while(fread(&entry, sizeof(DifxVisIndexedEntry), 1, in) == 1)
+			{
+				if(entry.offset != offset || !isValidBlock(vf, entry.offset))
+				{
+					fprintf(stderr, "Warning: index %s disagrees with the data after %d integrations; scanning the rest\n", indexFilename, vf->nIntegration);
+					break;
+				}
+				if(appendIndexEntry(vf, &nAlloc, &entry) < 0)
+				{
+					fclose(in);
+
+					return -1;
+				}
+				offset += entry.blockBytes;
+			}
+			fclose(in);
+		}
+	}
+
+	while(isValidBlock(vf, offset))
+	{
+		integration = (const DifxVisIndexedIntegration *)(vf->map + offset);
+		entry.mjd = integration->mjd;
+		entry.nRecord = integration->nRecord;
+		entry.seconds = integration->seconds;
+		entry.offset = offset;
+		entry.blockBytes = integration->blockBytes;
+		if(appendIndexEntry(vf, &nAlloc, &entry) < 0)
+		{
+			return -1;
+		}
+		offset += entry.blockBytes;
+	}
+
+	return 0;
+}
+
+DifxVisIndexedFile *newDifxVisIndexedFile(const char *filename)
+{
+	DifxVisIndexedFile *vf;
+	struct stat st;
+
+	vf = (DifxVisIndexedFile *)calloc(1, sizeof(DifxVisIndexedFile));
+	if(vf == 0)
+	{
+		fprintf(stderr, "newDifxVisIndexedFile : malloc error\n");
+
+		return 0;
+	}
+
+	vf->fd = open(filename, O_RDONLY);
+	if(vf->fd < 0)
+	{
+		fprintf(stderr, "Cannot open %s\n", filename);
+		free(vf);
+
+		return 0;
+	}
+	if(fstat(vf->fd, &st) != 0 || st.st_size < (off_t)sizeof(DifxVisIndexedFileHeader))
+	{
+		fprintf(stderr, "%s is too short to be an indexed difx file\n", filename);
+		close(vf->fd);
+		free(vf);
+
+		return 0;
+	}
+
+	vf->mapLength = st.st_size;
+	vf->map = (const char *)mmap(0, vf->mapLength, PROT_READ, MAP_SHARED, vf->fd, 0);
+	if(vf->map == MAP_FAILED)
+	{
+		fprintf(stderr, "Cannot map %s\n", filename);
+		close(vf->fd);
+		free(vf);
+
+		return 0;
+	}
+	vf->header = (const DifxVisIndexedFileHeader *)vf->map;
+
+	if(vf->header->sync != VISINDEXED_FILE_SYNC_WORD || vf->header->version != VISINDEXED_VERSION ||
+	   vf->header->alignment <= 0 ||
+	   vf->header->integrationHeaderBytes != sizeof(DifxVisIndexedIntegration) ||
+	   vf->header->recordBytes != sizeof(DifxVisIndexedRecord) ||
+	   vf->header->indexEntryBytes != sizeof(DifxVisIndexedEntry))
+	{
+		fprintf(stderr, "%s is not an indexed difx file of version %d with this byte order\n", filename, VISINDEXED_VERSION);
+		deleteDifxVisIndexedFile(vf);
+
+		return 0;
+	}
+
+	if(loadIndex(vf, filename) < 0)
+	{
+		fprintf(stderr, "newDifxVisIndexedFile : malloc error\n");
+		deleteDifxVisIndexedFile(vf);
+
+		return 0;
+	}
+
+	return vf;
+}
+
+void deleteDifxVisIndexedFile(DifxVisIndexedFile *vf)
+{
+	if(vf)
+	{
+		if(vf->map && vf->map != MAP_FAILED)
+		{
+			munmap((void *)vf->map, vf->mapLength);
+		}
+		if(vf->fd >= 0)
+		{
+			close(vf->fd);
+		}
+		free(vf->index);
+		free(vf);
+	}
+}
+
+int DifxVisIndexedFilefindIntegration(const DifxVisIndexedFile *vf, int mjd, double seconds)
+{
+	int lo, hi, mid;
+	double t, midt;
+
+	t = mjd*86400.0 + seconds;
+	lo = 0;
+	hi = vf->nIntegration;
+	while(lo < hi)
+	{
+		mid = (lo + hi)/2;
+		midt = vf->index[mid].mjd*86400.0 + vf->index[mid].seconds;
+		if(midt < t)
+		{
+			lo = mid + 1;
+		}
+		else
+		{
+			hi = mid;
+		}
+	}
+
+	return (lo < vf->nIntegration) ? lo : -1;
+}
+
+const DifxVisIndexedIntegration *DifxVisIndexedFilegetIntegration(const DifxVisIndexedFile *vf, int n)
+{
+	if(n < 0 || n >= vf->nIntegration)
+	{
+		return 0;
+	}
+
+	return (const DifxVisIndexedIntegration *)(vf->map + vf->index[n].offset);
+}
+
+const DifxVisIndexedRecord *DifxVisIndexedFilegetRecords(const DifxVisIndexedFile *vf, int n, int *nRecord)
+{
+	const DifxVisIndexedIntegration *integration;
+
+	integration = DifxVisIndexedFilegetIntegration(vf, n);
+	if(integration == 0)
+	{
+		if(nRecord)
+		{
+			*nRecord = 0;
+		}
+
+		return 0;
+	}
+	if(nRecord)
+	{
+		*nRecord = integration->nRecord;
+	}
+
+	return (const DifxVisIndexedRecord *)(integration + 1);
+}
+
+int DifxVisIndexedFilefindRecord(const DifxVisIndexedFile *vf, int n, int baseline, int freqIndex, const char *pol)
+{
+	const DifxVisIndexedRecord *records;
+	int r, nRecord;
+
+	records = DifxVisIndexedFilegetRecords(vf, n, &nRecord);
+	for(r = 0; r < nRecord; ++r)
+	{
+		if(records[r].baseline == baseline && records[r].freqIndex == freqIndex &&
+		   (pol == 0 || (records[r].polPair[0] == pol[0] && records[r].polPair[1] == pol[1])))
+		{
+			return r;
+		}
+	}
+
+	return -1;
+}
+
+const cplx32f *DifxVisIndexedFilegetSpectrum(const DifxVisIndexedFile *vf, int n, int r)
+{
+	const DifxVisIndexedRecord *records;
+	int nRecord;
+
+	records = DifxVisIndexedFilegetRecords(vf, n, &nRecord);
+	if(r < 0 || r >= nRecord ||
+	   records[r].dataOffset + (uint64_t)records[r].nChan*sizeof(cplx32f) > vf->index[n].blockBytes)
+	{
+		return 0;
+	}
+
+	return (const cplx32f *)(vf->map + vf->index[n].offset + records[r].dataOffset);
+}
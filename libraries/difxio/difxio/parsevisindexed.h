@@ -0,0 +1,144 @@
+/***************************************************************************
+ *   Copyright (C) 2007-2020 by Walter Brisken & Adam Deller               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+//===========================================================================
+// SVN properties (DO NOT CHANGE)
+//
+// $Id$
+// $HeadURL$
+// $LastChangedRevision$
+// $Author$
+// $LastChangedDate$
+//
+//============================================================================
+
+#ifndef __PARSE_VIS_INDEXED_H__
+#define __PARSE_VIS_INDEXED_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include "parsevis.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* The indexed visibility format, written by mpifxcorr for OUTPUT FORMAT INDEXED
+ * to files DIFXI_<mjd>_<sec>.s<phasecentre>.b<pulsarbin>, in native byte order:
+ *
+ *   file header (64 bytes)
+ *   for each integration, a block aligned to 64 bytes:
+ *     integration header (64 bytes)
+ *     numRecords records (64 bytes each), padded to a multiple of 64 bytes
+ *     the spectra (nChan complex floats each), each padded to a multiple of 64 bytes
+ *
+ * Alongside each file, <file>.idx holds one 32 byte entry per integration
+ * giving its time and offset, so any integration can be found without reading
+ * the ones before it.  If the index is missing or short (e.g. after a crash)
+ * the remaining blocks are found by following the block lengths.
+ */
+
+#define VISINDEXED_FILE_SYNC_WORD		0x44495846
+#define VISINDEXED_INTEGRATION_SYNC_WORD	0x54494446
+#define VISINDEXED_VERSION			1
+
+typedef struct
+{
+	uint32_t sync;
+	int32_t version;
+	int32_t alignment;		/* bytes; blocks, tables and spectra start on multiples of this */
+	int32_t integrationHeaderBytes;
+	int32_t recordBytes;
+	int32_t indexEntryBytes;
+	uint8_t padding[40];
+} DifxVisIndexedFileHeader;
+
+typedef struct
+{
+	uint32_t sync;
+	int32_t nRecord;
+	int32_t mjd;
+	int32_t configIndex;
+	double seconds;			/* centre of the integration */
+	uint64_t blockBytes;		/* length of the block, header included */
+	int32_t phaseCentre;
+	int32_t pulsarBin;
+	uint8_t padding[24];
+} DifxVisIndexedIntegration;
+
+typedef struct
+{
+	int32_t baseline;		/* 256*A1 + A2, 1 indexed */
+	int32_t freqIndex;
+	int32_t sourceIndex;
+	int32_t pulsarBin;
+	char polPair[2];
+	int16_t flag;
+	int32_t nChan;
+	double dataWeight;
+	double uvw[3];			/* metres */
+	uint64_t dataOffset;		/* of the spectrum, from the start of the integration block */
+} DifxVisIndexedRecord;
+
+typedef struct
+{
+	int32_t mjd;
+	int32_t nRecord;
+	double seconds;
+	uint64_t offset;		/* of the integration block within the file */
+	uint64_t blockBytes;
+} DifxVisIndexedEntry;
+
+typedef struct
+{
+	int fd;
+	const char *map;		/* the whole file, memory mapped read only */
+	size_t mapLength;
+	const DifxVisIndexedFileHeader *header;
+	DifxVisIndexedEntry *index;	/* one entry per complete integration, in file order */
+	int nIntegration;
+} DifxVisIndexedFile;
+
+/* map an indexed difx file and load (or rebuild) its index; returns 0 on error */
+DifxVisIndexedFile *newDifxVisIndexedFile(const char *filename);
+
+/* unmap the file and free the index */
+void deleteDifxVisIndexedFile(DifxVisIndexedFile *vf);
+
+/* return the first integration whose time is at or after mjd+seconds, or -1 if none.
+ * Integrations are written in time order, so this is a binary search of the index */
+int DifxVisIndexedFilefindIntegration(const DifxVisIndexedFile *vf, int mjd, double seconds);
+
+/* return the header of integration n, or 0 if out of range */
+const DifxVisIndexedIntegration *DifxVisIndexedFilegetIntegration(const DifxVisIndexedFile *vf, int n);
+
+/* return the record table of integration n and set *nRecord, or 0 if out of range */
+const DifxVisIndexedRecord *DifxVisIndexedFilegetRecords(const DifxVisIndexedFile *vf, int n, int *nRecord);
+
+/* return the number of the record of integration n with the given baseline, freq index and
+ * (if pol is not 0) polarisation pair, or -1 if there is none */
+int DifxVisIndexedFilefindRecord(const DifxVisIndexedFile *vf, int n, int baseline, int freqIndex, const char *pol);
+
+/* return the spectrum (record->nChan values, straight out of the mapped file) of record r of integration n */
+const cplx32f *DifxVisIndexedFilegetSpectrum(const DifxVisIndexedFile *vf, int n, int r);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,239 @@
+/***************************************************************************
+ *   Copyright (C) 2008-2020 by Walter Brisken                             *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+/*===========================================================================
+ * SVN properties (DO NOT CHANGE)
+ *
+ * $Id$
+ * $HeadURL: https://svn.atnf.csiro.au/difx/libraries/mark5access/trunk/mark5access/mark5_stream.c $
+ * $LastChangedRevision$
+ * $Author$
+ * $LastChangedDate$
+ *
+ *==========================================================================*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include "difxio/parsedifx.h"
+
+/* Writes a synthetic .input/.calc style file for a large job, then times the
+ * lookup pattern of difx_input.c (per-antenna, per-baseline and per-scan keys,
+ * mostly searched from row 0) with and without the key index, checking that
+ * both find the same rows. */
+
+static const char scanKeys[][MAX_DIFX_KEY_LEN] =
+{
+	"SCAN %d IDENTIFIER",
+	"SCAN %d START (S)",
+	"SCAN %d DUR (S)",
+	"SCAN %d OBS MODE NAME",
+	"SCAN %d UVSHIFT INTERVAL (NS)",
+	"SCAN %d AC AVG INTERVAL (NS)",
+	"SCAN %d POINTING SRC",
+	"SCAN %d NUM PHS CTRS",
+	"SCAN %d PHS CTR 0"
+};
+static const int N_SCAN_ROWS = sizeof(scanKeys)/sizeof(scanKeys[0]);
+
+static const char antennaKeys[][MAX_DIFX_KEY_LEN] =
+{
+	"TELESCOPE %d NAME",
+	"TELESCOPE %d MOUNT",
+	"TELESCOPE %d OFFSET (m)",
+	"TELESCOPE %d X (m)",
+	"TELESCOPE %d Y (m)",
+	"TELESCOPE %d Z (m)",
+	"TELESCOPE %d SHELF"
+};
+static const int N_ANTENNA_ROWS = sizeof(antennaKeys)/sizeof(antennaKeys[0]);
+
+static double now()
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, 0);
+
+	return tv.tv_sec + tv.tv_usec*1.0e-6;
+}
+
+static int writeSynthetic(const char *filename, int nAntenna, int nScan, int nFreq)
+{
+	FILE *out;
+	int a, b, i, f, s;
+
+	out = fopen(filename, "w");
+	if(!out)
+	{
+		fprintf(stderr, "Cannot open %s for write\n", filename);
+
+		return -1;
+	}
+
+	fprintf(out, "# synthetic job for benchparsedifx\n");
+	fprintf(out, "NUM TELESCOPES:     %d\n", nAntenna);
+	for(a = 0; a < nAntenna; ++a)
+	{
+		for(i = 0; i < N_ANTENNA_ROWS; ++i)
+		{
+			char key[MAX_DIFX_KEY_LEN+1];
+
+			snprintf(key, MAX_DIFX_KEY_LEN+1, antennaKeys[i], a);
+			fprintf(out, "%-20s%d\n", strcat(key, ":"), a*10+i);
+		}
+	}
+	fprintf(out, "ACTIVE BASELINES:   %d\n", nAntenna*(nAntenna-1)/2);
+	b = 0;
+	for(a = 0; a < nAntenna; ++a)
+	{
+		for(i = a+1; i < nAntenna; ++i)
+		{
+			fprintf(out, "D/STREAM A INDEX %d: %d\n", b, a);
+			fprintf(out, "D/STREAM B INDEX %d: %d\n", b, i);
+			fprintf(out, "NUM FREQS %d:       %d\n", b, nFreq);
+			for(f = 0; f < nFreq; ++f)
+			{
+				fprintf(out, "POL PRODUCTS %d/%d:  4\n", b, f);
+				fprintf(out, "D/STREAM A BAND 0:  %d\n", f);
+				fprintf(out, "D/STREAM B BAND 0:  %d\n", f);
+			}
+			++b;
+		}
+	}
+	fprintf(out, "NUM SCANS:          %d\n", nScan);
+	for(s = 0; s < nScan; ++s)
+	{
+		for(i = 0; i < N_SCAN_ROWS; ++i)
+		{
+			char key[MAX_DIFX_KEY_LEN+1];
+
+			snprintf(key, MAX_DIFX_KEY_LEN+1, scanKeys[i], s);
+			fprintf(out, "%-20s%d\n", strcat(key, ":"), s*100+i);
+		}
+	}
+	fclose(out);
+
+	return 0;
+}
+
+/* the lookups; returns a checksum of the rows found */
+static long long lookups(const DifxParameters *dp, int nAntenna, int nScan, int nFreq)
+{
+	int rows[20];
+	long long sum = 0;
+	int a, b, f, n, r, s;
+
+	for(a = 0; a < nAntenna; ++a)
+	{
+		n = DifxParametersbatchfind1(dp, 0, antennaKeys, a, N_ANTENNA_ROWS, rows);
+		sum += n + rows[n-1];
+	}
+	for(b = 0; b < nAntenna*(nAntenna-1)/2; ++b)
+	{
+		r = DifxParametersfind1(dp, 0, "D/STREAM A INDEX %d", b);
+		r = DifxParametersfind1(dp, r, "NUM FREQS %d", b);
+		sum += r;
+		for(f = 0; f < nFreq; ++f)
+		{
+			r = DifxParametersfind2(dp, r, "POL PRODUCTS %d/%d", b, f);
+			r = DifxParametersfind(dp, r, "D/STREAM B BAND 0");
+			sum += r;
+		}
+	}
+	for(s = 0; s < nScan; ++s)
+	{
+		r = DifxParametersfind1(dp, 0, "SCAN %d START (S)", s);
+		n = DifxParametersbatchfind1(dp, r, scanKeys+2, s, N_SCAN_ROWS-2, rows);
+		sum += r + n + rows[n-1];
+	}
+
+	return sum;
+}
+
+int main(int argc, char **argv)
+{
+	const char *filename = "benchparsedifx.input";
+	DifxParameters *dp;
+	int nAntenna = 60;
+	int nScan = 2000;
+	int nFreq = 16;
+	double t0, t1, t2, t3;
+	long long sumIndexed, sumScanned;
+
+	if(argc > 1 && (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0))
+	{
+		fprintf(stderr, "Usage : %s [<nAntenna> [<nScan> [<nFreq>]]]\n\n", argv[0]);
+		fprintf(stderr, "Writes %s in the current directory and times key lookups in it.\n", filename);
+
+		return EXIT_SUCCESS;
+	}
+	if(argc > 1)
+	{
+		nAntenna = atoi(argv[1]);
+	}
+	if(argc > 2)
+	{
+		nScan = atoi(argv[2]);
+	}
+	if(argc > 3)
+	{
+		nFreq = atoi(argv[3]);
+	}
+	if(nAntenna < 2 || nScan < 1 || nFreq < 1)
+	{
+		fprintf(stderr, "Need at least 2 antennas, 1 scan and 1 freq\n");
+
+		return EXIT_FAILURE;
+	}
+
+	if(writeSynthetic(filename, nAntenna, nScan, nFreq) < 0)
+	{
+		return EXIT_FAILURE;
+	}
+
+	t0 = now();
+	dp = newDifxParametersfromfile(filename);
+	if(!dp)
+	{
+		return EXIT_FAILURE;
+	}
+	t1 = now();
+	sumIndexed = lookups(dp, nAntenna, nScan, nFreq);
+	t2 = now();
+	DifxParametersdeleteindex(dp);
+	sumScanned = lookups(dp, nAntenna, nScan, nFreq);
+	t3 = now();
+
+	printf("%d rows (%d antennas, %d scans, %d freqs)\n", dp->num_rows, nAntenna, nScan, nFreq);
+	printf("load + index : %8.3f s\n", t1 - t0);
+	printf("indexed finds: %8.3f s\n", t2 - t1);
+	printf("scanned finds: %8.3f s\n", t3 - t2);
+
+	deleteDifxParameters(dp);
+	remove(filename);
+
+	if(sumIndexed != sumScanned)
+	{
+		fprintf(stderr, "Error: indexed and scanned finds disagree (%lld != %lld)\n", sumIndexed, sumScanned);
+
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
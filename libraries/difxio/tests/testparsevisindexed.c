@@ -0,0 +1,116 @@
+/***************************************************************************
+ *   Copyright (C) 2007-2020 by Walter Brisken                             *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+/*===========================================================================
+ * SVN properties (DO NOT CHANGE)
+ *
+ * $Id$
+ * $HeadURL: https://svn.atnf.csiro.au/difx/libraries/mark5access/trunk/mark5access/mark5_stream.c $
+ * $LastChangedRevision$
+ * $Author$
+ * $LastChangedDate$
+ *
+ *==========================================================================*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "difxio/parsevisindexed.h"
+
+const char program[] = "testparsevisindexed";
+const char version[] = "0.1";
+const char verdate[] = "20201017";
+const char author[]  = "Walter Brisken";
+
+int usage(const char *pgm)
+{
+	fprintf(stderr, "%s ver. %s   %s %s\n\n", program, version, author, verdate);
+	fprintf(stderr, "usage : %s <indexed difx file> [<mjd> <seconds> [<baseline> <freqindex> [<pol>]]]\n\n", pgm);
+	fprintf(stderr, "Without a time, summarizes every integration of the file.  With a time, lists\n");
+	fprintf(stderr, "the records of the first integration at or after it, or prints one spectrum.\n\n");
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	DifxVisIndexedFile *vf;
+	const DifxVisIndexedIntegration *integration;
+	const DifxVisIndexedRecord *records;
+	const cplx32f *spectrum;
+	int n, r, k, nRecord;
+
+	if(argc < 2 || argc == 3)
+	{
+		return usage(argv[0]);
+	}
+
+	vf = newDifxVisIndexedFile(argv[1]);
+	if(!vf)
+	{
+		return EXIT_FAILURE;
+	}
+
+	if(argc == 2)
+	{
+		printf("%d integrations\n", vf->nIntegration);
+		for(n = 0; n < vf->nIntegration; ++n)
+		{
+			integration = DifxVisIndexedFilegetIntegration(vf, n);
+			printf("%d  MJD %d sec %.6f  config %d  %d records  offset %llu  bytes %llu\n", n, integration->mjd, integration->seconds, integration->configIndex, integration->nRecord, (unsigned long long)vf->index[n].offset, (unsigned long long)integration->blockBytes);
+		}
+	}
+	else
+	{
+		n = DifxVisIndexedFilefindIntegration(vf, atoi(argv[2]), atof(argv[3]));
+		if(n < 0)
+		{
+			fprintf(stderr, "No integration at or after %s %s\n", argv[2], argv[3]);
+			deleteDifxVisIndexedFile(vf);
+
+			return EXIT_FAILURE;
+		}
+		records = DifxVisIndexedFilegetRecords(vf, n, &nRecord);
+		if(argc < 6)
+		{
+			for(r = 0; r < nRecord; ++r)
+			{
+				printf("%d  baseline %d  freq %d  pol %c%c  bin %d  nchan %d  weight %f  uvw %f %f %f\n", r, records[r].baseline, records[r].freqIndex, records[r].polPair[0], records[r].polPair[1], records[r].pulsarBin, records[r].nChan, records[r].dataWeight, records[r].uvw[0], records[r].uvw[1], records[r].uvw[2]);
+			}
+		}
+		else
+		{
+			r = DifxVisIndexedFilefindRecord(vf, n, atoi(argv[4]), atoi(argv[5]), argc > 6 ? argv[6] : 0);
+			spectrum = DifxVisIndexedFilegetSpectrum(vf, n, r);
+			if(!spectrum)
+			{
+				fprintf(stderr, "No such record in integration %d\n", n);
+				deleteDifxVisIndexedFile(vf);
+
+				return EXIT_FAILURE;
+			}
+			for(k = 0; k < records[r].nChan; ++k)
+			{
+				printf("%d %f %f\n", k, creal(spectrum[k]), cimag(spectrum[k]));
+			}
+		}
+	}
+
+	deleteDifxVisIndexedFile(vf);
+
+	return EXIT_SUCCESS;
+}
@@ -60,6 +60,7 @@ extern "C" {
 #define DIFX_MESSAGE_DISC_SERIAL_LENGTH	31
 #define DIFX_MESSAGE_DISC_MODEL_LENGTH	31
 #define DIFX_MESSAGE_MAX_SMART_IDS	32
+#define DIFX_MESSAGE_N_PROFILE_BINS	32	/* bin i counts durations of [2^i, 2^(i+1)) ns */
 #define DIFX_MESSAGE_MAX_INET_ADDRESS_LENGTH	64
 #define DIFX_MESSAGE_HOSTNAME_LENGTH	256
 
@@ -192,6 +193,7 @@ enum DifxDiagnosticType
 	DIFX_DIAGNOSTIC_DATACONSUMED,
 	DIFX_DIAGNOSTIC_INPUTDATARATE,
 	DIFX_DIAGNOSTIC_NUMSUBINTSLOST,
+	DIFX_DIAGNOSTIC_STAGEPROFILE,
 	NUM_DIFX_DIAGNOSTIC_TYPES	/* this needs to be the last line of enum */
 };
 
@@ -569,6 +571,9 @@ typedef struct
 	double microsec;
 	double rateMbps;
 	int bufferstatus[3];
+	char stage[DIFX_MESSAGE_PARAM_LENGTH];		/* only for StageProfile */
+	int nProfileBin;				/* only for StageProfile */
+	long long profileHistogram[DIFX_MESSAGE_N_PROFILE_BINS];	/* only for StageProfile */
 } DifxMessageDiagnostic;
 
 typedef struct
@@ -671,6 +676,13 @@ void difxMessageGetMulticastGroupPort(char *group, int *port);
 
 const char *getDifxMessageIdentifier();
 
+/* Once started, messages are queued and sent by a background thread; see difxsendqueue.c */
+#define DIFX_MESSAGE_SEND_COALESCE	0x01	/* pack consecutive diagnostic messages into one datagram */
+int difxMessageStartSendThread(int flags);
+int difxMessageFlushSendQueue();
+int difxMessageStopSendThread();	/* sends whatever is still queued first */
+void difxMessageGetSendQueueStatistics(long long *nMessage, long long *nDatagramSent);
+
 int difxMessageSend2(const char *message, int size);
 int difxMessageSendProcessState(const char *state);
 int difxMessageSendMark6Status(const DifxMessageMark6Status *mark6status);
@@ -691,6 +703,7 @@ int difxMessageSendDifxDiagnosticMemoryUsage(long long membytes);
 int difxMessageSendDifxDiagnosticDataConsumed(long long bytes);
 int difxMessageSendDifxDiagnosticInputDatarate(double bytespersec);
 int difxMessageSendDifxDiagnosticNumSubintsLost(int numsubintslost);
+int difxMessageSendDifxDiagnosticStageProfile(int threadid, const char *stage, long long count, double totalMicrosec, int nBin, const long long *histogram);
 int difxMessageSendDifxParameter(const char *name, const char *value, int mpiDestination);
 int difxMessageSendDifxParameterTo(const char *name, const char *value, const char *to);
 int difxMessageSendDifxParameter1(const char *name, int index1, const char *value, int mpiDestination);
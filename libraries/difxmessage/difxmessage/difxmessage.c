@@ -151,7 +151,8 @@ const char DifxDiagnosticStrings[][24] =
 	"ProcessingTime",
 	"DataConsumed",
 	"InputDatarate",
-	"NumSubintsLost"
+	"NumSubintsLost",
+	"StageProfile"
 };
 
 /* Note! Keep this in sync with enum DifxAlertLevel in difxmessage.h */
@@ -50,4 +50,7 @@ extern int difxBinaryLTAPort;
 extern int difxMessageInUse;
 extern int difxMessageUnicast;
 
+int difxMessageSendPaced(const char *message, int size);
+int difxMessageEnqueue(const char *message, int size, int coalesce);
+
 #endif
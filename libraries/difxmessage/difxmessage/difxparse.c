@@ -843,6 +843,32 @@ static void XMLCALL endElement(void *userData, const char *name)
 					{
 						G->body.diagnostic.microsec = atof(s);
 					}
+					else if(strcmp(elem, "stage") == 0)
+					{
+						strncpy(G->body.diagnostic.stage, s, DIFX_MESSAGE_PARAM_LENGTH-1);
+						G->body.diagnostic.stage[DIFX_MESSAGE_PARAM_LENGTH-1] = 0;
+					}
+					else if(strcmp(elem, "counts") == 0)
+					{
+						G->body.diagnostic.counter = atoll(s);
+					}
+					else if(strcmp(elem, "histogram") == 0)
+					{
+						const char *p = s;
+						char *end;
+						int n;
+
+						for(n = 0; n < DIFX_MESSAGE_N_PROFILE_BINS; ++n)
+						{
+							G->body.diagnostic.profileHistogram[n] = strtoll(p, &end, 10);
+							if(end == p)
+							{
+								break;
+							}
+							p = end;
+						}
+						G->body.diagnostic.nProfileBin = n;
+					}
 					break;
 				case DIFX_MESSAGE_FILETRANSFER:
 					if(strcmp(elem, "origin") == 0 )
@@ -1260,6 +1286,16 @@ void difxMessageGenericPrint(const DifxMessageGeneric *G)
 		printf("    numBufElements = %d\n", G->body.diagnostic.bufferstatus[0]);
 		printf("    startBufElement = %d\n", G->body.diagnostic.bufferstatus[1]);
 		printf("    activeBufElements = %d\n", G->body.diagnostic.bufferstatus[2]);
+		if(G->body.diagnostic.diagnosticType == DIFX_DIAGNOSTIC_STAGEPROFILE)
+		{
+			printf("    stage = %s\n", G->body.diagnostic.stage);
+			printf("    histogram =");
+			for(i = 0; i < G->body.diagnostic.nProfileBin; ++i)
+			{
+				printf(" %lld", G->body.diagnostic.profileHistogram[i]);
+			}
+			printf("\n");
+		}
 		break;
 	case DIFX_MESSAGE_START:
 		printf("    MPI wrapper = %s\n", G->body.start.mpiWrapper);
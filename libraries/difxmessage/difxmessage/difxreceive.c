@@ -27,6 +27,8 @@
 //
 //============================================================================
 #include <stdio.h>
+#include <string.h>
+#include <pthread.h>
 #include <sys/socket.h>
 #include "../difxmessage.h"
 #include "difxmessageinternal.h"
@@ -53,12 +55,144 @@ int difxMessageReceiveOpen()
 	return sock;
 }
 
+/* Datagrams from a coalescing sender (see difxsendqueue.c) hold several messages separated by NUL.
+ * The ones not yet returned are kept here, per receive socket.
+ */
+#define MAX_PENDING_SOCKETS	8
+
+typedef struct
+{
+	int sock;
+	int start;		/* offset of next message in buffer */
+	int end;		/* bytes in buffer */
+	char from[16];
+	char buffer[DIFX_MESSAGE_LENGTH];
+} DifxMessagePending;
+
+static DifxMessagePending pending[MAX_PENDING_SOCKETS];
+static int nPending = 0;
+static pthread_mutex_t pendingLock = PTHREAD_MUTEX_INITIALIZER;
+
+static DifxMessagePending *getPending(int sock, int create)
+{
+	int i;
+
+	for(i = 0; i < nPending; ++i)
+	{
+		if(pending[i].sock == sock)
+		{
+			return pending + i;
+		}
+	}
+	if(create && nPending < MAX_PENDING_SOCKETS)
+	{
+		pending[nPending].sock = sock;
+		pending[nPending].start = pending[nPending].end = 0;
+		
+		return pending + nPending++;
+	}
+
+	return 0;
+}
+
+/* Copy the next message (up to a NUL or the end) from P into message; returns its length or 0 if none left */
+static int nextPending(DifxMessagePending *P, char *message, int maxlen, char *from)
+{
+	const char *nul;
+	int n;
+
+	/* skip separators */
+	while(P->start < P->end && P->buffer[P->start] == 0)
+	{
+		++P->start;
+	}
+	if(P->start >= P->end)
+	{
+		return 0;
+	}
+	nul = memchr(P->buffer + P->start, 0, P->end - P->start);
+	n = nul ? (nul - (P->buffer + P->start)) : (P->end - P->start);
+	if(n > maxlen)
+	{
+		n = maxlen;
+	}
+	memcpy(message, P->buffer + P->start, n);
+	P->start += n;
+	if(from != 0)
+	{
+		strncpy(from, P->from, 16);
+	}
+
+	return n;
+}
+
 int difxMessageReceiveClose(int sock)
 {
+	DifxMessagePending *P;
+
+	pthread_mutex_lock(&pendingLock);
+	P = getPending(sock, 0);
+	if(P)
+	{
+		P->start = P->end = 0;
+	}
+	pthread_mutex_unlock(&pendingLock);
+
 	return closeMultiCastSocket(sock);
 }
 
 int difxMessageReceive(int sock, char *message, int maxlen, char *from)
 {
-	return MultiCastReceive(sock, message, maxlen, from);
+	DifxMessagePending *P;
+	const char *nul;
+	int n;
+
+	pthread_mutex_lock(&pendingLock);
+	P = getPending(sock, 0);
+	if(P)
+	{
+		n = nextPending(P, message, maxlen, from);
+		if(n > 0)
+		{
+			pthread_mutex_unlock(&pendingLock);
+
+			return n;
+		}
+	}
+	pthread_mutex_unlock(&pendingLock);
+
+	n = MultiCastReceive(sock, message, maxlen, from);
+	if(n <= 0)
+	{
+		return n;
+	}
+
+	nul = memchr(message, 0, n);
+	if(nul == 0 || nul - message >= n - 1)
+	{
+		/* the usual case: a single message */
+		return n;
+	}
+
+	/* several messages; return the first and keep the rest */
+	pthread_mutex_lock(&pendingLock);
+	P = getPending(sock, 1);
+	if(P && n - (nul - message) <= DIFX_MESSAGE_LENGTH)
+	{
+		P->start = 0;
+		P->end = n - (nul - message);
+		memcpy(P->buffer, nul, P->end);
+		if(from != 0)
+		{
+			strncpy(P->from, from, 15);
+			P->from[15] = 0;
+		}
+		else
+		{
+			P->from[0] = 0;
+		}
+	}
+	pthread_mutex_unlock(&pendingLock);
+
+	return nul - message;
 }
@@ -95,7 +95,8 @@ static int expandEntityReferences(char *dest, const char *src, int maxLength)
 	return j - i;
 }
 
-int difxMessageSend2(const char *message, int size)
+/* Send one datagram now, keeping at least MIN_SEND_GAP microseconds since the previous one */
+int difxMessageSendPaced(const char *message, int size)
 {
 	static int first = 1;
 	static struct timeval tv0;
@@ -137,6 +138,43 @@ int difxMessageSend2(const char *message, int size)
 	return MulticastSend(difxMessageGroup, difxMessagePort, message, size);
 }
 
+int difxMessageSend2(const char *message, int size)
+{
+	int v;
+
+	if(difxMessagePort < 0)
+	{
+		return -1;
+	}
+
+	v = difxMessageEnqueue(message, size, 0);
+	if(v != -2)
+	{
+		return v;
+	}
+
+	return difxMessageSendPaced(message, size);
+}
+
+/* Diagnostics may be packed with others into one datagram */
+static int difxMessageSendDiagnostic(const char *message, int size)
+{
+	int v;
+
+	if(difxMessagePort < 0)
+	{
+		return -1;
+	}
+
+	v = difxMessageEnqueue(message, size, 1);
+	if(v != -2)
+	{
+		return v;
+	}
+
+	return difxMessageSendPaced(message, size);
+}
+
 int difxMessageSend(const char *message)
 {
 	return difxMessageSend2(message, strlen(message));
@@ -266,6 +304,12 @@ int difxMessageSendDifxAlert(const char *alertMessage, int severity)
 
 		difxMessageSend2(message, size);
 
+		/* A process often aborts right after a fatal or severe alert, so don't leave it queued */
+		if(severity <= DIFX_ALERT_LEVEL_SEVERE)
+		{
+			difxMessageFlushSendQueue();
+		}
+
 		/* Make sure all fatal errors go to the console */
 		if(severity == DIFX_ALERT_LEVEL_FATAL)
 		{
@@ -1448,7 +1492,7 @@ int difxMessageSendDifxDiagnosticBufferStatus(int threadid, int numelements, int
 		return -1;
 	}
 	
-	return difxMessageSend2(message, size);
+	return difxMessageSendDiagnostic(message, size);
 }
 
 int difxMessageSendDifxDiagnosticNumSubintsLost(int numsubintslost)
@@ -1485,7 +1529,7 @@ int difxMessageSendDifxDiagnosticNumSubintsLost(int numsubintslost)
 		return -1;
 	}
 	
-	return difxMessageSend2(message, size);
+	return difxMessageSendDiagnostic(message, size);
 }
 
 int difxMessageSendDifxDiagnosticInputDatarate(double bytespersec)
@@ -1522,7 +1566,7 @@ int difxMessageSendDifxDiagnosticInputDatarate(double bytespersec)
 		return -1;
 	}
 	
-	return difxMessageSend2(message, size);
+	return difxMessageSendDiagnostic(message, size);
 }
 
 int difxMessageSendDifxDiagnosticDataConsumed(long long bytes)
@@ -1559,7 +1603,7 @@ int difxMessageSendDifxDiagnosticDataConsumed(long long bytes)
 		return -1;
 	}
 	
-	return difxMessageSend2(message, size);
+	return difxMessageSendDiagnostic(message, size);
 }
 
 int difxMessageSendDifxDiagnosticMemoryUsage(long long membytes)
@@ -1596,7 +1640,7 @@ int difxMessageSendDifxDiagnosticMemoryUsage(long long membytes)
 		return -1;
 	}
 	
-	return difxMessageSend2(message, size);
+	return difxMessageSendDiagnostic(message, size);
 }
 
 int difxMessageSendDifxDiagnosticProcessingTime(int threadid, double durationMicrosec)
@@ -1635,7 +1679,73 @@ int difxMessageSendDifxDiagnosticProcessingTime(int threadid, double durationMic
 		return -1;
 	}
 	
-	return difxMessageSend2(message, size);
+	return difxMessageSendDiagnostic(message, size);
+}
+
+int difxMessageSendDifxDiagnosticStageProfile(int threadid, const char *stage, long long count, double totalMicrosec, int nBin, const long long *histogram)
+{
+	char message[DIFX_MESSAGE_LENGTH];
+	char body[DIFX_MESSAGE_LENGTH];
+	char histogramString[DIFX_MESSAGE_LENGTH/2];
+	int size;
+	int i;
+	int v;
+
+	if(nBin > DIFX_MESSAGE_N_PROFILE_BINS)
+	{
+		nBin = DIFX_MESSAGE_N_PROFILE_BINS;
+	}
+
+	v = 0;
+	histogramString[0] = 0;
+	for(i = 0; i < nBin; ++i)
+	{
+		v += snprintf(histogramString + v, sizeof(histogramString) - v, "%s%lld", (i > 0 ? " " : ""), histogram[i]);
+		if(v >= (int)sizeof(histogramString))
+		{
+			fprintf(stderr, "difxMessageSendDifxDiagnostic: histogram overflow (%d >= %d)\n", v, (int)sizeof(histogramString));
+
+			return -1;
+		}
+	}
+
+	size = snprintf(body, DIFX_MESSAGE_LENGTH,
+
+		"<difxDiagnostic>"
+		  "<diagnosticType>%s</diagnosticType>"
+		  "<threadId>%d</threadId>"
+		  "<stage>%s</stage>"
+		  "<counts>%lld</counts>"
+		  "<microsec>%f</microsec>"
+		  "<histogram>%s</histogram>"
+		"</difxDiagnostic>",
+		DifxDiagnosticStrings[DIFX_DIAGNOSTIC_STAGEPROFILE],
+		threadid,
+		stage,
+		count,
+		totalMicrosec,
+		histogramString);
+
+	if(size >= DIFX_MESSAGE_LENGTH)
+	{
+		fprintf(stderr, "difxMessageSendDifxDiagnostic: message body overflow (%d >= %d)\n", size, DIFX_MESSAGE_LENGTH);
+	
+		return -1;
+	}
+	
+	size = snprintf(message, DIFX_MESSAGE_LENGTH,
+		difxMessageXMLFormat,
+		DifxMessageTypeStrings[DIFX_MESSAGE_DIAGNOSTIC],
+		difxMessageSequenceNumber++, body);
+	
+	if(size >= DIFX_MESSAGE_LENGTH)
+	{
+		fprintf(stderr, "difxMessageSendDifxDiagnostic: message overflow (%d >= %d)\n", size, DIFX_MESSAGE_LENGTH);
+	
+		return -1;
+	}
+	
+	return difxMessageSendDiagnostic(message, size);
 }
 
 int difxMessageSendDifxTransient(const DifxMessageTransient *transient)
@@ -0,0 +1,279 @@
+/***************************************************************************
+ *   Copyright (C) 2007-2020 by Walter Brisken                             *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+//===========================================================================
+// SVN properties (DO NOT CHANGE)
+//
+// $Id$
+// $HeadURL$
+// $LastChangedRevision$
+// $Author$
+// $LastChangedDate$
+//
+//============================================================================
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "../difxmessage.h"
+#include "difxmessageinternal.h"
+
+/* Asynchronous sending of difx messages.
+ *
+ * Once difxMessageStartSendThread() has been called, difxMessageSend2() (and so all of the
+ * difxMessageSend* functions) only copy the message into a queue; a background thread sends
+ * them in order, keeping the minimum gap between datagrams.  With DIFX_MESSAGE_SEND_COALESCE,
+ * runs of queued diagnostic messages are packed into one datagram, separated by NUL characters.
+ * Each packed message is a complete, unchanged XML document; difxMessageReceive() hands them
+ * back one at a time.  A receiver built against an older difxmessage sees only the first.
+ */
+
+#define DIFX_MESSAGE_QUEUE_LENGTH	1024
+
+typedef struct
+{
+	int size;
+	int coalesce;
+	char *message;
+} DifxMessageQueueEntry;
+
+static pthread_mutex_t queueLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queueNotEmpty = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t queueNotFull = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t queueDrained = PTHREAD_COND_INITIALIZER;
+static pthread_t sendThread;
+static DifxMessageQueueEntry *queue = 0;
+static int queueHead = 0;		/* next entry to send */
+static int queueCount = 0;		/* entries waiting */
+static int queueActive = 0;		/* 1 while the send thread is accepting messages */
+static int queueStopping = 0;
+static int sendInProgress = 0;		/* the send thread holds a datagram not yet sent */
+static int queueFlags = 0;
+static long long nDatagram = 0;
+static long long nQueuedMessage = 0;
+
+static void *sendThreadFunction(void *arg)
+{
+	static char datagram[DIFX_MESSAGE_LENGTH];
+	int size;
+
+	pthread_mutex_lock(&queueLock);
+	for(;;)
+	{
+		const DifxMessageQueueEntry *E;
+
+		while(queueCount == 0 && !queueStopping)
+		{
+			pthread_cond_wait(&queueNotEmpty, &queueLock);
+		}
+		if(queueCount == 0)
+		{
+			/* stopping and nothing left to send */
+			break;
+		}
+
+		E = queue + queueHead;
+		memcpy(datagram, E->message, E->size);
+		size = E->size;
+		free(E->message);
+		queueHead = (queueHead + 1) % DIFX_MESSAGE_QUEUE_LENGTH;
+		--queueCount;
+
+		if(E->coalesce && (queueFlags & DIFX_MESSAGE_SEND_COALESCE))
+		{
+			/* Receivers read at most DIFX_MESSAGE_LENGTH-1 bytes, so stay below that */
+			while(queueCount > 0)
+			{
+				E = queue + queueHead;
+				if(!E->coalesce || size + 1 + E->size > DIFX_MESSAGE_LENGTH-1)
+				{
+					break;
+				}
+				datagram[size] = 0;
+				memcpy(datagram + size + 1, E->message, E->size);
+				size += 1 + E->size;
+				free(E->message);
+				queueHead = (queueHead + 1) % DIFX_MESSAGE_QUEUE_LENGTH;
+				--queueCount;
+			}
+		}
+		sendInProgress = 1;
+		pthread_cond_broadcast(&queueNotFull);
+		pthread_mutex_unlock(&queueLock);
+
+		difxMessageSendPaced(datagram, size);
+
+		pthread_mutex_lock(&queueLock);
+		sendInProgress = 0;
+		++nDatagram;
+		if(queueCount == 0)
+		{
+			pthread_cond_broadcast(&queueDrained);
+		}
+	}
+	pthread_cond_broadcast(&queueDrained);
+	pthread_mutex_unlock(&queueLock);
+
+	return 0;
+}
+
+int difxMessageStartSendThread(int flags)
+{
+	int v;
+
+	if(difxMessagePort < 0)
+	{
+		return -1;
+	}
+
+	pthread_mutex_lock(&queueLock);
+	if(queueActive)
+	{
+		queueFlags = flags;
+		pthread_mutex_unlock(&queueLock);
+
+		return 0;
+	}
+	queue = (DifxMessageQueueEntry *)calloc(DIFX_MESSAGE_QUEUE_LENGTH, sizeof(DifxMessageQueueEntry));
+	if(!queue)
+	{
+		pthread_mutex_unlock(&queueLock);
+		fprintf(stderr, "Error: difxMessageStartSendThread: cannot allocate message queue\n");
+
+		return -2;
+	}
+	queueHead = queueCount = 0;
+	queueStopping = 0;
+	queueFlags = flags;
+	nDatagram = nQueuedMessage = 0;
+
+	v = pthread_create(&sendThread, 0, sendThreadFunction, 0);
+	if(v != 0)
+	{
+		free(queue);
+		queue = 0;
+		pthread_mutex_unlock(&queueLock);
+		fprintf(stderr, "Error: difxMessageStartSendThread: cannot start send thread (%d); messages will be sent synchronously\n", v);
+
+		return -3;
+	}
+	queueActive = 1;
+	pthread_mutex_unlock(&queueLock);
+
+	return 0;
+}
+
+int difxMessageFlushSendQueue()
+{
+	pthread_mutex_lock(&queueLock);
+	while(queueActive && (queueCount > 0 || sendInProgress))
+	{
+		pthread_cond_wait(&queueDrained, &queueLock);
+	}
+	pthread_mutex_unlock(&queueLock);
+
+	return 0;
+}
+
+int difxMessageStopSendThread()
+{
+	pthread_mutex_lock(&queueLock);
+	if(!queueActive)
+	{
+		pthread_mutex_unlock(&queueLock);
+
+		return -1;
+	}
+	queueStopping = 1;
+	pthread_cond_broadcast(&queueNotEmpty);
+	pthread_mutex_unlock(&queueLock);
+
+	pthread_join(sendThread, 0);
+
+	pthread_mutex_lock(&queueLock);
+	queueActive = 0;
+	queueStopping = 0;
+	free(queue);
+	queue = 0;
+	/* wake anyone who was waiting for space; they will now send directly */
+	pthread_cond_broadcast(&queueNotFull);
+	pthread_cond_broadcast(&queueDrained);
+	pthread_mutex_unlock(&queueLock);
+
+	return 0;
+}
+
+/* Returns size on success, or -2 if the message could not be queued (no send thread running,
+ * message too long, out of memory), in which case the caller should send it directly.
+ * Waits for space if the queue is full.
+ */
+int difxMessageEnqueue(const char *message, int size, int coalesce)
+{
+	DifxMessageQueueEntry *E;
+	char *copy;
+
+	if(!queueActive || size <= 0 || size > DIFX_MESSAGE_LENGTH)
+	{
+		/* unlocked peek at queueActive; the common case when asynchronous sending was never started */
+		return -2;
+	}
+	copy = (char *)malloc(size);
+	if(!copy)
+	{
+		return -2;
+	}
+	memcpy(copy, message, size);
+
+	pthread_mutex_lock(&queueLock);
+	while(queueActive && !queueStopping && queueCount >= DIFX_MESSAGE_QUEUE_LENGTH)
+	{
+		pthread_cond_wait(&queueNotFull, &queueLock);
+	}
+	if(!queueActive || queueStopping)
+	{
+		pthread_mutex_unlock(&queueLock);
+		free(copy);
+
+		return -2;
+	}
+
+	E = queue + (queueHead + queueCount) % DIFX_MESSAGE_QUEUE_LENGTH;
+	E->message = copy;
+	E->size = size;
+	E->coalesce = coalesce;
+	++queueCount;
+	++nQueuedMessage;
+	pthread_cond_signal(&queueNotEmpty);
+	pthread_mutex_unlock(&queueLock);
+
+	return size;
+}
+
+void difxMessageGetSendQueueStatistics(long long *nMessage, long long *nDatagramSent)
+{
+	pthread_mutex_lock(&queueLock);
+	if(nMessage)
+	{
+		*nMessage = nQueuedMessage;
+	}
+	if(nDatagramSent)
+	{
+		*nDatagramSent = nDatagram;
+	}
+	pthread_mutex_unlock(&queueLock);
+}
@@ -33,29 +33,40 @@
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
+#include <pthread.h>
 #include "../difxmessage.h"
 
+/* One socket, opened on first use, serves every send from this process */
+static int sendSocket = -1;
+static pthread_once_t sendSocketOnce = PTHREAD_ONCE_INIT;
+
+static void openSendSocket()
+{
+        unsigned char ttl=3;    /* time-to-live.  Max hops before discard */
+
+        sendSocket = socket(AF_INET, SOCK_DGRAM, 0);
+        if(sendSocket >= 0)
+        {
+                setsockopt(sendSocket, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+        }
+}
+
 int MulticastSend(const char *group, int port, const char *message, int length)
 {
         struct sockaddr_in addr;
-        int fd, l;
-        unsigned char ttl=3;    /* time-to-live.  Max hops before discard */
+        int l;
 
-        fd = socket(AF_INET, SOCK_DGRAM, 0);
-        if(fd < 0)
+        pthread_once(&sendSocketOnce, openSendSocket);
+        if(sendSocket < 0)
         {
                 return -1;
         }
 
-        setsockopt(fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
-
         memset(&addr, 0, sizeof(addr));
         addr.sin_family = AF_INET;
         addr.sin_addr.s_addr = inet_addr(group);
         addr.sin_port = htons(port);
-        l = sendto(fd, message, length, 0, (struct sockaddr *)&addr, sizeof(addr));
-
-        close(fd);
+        l = sendto(sendSocket, message, length, 0, (struct sockaddr *)&addr, sizeof(addr));
 
         return l;
 }
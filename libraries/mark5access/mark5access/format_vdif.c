@@ -44,6 +44,7 @@
 static unsigned char VDIF_FILL_BYTES[4] = { 0x44, 0x33, 0x22, 0x11 };
 
 #include "mark5access/mark5_stream.h"
+#include "mark5access/mark5_simd_decode.h"
 
 static const float HiMag = OPTIMAL_2BIT_HIGH;
 static const float FourBit1sigma = 2.95;
@@ -59,6 +60,10 @@ static float complex complex_lut1bit[256][4];
 static float complex complex_lut2bit[256][2];
 static float complex complex_lut4bit[256];
 
+/* code -> value tables for the frame-at-a-time decoders */
+static float levels2bit[4];
+static float levels4bit[16];
+
 /* for use in counting high states; 2-bit support only at this time */
 static unsigned char countlut2bit[256][4];
 
@@ -86,6 +91,8 @@ static void initluts()
 		zeros[i] = 0.0;
 		complex_zeros[i] = 0.0+0.0*I;
 	}
+	memcpy(levels2bit, lut4level, sizeof(levels2bit));
+	memcpy(levels4bit, lut16level, sizeof(levels4bit));
 
 	for(b = 0; b < 256; b++)
 	{
@@ -227,6 +234,27 @@ static int mark5_stream_frame_time_vdif(const struct mark5_stream *ms, int *mjd,
 
 /************************* decode routines **************************/
 
+/* Frame-at-a-time decoders, used in place of the ones below where the CPU allows */
+
+static int vdif_decode_simd(struct mark5_stream *ms, int nsamp, float **data)
+{
+	return mark5_simd_decode_frames(ms, nsamp, data, ms->nbit, ms->nchan,
+		(ms->nbit == 2) ? levels2bit : levels4bit, ms->databytes, 0);
+}
+
+/* single channel complex samples are real and imaginary codes alternating, so decode as one real stream */
+static int vdif_complex_decode_simd(struct mark5_stream *ms, int nsamp, float complex **data)
+{
+	float *fdata;
+	int n;
+
+	fdata = (float *)(data[0]);
+	n = mark5_simd_decode_frames(ms, 2*nsamp, &fdata, ms->nbit, 1,
+		(ms->nbit == 2) ? levels2bit : levels4bit, ms->databytes, 0);
+
+	return (n < 0) ? n : n/2;
+}
+
 static int vdif_decode_1channel_1bit_decimation1(struct mark5_stream *ms, int nsamp, float **data)
 {
 	const unsigned char *buf;
@@ -4303,6 +4331,10 @@ struct mark5_format_generic *new_mark5_format_generalized_vdif(int framesperperi
 		
 		return 0;
 	    }
+	    if((nbit == 2 || nbit == 4) && mark5_simd_decode_supported(nbit, nchan))
+	    {
+		f->decode = vdif_decode_simd;
+	    }
 	}
 	else
 	{
@@ -4402,6 +4434,10 @@ struct mark5_format_generic *new_mark5_format_generalized_vdif(int framesperperi
 
 		return 0;
 	    }
+	    if(nchan == 1 && (nbit == 2 || nbit == 4) && mark5_simd_decode_supported(nbit, 1))
+	    {
+		f->complex_decode = vdif_complex_decode_simd;
+	    }
 
 	}
 
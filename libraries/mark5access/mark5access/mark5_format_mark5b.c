@@ -37,6 +37,7 @@
 #include <string.h>
 #include <math.h>
 #include "mark5access/mark5_stream.h"
+#include "mark5access/mark5_simd_decode.h"
 
 #define MK5B_PAYLOADSIZE 10000
 
@@ -55,6 +56,7 @@ static float lut1bit[256][8];
 static float lut2bit[256][4];
 static unsigned char countlut2bit[256][4];
 static float zeros[8];
+static float levels2bit[4];	/* code (sign + 2*mag) -> value, for the frame-at-a-time decoder */
 
 static void initluts()
 {
@@ -66,6 +68,7 @@ static void initluts()
 	{
 		zeros[i] = 0.0;
 	}
+	memcpy(levels2bit, lut4level, sizeof(levels2bit));
 
 	for(b = 0; b < 256; ++b)
 	{
@@ -1302,6 +1305,19 @@ static int mark5b_decode_32bitstream_1bit_decimation4(struct mark5_stream *ms, i
 
 /************************ 2-bit decoders *********************/
 
+/* the invalid data bit of the frame header */
+static int mark5b_frame_invalid(const struct mark5_stream *ms)
+{
+	return ms->payload[-11] & 0x80;
+}
+
+/* frame-at-a-time decoder, used in place of the decimation1 ones below where the CPU allows */
+static int mark5b_decode_2bit_simd(struct mark5_stream *ms, int nsamp, float **data)
+{
+	return mark5_simd_decode_frames(ms, nsamp, data, 2, ms->nchan, levels2bit, MK5B_PAYLOADSIZE, mark5b_frame_invalid);
+}
+
+
 static int mark5b_decode_2bitstream_2bit_decimation1(struct mark5_stream *ms, int nsamp, float **data)
 {
 	const unsigned char *buf;
@@ -3244,6 +3260,10 @@ struct mark5_format_generic *new_mark5_format_mark5b(int Mbps, int nchan, int nb
 
 		return 0;
 	}
+	if(decimation == 1 && nbit == 2 && mark5_simd_decode_supported(nbit, nchan))
+	{
+		f->decode = mark5b_decode_2bit_simd;
+	}
 
 	return f;
 }
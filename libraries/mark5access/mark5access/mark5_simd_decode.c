@@ -0,0 +1,489 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by Walter Brisken                                  *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+//===========================================================================
+// SVN properties (DO NOT CHANGE)
+//
+// $Id$
+// $HeadURL$
+// $LastChangedRevision$
+// $Author$
+// $LastChangedDate$
+//
+//============================================================================
+
+#include <stdlib.h>
+#include <string.h>
+#include "config.h"
+#include "mark5access/mark5_simd_decode.h"
+
+/* define MARK5_NO_SIMD to build without the x86 kernels */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && !defined(WORDS_BIGENDIAN) && \
+	(__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)) && !defined(MARK5_NO_SIMD)
+#define MARK5_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+/* bytes of payload handled per kernel call */
+#define SIMD_BLOCK_BYTES	16
+
+typedef void (*simdkernel)(const unsigned char *src, int nblock, const float *levels, float **data, int offset);
+
+#ifdef MARK5_SIMD_X86
+
+#define AVX2 __attribute__((target("avx2")))
+
+/* 8 2-bit codes in the low bytes of codes -> 8 floats */
+static inline AVX2 void store8_2bit(float *dest, __m128i codes, __m256 lev)
+{
+	_mm256_storeu_ps(dest, _mm256_permutevar8x32_ps(lev, _mm256_cvtepu8_epi32(codes)));
+}
+
+/* 4 2-bit codes in the low bytes of codes -> 4 floats */
+static inline AVX2 void store4_2bit(float *dest, __m128i codes, __m128 lev)
+{
+	_mm_storeu_ps(dest, _mm_permutevar_ps(lev, _mm_cvtepu8_epi32(codes)));
+}
+
+/* 8 4-bit codes -> 8 floats: permute within each half of the table, then select on bit 3 */
+static inline AVX2 __m256 lookup8_4bit(__m128i codes, __m256 levlo, __m256 levhi)
+{
+	__m256i idx = _mm256_cvtepu8_epi32(codes);
+
+	return _mm256_blendv_ps(_mm256_permutevar8x32_ps(levlo, idx), _mm256_permutevar8x32_ps(levhi, idx),
+		_mm256_castsi256_ps(_mm256_slli_epi32(idx, 28)));
+}
+
+static inline AVX2 void store8_4bit(float *dest, __m128i codes, __m256 levlo, __m256 levhi)
+{
+	_mm256_storeu_ps(dest, lookup8_4bit(codes, levlo, levhi));
+}
+
+static inline AVX2 void store4_4bit(float *dest, __m128i codes, __m256 levlo, __m256 levhi)
+{
+	_mm_storeu_ps(dest, _mm256_castps256_ps128(lookup8_4bit(codes, levlo, levhi)));
+}
+
+/* Each 2-bit kernel splits a 16 byte block into c[k] = bits 2k,2k+1 of every byte, then
+ * regroups those codes by channel.  With 4 codes per byte and channels fastest, the code
+ * in c[k] of byte j is channel (4j+k)%nchan at time (4j+k)/nchan. */
+#define SPLIT_2BIT(src) \
+	__m128i v = _mm_loadu_si128((const __m128i *)(src)); \
+	__m128i c0 = _mm_and_si128(v, m3); \
+	__m128i c1 = _mm_and_si128(_mm_srli_epi16(v, 2), m3); \
+	__m128i c2 = _mm_and_si128(_mm_srli_epi16(v, 4), m3); \
+	__m128i c3 = _mm_and_si128(_mm_srli_epi16(v, 6), m3);
+
+static AVX2 void decode_2bit_1chan(const unsigned char *src, int nblock, const float *levels, float **data, int offset)
+{
+	const __m128i m3 = _mm_set1_epi8(0x03);
+	const __m256 lev = _mm256_setr_ps(levels[0], levels[1], levels[2], levels[3], levels[0], levels[1], levels[2], levels[3]);
+	float *d0 = data[0] + offset;
+	int n;
+
+	for(n = 0; n < nblock; ++n, src += SIMD_BLOCK_BYTES, d0 += 64)
+	{
+		SPLIT_2BIT(src)
+		__m128i a = _mm_unpacklo_epi8(c0, c1);
+		__m128i b = _mm_unpacklo_epi8(c2, c3);
+		__m128i t0 = _mm_unpacklo_epi16(a, b);
+		__m128i t1 = _mm_unpackhi_epi16(a, b);
+
+		a = _mm_unpackhi_epi8(c0, c1);
+		b = _mm_unpackhi_epi8(c2, c3);
+		store8_2bit(d0,      t0, lev);
+		store8_2bit(d0 +  8, _mm_srli_si128(t0, 8), lev);
+		store8_2bit(d0 + 16, t1, lev);
+		store8_2bit(d0 + 24, _mm_srli_si128(t1, 8), lev);
+		t0 = _mm_unpacklo_epi16(a, b);
+		t1 = _mm_unpackhi_epi16(a, b);
+		store8_2bit(d0 + 32, t0, lev);
+		store8_2bit(d0 + 40, _mm_srli_si128(t0, 8), lev);
+		store8_2bit(d0 + 48, t1, lev);
+		store8_2bit(d0 + 56, _mm_srli_si128(t1, 8), lev);
+	}
+}
+
+static AVX2 void decode_2bit_2chan(const unsigned char *src, int nblock, const float *levels, float **data, int offset)
+{
+	const __m128i m3 = _mm_set1_epi8(0x03);
+	const __m256 lev = _mm256_setr_ps(levels[0], levels[1], levels[2], levels[3], levels[0], levels[1], levels[2], levels[3]);
+	float *d0 = data[0] + offset;
+	float *d1 = data[1] + offset;
+	int n;
+
+	for(n = 0; n < nblock; ++n, src += SIMD_BLOCK_BYTES, d0 += 32, d1 += 32)
+	{
+		SPLIT_2BIT(src)
+		__m128i t0 = _mm_unpacklo_epi8(c0, c2);
+		__m128i t1 = _mm_unpackhi_epi8(c0, c2);
+		__m128i t2 = _mm_unpacklo_epi8(c1, c3);
+		__m128i t3 = _mm_unpackhi_epi8(c1, c3);
+
+		store8_2bit(d0,      t0, lev);
+		store8_2bit(d0 +  8, _mm_srli_si128(t0, 8), lev);
+		store8_2bit(d0 + 16, t1, lev);
+		store8_2bit(d0 + 24, _mm_srli_si128(t1, 8), lev);
+		store8_2bit(d1,      t2, lev);
+		store8_2bit(d1 +  8, _mm_srli_si128(t2, 8), lev);
+		store8_2bit(d1 + 16, t3, lev);
+		store8_2bit(d1 + 24, _mm_srli_si128(t3, 8), lev);
+	}
+}
+
+static AVX2 void decode_2bit_4chan(const unsigned char *src, int nblock, const float *levels, float **data, int offset)
+{
+	const __m128i m3 = _mm_set1_epi8(0x03);
+	const __m256 lev = _mm256_setr_ps(levels[0], levels[1], levels[2], levels[3], levels[0], levels[1], levels[2], levels[3]);
+	int n, o;
+
+	for(n = 0, o = offset; n < nblock; ++n, src += SIMD_BLOCK_BYTES, o += 16)
+	{
+		SPLIT_2BIT(src)
+
+		store8_2bit(data[0] + o,     c0, lev);
+		store8_2bit(data[0] + o + 8, _mm_srli_si128(c0, 8), lev);
+		store8_2bit(data[1] + o,     c1, lev);
+		store8_2bit(data[1] + o + 8, _mm_srli_si128(c1, 8), lev);
+		store8_2bit(data[2] + o,     c2, lev);
+		store8_2bit(data[2] + o + 8, _mm_srli_si128(c2, 8), lev);
+		store8_2bit(data[3] + o,     c3, lev);
+		store8_2bit(data[3] + o + 8, _mm_srli_si128(c3, 8), lev);
+	}
+}
+
+static AVX2 void decode_2bit_8chan(const unsigned char *src, int nblock, const float *levels, float **data, int offset)
+{
+	const __m128i m3 = _mm_set1_epi8(0x03);
+	const __m128i evenodd = _mm_setr_epi8(0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15);
+	const __m256 lev = _mm256_setr_ps(levels[0], levels[1], levels[2], levels[3], levels[0], levels[1], levels[2], levels[3]);
+	int n, o;
+
+	/* even bytes hold channels 0-3, odd bytes channels 4-7 */
+	for(n = 0, o = offset; n < nblock; ++n, src += SIMD_BLOCK_BYTES, o += 8)
+	{
+		SPLIT_2BIT(src)
+
+		c0 = _mm_shuffle_epi8(c0, evenodd);
+		c1 = _mm_shuffle_epi8(c1, evenodd);
+		c2 = _mm_shuffle_epi8(c2, evenodd);
+		c3 = _mm_shuffle_epi8(c3, evenodd);
+		store8_2bit(data[0] + o, c0, lev);
+		store8_2bit(data[1] + o, c1, lev);
+		store8_2bit(data[2] + o, c2, lev);
+		store8_2bit(data[3] + o, c3, lev);
+		store8_2bit(data[4] + o, _mm_srli_si128(c0, 8), lev);
+		store8_2bit(data[5] + o, _mm_srli_si128(c1, 8), lev);
+		store8_2bit(data[6] + o, _mm_srli_si128(c2, 8), lev);
+		store8_2bit(data[7] + o, _mm_srli_si128(c3, 8), lev);
+	}
+}
+
+static AVX2 void decode_2bit_16chan(const unsigned char *src, int nblock, const float *levels, float **data, int offset)
+{
+	const __m128i m3 = _mm_set1_epi8(0x03);
+	const __m128i stride4 = _mm_setr_epi8(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+	const __m128 lev = _mm_setr_ps(levels[0], levels[1], levels[2], levels[3]);
+	__m128i c[4];
+	int n, o, k, m;
+
+	/* byte 4j+m holds channels 4m to 4m+3 at time j */
+	for(n = 0, o = offset; n < nblock; ++n, src += SIMD_BLOCK_BYTES, o += 4)
+	{
+		SPLIT_2BIT(src)
+
+		c[0] = _mm_shuffle_epi8(c0, stride4);
+		c[1] = _mm_shuffle_epi8(c1, stride4);
+		c[2] = _mm_shuffle_epi8(c2, stride4);
+		c[3] = _mm_shuffle_epi8(c3, stride4);
+		for(k = 0; k < 4; ++k)
+		{
+			for(m = 0; m < 4; ++m)
+			{
+				store4_2bit(data[4*m+k] + o, c[k], lev);
+				c[k] = _mm_srli_si128(c[k], 4);
+			}
+		}
+	}
+}
+
+/* 4-bit: c0 = low nibbles, c1 = high nibbles; byte j holds codes 2j and 2j+1 */
+#define SPLIT_4BIT(src) \
+	__m128i v = _mm_loadu_si128((const __m128i *)(src)); \
+	__m128i c0 = _mm_and_si128(v, m15); \
+	__m128i c1 = _mm_and_si128(_mm_srli_epi16(v, 4), m15);
+
+#define LEVELS_4BIT \
+	const __m256 levlo = _mm256_loadu_ps(levels); \
+	const __m256 levhi = _mm256_loadu_ps(levels + 8);
+
+static AVX2 void decode_4bit_1chan(const unsigned char *src, int nblock, const float *levels, float **data, int offset)
+{
+	const __m128i m15 = _mm_set1_epi8(0x0F);
+	LEVELS_4BIT
+	float *d0 = data[0] + offset;
+	int n;
+
+	for(n = 0; n < nblock; ++n, src += SIMD_BLOCK_BYTES, d0 += 32)
+	{
+		SPLIT_4BIT(src)
+		__m128i t0 = _mm_unpacklo_epi8(c0, c1);
+		__m128i t1 = _mm_unpackhi_epi8(c0, c1);
+
+		store8_4bit(d0,      t0, levlo, levhi);
+		store8_4bit(d0 +  8, _mm_srli_si128(t0, 8), levlo, levhi);
+		store8_4bit(d0 + 16, t1, levlo, levhi);
+		store8_4bit(d0 + 24, _mm_srli_si128(t1, 8), levlo, levhi);
+	}
+}
+
+static AVX2 void decode_4bit_2chan(const unsigned char *src, int nblock, const float *levels, float **data, int offset)
+{
+	const __m128i m15 = _mm_set1_epi8(0x0F);
+	LEVELS_4BIT
+	int n, o;
+
+	for(n = 0, o = offset; n < nblock; ++n, src += SIMD_BLOCK_BYTES, o += 16)
+	{
+		SPLIT_4BIT(src)
+
+		store8_4bit(data[0] + o,     c0, levlo, levhi);
+		store8_4bit(data[0] + o + 8, _mm_srli_si128(c0, 8), levlo, levhi);
+		store8_4bit(data[1] + o,     c1, levlo, levhi);
+		store8_4bit(data[1] + o + 8, _mm_srli_si128(c1, 8), levlo, levhi);
+	}
+}
+
+static AVX2 void decode_4bit_4chan(const unsigned char *src, int nblock, const float *levels, float **data, int offset)
+{
+	const __m128i m15 = _mm_set1_epi8(0x0F);
+	const __m128i evenodd = _mm_setr_epi8(0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15);
+	LEVELS_4BIT
+	int n, o;
+
+	/* even bytes hold channels 0 and 1, odd bytes channels 2 and 3 */
+	for(n = 0, o = offset; n < nblock; ++n, src += SIMD_BLOCK_BYTES, o += 8)
+	{
+		SPLIT_4BIT(src)
+
+		c0 = _mm_shuffle_epi8(c0, evenodd);
+		c1 = _mm_shuffle_epi8(c1, evenodd);
+		store8_4bit(data[0] + o, c0, levlo, levhi);
+		store8_4bit(data[1] + o, c1, levlo, levhi);
+		store8_4bit(data[2] + o, _mm_srli_si128(c0, 8), levlo, levhi);
+		store8_4bit(data[3] + o, _mm_srli_si128(c1, 8), levlo, levhi);
+	}
+}
+
+static AVX2 void decode_4bit_8chan(const unsigned char *src, int nblock, const float *levels, float **data, int offset)
+{
+	const __m128i m15 = _mm_set1_epi8(0x0F);
+	const __m128i stride4 = _mm_setr_epi8(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+	LEVELS_4BIT
+	int n, o, m;
+
+	/* byte 4j+m holds channels 2m and 2m+1 at time j */
+	for(n = 0, o = offset; n < nblock; ++n, src += SIMD_BLOCK_BYTES, o += 4)
+	{
+		SPLIT_4BIT(src)
+
+		c0 = _mm_shuffle_epi8(c0, stride4);
+		c1 = _mm_shuffle_epi8(c1, stride4);
+		for(m = 0; m < 4; ++m)
+		{
+			store4_4bit(data[2*m] + o, c0, levlo, levhi);
+			store4_4bit(data[2*m+1] + o, c1, levlo, levhi);
+			c0 = _mm_srli_si128(c0, 4);
+			c1 = _mm_srli_si128(c1, 4);
+		}
+	}
+}
+
+static int haveavx2(void)
+{
+	static int have = -1;
+
+	if(have < 0)
+	{
+		__builtin_cpu_init();
+		have = __builtin_cpu_supports("avx2") ? 1 : 0;
+	}
+
+	return have;
+}
+
+static simdkernel selectkernel(int nbit, int nchan)
+{
+	if(!haveavx2())
+	{
+		return 0;
+	}
+
+	switch(nbit*100 + nchan)
+	{
+		case 201: return decode_2bit_1chan;
+		case 202: return decode_2bit_2chan;
+		case 204: return decode_2bit_4chan;
+		case 208: return decode_2bit_8chan;
+		case 216: return decode_2bit_16chan;
+		case 401: return decode_4bit_1chan;
+		case 402: return decode_4bit_2chan;
+		case 404: return decode_4bit_4chan;
+		case 408: return decode_4bit_8chan;
+		default:  return 0;
+	}
+}
+
+#else
+
+static simdkernel selectkernel(int nbit, int nchan)
+{
+	return 0;
+}
+
+#endif
+
+int mark5_simd_decode_supported(int nbit, int nchan)
+{
+	if(getenv("MARK5ACCESS_NO_SIMD") != 0)
+	{
+		return 0;
+	}
+
+	return selectkernel(nbit, nchan) != 0;
+}
+
+/* whole bytes not covered by the kernels (short runs and block remainders) */
+static void decode_tail(const unsigned char *src, int nbytes, int nbit, int nchan, const float *levels, float **data, int offset)
+{
+	const int codesperbyte = 8/nbit;
+	const int mask = (1 << nbit) - 1;
+	int j, k, s;
+
+	/* offset counts samples per channel, so sample s of the run is at time offset + s/nchan */
+	for(j = 0, s = 0; j < nbytes; ++j)
+	{
+		for(k = 0; k < codesperbyte; ++k, ++s)
+		{
+			data[s % nchan][offset + s/nchan] = levels[(src[j] >> (k*nbit)) & mask];
+		}
+	}
+}
+
+static void zero_fill(float **data, int nchan, int offset, int n)
+{
+	int c;
+
+	for(c = 0; c < nchan; ++c)
+	{
+		memset(data[c] + offset, 0, n*sizeof(float));
+	}
+}
+
+int mark5_simd_decode_frames(struct mark5_stream *ms, int nsamp, float **data,
+	int nbit, int nchan, const float *levels, int payloadbytes,
+	int (*frameinvalid)(const struct mark5_stream *ms))
+{
+	simdkernel kernel;
+	int groupbytes, groupsamples;	/* a group is the smallest whole number of bytes and time samples */
+	int o, i, ngroup, gstart, gend, nblank, nbytes, nblock;
+
+	kernel = selectkernel(nbit, nchan);
+	if(nbit*nchan >= 8)
+	{
+		groupbytes = nbit*nchan/8;
+		groupsamples = 1;
+	}
+	else
+	{
+		groupbytes = 1;
+		groupsamples = 8/(nbit*nchan);
+	}
+
+	i = ms->readposition;
+	nblank = 0;
+	for(o = 0; o + groupsamples <= nsamp; )
+	{
+		ngroup = (payloadbytes - i)/groupbytes;
+		if(ngroup > (nsamp - o)/groupsamples)
+		{
+			ngroup = (nsamp - o)/groupsamples;
+		}
+
+		/* the groups of this span starting within the valid zone; the rest are blank */
+		if(frameinvalid && frameinvalid(ms))
+		{
+			gstart = gend = 0;
+		}
+		else
+		{
+			gstart = ms->blankzonestartvalid[0] - i;
+			gstart = (gstart > 0) ? (gstart + groupbytes - 1)/groupbytes : 0;
+			gend = ms->blankzoneendvalid[0] - i;
+			gend = (gend > 0) ? (gend + groupbytes - 1)/groupbytes : 0;
+			if(gstart > ngroup)
+			{
+				gstart = ngroup;
+			}
+			if(gend > ngroup)
+			{
+				gend = ngroup;
+			}
+			if(gend < gstart)
+			{
+				gend = gstart;
+			}
+		}
+
+		if(gstart > 0)
+		{
+			zero_fill(data, nchan, o, gstart*groupsamples);
+		}
+		nbytes = (gend - gstart)*groupbytes;
+		nblock = kernel ? nbytes/SIMD_BLOCK_BYTES : 0;
+		if(nblock > 0)
+		{
+			kernel(ms->payload + i + gstart*groupbytes, nblock, levels, data, o + gstart*groupsamples);
+		}
+		if(nbytes > nblock*SIMD_BLOCK_BYTES)
+		{
+			decode_tail(ms->payload + i + gstart*groupbytes + nblock*SIMD_BLOCK_BYTES, nbytes - nblock*SIMD_BLOCK_BYTES,
+				nbit, nchan, levels, data, o + (gstart*groupbytes + nblock*SIMD_BLOCK_BYTES)/groupbytes*groupsamples);
+		}
+		if(gend < ngroup)
+		{
+			zero_fill(data, nchan, o + gend*groupsamples, (ngroup - gend)*groupsamples);
+		}
+		nblank += (ngroup - (gend - gstart))*groupsamples;
+
+		o += ngroup*groupsamples;
+		i += ngroup*groupbytes;
+		if(i >= payloadbytes)
+		{
+			if(mark5_stream_next_frame(ms) < 0)
+			{
+				return -1;
+			}
+			i = 0;
+		}
+	}
+
+	ms->readposition = i;
+
+	return nsamp - nblank;
+}
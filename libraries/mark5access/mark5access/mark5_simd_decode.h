@@ -0,0 +1,65 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by Walter Brisken                                  *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+//===========================================================================
+// SVN properties (DO NOT CHANGE)
+//
+// $Id$
+// $HeadURL$
+// $LastChangedRevision$
+// $Author$
+// $LastChangedDate$
+//
+//============================================================================
+
+#ifndef __MARK5_SIMD_DECODE_H__
+#define __MARK5_SIMD_DECODE_H__
+
+#include "mark5access/mark5_stream.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Frame-at-a-time decoding of real samples packed least significant bits first
+ * with channels fastest (VDIF, and Mark5B 2-bit).  Rather than a table lookup,
+ * blank zone test and end of frame test per byte, each frame's valid span is
+ * decoded in 16 byte blocks with SSSE3/AVX2 shuffles and register permutes,
+ * and blanked spans are zero filled.  Only used when the running CPU has AVX2.
+ */
+
+/* return 1 if mark5_simd_decode_frames can decode nchan channels of nbit bits.
+ * Always 0 while MARK5ACCESS_NO_SIMD is set in the environment, so formats
+ * created then use the table decoders. */
+int mark5_simd_decode_supported(int nbit, int nchan);
+
+/* Decode nsamp samples per channel to data[chan][] starting from ms->readposition,
+ * reading further frames as needed.  levels has 1<<nbit entries mapping each
+ * nbit code to a value.  payloadbytes is the data size of each frame; bytes of a
+ * frame outside [blankzonestartvalid[0], blankzoneendvalid[0]), or all of it if
+ * frameinvalid is given and returns nonzero, decode to zero.
+ * Returns the number of good samples per channel, or -1 if data ran out. */
+int mark5_simd_decode_frames(struct mark5_stream *ms, int nsamp, float **data,
+	int nbit, int nchan, const float *levels, int payloadbytes,
+	int (*frameinvalid)(const struct mark5_stream *ms));
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
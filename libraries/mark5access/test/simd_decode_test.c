@@ -0,0 +1,313 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by Walter Brisken                                  *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+//===========================================================================
+// SVN properties (DO NOT CHANGE)
+//
+// $Id$
+// $HeadURL$
+// $LastChangedRevision$
+// $Author$
+// $LastChangedDate$
+//
+//============================================================================
+//
+// ./simd_decode_test
+//
+// Decodes synthetic VDIF, complex VDIF and Mark5B streams, containing invalid
+// frames and frames with fill pattern, once with the SIMD decoders and once
+// with the table decoders (MARK5ACCESS_NO_SIMD set), in identically sized
+// calls, and requires the return values and decoded samples to match exactly.
+// Exits with 77 (skipped) when the SIMD decoders are not available.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "mark5access/mark5_stream.h"
+#include "mark5access/mark5_simd_decode.h"
+
+#define MAX_DECODE	60000
+#define N_DECODES	400
+
+static const unsigned char fill[4] = { 0x44, 0x33, 0x22, 0x11 };
+
+static uint32_t rs = 12345;
+
+static uint32_t rnd(void)
+{
+	rs ^= rs << 13;
+	rs ^= rs >> 17;
+	rs ^= rs << 5;
+
+	return rs;
+}
+
+static void setfill(unsigned char *p, int n)
+{
+	int i;
+
+	for(i = 0; i < n; ++i)
+	{
+		p[i] = fill[i%4];
+	}
+}
+
+/* frames with the invalid bit set, fill pattern at the start and fill pattern at the end are sprinkled through */
+static unsigned char *makevdif(int nframes, int payloadbytes, int nbit, int nchan, int iscomplex, size_t *len)
+{
+	int framebytes = payloadbytes + 32;
+	int lognchan = 0;
+	unsigned char *buf;
+	int f, i;
+
+	while((1 << lognchan) < nchan)
+	{
+		++lognchan;
+	}
+	buf = calloc(nframes, framebytes);
+	for(f = 0; f < nframes; ++f)
+	{
+		uint32_t *h = (uint32_t *)(buf + (size_t)f*framebytes);
+		unsigned char *p = (unsigned char *)(h + 8);
+
+		h[0] = 0;
+		h[1] = (30u << 24) | (uint32_t)f;
+		h[2] = (uint32_t)(framebytes/8) | (lognchan << 24);
+		h[3] = ((uint32_t)(nbit-1) << 26) | ((uint32_t)iscomplex << 31) | 0x4142;
+		for(i = 0; i < payloadbytes; ++i)
+		{
+			p[i] = rnd();
+		}
+		if(f > 2 && f % 7 == 3)
+		{
+			h[0] |= 1u << 31;
+		}
+		if(f > 2 && f % 11 == 5)
+		{
+			setfill(p, 8);
+		}
+		if(f > 2 && f % 13 == 6)
+		{
+			setfill(p + payloadbytes - 8, 8);
+		}
+	}
+	*len = (size_t)nframes*framebytes;
+
+	return buf;
+}
+
+/* as above, plus frames entirely of fill pattern */
+static unsigned char *makemark5b(int nframes, size_t *len)
+{
+	const int framebytes = 10016;
+	unsigned char *buf;
+	int f, i;
+
+	buf = calloc(nframes, framebytes);
+	for(f = 0; f < nframes; ++f)
+	{
+		uint32_t *h = (uint32_t *)(buf + (size_t)f*framebytes);
+		unsigned char *p = (unsigned char *)(h + 4);
+
+		h[0] = 0xABADDEED;
+		h[1] = (uint32_t)(f & 0x7fff);
+		for(i = 0; i < 10000; ++i)
+		{
+			p[i] = rnd();
+		}
+		if(f > 2 && f % 7 == 3)
+		{
+			p[-11] |= 0x80;
+		}
+		if(f > 2 && f % 11 == 5)
+		{
+			setfill(p, 808);
+		}
+		if(f > 2 && f % 13 == 6)
+		{
+			setfill(p + 10000 - 1200, 1200);
+		}
+		if(f > 2 && f % 17 == 8)
+		{
+			setfill(p, 10000);
+		}
+	}
+	*len = (size_t)nframes*framebytes;
+
+	return buf;
+}
+
+static struct mark5_stream *openstream(const char *formatname, unsigned char *buf, size_t len, int simd)
+{
+	if(simd)
+	{
+		unsetenv("MARK5ACCESS_NO_SIMD");
+	}
+	else
+	{
+		setenv("MARK5ACCESS_NO_SIMD", "1", 1);
+	}
+
+	return new_mark5_stream_absorb(new_mark5_stream_memory(buf, len), new_mark5_format_generic_from_string(formatname));
+}
+
+/* returns number of mismatching decode calls, or -1 on error */
+static int compare(const char *formatname, unsigned char *buf, size_t len, int iscomplex)
+{
+	struct mark5_stream *ms[2];
+	float **data[2];
+	int nchan, granularity, nbad = 0;
+	int s, c, k;
+
+	ms[0] = openstream(formatname, buf, len, 0);
+	ms[1] = openstream(formatname, buf, len, 1);
+	unsetenv("MARK5ACCESS_NO_SIMD");
+	if(!ms[0] || !ms[1])
+	{
+		fprintf(stderr, "Error: cannot open stream for %s\n", formatname);
+		free(buf);
+
+		return -1;
+	}
+	nchan = ms[0]->nchan;
+	granularity = ms[0]->samplegranularity;
+	for(s = 0; s < 2; ++s)
+	{
+		data[s] = (float **)malloc(nchan*sizeof(float *));
+		for(c = 0; c < nchan; ++c)
+		{
+			/* room for complex samples too */
+			data[s][c] = (float *)malloc(2*MAX_DECODE*sizeof(float));
+		}
+	}
+
+	for(k = 0; k < N_DECODES; ++k)
+	{
+		int n = granularity*(1 + rnd()%(MAX_DECODE/granularity));
+		int r[2];
+
+		for(s = 0; s < 2; ++s)
+		{
+			if(iscomplex)
+			{
+				r[s] = mark5_stream_decode_complex(ms[s], n, (mark5_float_complex **)data[s]);
+			}
+			else
+			{
+				r[s] = mark5_stream_decode(ms[s], n, data[s]);
+			}
+		}
+		if(r[0] != r[1])
+		{
+			fprintf(stderr, "%s: call %d of %d samples returned %d (table) vs %d (SIMD)\n", formatname, k, n, r[0], r[1]);
+			++nbad;
+		}
+		else if(r[0] >= 0)
+		{
+			for(c = 0; c < nchan; ++c)
+			{
+				if(memcmp(data[0][c], data[1][c], (iscomplex ? 2 : 1)*n*sizeof(float)) != 0)
+				{
+					fprintf(stderr, "%s: call %d of %d samples differs in channel %d\n", formatname, k, n, c);
+					++nbad;
+					break;
+				}
+			}
+		}
+		if(r[0] < 0 || r[1] < 0)
+		{
+			break;
+		}
+	}
+
+	for(s = 0; s < 2; ++s)
+	{
+		for(c = 0; c < nchan; ++c)
+		{
+			free(data[s][c]);
+		}
+		free(data[s]);
+	}
+	/* the memory streams do not own buf */
+	delete_mark5_stream(ms[0]);
+	delete_mark5_stream(ms[1]);
+	free(buf);
+
+	printf("%-24s %s\n", formatname, nbad ? "FAIL" : "PASS");
+
+	return nbad;
+}
+
+int main(int argc, char **argv)
+{
+	const int nbits[2] = { 2, 4 };
+	const int nchans[5] = { 1, 2, 4, 8, 16 };
+	char formatname[64];
+	unsigned char *buf;
+	size_t len;
+	int a, b, r;
+	int nfail = 0;
+
+	if(!mark5_simd_decode_supported(2, 1))
+	{
+		printf("SIMD decoders not available on this build/CPU; skipping\n");
+
+		return 77;
+	}
+
+	for(a = 0; a < 2; ++a)
+	{
+		for(b = 0; b < 5; ++b)
+		{
+			if(!mark5_simd_decode_supported(nbits[a], nchans[b]))
+			{
+				continue;
+			}
+			buf = makevdif(600, 8000, nbits[a], nchans[b], 0, &len);
+			snprintf(formatname, sizeof formatname, "VDIF_8000-%d-%d-%d", 32*nchans[b]*nbits[a], nchans[b], nbits[a]);
+			r = compare(formatname, buf, len, 0);
+			nfail += (r != 0);
+		}
+	}
+
+	for(a = 0; a < 2; ++a)
+	{
+		buf = makevdif(600, 8000, nbits[a], 1, 1, &len);
+		snprintf(formatname, sizeof formatname, "VDIFC_8000-%d-1-%d", 32*nbits[a], nbits[a]);
+		r = compare(formatname, buf, len, 1);
+		nfail += (r != 0);
+	}
+
+	for(b = 0; b < 5; ++b)
+	{
+		buf = makemark5b(400, &len);
+		snprintf(formatname, sizeof formatname, "Mark5B-%d-%d-2", 64*nchans[b] > 2048 ? 2048 : 64*nchans[b], nchans[b]);
+		r = compare(formatname, buf, len, 0);
+		nfail += (r != 0);
+	}
+
+	if(nfail)
+	{
+		printf("%d format(s) decoded differently\n", nfail);
+
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -27,11 +27,13 @@
 //
 //============================================================================
 
-#include <stdio.h>
 #define _GNU_SOURCE
+#include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <sys/stat.h>
+#include <fcntl.h>
+#include <time.h>
 #include <glob.h>
 #include "mark6gather.h"
 
@@ -213,53 +215,199 @@ static int getFirstBlocks(Mark6File *m6f)
 	return 0;
 }
 
+static double mark6Now()
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+
+	return t.tv_sec + t.tv_nsec*1.0e-9;
+}
+
+/* Reads length bytes at file offset into buffer; with O_DIRECT the read is widened to aligned offset and length.
+ * Returns the number of bytes read at or after offset, or <= 0 at end of file or on error; *skew is set to the
+ * position of offset within buffer.
+ */
+static ssize_t preadMark6(Mark6File *m6f, char *buffer, size_t length, off_t offset, int *skew)
+{
+	off_t start = offset;
+	ssize_t n;
+	double t0;
+
+	if(m6f->directIO)
+	{
+		start = offset - (offset % MARK6_DIRECT_ALIGN);
+		length += offset - start;
+		length += (MARK6_DIRECT_ALIGN - length % MARK6_DIRECT_ALIGN) % MARK6_DIRECT_ALIGN;
+	}
+	*skew = offset - start;
+
+	t0 = mark6Now();
+	n = pread(m6f->fd, buffer, length, start);
+	m6f->readSeconds += mark6Now() - t0;
+	if(n <= 0)
+	{
+		return n;
+	}
+	m6f->nByteRead += n;
+
+	return n - *skew;
+}
+
+/* Returns the wb_size field of a block header, or 0 if it is not a plausible block size */
+static int mark6BlockSize(const Mark6File *m6f, const char *header)
+{
+	int32_t size;
+
+	if(m6f->version == 1)
+	{
+		return m6f->maxBlockSize;
+	}
+	memcpy(&size, header + sizeof(int32_t), sizeof(int32_t));
+	if(size <= m6f->blockHeaderSize || size > m6f->maxBlockSize)
+	{
+		fprintf(stderr, "Warning: corrupt scatter-gather file! Size %d of current block exceeds maxBlockSize %d\n", size, m6f->maxBlockSize);
+
+		return 0;
+	}
+
+	return size;
+}
+
+/* Reads the block (header and payload) starting at file offset into B with a single pread sized to the block.
+ * For version 2 files the header of the following block is read along with it, giving the size of the next read.
+ * Only the first block after opening or seeking needs its header read separately.
+ * Returns the size of the block in the file, or 0 at end of file or on a corrupt block.
+ */
+static ssize_t readMark6Block(Mark6File *m6f, Mark6ReadAheadBlock *B, off_t offset)
+{
+	size_t length;
+	ssize_t n;
+	int size, skew;
+
+	size = m6f->nextBlockSize;
+	if(size <= 0)
+	{
+		n = preadMark6(m6f, B->buffer, m6f->blockHeaderSize, offset, &skew);
+		if(n < m6f->blockHeaderSize)
+		{
+			return 0;
+		}
+		size = mark6BlockSize(m6f, B->buffer + skew);
+		if(size <= 0)
+		{
+			return 0;
+		}
+	}
+
+	length = size;
+	if(m6f->version > 1)
+	{
+		length += m6f->blockHeaderSize;
+	}
+	n = preadMark6(m6f, B->buffer, length, offset, &skew);
+	m6f->nextBlockSize = 0;
+	if(n < m6f->blockHeaderSize)
+	{
+		return 0;
+	}
+	++m6f->nBlockRead;
+
+	memcpy(&B->blockHeader.blocknum, B->buffer + skew, sizeof(int32_t));
+	B->blockHeader.wb_size = size;
+	if(m6f->version == 1)
+	{
+		m6f->nextBlockSize = size;
+	}
+	else if(n >= size + m6f->blockHeaderSize)
+	{
+		m6f->nextBlockSize = mark6BlockSize(m6f, B->buffer + skew + size);
+	}
+
+	B->data = B->buffer + skew + m6f->blockHeaderSize;
+	B->payloadBytes = (n < size ? n : size) - m6f->blockHeaderSize;
+
+	return size;
+}
+
+/* Keeps up to readAhead blocks of one file queued, reading sequentially from readOffset */
 static void *mark6Reader(void *arg)
 {
 	Mark6File *m6f = (Mark6File *)arg;
-	int corrupted = 0;
 
-	while(1)
+	pthread_mutex_lock(&m6f->readLock);
+	for(;;)
 	{
-		size_t v;
+		Mark6ReadAheadBlock *B;
+		off_t offset;
+		ssize_t v;
 
-		pthread_barrier_wait(&m6f->readBarrier);
-
-		if (!corrupted)
+		while(!m6f->stopReading && (m6f->pauseReading || m6f->readEOF || m6f->queueCount >= m6f->readAhead))
 		{
-			v = fread(&m6f->readHeader, m6f->blockHeaderSize, 1, m6f->in);
-			if(v == 1)
+			if(m6f->pauseReading && !m6f->readPaused)
 			{
-				int nrd = m6f->readHeader.wb_size - m6f->blockHeaderSize;
-				if ((nrd <= 0) || (nrd > (m6f->maxBlockSize - m6f->blockHeaderSize)))
-				{
-					fprintf(stderr, "Warning: corrupt scatter-gather file! Size %d of current block exceeds maxBlockSize %d\n", m6f->readHeader.wb_size, m6f->maxBlockSize);
-					memset(m6f->readBuffer, 0xFF, m6f->maxBlockSize - m6f->blockHeaderSize);
-					m6f->readBytes = 0;
-					corrupted = 1;
-				}
-				else
-				{
-					m6f->readBytes = fread(m6f->readBuffer, 1, m6f->readHeader.wb_size - m6f->blockHeaderSize, m6f->in);
-				}
-			}
-			else
-			{
-				m6f->readBytes = 0;
+				m6f->readPaused = 1;
+				pthread_cond_broadcast(&m6f->readCond);
 			}
+			pthread_cond_wait(&m6f->spaceCond, &m6f->readLock);
 		}
-
-		pthread_barrier_wait(&m6f->readBarrier);
-
-		if (m6f->stopReading)
+		m6f->readPaused = 0;
+		if(m6f->stopReading)
 		{
 			break;
 		}
 
+		/* the slot past the end of the queue belongs to this thread until queueCount is increased */
+		B = m6f->readQueue + (m6f->queueHead + m6f->queueCount) % m6f->readAhead;
+		offset = m6f->readOffset;
+		pthread_mutex_unlock(&m6f->readLock);
+
+		v = readMark6Block(m6f, B, offset);
+
+		pthread_mutex_lock(&m6f->readLock);
+		if(v > 0)
+		{
+			m6f->readOffset = offset + v;
+			++m6f->queueCount;
+		}
+		else
+		{
+			m6f->readEOF = 1;
+		}
+		pthread_cond_broadcast(&m6f->readCond);
 	}
+	pthread_mutex_unlock(&m6f->readLock);
 
 	return 0;
 }
 
+/* Waits until the read thread is idle; any read in progress is completed first */
+static void pauseMark6Reader(Mark6File *m6f)
+{
+	pthread_mutex_lock(&m6f->readLock);
+	m6f->pauseReading = 1;
+	pthread_cond_broadcast(&m6f->spaceCond);
+	while(!m6f->readPaused)
+	{
+		pthread_cond_wait(&m6f->readCond, &m6f->readLock);
+	}
+	pthread_mutex_unlock(&m6f->readLock);
+}
+
+/* Discards anything read ahead and restarts reading at file offset */
+static void resumeMark6Reader(Mark6File *m6f, off_t offset)
+{
+	pthread_mutex_lock(&m6f->readLock);
+	m6f->queueHead = 0;
+	m6f->queueCount = 0;
+	m6f->readOffset = offset;
+	m6f->nextBlockSize = 0;
+	m6f->readEOF = 0;
+	m6f->pauseReading = 0;
+	pthread_cond_broadcast(&m6f->spaceCond);
+	pthread_mutex_unlock(&m6f->readLock);
+}
+
 /* position is the position of the reconstructed stream to seek to */
 struct seekArgs
 {
@@ -273,50 +421,72 @@ struct seekArgs
 static ssize_t Mark6FileReadBlock(Mark6File *m6f, int slotIndex)
 {
 	Mark6BufferSlot *slot;
+	Mark6ReadAheadBlock *B;
 
 	slot = m6f->slot + slotIndex;
 
-	pthread_barrier_wait(&m6f->readBarrier);
+	pthread_mutex_lock(&m6f->readLock);
+	if(m6f->queueCount == 0 && !m6f->readEOF)
+	{
+		double t0 = mark6Now();
 
-	slot->payloadBytes = m6f->readBytes;
+		++m6f->nReadWait;
+		while(m6f->queueCount == 0 && !m6f->readEOF)
+		{
+			pthread_cond_wait(&m6f->readCond, &m6f->readLock);
+		}
+		m6f->waitSeconds += mark6Now() - t0;
+	}
 
-	if(slot->payloadBytes == 0)
+	if(m6f->queueCount == 0)
 	{
+		pthread_mutex_unlock(&m6f->readLock);
+
+		slot->payloadBytes = 0;
 		slot->index = 0;
 		slot->frame = 0;
+
+		return 0;
 	}
-	else
+
+	B = m6f->readQueue + m6f->queueHead;
 	{
 		char *tmp;
-		vdif_header *vh;
-		
-		slot->payloadBytes -= (slot->payloadBytes % m6f->packetSize);
 
-		memcpy(&slot->blockHeader, &m6f->readHeader, m6f->blockHeaderSize);
-		
-		tmp = slot->data;
-		slot->data = m6f->readBuffer;
-		m6f->readBuffer = tmp;
+		tmp = slot->buffer;
+		slot->buffer = B->buffer;
+		B->buffer = tmp;
+	}
+	slot->data = B->data;
+	slot->payloadBytes = B->payloadBytes - (B->payloadBytes % m6f->packetSize);
+	slot->blockHeader = B->blockHeader;
+	m6f->queueHead = (m6f->queueHead + 1) % m6f->readAhead;
+	--m6f->queueCount;
+	pthread_cond_broadcast(&m6f->spaceCond);
+	pthread_mutex_unlock(&m6f->readLock);
 
-		slot->index = 0;
+	slot->index = 0;
 
-		if(m6f->packetFormat == M6SG_PACKET_FORMAT_VDIF)
-		{
-			vh = (vdif_header *)(slot->data);
-			slot->frame = vdifFrame(vh);
-		}
-		else
+	if(slot->payloadBytes == 0)
+	{
+		slot->frame = 0;
+	}
+	else if(m6f->packetFormat == M6SG_PACKET_FORMAT_VDIF)
+	{
+		vdif_header *vh;
+
+		vh = (vdif_header *)(slot->data);
+		slot->frame = vdifFrame(vh);
+	}
+	else
+	{
+		if(!checkMark5BPacket(slot->data))
 		{
-			if(!checkMark5BPacket(slot->data))
-			{
-				fprintf(stderr, "Error: Mark6FileReadBlock: file header claims data are Mark5B, yet frame header lacks Mark5B header magic\n");
-			}
-			slot->frame = mark5bFrame(slot->data);
+			fprintf(stderr, "Error: Mark6FileReadBlock: file header claims data are Mark5B, yet frame header lacks Mark5B header magic\n");
 		}
+		slot->frame = mark5bFrame(slot->data);
 	}
 
-	pthread_barrier_wait(&m6f->readBarrier);
-
 	return slot->payloadBytes;
 }
 
@@ -334,7 +504,7 @@ static void *mark6Seeker(void *arg)
 	targetBlock = S->m6f->stat.st_size/(blockSize - S->m6f->blockHeaderSize)/S->nFile;
 
 	/*   1. wait for any ongoing reads to complete */
-	pthread_barrier_wait(&S->m6f->readBarrier);
+	pauseMark6Reader(S->m6f);
 
 	/*   2. figure out where we need to be */ 
 	if(S->position == 0)
@@ -411,10 +581,9 @@ static void *mark6Seeker(void *arg)
 		
 		pos += blockSize;
 	}
-	fseeko(S->m6f->in, pos, SEEK_SET);
 
-	/*   4. give control back to reader thread */
-	pthread_barrier_wait(&S->m6f->readBarrier);
+	/*   4. give control back to reader thread, reading from the new position */
+	resumeMark6Reader(S->m6f, pos);
 
 	/*   5. explicitly load the next block for each slot */
 	for(slotIndex = 0; slotIndex < MARK6_BUFFER_SLOTS; ++slotIndex)
@@ -439,18 +608,28 @@ static void deallocateMark6File(Mark6File *m6f)
 		free(m6f->fileName);
 		m6f->fileName = 0;
 	}
+	if(m6f->fd >= 0)
+	{
+		close(m6f->fd);
+		m6f->fd = -1;
+	}
 	for(s = 0; s < MARK6_BUFFER_SLOTS; ++s)
 	{
-		if(m6f->slot[s].data)
+		if(m6f->slot[s].buffer)
 		{
-			free(m6f->slot[s].data);
+			free(m6f->slot[s].buffer);
+			m6f->slot[s].buffer = 0;
 			m6f->slot[s].data = 0;
 		}
 	}
-	if(m6f->readBuffer)
+	if(m6f->readQueue)
 	{
-		free(m6f->readBuffer);
-		m6f->readBuffer = 0;
+		for(s = 0; s < m6f->readAhead; ++s)
+		{
+			free(m6f->readQueue[s].buffer);
+		}
+		free(m6f->readQueue);
+		m6f->readQueue = 0;
 	}
 	m6f->version = -1;
 }
@@ -458,6 +637,19 @@ static void deallocateMark6File(Mark6File *m6f)
 /* this assumes *m6f is already allocated but that the structures within are not. */
 /* no attempt is made here to free existing data */
 
+/* all block buffers are the same size, so they can be swapped between slots and read-ahead queue */
+static char *allocateMark6BlockBuffer(const Mark6File *m6f)
+{
+	void *buffer;
+
+	if(posix_memalign(&buffer, MARK6_DIRECT_ALIGN, m6f->bufferSize) != 0)
+	{
+		return 0;
+	}
+
+	return (char *)buffer;
+}
+
 /* returns 0 on success, or error code otherwise */
 int openMark6File(Mark6File *m6f, const char *filename)
 {
@@ -466,6 +658,7 @@ int openMark6File(Mark6File *m6f, const char *filename)
 	int slotIndex;
 	size_t v;
 
+	m6f->fd = -1;
 	stat(filename, &m6f->stat);
 	m6f->in = fopen(filename, "r");
 	if(!m6f->in)
@@ -490,17 +683,17 @@ int openMark6File(Mark6File *m6f, const char *filename)
 
 		return -2;
 	}
-	m6f->readHeader.wb_size = m6f->maxBlockSize;
 	m6f->maxBlockSize = header.block_size;
 	m6f->packetSize = header.packet_size;
 	m6f->packetFormat = header.packet_format;
-	m6f->readBuffer = (char *)malloc(m6f->maxBlockSize-m6f->blockHeaderSize);
-	if(!m6f->readBuffer)
+	if(m6f->maxBlockSize <= m6f->blockHeaderSize || m6f->packetSize <= 0)
 	{
 		deallocateMark6File(m6f);
 
-		return -5;
+		return -2;
 	}
+	/* room for a block, the next block's header, and an O_DIRECT read widened to alignment at both ends */
+	m6f->bufferSize = m6f->maxBlockSize + m6f->blockHeaderSize + 2*MARK6_DIRECT_ALIGN;
 
 	if(getFirstBlocks(m6f) < 0)
 	{
@@ -509,19 +702,46 @@ int openMark6File(Mark6File *m6f, const char *filename)
 		return -4;
 	}
 
+	m6f->directIO = 0;
+#ifdef O_DIRECT
+	if(getMark6DirectIO())
+	{
+		/* not all file systems support O_DIRECT (e.g., tmpfs), in which case fall back to buffered reads */
+		m6f->fd = open(filename, O_RDONLY | O_DIRECT);
+		if(m6f->fd >= 0)
+		{
+			m6f->directIO = 1;
+		}
+	}
+#endif
+	if(m6f->fd < 0)
+	{
+		m6f->fd = open(filename, O_RDONLY);
+	}
+	if(m6f->fd < 0)
+	{
+		deallocateMark6File(m6f);
+
+		return -1;
+	}
+#ifdef POSIX_FADV_SEQUENTIAL
+	posix_fadvise(m6f->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
 	for(slotIndex = 0; slotIndex < MARK6_BUFFER_SLOTS; ++slotIndex)
 	{
 		Mark6BufferSlot *slot;
 
 		slot = m6f->slot + slotIndex;
 
-		slot->data = (char *)malloc(m6f->maxBlockSize-m6f->blockHeaderSize);
-		if(!slot->data)
+		slot->buffer = allocateMark6BlockBuffer(m6f);
+		if(!slot->buffer)
 		{
 			deallocateMark6File(m6f);
 
 			return -3;
 		}
+		slot->data = slot->buffer;
 
 		slot->blockHeader.blocknum = -1;
 		slot->blockHeader.wb_size = m6f->maxBlockSize;
@@ -529,13 +749,39 @@ int openMark6File(Mark6File *m6f, const char *filename)
 		slot->payloadBytes = 0;	/* nothing read yet */
 	}
 
+	m6f->readAhead = getMark6ReadAhead();
+	m6f->readQueue = (Mark6ReadAheadBlock *)calloc(m6f->readAhead, sizeof(Mark6ReadAheadBlock));
+	if(!m6f->readQueue)
+	{
+		deallocateMark6File(m6f);
+
+		return -5;
+	}
+	for(slotIndex = 0; slotIndex < m6f->readAhead; ++slotIndex)
+	{
+		m6f->readQueue[slotIndex].buffer = allocateMark6BlockBuffer(m6f);
+		if(!m6f->readQueue[slotIndex].buffer)
+		{
+			deallocateMark6File(m6f);
+
+			return -5;
+		}
+	}
+	m6f->queueHead = m6f->queueCount = 0;
+	m6f->readOffset = sizeof(Mark6Header);
+	m6f->nextBlockSize = 0;
+	m6f->stopReading = m6f->pauseReading = m6f->readPaused = m6f->readEOF = 0;
+	m6f->nBlockRead = m6f->nByteRead = m6f->nReadWait = 0;
+	m6f->readSeconds = m6f->waitSeconds = 0.0;
+
 	/* start reading thread */
-	pthread_barrier_init(&m6f->readBarrier, 0, 2);
+	pthread_mutex_init(&m6f->readLock, 0);
+	pthread_cond_init(&m6f->readCond, 0);
+	pthread_cond_init(&m6f->spaceCond, 0);
 	pthread_attr_init(&attr);
 	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
 	pthread_create(&m6f->readThread, &attr, mark6Reader, m6f);
 	pthread_attr_destroy(&attr);
-	pthread_barrier_wait(&m6f->readBarrier);
 
 	return 0;
 }
@@ -549,11 +795,16 @@ int closeMark6File(Mark6File *m6f)
 
 		return -1;
 	}
-	m6f->stopReading = 1;
 	if(m6f->in)
 	{
-		pthread_barrier_wait(&m6f->readBarrier);
+		pthread_mutex_lock(&m6f->readLock);
+		m6f->stopReading = 1;
+		pthread_cond_broadcast(&m6f->spaceCond);
+		pthread_mutex_unlock(&m6f->readLock);
 		pthread_join(m6f->readThread, 0);
+		pthread_cond_destroy(&m6f->spaceCond);
+		pthread_cond_destroy(&m6f->readCond);
+		pthread_mutex_destroy(&m6f->readLock);
 	}
 
 	deallocateMark6File(m6f);
@@ -580,6 +831,10 @@ void printMark6File(const Mark6File *m6f)
 		printf("  First two block numbers = %d, %d\n", m6f->block1, m6f->block2);
 		printf("  File size = %lld\n", (long long)(m6f->stat.st_size));
 		printf("  Packet size = %d\n", m6f->packetSize);
+		printf("  Read ahead = %d blocks%s\n", m6f->readAhead, m6f->directIO ? " (O_DIRECT)" : "");
+		printf("  Blocks read = %lld\n", m6f->nBlockRead);
+		printf("  Bytes read = %lld in %5.3f sec\n", m6f->nByteRead, m6f->readSeconds);
+		printf("  Gatherer waits = %lld for %5.3f sec\n", m6f->nReadWait, m6f->waitSeconds);
 
 		for(s = 0; s < MARK6_BUFFER_SLOTS; ++s)
 		{
@@ -863,6 +1118,35 @@ void printMark6Gatherer(const Mark6Gatherer *m6g)
 	}
 }
 
+/* Per file: data rate of the reads themselves (bytes read / time in pread), and how often and how
+ * long the gatherer had to wait for a block.  A disk with a low rate and many waits is holding up the
+ * others.
+ */
+void printMark6GathererReadStatistics(const Mark6Gatherer *m6g)
+{
+	long long nByte = 0, nWait = 0;
+	double waitSeconds = 0.0;
+	int i;
+
+	if(m6g == 0)
+	{
+		return;
+	}
+
+	printf("Mark6Gatherer read statistics:\n");
+	printf("  File                                               Blocks      MB  Read(s)  MB/s  Waits  Wait(s)\n");
+	for(i = 0; i < m6g->nFile; ++i)
+	{
+		const Mark6File *F = m6g->mk6Files + i;
+
+		printf("  %-48s %8lld %7.0f %8.3f %5.0f %6lld %8.3f\n", F->fileName, F->nBlockRead, F->nByteRead*1.0e-6, F->readSeconds, (F->readSeconds > 0.0) ? F->nByteRead*1.0e-6/F->readSeconds : 0.0, F->nReadWait, F->waitSeconds);
+		nByte += F->nByteRead;
+		nWait += F->nReadWait;
+		waitSeconds += F->waitSeconds;
+	}
+	printf("  Total: %lld bytes, %lld waits for %5.3f sec\n", nByte, nWait, waitSeconds);
+}
+
 /* position is the position of the reconstructed stream to seek to */
 int seekMark6Gather(Mark6Gatherer *m6g, off_t position)
 {
@@ -920,13 +1204,16 @@ int mark6Gather(Mark6Gatherer *m6g, void *buf, size_t count)
 		Mark6File *F;
 		Mark6BufferSlot *slot;
 		
-		for(s = 0; s < MARK6_BUFFER_SLOTS; ++s)
+		// start from any loaded slot; file 0 may be completely read while others still have data
+		for(f = 0; f < m6g->nFile && lowestFrame == 0; ++f)
 		{
-			// after file is completely read, do not skip unread slots
-			if(m6g->mk6Files[0].slot[s].frame > 0)
+			for(s = 0; s < MARK6_BUFFER_SLOTS; ++s)
 			{
-				lowestFrame = m6g->mk6Files[0].slot[s].frame+1;
-				break;
+				if(m6g->mk6Files[f].slot[s].payloadBytes > 0)
+				{
+					lowestFrame = m6g->mk6Files[f].slot[s].frame+1;
+					break;
+				}
 			}
 		}
 		fileIndex = -1;
@@ -1006,6 +1293,63 @@ const char *getMark6Root()
 	return root;
 }
 
+static int mark6ReadAhead = -1;
+static int mark6DirectIO = -1;
+
+int getMark6ReadAhead()
+{
+	if(mark6ReadAhead < 0)
+	{
+		const char *e = getenv("MARK6_READ_AHEAD");
+
+		mark6ReadAhead = MARK6_DEFAULT_READ_AHEAD;
+		if(e)
+		{
+			mark6ReadAhead = atoi(e);
+			if(mark6ReadAhead < 1 || mark6ReadAhead > MARK6_MAX_READ_AHEAD)
+			{
+				fprintf(stderr, "Warning: MARK6_READ_AHEAD=%s is out of range [1, %d]; using %d\n", e, MARK6_MAX_READ_AHEAD, MARK6_DEFAULT_READ_AHEAD);
+				mark6ReadAhead = MARK6_DEFAULT_READ_AHEAD;
+			}
+		}
+	}
+
+	return mark6ReadAhead;
+}
+
+int setMark6ReadAhead(int readAhead)
+{
+	int prev = getMark6ReadAhead();
+
+	if(readAhead >= 1 && readAhead <= MARK6_MAX_READ_AHEAD)
+	{
+		mark6ReadAhead = readAhead;
+	}
+
+	return prev;
+}
+
+int getMark6DirectIO()
+{
+	if(mark6DirectIO < 0)
+	{
+		const char *e = getenv("MARK6_DIRECT_IO");
+
+		mark6DirectIO = (e && atoi(e) > 0) ? 1 : 0;
+	}
+
+	return mark6DirectIO;
+}
+
+int setMark6DirectIO(int directIO)
+{
+	int prev = getMark6DirectIO();
+
+	mark6DirectIO = directIO ? 1 : 0;
+
+	return prev;
+}
+
 const char *getMark6MetaRoot()
 {
 	static const char *root = 0;
@@ -84,6 +84,10 @@ typedef struct
 	int32_t blocknum;
 } Mark6BlockHeader_ver1;
 
+#define MARK6_DEFAULT_READ_AHEAD	2	/* blocks read ahead per file unless MARK6_READ_AHEAD is set */
+#define MARK6_MAX_READ_AHEAD	64
+#define MARK6_DIRECT_ALIGN	4096	/* alignment of offsets, lengths and buffers when reading with O_DIRECT */
+
 typedef struct
 {
 	int payloadBytes;			/* [bytes] actual number of payload bytes (usually == payload_size) */
@@ -91,8 +95,17 @@ typedef struct
 	uint64_t frame;				/* from frame header */
 	char *data;				/* points to payload within buffer */
 	Mark6BlockHeader_ver2 blockHeader;	/* header corresponding to recent data */
+	char *buffer;				/* allocated block buffer; swapped with read-ahead blocks */
 } Mark6BufferSlot;
 
+typedef struct
+{
+	int payloadBytes;			/* [bytes] 0 for end of file */
+	char *data;				/* points to payload within buffer */
+	Mark6BlockHeader_ver2 blockHeader;
+	char *buffer;
+} Mark6ReadAheadBlock;
+
 typedef struct
 {
 	FILE *in;				/* actual file descriptor */
@@ -107,13 +120,30 @@ typedef struct
 
 	Mark6BufferSlot slot[MARK6_BUFFER_SLOTS];	/* Allow MARK6_BUFFER_SLOTS blocks to be visible to gatherer at once */
 
-	/* some parallel-read infrastructure */
+	/* read-ahead: a thread per file keeps up to readAhead blocks queued for the gatherer */
+	int fd;					/* separate descriptor for the read thread; opened O_DIRECT if possible and requested */
+	int directIO;				/* 1 if fd is O_DIRECT */
+	int bufferSize;				/* [bytes] allocation size of each block buffer */
 	int stopReading;			/* if > 0, get out of read loop */
+	int pauseReading;			/* if > 0, read thread goes idle (for seeking) */
+	int readPaused;				/* set by read thread while idle at pauseReading's request */
+	int readEOF;				/* read thread has reached the end of the file */
+	off_t readOffset;			/* file offset of the next block for the read thread */
+	int nextBlockSize;			/* [bytes] size of the block at readOffset if already known, else 0 */
+	int readAhead;				/* number of entries in readQueue */
+	int queueHead, queueCount;
+	Mark6ReadAheadBlock *readQueue;
 	pthread_t readThread;
-	pthread_barrier_t readBarrier;
-	Mark6BlockHeader_ver2 readHeader;	/* header corresponding to recent data */
-	char *readBuffer;			/* same size as data[] above */
-	int readBytes;				/* how many bytes were actually read */
+	pthread_mutex_t readLock;
+	pthread_cond_t readCond;		/* signalled by read thread: block added, end of file, or paused */
+	pthread_cond_t spaceCond;		/* signalled to read thread: block taken, pause, resume or stop */
+
+	/* read statistics */
+	long long nBlockRead;
+	long long nByteRead;
+	double readSeconds;			/* [sec] time spent in pread() */
+	long long nReadWait;			/* times the gatherer found no block ready */
+	double waitSeconds;			/* [sec] time the gatherer spent waiting */
 } Mark6File;
 
 typedef struct
@@ -161,8 +191,21 @@ int seekMark6Gather(Mark6Gatherer *m6g, off_t position);
 
 int mark6Gather(Mark6Gatherer *m6g, void *buf, size_t count);
 
+void printMark6GathererReadStatistics(const Mark6Gatherer *m6g);
+
 const char *getMark6Root();
 
+/* number of blocks read ahead per file: MARK6_READ_AHEAD env var, or MARK6_DEFAULT_READ_AHEAD */
+int getMark6ReadAhead();
+
+/* overrides MARK6_READ_AHEAD for files opened after the call; returns the previous value */
+int setMark6ReadAhead(int readAhead);
+
+/* 1 if env var MARK6_DIRECT_IO is set to 1, in which case files are read with O_DIRECT where possible */
+int getMark6DirectIO();
+
+int setMark6DirectIO(int directIO);
+
 const char *getMark6MetaRoot();
 
 int getMark6FileList(char ***fileList);
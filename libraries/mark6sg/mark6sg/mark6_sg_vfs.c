@@ -65,7 +65,8 @@
 
 // Prefetch (via mmap() MAP_POPULATE-like threaded forced kernel page faults)
 #define USE_MMAP_POPULATE_LIKE_PREFETCH 1  // 1 to enable, 0 to disable
-#define PREFETCH_NUM_BLOCKS_PER_FILE    4
+#define PREFETCH_NUM_BLOCKS_PER_FILE    4  // default; env var MARK6_READ_AHEAD overrides it, as it does for mark6gather
+#define PREFETCH_MAX_BLOCKS_PER_FILE    64
 #define WRITER_FRAMES_PER_BLOCK         5000
 
 // When disks have unrelocatable bad sectors that cause I/O errors, mmap()'ed regions cause SIGBUS, whereas fread() returns a handleable error
@@ -127,6 +128,27 @@ __attribute__((constructor)) void init(void)
 #endif
 }
 
+/**
+ * Number of blocks per file that the prefetch threads keep ahead of the read position.
+ */
+static int prefetch_blocks_per_file(void)
+{
+    const char* e = getenv("MARK6_READ_AHEAD");
+    int n;
+
+    if (e == NULL)
+    {
+        return PREFETCH_NUM_BLOCKS_PER_FILE;
+    }
+    n = atoi(e);
+    if ((n < 1) || (n > PREFETCH_MAX_BLOCKS_PER_FILE))
+    {
+        fprintf(stderr, "Warning: MARK6_READ_AHEAD=%s is out of range [1, %d]; using %d\n", e, PREFETCH_MAX_BLOCKS_PER_FILE, PREFETCH_NUM_BLOCKS_PER_FILE);
+        return PREFETCH_NUM_BLOCKS_PER_FILE;
+    }
+    return n;
+}
+
 /**
  * Open a scatter-gather recording for reading.
  * Similar behaviour as 'man 2 open'.
@@ -255,6 +277,7 @@ int mark6_sg_open(const char *scanname, int flags)
     // Trigger a preload of future mmap()'ed data in the background
 #if (USE_MMAP_POPULATE_LIKE_PREFETCH != 0)
     vfd->touch_terminate = 0;
+    vfd->prefetch_nblocks = prefetch_blocks_per_file();
     for (i = 0; i < vfd->nfiles; i++)
     {
         vfd->touch_ctxs[i].vfd = vfd;
@@ -1092,8 +1115,9 @@ void* touch_next_blocks_thread(void* p_ioctx)
         // Do not care about block numbers; just touch the next blocks in current file
         off      = vfd->blks[blk].file_offset;
         off     &= ~((off64_t)(pagesz - 1));
-        off_stop = off + vfd->blks[blk].datalen * PREFETCH_NUM_BLOCKS_PER_FILE;
+        off_stop = off + vfd->blks[blk].datalen * vfd->prefetch_nblocks;
         off_stop = (off_stop > vfd->fsize[ctx->file_id]) ? vfd->fsize[ctx->file_id] : off_stop;
+#if !AVOID_MMAP
         while (off < off_stop)
         {
             // Reference the data to cause page fault and a kernel
@@ -1101,17 +1125,18 @@ void* touch_next_blocks_thread(void* p_ioctx)
             // Data is not actually used here. The pages cached by
             // kernel will however be available in future read() calls.
             char dummy;
-#if !AVOID_MMAP
             dummy = fdata[off];
-#else
-            (void)pread(vfd->fds[ctx->file_id], &dummy, 1, off);
-#endif
             off += pagesz;
             if (m_m6sg_dbglevel>99) { printf("(printf to prevent optimizing away 'dummy') %c", dummy); }
 
             // Cancel if we're running late relative to user
-            if ((blk + PREFETCH_NUM_BLOCKS_PER_FILE) < vfd->rdblock) break;
+            if ((blk + vfd->prefetch_nblocks) < vfd->rdblock) break;
         }
+#else
+        // Without a mapping the kernel can read the whole range in the background;
+        // a single call replaces one pread() per page
+        (void)posix_fadvise(vfd->fds[ctx->file_id], off, off_stop - off, POSIX_FADV_WILLNEED);
+#endif
 
     }
 
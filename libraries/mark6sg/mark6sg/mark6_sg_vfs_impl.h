@@ -77,6 +77,7 @@ typedef struct m6sg_virt_filedescr {
     m6sg_blockmeta_t*  blks;
     io_thread_ctx_t    touch_ctxs[MARK6_SG_MAXFILES];
     volatile int       touch_terminate;
+    int                prefetch_nblocks;
     io_thread_ctx_t    writer_ctxs[MARK6_SG_MAXFILES];
     writer_pool_t      writer_pool;
     volatile int       writers_terminate;
@@ -0,0 +1,362 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by Walter Brisken                                  *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+//===========================================================================
+// SVN properties (DO NOT CHANGE)
+//
+// $Id$
+// $HeadURL$
+// $LastChangedRevision$
+// $Author$
+// $LastChangedDate$
+//
+//============================================================================
+//
+// ./mk6readbench [options]
+//
+// Writes a fake Mark6 module (a set of scatter-gather files holding a
+// single VDIF thread) to a directory, by default on tmpfs, then gathers
+// it back with several read-ahead depths.  The gathered stream is checked
+// for frame order and content, and gather rate and per-file read
+// statistics are reported.
+//
+//============================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "mark6gather.h"
+
+#define VDIF_HEADER_WORDS	8
+#define FRAMES_PER_SECOND	25600
+#define MAX_DEPTHS		16
+
+static void usage(const char *prog)
+{
+	printf("Usage: %s [options]\n\n", prog);
+	printf("options can include:\n");
+	printf("  -h           print this help info and quit\n");
+	printf("  -d <dir>     directory for the fake module files [/dev/shm]\n");
+	printf("  -n <files>   number of files (disks) [8]\n");
+	printf("  -m <MB>      total size of the fake module [512]\n");
+	printf("  -b <bytes>   Mark6 block size [10000000]\n");
+	printf("  -p <bytes>   VDIF frame size [8032]\n");
+	printf("  -r <list>    comma separated read-ahead depths to test [1,2,4,8]\n");
+	printf("  -D           request O_DIRECT reads (ignored where unsupported, e.g., tmpfs)\n");
+	printf("  -k           keep the fake module files\n\n");
+}
+
+static double now()
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+
+	return t.tv_sec + t.tv_nsec*1.0e-9;
+}
+
+/* frame counter n is stored in the VDIF header time and in the first payload word */
+static void makeFrame(uint32_t *frame, int frameSize, long long n)
+{
+	memset(frame, 0, VDIF_HEADER_WORDS*sizeof(uint32_t));
+	frame[0] = n / FRAMES_PER_SECOND;
+	frame[1] = n % FRAMES_PER_SECOND;
+	frame[2] = (frameSize/8) | (1 << 24);
+	frame[3] = 1 << 26;		/* 2 bits per sample */
+	frame[VDIF_HEADER_WORDS] = (uint32_t)n;
+	frame[VDIF_HEADER_WORDS+1] = ~(uint32_t)n;
+}
+
+static int writeModule(const char *dir, int nFile, long long totalBytes, int blockSize, int frameSize, long long *nFrameWritten)
+{
+	FILE **out;
+	char *block;
+	int framesPerBlock;
+	int wbSize;
+	long long nBlock, b, n = 0;
+	int f;
+
+	framesPerBlock = (blockSize - sizeof(Mark6BlockHeader_ver2))/frameSize;
+	if(framesPerBlock < 1)
+	{
+		fprintf(stderr, "Error: block size %d is too small for frame size %d\n", blockSize, frameSize);
+
+		return -1;
+	}
+	wbSize = sizeof(Mark6BlockHeader_ver2) + framesPerBlock*frameSize;
+	nBlock = totalBytes/wbSize;
+
+	out = (FILE **)calloc(nFile, sizeof(FILE *));
+	block = (char *)calloc(1, wbSize);
+	for(f = 0; f < nFile; ++f)
+	{
+		Mark6Header header;
+		char fileName[1024];
+
+		snprintf(fileName, sizeof(fileName), "%s/mk6readbench_No0001.%d", dir, f);
+		out[f] = fopen(fileName, "w");
+		if(!out[f])
+		{
+			fprintf(stderr, "Error: cannot open %s for write\n", fileName);
+
+			return -1;
+		}
+		header.sync_word = MARK6_SYNC;
+		header.version = 2;
+		header.block_size = wbSize;
+		header.packet_format = 0;
+		header.packet_size = frameSize;
+		fwrite(&header, sizeof(header), 1, out[f]);
+	}
+
+	/* blocks are dealt to the files round robin, as the recorder would with evenly performing disks */
+	for(b = 0; b < nBlock; ++b)
+	{
+		Mark6BlockHeader_ver2 *bh = (Mark6BlockHeader_ver2 *)block;
+		int i;
+
+		bh->blocknum = b;
+		bh->wb_size = wbSize;
+		for(i = 0; i < framesPerBlock; ++i)
+		{
+			makeFrame((uint32_t *)(block + sizeof(Mark6BlockHeader_ver2) + i*frameSize), frameSize, n);
+			++n;
+		}
+		fwrite(block, wbSize, 1, out[b % nFile]);
+	}
+
+	for(f = 0; f < nFile; ++f)
+	{
+		fclose(out[f]);
+	}
+	free(out);
+	free(block);
+
+	*nFrameWritten = n;
+
+	return 0;
+}
+
+static void removeModule(const char *dir, int nFile)
+{
+	int f;
+
+	for(f = 0; f < nFile; ++f)
+	{
+		char fileName[1024];
+
+		snprintf(fileName, sizeof(fileName), "%s/mk6readbench_No0001.%d", dir, f);
+		unlink(fileName);
+	}
+}
+
+/* returns number of errors found */
+static int gatherModule(const char *dir, int frameSize, long long nFrame)
+{
+	const int GatherSize = 10000000;
+	Mark6Gatherer *G;
+	char template[1024];
+	char *buf;
+	long long n = 0, totalBytes = 0;
+	int nError = 0;
+	double t0, t1;
+
+	snprintf(template, sizeof(template), "%s/mk6readbench_No0001.*", dir);
+
+	buf = (char *)malloc(GatherSize);
+
+	t0 = now();
+	G = openMark6GathererFromTemplate(template);
+	if(!G)
+	{
+		fprintf(stderr, "Error: cannot open gatherer for %s\n", template);
+		free(buf);
+
+		return 1;
+	}
+	for(;;)
+	{
+		int v, i;
+
+		v = mark6Gather(G, buf, GatherSize);
+		if(v <= 0)
+		{
+			break;
+		}
+		totalBytes += v;
+		for(i = 0; i + frameSize <= v; i += frameSize)
+		{
+			const uint32_t *frame = (const uint32_t *)(buf + i);
+			long long m = (long long)frame[0]*FRAMES_PER_SECOND + frame[1];
+
+			if(m != n || frame[VDIF_HEADER_WORDS] != (uint32_t)n || frame[VDIF_HEADER_WORDS+1] != ~(uint32_t)n)
+			{
+				if(nError < 10)
+				{
+					fprintf(stderr, "Error: frame %lld: got frame %lld\n", n, m);
+				}
+				++nError;
+				n = m;
+			}
+			++n;
+		}
+	}
+	t1 = now();
+
+	if(n != nFrame)
+	{
+		fprintf(stderr, "Error: gathered %lld frames; %lld were written\n", n, nFrame);
+		++nError;
+	}
+
+	printf("  Gathered %lld bytes in %5.3f sec: %5.0f MB/s\n", totalBytes, t1-t0, totalBytes*1.0e-6/(t1-t0));
+	printMark6GathererReadStatistics(G);
+
+	closeMark6Gatherer(G);
+	free(buf);
+
+	return nError;
+}
+
+int main(int argc, char **argv)
+{
+	const char *dir = "/dev/shm";
+	int nFile = 8;
+	long long totalMB = 512;
+	int blockSize = 10000000;
+	int frameSize = 8032;
+	int depths[MAX_DEPTHS] = { 1, 2, 4, 8 };
+	int nDepth = 4;
+	int keep = 0;
+	long long nFrame;
+	int nError = 0;
+	int a, d;
+
+	for(a = 1; a < argc; ++a)
+	{
+		if(strcmp(argv[a], "-h") == 0)
+		{
+			usage(argv[0]);
+
+			return EXIT_SUCCESS;
+		}
+		else if(strcmp(argv[a], "-D") == 0)
+		{
+			setMark6DirectIO(1);
+		}
+		else if(strcmp(argv[a], "-k") == 0)
+		{
+			keep = 1;
+		}
+		else if(a < argc-1)
+		{
+			if(strcmp(argv[a], "-d") == 0)
+			{
+				dir = argv[a+1];
+			}
+			else if(strcmp(argv[a], "-n") == 0)
+			{
+				nFile = atoi(argv[a+1]);
+			}
+			else if(strcmp(argv[a], "-m") == 0)
+			{
+				totalMB = atoll(argv[a+1]);
+			}
+			else if(strcmp(argv[a], "-b") == 0)
+			{
+				blockSize = atoi(argv[a+1]);
+			}
+			else if(strcmp(argv[a], "-p") == 0)
+			{
+				frameSize = atoi(argv[a+1]);
+			}
+			else if(strcmp(argv[a], "-r") == 0)
+			{
+				char *p = argv[a+1];
+
+				for(nDepth = 0; nDepth < MAX_DEPTHS && *p; ++nDepth)
+				{
+					depths[nDepth] = strtol(p, &p, 10);
+					if(*p == ',')
+					{
+						++p;
+					}
+				}
+			}
+			else
+			{
+				fprintf(stderr, "Error: unknown command line parameter %s\n", argv[a]);
+
+				return EXIT_FAILURE;
+			}
+			++a;
+		}
+		else
+		{
+			fprintf(stderr, "Error: unknown command line parameter %s\n", argv[a]);
+
+			return EXIT_FAILURE;
+		}
+	}
+
+	if(nFile < 1 || totalMB < 1 || frameSize < 64 || frameSize % 8 != 0)
+	{
+		fprintf(stderr, "Error: bad parameters\n");
+
+		return EXIT_FAILURE;
+	}
+
+	printf("Writing %lld MB fake module as %d files in %s\n", totalMB, nFile, dir);
+	if(writeModule(dir, nFile, totalMB*1000000LL, blockSize, frameSize, &nFrame) < 0)
+	{
+		removeModule(dir, nFile);
+
+		return EXIT_FAILURE;
+	}
+
+	for(d = 0; d < nDepth; ++d)
+	{
+		int e;
+
+		setMark6ReadAhead(depths[d]);
+		if(getMark6ReadAhead() != depths[d])
+		{
+			fprintf(stderr, "Warning: read-ahead depth %d is out of range; skipping\n", depths[d]);
+
+			continue;
+		}
+		printf("\nRead-ahead depth %d%s:\n", depths[d], getMark6DirectIO() ? ", O_DIRECT requested" : "");
+		e = gatherModule(dir, frameSize, nFrame);
+		if(e > 0)
+		{
+			fprintf(stderr, "Error: %d errors in gathered stream at read-ahead depth %d\n", e, depths[d]);
+		}
+		nError += e;
+	}
+
+	if(!keep)
+	{
+		removeModule(dir, nFile);
+	}
+
+	return nError > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
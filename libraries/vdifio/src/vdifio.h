@@ -431,6 +431,20 @@ void printvdifmux(const struct vdif_mux *vm);
 
 int vdifmux(unsigned char *dest, int destSize, const unsigned char *src, int srcSize, const struct vdif_mux *vm, int64_t startOutputFrameNumber, struct vdif_mux_statistics *stats);
 
+/* A pool of threads sharing the corner turning of vdifmuxparallel() calls.  nThread includes the calling thread, so
+ * newvdifmuxpool(4) starts 3 helper threads.  Returns 0 on error.  A pool must only be used by one caller at a time. */
+struct vdif_mux_pool;
+
+struct vdif_mux_pool *newvdifmuxpool(int nThread);
+
+void deletevdifmuxpool(struct vdif_mux_pool *pool);
+
+int getvdifmuxpoolthreads(const struct vdif_mux_pool *pool);
+
+/* As vdifmux(), but the output frame range is split across the threads of pool (which may be 0, meaning just the
+ * calling thread).  Output and statistics are identical to those of vdifmux(). */
+int vdifmuxparallel(unsigned char *dest, int destSize, const unsigned char *src, int srcSize, const struct vdif_mux *vm, int64_t startOutputFrameNumber, struct vdif_mux_statistics *stats, struct vdif_mux_pool *pool);
+
 void printvdifmuxstatistics(const struct vdif_mux_statistics *stats);
 
 void resetvdifmuxstatistics(struct vdif_mux_statistics *stats);
@@ -33,6 +33,7 @@
 #include <stdlib.h>
 #include <inttypes.h>
 #include <time.h>
+#include <pthread.h>
 #include <vdifio.h>
 #include "config.h"
 
@@ -472,6 +473,381 @@ static int64_t getHighestFrameNumber(const unsigned char *src, int srcSize, cons
 	return highest;
 }
 
+/* Prototype header for output frames; EDV4 when validity is propagated */
+typedef union
+{
+	vdif_header generic;
+	vdif_edv4_header edv4;
+} vdif_mux_header;
+
+/* Stage 2 output frame counts for one range of output frames */
+struct vdif_mux_part
+{
+	int firstFrame;
+	int nFrame;
+	int nGoodOutput;
+	int nPartialOutput;
+	int nBadOutput;
+};
+
+/* A stage 2 job, shared by all members of a pool for one call of vdifmuxparallel() */
+struct vdif_mux_job
+{
+	unsigned char *dest;
+	const unsigned char *src;
+	const struct vdif_mux *vm;
+	const vdif_mux_header *outputHeader;
+	int64_t startFrameNumber;
+};
+
+struct vdif_mux_pool
+{
+	int nWorker;				/* helper threads; the calling thread does one more share */
+	pthread_t *workers;
+	pthread_mutex_t lock;
+	pthread_cond_t startCond;
+	pthread_cond_t doneCond;
+	unsigned int generation;		/* incremented once per job */
+	int nBusy;				/* helpers yet to finish the current job */
+	int quit;
+	struct vdif_mux_job job;
+	struct vdif_mux_part *parts;		/* nWorker+1 of them; part 0 is done by the calling thread */
+};
+
+struct vdif_mux_worker_arg
+{
+	struct vdif_mux_pool *pool;
+	int index;
+};
+
+/* don't bother waking helpers for less than this many output frames each */
+#define VDIF_MUX_MIN_FRAMES_PER_PART	16
+
+/* Stage 2 of vdifmux: corner turn and populate headers for output frames firstFrame to firstFrame+nFrame-1.
+ * Each output frame is independent of the others, so disjoint ranges can be processed concurrently.
+ */
+static void muxoutputframes(const struct vdif_mux_job *job, struct vdif_mux_part *part)
+{
+	const struct vdif_mux *vm = job->vm;
+	int64_t frameNumber;
+	int seconds, frameNum;
+	int f, end;
+
+	part->nGoodOutput = 0;
+	part->nPartialOutput = 0;
+	part->nBadOutput = 0;
+
+	frameNumber = job->startFrameNumber + part->firstFrame;
+	seconds = frameNumber/vm->inputFramesPerSecond;
+	frameNum = frameNumber%vm->inputFramesPerSecond;
+
+	end = part->firstFrame + part->nFrame;
+	for(f = part->firstFrame; f < end; ++f)
+	{
+		unsigned char *frame = job->dest + vm->outputFrameSize*f;	/* points to rearrangement destination */
+		const uint64_t *p = (const uint64_t *)frame;
+		uint64_t mask;
+
+		mask = p[3];
+
+		/* generate header for output frame */
+		memcpy(frame, (const char *)job->outputHeader, VDIF_HEADER_BYTES);
+		setVDIFFrameEpochSecOffset((vdif_header *)frame, seconds);
+		setVDIFFrameNumber((vdif_header *)frame, frameNum);
+
+		if(vm->flags & VDIF_MUX_FLAG_PROPAGATEVALIDITY)
+		{
+			if(mask != 0)
+			{
+				const unsigned char **threadBuffers = (const unsigned char **)(frame + VDIF_HEADER_BYTES);
+				vdif_edv4_header *edv4 = (vdif_edv4_header *)frame;
+				if(vm->fanoutFactor > 1)
+				{
+					int i, k;
+
+					edv4->validitymask = 0;
+					for(i = k = 0; i < vm->nThread; i += vm->fanoutFactor, ++k)
+					{
+						int m;
+						int j;
+						
+						m = 1;
+						for(j = 0; j < vm->fanoutFactor; ++j)
+						{
+							m &= (mask >> (i+j));
+						}
+						edv4->validitymask |= (m << k);
+					}
+				}
+				else
+				{
+					edv4->validitymask = mask;
+				}
+
+				if(mask != vm->goodMask)
+				{
+					int64_t i;
+					/* point to random data rather than nowhere for invalid frames */
+
+					for(i = 0; i < vm->nThread; ++i)
+					{
+						if( (mask & (1LL << i)) == 0)
+						{
+							threadBuffers[i] = job->src;
+						}
+					}
+
+				}
+
+				/* Note: The following function only works because all of the corner turners make a copy of the
+				 * thread pointers before beginning */
+				vm->cornerTurner(frame + VDIF_HEADER_BYTES, threadBuffers, vm->outputDataSize);
+
+				if(mask == vm->goodMask)
+				{
+					++part->nGoodOutput;
+				}
+				else
+				{
+					++part->nPartialOutput;
+				}
+			}
+			else
+			{
+				/* Set invalid bit */
+				setVDIFFrameInvalid((vdif_header *)frame, 1);
+
+				++part->nBadOutput;
+			}
+		}
+		else
+		{
+			if(mask == vm->goodMask)
+			{
+				const unsigned char * const *threadBuffers = (const unsigned char * const *)(frame + VDIF_HEADER_BYTES);
+
+				/* Note: The following function only works because all of the corner turners make a copy of the
+				 * thread pointers before beginning */
+				vm->cornerTurner(frame + VDIF_HEADER_BYTES, threadBuffers, vm->outputDataSize);
+
+				++part->nGoodOutput;
+			}
+			else
+			{
+				/* Set invalid bit */
+				setVDIFFrameInvalid((vdif_header *)frame, 1);
+
+				++part->nBadOutput;
+			}
+		}
+
+		++frameNum;
+		if(frameNum >= vm->inputFramesPerSecond)
+		{
+			++seconds;
+			frameNum -= vm->inputFramesPerSecond;
+		}
+	}
+}
+
+static void *muxworker(void *arg)
+{
+	struct vdif_mux_worker_arg *W = (struct vdif_mux_worker_arg *)arg;
+	struct vdif_mux_pool *pool = W->pool;
+	int index = W->index;
+	unsigned int seen = 0;
+
+	free(W);
+
+	pthread_mutex_lock(&pool->lock);
+	for(;;)
+	{
+		while(!pool->quit && pool->generation == seen)
+		{
+			pthread_cond_wait(&pool->startCond, &pool->lock);
+		}
+		if(pool->quit)
+		{
+			break;
+		}
+		seen = pool->generation;
+		pthread_mutex_unlock(&pool->lock);
+
+		muxoutputframes(&pool->job, pool->parts + index);
+
+		pthread_mutex_lock(&pool->lock);
+		--pool->nBusy;
+		if(pool->nBusy == 0)
+		{
+			pthread_cond_signal(&pool->doneCond);
+		}
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	return 0;
+}
+
+struct vdif_mux_pool *newvdifmuxpool(int nThread)
+{
+	struct vdif_mux_pool *pool;
+	pthread_attr_t attr;
+	int w;
+
+	if(nThread < 1)
+	{
+		return 0;
+	}
+
+	pool = (struct vdif_mux_pool *)calloc(1, sizeof(struct vdif_mux_pool));
+	if(!pool)
+	{
+		return 0;
+	}
+	pool->parts = (struct vdif_mux_part *)calloc(nThread, sizeof(struct vdif_mux_part));
+	pool->workers = (pthread_t *)calloc(nThread, sizeof(pthread_t));
+	if(!pool->parts || !pool->workers)
+	{
+		free(pool->parts);
+		free(pool->workers);
+		free(pool);
+
+		return 0;
+	}
+	pthread_mutex_init(&pool->lock, 0);
+	pthread_cond_init(&pool->startCond, 0);
+	pthread_cond_init(&pool->doneCond, 0);
+
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+	for(w = 1; w < nThread; ++w)
+	{
+		struct vdif_mux_worker_arg *W;
+
+		W = (struct vdif_mux_worker_arg *)malloc(sizeof(struct vdif_mux_worker_arg));
+		if(!W)
+		{
+			break;
+		}
+		W->pool = pool;
+		W->index = w;
+		if(pthread_create(&pool->workers[w-1], &attr, muxworker, W) != 0)
+		{
+			free(W);
+			break;
+		}
+		++pool->nWorker;
+	}
+	pthread_attr_destroy(&attr);
+
+	if(pool->nWorker != nThread-1)
+	{
+		fprintf(stderr, "Warning: newvdifmuxpool: only %d of %d threads could be started\n", pool->nWorker+1, nThread);
+	}
+
+	return pool;
+}
+
+void deletevdifmuxpool(struct vdif_mux_pool *pool)
+{
+	int w;
+
+	if(!pool)
+	{
+		return;
+	}
+
+	pthread_mutex_lock(&pool->lock);
+	pool->quit = 1;
+	pthread_cond_broadcast(&pool->startCond);
+	pthread_mutex_unlock(&pool->lock);
+	for(w = 0; w < pool->nWorker; ++w)
+	{
+		pthread_join(pool->workers[w], 0);
+	}
+	pthread_cond_destroy(&pool->doneCond);
+	pthread_cond_destroy(&pool->startCond);
+	pthread_mutex_destroy(&pool->lock);
+	free(pool->workers);
+	free(pool->parts);
+	free(pool);
+}
+
+int getvdifmuxpoolthreads(const struct vdif_mux_pool *pool)
+{
+	if(!pool)
+	{
+		return 1;
+	}
+
+	return pool->nWorker + 1;
+}
+
+/* Run stage 2 over output frames 0 to nFrame-1, split into contiguous ranges across the pool (if any) */
+static void runmuxoutputframes(struct vdif_mux_pool *pool, const struct vdif_mux_job *job, int nFrame, struct vdif_mux_part *total)
+{
+	int nPart, w, first;
+
+	nPart = 1;
+	if(pool && pool->nWorker > 0)
+	{
+		nPart = nFrame/VDIF_MUX_MIN_FRAMES_PER_PART;
+		if(nPart > pool->nWorker + 1)
+		{
+			nPart = pool->nWorker + 1;
+		}
+		if(nPart < 1)
+		{
+			nPart = 1;
+		}
+	}
+
+	if(nPart == 1)
+	{
+		total->firstFrame = 0;
+		total->nFrame = nFrame;
+		muxoutputframes(job, total);
+
+		return;
+	}
+
+	/* parts beyond nPart are given no frames so their helpers return immediately */
+	first = 0;
+	for(w = 0; w <= pool->nWorker; ++w)
+	{
+		int n = (w < nPart) ? (nFrame - first)/(nPart - w) : 0;
+
+		pool->parts[w].firstFrame = first;
+		pool->parts[w].nFrame = n;
+		first += n;
+	}
+
+	pthread_mutex_lock(&pool->lock);
+	pool->job = *job;
+	pool->nBusy = pool->nWorker;
+	++pool->generation;
+	pthread_cond_broadcast(&pool->startCond);
+	pthread_mutex_unlock(&pool->lock);
+
+	muxoutputframes(&pool->job, pool->parts);
+
+	pthread_mutex_lock(&pool->lock);
+	while(pool->nBusy > 0)
+	{
+		pthread_cond_wait(&pool->doneCond, &pool->lock);
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	total->firstFrame = 0;
+	total->nFrame = nFrame;
+	total->nGoodOutput = total->nPartialOutput = total->nBadOutput = 0;
+	for(w = 0; w <= pool->nWorker; ++w)
+	{
+		total->nGoodOutput += pool->parts[w].nGoodOutput;
+		total->nPartialOutput += pool->parts[w].nPartialOutput;
+		total->nBadOutput += pool->parts[w].nBadOutput;
+	}
+}
+
 /* Params are:
  *
  * dest:
@@ -504,7 +880,7 @@ static int64_t getHighestFrameNumber(const unsigned char *src, int srcSize, cons
  *
  * see ../utils/vmux.c for example usage of this function
  */
-int vdifmux(unsigned char *dest, int destSize, const unsigned char *src, int srcSize, const struct vdif_mux *vm, int64_t startOutputFrameNumber, struct vdif_mux_statistics *stats)
+static int vdifmuxinternal(unsigned char *dest, int destSize, const unsigned char *src, int srcSize, const struct vdif_mux *vm, int64_t startOutputFrameNumber, struct vdif_mux_statistics *stats, struct vdif_mux_pool *pool)
 {
 	int threadId;
 	int nValidFrame = 0;			/* counts number of valid input frames found so far */
@@ -529,12 +905,9 @@ int vdifmux(unsigned char *dest, int destSize, const unsigned char *src, int src
 	int nBadOutput = 0;
 	int nPartialOutput = 0;
 	int nWrongThread = 0;
-	int seconds, frameNum;
-	union
-	{
-		vdif_header generic;
-		vdif_edv4_header edv4;
-	} outputHeader;
+	vdif_mux_header outputHeader;
+	struct vdif_mux_job job;
+	struct vdif_mux_part total;
 	int epoch = -1;
 	int highestSortedDestIndex = -1;
 	int vhUnset = 1;
@@ -880,115 +1253,15 @@ int vdifmux(unsigned char *dest, int destSize, const unsigned char *src, int src
 
 	/* Stage 2: do the corner turning and header population */
 
-	seconds = startFrameNumber/vm->inputFramesPerSecond;
-	frameNum = startFrameNumber%vm->inputFramesPerSecond;
-
-	for(f = 0; f <= highestDestIndex; ++f)
-	{
-		unsigned char *frame = dest + vm->outputFrameSize*f;	/* points to rearrangement destination */
-		const uint64_t *p = (const uint64_t *)frame;
-		uint64_t mask;
-
-		mask = p[3];
-
-		/* generate header for output frame */
-		memcpy(frame, (const char *)&outputHeader, VDIF_HEADER_BYTES);
-		setVDIFFrameEpochSecOffset((vdif_header *)frame, seconds);
-		setVDIFFrameNumber((vdif_header *)frame, frameNum);
-
-		if(vm->flags & VDIF_MUX_FLAG_PROPAGATEVALIDITY)
-		{
-			if(mask != 0)
-			{
-				const unsigned char **threadBuffers = (const unsigned char **)(frame + VDIF_HEADER_BYTES);
-				vdif_edv4_header *edv4 = (vdif_edv4_header *)frame;
-				if(vm->fanoutFactor > 1)
-				{
-					int k;
-
-					edv4->validitymask = 0;
-					for(i = k = 0; i < vm->nThread; i += vm->fanoutFactor, ++k)
-					{
-						int m;
-						int j;
-						
-						m = 1;
-						for(j = 0; j < vm->fanoutFactor; ++j)
-						{
-							m &= (mask >> (i+j));
-						}
-						edv4->validitymask |= (m << k);
-					}
-				}
-				else
-				{
-					edv4->validitymask = mask;
-				}
-
-				if(mask != vm->goodMask)
-				{
-					int64_t i;
-					/* point to random data rather than nowhere for invalid frames */
-
-					for(i = 0; i < vm->nThread; ++i)
-					{
-						if( (mask & (1LL << i)) == 0)
-						{
-							threadBuffers[i] = src;
-						}
-					}
-
-				}
-
-				/* Note: The following function only works because all of the corner turners make a copy of the
-				 * thread pointers before beginning */
-				vm->cornerTurner(frame + VDIF_HEADER_BYTES, threadBuffers, vm->outputDataSize);
-
-				if(mask == vm->goodMask)
-				{
-					++nGoodOutput;
-				}
-				else
-				{
-					++nPartialOutput;
-				}
-			}
-			else
-			{
-				/* Set invalid bit */
-				setVDIFFrameInvalid((vdif_header *)frame, 1);
-
-				++nBadOutput;
-			}
-		}
-		else
-		{
-			if(mask == vm->goodMask)
-			{
-				const unsigned char * const *threadBuffers = (const unsigned char * const *)(frame + VDIF_HEADER_BYTES);
-
-				/* Note: The following function only works because all of the corner turners make a copy of the
-				 * thread pointers before beginning */
-				vm->cornerTurner(frame + VDIF_HEADER_BYTES, threadBuffers, vm->outputDataSize);
-
-				++nGoodOutput;
-			}
-			else
-			{
-				/* Set invalid bit */
-				setVDIFFrameInvalid((vdif_header *)frame, 1);
-
-				++nBadOutput;
-			}
-		}
-
-		++frameNum;
-		if(frameNum >= vm->inputFramesPerSecond)
-		{
-			++seconds;
-			frameNum -= vm->inputFramesPerSecond;
-		}
-	}
+	job.dest = dest;
+	job.src = src;
+	job.vm = vm;
+	job.outputHeader = &outputHeader;
+	job.startFrameNumber = startFrameNumber;
+	runmuxoutputframes(pool, &job, highestDestIndex + 1, &total);
+	nGoodOutput = total.nGoodOutput;
+	nPartialOutput = total.nPartialOutput;
+	nBadOutput = total.nBadOutput;
 
 	if(stats)
 	{
@@ -1043,6 +1316,16 @@ int vdifmux(unsigned char *dest, int destSize, const unsigned char *src, int src
 	return firstGoodByte;
 }
 
+int vdifmux(unsigned char *dest, int destSize, const unsigned char *src, int srcSize, const struct vdif_mux *vm, int64_t startOutputFrameNumber, struct vdif_mux_statistics *stats)
+{
+	return vdifmuxinternal(dest, destSize, src, srcSize, vm, startOutputFrameNumber, stats, 0);
+}
+
+int vdifmuxparallel(unsigned char *dest, int destSize, const unsigned char *src, int srcSize, const struct vdif_mux *vm, int64_t startOutputFrameNumber, struct vdif_mux_statistics *stats, struct vdif_mux_pool *pool)
+{
+	return vdifmuxinternal(dest, destSize, src, srcSize, vm, startOutputFrameNumber, stats, pool);
+}
+
 void printvdifmuxstatistics(const struct vdif_mux_statistics *stats)
 {
 	if(stats)
@@ -41,6 +41,15 @@
 #include "sysutil.h"
 
 int Configuration::MONITOR_TCP_WINDOWBYTES;
+const int Configuration::XMAC_TILE_STATIONS = 8;
+const int Configuration::XMAC_TILE_BYTES = 262144;
+const int Configuration::DEFAULT_CORE_RING_LENGTH = 4;
+const int Configuration::MIN_CORE_RING_LENGTH = 3;
+const int Configuration::MAX_CORE_RING_LENGTH = 64;
+const int Configuration::MAX_VDIF_MUX_THREADS = 32;
+const int Configuration::DEFAULT_NETWORK_BATCH = 64;
+const int Configuration::MAX_NETWORK_BATCH = 1024;
+const int Configuration::MAX_VDIF_REORDER_DEPTH = 16384;
 
 // finds the integer closest to but not less than the square root of fftchannels
 static unsigned int calcstridelength(unsigned int arraylength)
@@ -75,15 +84,7 @@ Configuration::Configuration(const char * configfile, int id, MPI_Comm& comm, do
     cfatal << startl << "Failed MPI setup on MPI_Comm_dup() duplication! Correlation may produce strange results!" << endl;
 
   setJobNameFromConfigfilename(string(configfile));
-  char * difxmtu = getenv("DIFX_MTU");
-  if(difxmtu == 0)
-    mtu = 1500;
-  else
-    mtu = atoi(difxmtu);
-  if (mtu > 9000) {
-    cerror << startl << "DIFX_MTU was set to " << mtu << " - resetting to 9000 bytes (max)" << endl;
-    mtu = 9000;
-  }
+  parseEnvironmentTuning();
 
   //open the file
   istream * input = mpiGetFileContent(configfile);
@@ -116,15 +117,7 @@ Configuration::Configuration(const char * configfile, int id, double restartsec)
   model = NULL;
 
   setJobNameFromConfigfilename(string(configfile));
-  char * difxmtu = getenv("DIFX_MTU");
-  if(difxmtu == 0)
-    mtu = 1500;
-  else
-    mtu = atoi(difxmtu);
-  if (mtu > 9000) {
-    cerror << startl << "DIFX_MTU was set to " << mtu << " - resetting to 9000 bytes (max)" << endl;
-    mtu = 9000;
-  }
+  parseEnvironmentTuning();
 
   //open the file
   istream * input = mpiGetFileContent(configfile);
@@ -143,6 +136,111 @@ Configuration::Configuration(const char * configfile, int id, double restartsec)
 }
 
 
+void Configuration::parseEnvironmentTuning()
+{
+  char * difxmtu = getenv("DIFX_MTU");
+  if(difxmtu == 0)
+    mtu = 1500;
+  else
+    mtu = atoi(difxmtu);
+  if (mtu > 9000) {
+    cerror << startl << "DIFX_MTU was set to " << mtu << " - resetting to 9000 bytes (max)" << endl;
+    mtu = 9000;
+  }
+  char * difxfftwplanning = getenv("DIFX_FFTW_PLANNING");
+  fftplanmode = FFTPLANESTIMATE;
+  if(difxfftwplanning != 0)
+  {
+    if(strcmp(difxfftwplanning, "MEASURE") == 0)
+      fftplanmode = FFTPLANMEASURE;
+    else if(strcmp(difxfftwplanning, "PATIENT") == 0)
+      fftplanmode = FFTPLANPATIENT;
+    else if(strcmp(difxfftwplanning, "ESTIMATE") != 0)
+      cerror << startl << "DIFX_FFTW_PLANNING was set to " << difxfftwplanning << " - should be ESTIMATE, MEASURE or PATIENT; using ESTIMATE" << endl;
+  }
+  char * difxcoreaccumulation = getenv("DIFX_CORE_ACCUMULATION");
+  coreaccumulationmode = LOCKEDACCUMULATION;
+  if(difxcoreaccumulation != 0)
+  {
+    if(strcmp(difxcoreaccumulation, "REDUCTION") == 0)
+      coreaccumulationmode = REDUCTIONACCUMULATION;
+    else if(strcmp(difxcoreaccumulation, "LOCKED") != 0)
+      cerror << startl << "DIFX_CORE_ACCUMULATION was set to " << difxcoreaccumulation << " - should be LOCKED or REDUCTION; using LOCKED" << endl;
+  }
+  char * difxcorescheduling = getenv("DIFX_CORE_SCHEDULING");
+  coreschedulingmode = STATICBLOCKS;
+  if(difxcorescheduling != 0)
+  {
+    if(strcmp(difxcorescheduling, "DYNAMIC") == 0)
+      coreschedulingmode = DYNAMICBLOCKS;
+    else if(strcmp(difxcorescheduling, "STATIC") != 0)
+      cerror << startl << "DIFX_CORE_SCHEDULING was set to " << difxcorescheduling << " - should be STATIC or DYNAMIC; using STATIC" << endl;
+  }
+  char * difxcoreringlength = getenv("DIFX_CORE_RING_LENGTH");
+  coreringlength = DEFAULT_CORE_RING_LENGTH;
+  if(difxcoreringlength != 0)
+  {
+    coreringlength = atoi(difxcoreringlength);
+    if(coreringlength < MIN_CORE_RING_LENGTH || coreringlength > MAX_CORE_RING_LENGTH) {
+      cerror << startl << "DIFX_CORE_RING_LENGTH was set to " << difxcoreringlength << " - should be between " << MIN_CORE_RING_LENGTH << " and " << MAX_CORE_RING_LENGTH << "; using " << DEFAULT_CORE_RING_LENGTH << endl;
+      coreringlength = DEFAULT_CORE_RING_LENGTH;
+    }
+  }
+  //the manager and all Cores must agree on the ring length, so everyone uses the manager's value
+  if(enableMpi)
+    MPI_Bcast(&coreringlength, 1, MPI_INT, fxcorr::MANAGERID, mpicomm);
+  char * difxvdifmuxthreads = getenv("DIFX_VDIF_MUX_THREADS");
+  vdifmuxthreads = 1;
+  if(difxvdifmuxthreads != 0)
+  {
+    vdifmuxthreads = atoi(difxvdifmuxthreads);
+    if(vdifmuxthreads < 1 || vdifmuxthreads > MAX_VDIF_MUX_THREADS) {
+      cerror << startl << "DIFX_VDIF_MUX_THREADS was set to " << difxvdifmuxthreads << " - should be between 1 and " << MAX_VDIF_MUX_THREADS << "; using 1" << endl;
+      vdifmuxthreads = 1;
+    }
+  }
+  char * difxnetworkbatch = getenv("DIFX_NETWORK_BATCH");
+  networkbatch = DEFAULT_NETWORK_BATCH;
+  if(difxnetworkbatch != 0)
+  {
+    networkbatch = atoi(difxnetworkbatch);
+    if(networkbatch < 1 || networkbatch > MAX_NETWORK_BATCH) {
+      cerror << startl << "DIFX_NETWORK_BATCH was set to " << difxnetworkbatch << " - should be between 1 and " << MAX_NETWORK_BATCH << "; using " << DEFAULT_NETWORK_BATCH << endl;
+      networkbatch = DEFAULT_NETWORK_BATCH;
+    }
+  }
+  char * difxvdifreorderdepth = getenv("DIFX_VDIF_REORDER_DEPTH");
+  vdifreorderdepth = 0;
+  if(difxvdifreorderdepth != 0)
+  {
+    vdifreorderdepth = atoi(difxvdifreorderdepth);
+    if(vdifreorderdepth < 0 || vdifreorderdepth > MAX_VDIF_REORDER_DEPTH) {
+      cerror << startl << "DIFX_VDIF_REORDER_DEPTH was set to " << difxvdifreorderdepth << " - should be between 0 (no reordering) and " << MAX_VDIF_REORDER_DEPTH << "; not reordering" << endl;
+      vdifreorderdepth = 0;
+    }
+  }
+  char * difxprofile = getenv("DIFX_PROFILE");
+  profileinterval = 0;
+  if(difxprofile != 0)
+  {
+    profileinterval = atoi(difxprofile);
+    if(profileinterval < 0) {
+      cerror << startl << "DIFX_PROFILE was set to " << difxprofile << " - should be the reporting interval in seconds; disabling profiling" << endl;
+      profileinterval = 0;
+    }
+  }
+  char * difxpcalextraction = getenv("DIFX_PCAL_EXTRACTION");
+  pcalextractionmode = TIMEDOMAINPCAL;
+  if(difxpcalextraction != 0)
+  {
+    if(strcmp(difxpcalextraction, "SPECTRAL") == 0)
+      pcalextractionmode = SPECTRALPCAL;
+    else if(strcmp(difxpcalextraction, "TIME") != 0)
+      cerror << startl << "DIFX_PCAL_EXTRACTION was set to " << difxpcalextraction << " - should be TIME or SPECTRAL; using TIME" << endl;
+  }
+
+}
+
 void Configuration::setJobNameFromConfigfilename(string configfilename)
 {
   size_t basestart = configfilename.find_last_of('/');
@@ -151,9 +249,13 @@ void Configuration::setJobNameFromConfigfilename(string configfilename)
   else
     basestart = basestart+1;
   size_t baseend = configfilename.find_last_of('.');
-  if (baseend == string::npos)
+  //a '.' in a directory name (e.g. "../v2.1/job") is not an extension
+  if (baseend == string::npos || baseend < basestart)
     baseend = configfilename.size();
   jobname = configfilename.substr(basestart, baseend-basestart);
+  //FFTW wisdom and the stage profile live next to the .input file
+  fftwisdomfilename = configfilename.substr(0, baseend) + ".fftwisdom";
+  profilefilename = configfilename.substr(0, baseend) + ".profile";
 }
 
 istream* Configuration::mpiGetFileContent(const char* filename)
@@ -450,6 +552,7 @@ Configuration::~Configuration()
       delete [] configs[i].arraystridelen;
       delete [] configs[i].datastreamindices;
       delete [] configs[i].baselineindices;
+      delete [] configs[i].xmactiledbaselines;
       delete [] configs[i].ordereddatastreamindices;
       delete [] configs[i].frequsedbybaseline;
       delete [] configs[i].equivfrequsedbybaseline;
@@ -1327,10 +1430,14 @@ void Configuration::processCommon(istream * input)
   {
     outformat = ASCII;
   }
+  else if(line == "INDEXED")
+  {
+    outformat = DIFXINDEXED;
+  }
   else
   {
     if(mpiid == 0) //only write one copy of this error message
-      cerror << startl << "Unknown output format " << line << " (case sensitive choices are SWIN, DIFX (same thing) and ASCII), assuming SWIN/DIFX" << endl;
+      cerror << startl << "Unknown output format " << line << " (case sensitive choices are SWIN, DIFX (same thing), INDEXED and ASCII), assuming SWIN/DIFX" << endl;
     outformat = DIFX;
   }
   getinputline(input, &outputfilename, "OUTPUT FILENAME");
@@ -1340,7 +1447,7 @@ void Configuration::processCommon(istream * input)
 
 bool Configuration::processConfig(istream * input)
 {
-  string line;
+  string line, key;
   int arraystridelenfrominputfile;
 
   maxnumpulsarbins = 0;
@@ -1355,6 +1462,7 @@ bool Configuration::processConfig(istream * input)
     configs[i].arraystridelen = new int[numdatastreams]();
     configs[i].datastreamindices = new int[numdatastreams]();
     configs[i].baselineindices = new int [numbaselines]();
+    configs[i].xmactiledbaselines = new int [numbaselines]();
     getinputline(input, &(configs[i].name), "CONFIG NAME");
     getinputline(input, &line, "INT TIME (SEC)");
     configs[i].inttime = atof(line.c_str());
@@ -1388,7 +1496,24 @@ bool Configuration::processConfig(istream * input)
     configs[i].numbufferedffts = atoi(line.c_str());
     if(configs[i].numbufferedffts > maxnumbufferedffts)
       maxnumbufferedffts = configs[i].numbufferedffts;
-    getinputline(input, &line, "WRITE AUTOCORRS");
+    configs[i].xmacorder = BASELINEXMAC;
+    configs[i].xmactilechannels = 0;
+    getinputkeyval(input, &key, &line);
+    if(key.find("XMAC MODE") != string::npos) {
+      if(line == "TILED")
+        configs[i].xmacorder = TILEDXMAC;
+      else if(line != "BASELINE")
+      {
+        if(mpiid == 0) //only write one copy of this error message
+          cerror << startl << "Unknown XMAC MODE '" << line << "' (case sensitive choices are BASELINE and TILED), assuming BASELINE" << endl;
+      }
+      getinputline(input, &line, "WRITE AUTOCORRS");
+    }
+    else if(key.find("WRITE AUTOCORRS") == string::npos) {
+      if(mpiid == 0) //only write one copy of this error message
+        cfatal << startl << "Went looking for WRITE AUTOCORRS (or maybe XMAC MODE), but got " << key << endl;
+      consistencyok = false;
+    }
     configs[i].writeautocorrs = ((line == "TRUE") || (line == "T") || (line == "true") || (line == "t"))?true:false;
     getinputline(input, &line, "PULSAR BINNING");
     configs[i].pulsarbin = ((line == "TRUE") || (line == "T") || (line == "true") || (line == "t"))?true:false;
@@ -2540,6 +2665,23 @@ bool Configuration::setStrides()
     configs[i].rotatestridelen = calcstridelength(configs[i].xmacstridelen);
     if(mpiid == 0)
       cinfo << startl << "Config[" << i << "] had its rotate stride length automatically set to " << configs[i].rotatestridelen << " based on xmacstridelen = " << configs[i].xmacstridelen << endl;
+
+    // for the tiled xmac, halve the xmac stride until the spectra and accumulators of one
+    // group of datastream tiles (assuming dual pol, all four products) fit in XMAC_TILE_BYTES
+    if(configs[i].xmacorder == TILEDXMAC && (configs[i].pulsarbin || configs[i].phasedarray))
+    {
+      if(mpiid == 0)
+        cwarn << startl << "Config[" << i << "] requested the tiled xmac, which is not supported with pulsar binning or phased array output - using the per-baseline xmac" << endl;
+      configs[i].xmacorder = BASELINEXMAC;
+    }
+    if(configs[i].xmacorder == TILEDXMAC)
+    {
+      configs[i].xmactilechannels = configs[i].xmacstridelen;
+      while(configs[i].xmactilechannels%2 == 0 && configs[i].xmactilechannels > 16 && configs[i].xmactilechannels*sizeof(cf32)*(4*XMAC_TILE_STATIONS + 4*XMAC_TILE_STATIONS*XMAC_TILE_STATIONS) > (unsigned int)XMAC_TILE_BYTES)
+        configs[i].xmactilechannels /= 2;
+      if(mpiid == 0)
+        cinfo << startl << "Config[" << i << "] will use the tiled xmac with " << configs[i].xmactilechannels << " channels per tile" << endl;
+    }
   }
 
   return true;
@@ -2817,6 +2959,20 @@ bool Configuration::consistencyCheck()
       return false;
     }
 
+    //sort the baselines by datastream tile, so the tiled xmac can reuse each station's spectra
+    //for all the baselines of a tile pair.  Insertion sort is stable, keeping the input order within a tile pair
+    for(int j=0;j<numbaselines;j++)
+    {
+      int tilekey = (getBOrderedDataStream1Index(i, j)/XMAC_TILE_STATIONS)*numdatastreams + getBOrderedDataStream2Index(i, j)/XMAC_TILE_STATIONS;
+      int k = j;
+      while(k > 0 && (getBOrderedDataStream1Index(i, configs[i].xmactiledbaselines[k-1])/XMAC_TILE_STATIONS)*numdatastreams + getBOrderedDataStream2Index(i, configs[i].xmactiledbaselines[k-1])/XMAC_TILE_STATIONS > tilekey)
+      {
+        configs[i].xmactiledbaselines[k] = configs[i].xmactiledbaselines[k-1];
+        k--;
+      }
+      configs[i].xmactiledbaselines[k] = j;
+    }
+
     //check that the subint time results in a whole number of FFTs for each datastream
     //also that the blockspersend is the same for all datastreams
     for(int j=0;j<numdatastreams;j++)
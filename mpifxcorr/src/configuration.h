@@ -54,8 +54,9 @@ to this configuration information to the other objects which actually perform th
 */
 class Configuration{
 public:
-  /// Enumeration for the format of the output than can be produced
-  enum outputformat {ASCII, DIFX, VDIFOUT};
+  /// Enumeration for the format of the output than can be produced.  DIFXINDEXED is binary with a fixed size
+  /// record table per integration, 64 byte aligned spectra and a time index, so it can be memory mapped
+  enum outputformat {ASCII, DIFX, VDIFOUT, DIFXINDEXED};
 
   ///Enumeration for the type of phased array output
   enum datadomain {TIME, FREQUENCY};
@@ -74,9 +75,45 @@ public:
   /// For certain FILE data types (e.g., VDIF), can influence peeking / seeking on open
   enum filechecklevel {FILECHECKNONE, FILECHECKSEEK, FILECHECKUNKNOWN};
 
+  /// Supported orderings of the cross-multiply-accumulate in the Core
+  enum xmacmode {BASELINEXMAC, TILEDXMAC};
+
+  /// How thoroughly FFT plans are optimised (only meaningful for FFTW builds)
+  enum fftplanning {FFTPLANESTIMATE, FFTPLANMEASURE, FFTPLANPATIENT};
+
+  /// How Core process threads combine their results into a slot: under per-baseline/freq mutexes, or privately then by reduction
+  enum coreaccumulation {LOCKEDACCUMULATION, REDUCTIONACCUMULATION};
+
+  /// How Core process threads divide up the FFT blocks of a subintegration: fixed contiguous ranges, or chunks claimed (and stolen) at run time
+  enum coreblockscheduling {STATICBLOCKS, DYNAMICBLOCKS};
+
+  /// Where phase cal tones are extracted: from a separate pass over the unpacked samples, or from the spectra of the station FFT where possible
+  enum pcalextraction {TIMEDOMAINPCAL, SPECTRALPCAL};
+
   /// Constant for the TCP window size for monitoring
   static int MONITOR_TCP_WINDOWBYTES;
 
+  /// Number of datastreams grouped together into one tile by the tiled xmac
+  static const int XMAC_TILE_STATIONS;
+
+  /// Approximate cache footprint (inputs plus accumulators) targeted by one tile of the tiled xmac
+  static const int XMAC_TILE_BYTES;
+
+  /// Default, minimum and maximum number of slots in the Core send/receive ring (DIFX_CORE_RING_LENGTH)
+  static const int DEFAULT_CORE_RING_LENGTH;
+  static const int MIN_CORE_RING_LENGTH;
+  static const int MAX_CORE_RING_LENGTH;
+
+  /// Maximum number of threads sharing the VDIF multiplexing of one datastream (DIFX_VDIF_MUX_THREADS)
+  static const int MAX_VDIF_MUX_THREADS;
+
+  /// Default and maximum number of packets taken per batched raw network receive (DIFX_NETWORK_BATCH)
+  static const int DEFAULT_NETWORK_BATCH;
+  static const int MAX_NETWORK_BATCH;
+
+  /// Maximum number of frame periods a network VDIF frame may be late and still be put back in order (DIFX_VDIF_REORDER_DEPTH)
+  static const int MAX_VDIF_REORDER_DEPTH;
+
  /**
   * Constructor: Reads information from an input file and stores it internally
   * Content of the input file and ancillary referenced files are read locally on the fx manager node,
@@ -106,6 +143,18 @@ public:
   inline string getJobName() const { return jobname; }
   inline void setJobName(string jname) { jobname = jname; }
   void setJobNameFromConfigfilename(string configfilename);
+  inline string getFFTWisdomFilename() const { return fftwisdomfilename; }
+  inline string getProfileFilename() const { return profilefilename; }
+  inline int getProfileInterval() const { return profileinterval; }
+  inline fftplanning getFFTPlanning() const { return fftplanmode; }
+  inline void setFFTPlanning(fftplanning planning) { fftplanmode = planning; }
+  inline coreaccumulation getCoreAccumulation() const { return coreaccumulationmode; }
+  inline coreblockscheduling getCoreBlockScheduling() const { return coreschedulingmode; }
+  inline int getCoreRingLength() const { return coreringlength; }
+  inline int getVDIFMuxThreads() const { return vdifmuxthreads; }
+  inline int getNetworkBatch() const { return networkbatch; }
+  inline int getVDIFReorderDepth() const { return vdifreorderdepth; }
+  inline pcalextraction getPCalExtraction() const { return pcalextractionmode; }
   inline string getObsCode() const { return obscode; }
   inline void setObsCode(string ocode) { obscode = ocode; }
   inline long long getEstimatedBytes() const { return estimatedbytes; }
@@ -117,6 +166,9 @@ public:
   inline int getXmacStrideLength(int configindex) const { return configs[configindex].xmacstridelen; }
   inline int getRotateStrideLength(int configindex) const { return configs[configindex].rotatestridelen; }
   inline int getNumBufferedFFTs(int configindex) const { return configs[configindex].numbufferedffts; }
+  inline xmacmode getXmacMode(int configindex) const { return configs[configindex].xmacorder; }
+  inline int getXmacTileChannels(int configindex) const { return configs[configindex].xmactilechannels; }
+  inline int getXmacTiledBaseline(int configindex, int tiledbaselineindex) const { return configs[configindex].xmactiledbaselines[tiledbaselineindex]; }
   inline int getThreadResultLength(int configindex) const { return configs[configindex].threadresultlength; }
   inline int getCoreResultLength(int configindex) const { return configs[configindex].coreresultlength; }
   inline long long getMaxThreadResultLength() const { return maxthreadresultlength; }
@@ -749,6 +801,8 @@ private:
     int xmacstridelen;
     int rotatestridelen;
     int numbufferedffts;
+    xmacmode xmacorder;
+    int xmactilechannels;
     bool writeautocorrs;
     bool pulsarbin;
     bool phasedarray;
@@ -774,6 +828,7 @@ private:
     int  * datastreamindices; //[datastream]
     int  * ordereddatastreamindices;
     int  * baselineindices;
+    int  * xmactiledbaselines; //[baseline], baselines sorted by datastream tile
     bool * frequsedbybaseline;
     bool * equivfrequsedbybaseline;
     //bookkeeping info for thread results
@@ -870,6 +925,14 @@ private:
   */
   sectionheader getSectionHeader(istream * input);
 
+ /**
+  * Reads the DIFX_* environment variables that tune the correlator (MTU, FFT planning,
+  * Core accumulation, scheduling and ring length, datastream threads and batching,
+  * profiling and pcal extraction).  With MPI enabled, everyone takes the manager's
+  * Core ring length
+  */
+  void parseEnvironmentTuning();
+
  /**
   * Looks at number of output channels for each used frequency to determine the best xmac stride
   * @param configId The configuration object ID 
@@ -1044,10 +1107,19 @@ private:
   int maxnumchannels, maxnumpulsarbins;
   long long maxthreadresultlength, maxcoreresultlength;
   int maxnumbufferedffts, mtu;
+  fftplanning fftplanmode;
+  coreaccumulation coreaccumulationmode;
+  coreblockscheduling coreschedulingmode;
+  pcalextraction pcalextractionmode;
+  int coreringlength;
+  int vdifmuxthreads;
+  int networkbatch;
+  int vdifreorderdepth;
+  int profileinterval;
   int stadumpchannels, ltadumpchannels;
   int numconfigs, numrules, baselinetablelength, telescopetablelength, datastreamtablelength, freqtablelength;
   long long estimatedbytes;
-  string calcfilename, modelfilename, coreconffilename, outputfilename, jobname, obscode;
+  string calcfilename, modelfilename, coreconffilename, outputfilename, jobname, obscode, fftwisdomfilename, profilefilename;
   int * numprocessthreads;
   int * scanconfigindices;
   configdata * configs;
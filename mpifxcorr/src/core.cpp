@@ -29,6 +29,8 @@
 #include "fxmanager.h"
 #include "alert.h"
 #include "config.h"
+#include <sstream>
+#include <cstdio>
 
 Core::Core(int id, Configuration * conf, int * dids, MPI_Comm rcomm)
   : mpiid(id), config(conf), return_comm(rcomm)
@@ -40,6 +42,28 @@ Core::Core(int id, Configuration * conf, int * dids, MPI_Comm rcomm)
   cwarn << startl << "This CORE process is not linked against a high performance math library.  Expect reduced performance." << endl;
 #endif
 
+  //set the FFT plan rigor and load any saved wisdom before the Modes are created (no-ops for IPP)
+  switch(config->getFFTPlanning())
+  {
+    case Configuration::FFTPLANESTIMATE:
+      status = vectorSetFFTPlanFlags(vecFFTPlanEstimate);
+      break;
+    case Configuration::FFTPLANPATIENT:
+      status = vectorSetFFTPlanFlags(vecFFTPlanPatient);
+      break;
+    default:
+      status = vectorSetFFTPlanFlags(vecFFTPlanMeasure);
+      break;
+  }
+  if(status != vecNoErr)
+    csevere << startl << "Error trying to set the FFT plan flags in core " << mpiid << endl;
+  //wisdom is only used with the slower planning modes, which have to be asked for
+  fftwisdomimported = false;
+  if(config->getFFTPlanning() != Configuration::FFTPLANESTIMATE)
+    fftwisdomimported = (vectorImportFFTWisdom(config->getFFTWisdomFilename().c_str()) == vecNoErr);
+  if(fftwisdomimported)
+    cverbose << startl << "Core " << mpiid << " loaded FFT wisdom from " << config->getFFTWisdomFilename() << endl;
+
   estimatedbytes = config->getEstimatedBytes();
 
   //Get all the correlation parameters from config
@@ -76,10 +100,17 @@ Core::Core(int id, Configuration * conf, int * dids, MPI_Comm rcomm)
   }
   databytes += overheadbytes;
 
-  //allocate the send/receive circular buffer (length RECEIVE_RING_LENGTH)
+  //allocate the send/receive circular buffer (length receiveringlength)
   controllength = config->getMaxBlocksPerSend() + 4;
-  procslots = new processslot[RECEIVE_RING_LENGTH];
-  for(int i=0;i<RECEIVE_RING_LENGTH;i++)
+  receiveringlength = config->getCoreRingLength();
+  delaytablelength = 0;
+  for(int i=0;i<model->getNumScans();i++)
+  {
+    if(model->getDelayInterpolatorTableLength(i, 2) > delaytablelength)
+      delaytablelength = model->getDelayInterpolatorTableLength(i, 2);
+  }
+  procslots = new processslot[receiveringlength];
+  for(int i=0;i<receiveringlength;i++)
   {
     procslots[i].results = vectorAlloc_cf32(maxcoreresultlength);
     procslots[i].floatresults = (f32*)procslots[i].results;
@@ -88,6 +119,13 @@ Core::Core(int id, Configuration * conf, int * dids, MPI_Comm rcomm)
     if(status != vecNoErr)
       csevere << startl << "Error trying to zero results in core " << mpiid << ", processing slot " << i << endl;
     procslots[i].resultsvalid = CR_VALIDVIS;
+    procslots[i].delaytable = vectorAlloc_f64(delaytablelength);
+    procslots[i].delaytablevalid = false;
+    procslots[i].sendrequestinitialised = false;
+    procslots[i].sendpending = false;
+    procslots[i].numsends = 0;
+    procslots[i].sendwaitns = 0;
+    procslots[i].maxsendwaitns = 0;
     procslots[i].configindex = currentconfigindex;
     procslots[i].threadresultlength = config->getThreadResultLength(currentconfigindex);
     procslots[i].coreresultlength = config->getCoreResultLength(currentconfigindex);
@@ -120,6 +158,7 @@ Core::Core(int id, Configuration * conf, int * dids, MPI_Comm rcomm)
     perr = pthread_mutex_init(&(procslots[i].pcalcopylock), NULL);
     if(perr != 0)
       csevere << startl << "Problem initialising pcalcopylock in slot " << i << "(" << perr << ")" << endl;
+    procslots[i].chunkqueues = 0;
     procslots[i].datalengthbytes = new int[numdatastreams];
     procslots[i].databuffer = new u8*[numdatastreams];
     procslots[i].controlbuffer = new s32*[numdatastreams];
@@ -149,6 +188,55 @@ Core::Core(int id, Configuration * conf, int * dids, MPI_Comm rcomm)
     threadbytes[i] = 8*maxthreadresultlength;
   }
 
+  //if requested, give each process thread a private result array to accumulate into, reduced into the slot at the end
+  reduceresults = (config->getCoreAccumulation() == Configuration::REDUCTIONACCUMULATION && numprocessthreads > 1);
+  threadresults = 0;
+  if(reduceresults)
+  {
+    cinfo << startl << "Core " << mpiid << " will accumulate results in per-thread arrays and reduce them at the end of each subintegration" << endl;
+    threadresults = new cf32*[numprocessthreads];
+    for(int i=0;i<numprocessthreads;i++)
+    {
+      threadresults[i] = vectorAlloc_cf32(maxcoreresultlength);
+      status = vectorZero_cf32(threadresults[i], maxcoreresultlength);
+      if(status != vecNoErr)
+        csevere << startl << "Error trying to zero thread results in core " << mpiid << ", thread " << i << endl;
+      estimatedbytes += 8*maxcoreresultlength;
+    }
+    perr = pthread_barrier_init(&reductionbarrier, 0, numprocessthreads);
+    if(perr != 0)
+      csevere << startl << "Problem initialising the result reduction barrier in core " << mpiid << "(" << perr << ")" << endl;
+  }
+
+  //one stage profile per process thread, plus one for the receiving (main) thread
+  threadprofiles = new StageProfile*[numprocessthreads];
+  for(int i=0;i<numprocessthreads;i++)
+    threadprofiles[i] = StageProfiler::createProfile();
+  receiveprofile = StageProfiler::createProfile();
+
+  //if requested, let the process threads share out the blocks of each slot at run time
+  dynamicblocks = (config->getCoreBlockScheduling() == Configuration::DYNAMICBLOCKS && numprocessthreads > 1);
+  laststolenfrom = 0;
+  if(dynamicblocks)
+  {
+    cinfo << startl << "Core " << mpiid << " will schedule FFT blocks dynamically between its process threads" << endl;
+    laststolenfrom = new int[numprocessthreads];
+    for(int i=0;i<numprocessthreads;i++)
+      laststolenfrom[i] = (i+1)%numprocessthreads;
+    for(int i=0;i<receiveringlength;i++)
+    {
+      procslots[i].chunkqueues = new blockchunkqueue[numprocessthreads];
+      for(int j=0;j<numprocessthreads;j++)
+      {
+        procslots[i].chunkqueues[j].nextchunk = 0;
+        procslots[i].chunkqueues[j].endchunk = 0;
+        perr = pthread_mutex_init(&(procslots[i].chunkqueues[j].lock), NULL);
+        if(perr != 0)
+          csevere << startl << "Problem initialising block chunk queue lock " << j << " in slot " << i << "(" << perr << ")" << endl;
+      }
+    }
+  }
+
   //initialise the MPI communication objects
   datarequests = new MPI_Request[numdatastreams];
   controlrequests = new MPI_Request[numdatastreams];
@@ -163,12 +251,12 @@ Core::Core(int id, Configuration * conf, int * dids, MPI_Comm rcomm)
   difxMessageInitBinary();
 }
 
-const int Core::RECEIVE_RING_LENGTH = 4;
 const double Core::MINIMUM_FILTERBANK_WEIGHT = 0.333;
+const int Core::MIN_VECTOR_BIN_RUN = 8;
 
 Core::~Core()
 {
-  for(int i=0;i<RECEIVE_RING_LENGTH;i++)
+  for(int i=0;i<receiveringlength;i++)
   {
     for(int j=0;j<numdatastreams;j++)
     {
@@ -179,11 +267,24 @@ Core::~Core()
     for(int j=0;j<config->getFreqTableLength();j++)
       delete [] procslots[i].viscopylocks[j];
     delete [] procslots[i].viscopylocks;
+    if(procslots[i].chunkqueues)
+      delete [] procslots[i].chunkqueues;
     delete [] procslots[i].datalengthbytes;
     delete [] procslots[i].databuffer;
     delete [] procslots[i].controlbuffer;
     vectorFree(procslots[i].results);
+    vectorFree(procslots[i].delaytable);
+  }
+  if(reduceresults)
+  {
+    for(int i=0;i<numprocessthreads;i++)
+      vectorFree(threadresults[i]);
+    delete [] threadresults;
+    pthread_barrier_destroy(&reductionbarrier);
   }
+  if(dynamicblocks)
+    delete [] laststolenfrom;
+  delete [] threadprofiles;
   delete [] threadbytes;
   delete [] processthreads;
   delete [] processconds;
@@ -217,7 +318,7 @@ void Core::execute()
 
   //cverbose << startl << "Core about to fill up receive ring buffer" << endl;
   //start off by filling up the data and control buffers for all slots
-  for(int i=0;i<RECEIVE_RING_LENGTH-1;i++)
+  for(int i=0;i<receiveringlength-1;i++)
   {
     if(!terminate)
       numreceived += receivedata(numreceived, &terminate);
@@ -237,7 +338,7 @@ void Core::execute()
     delete [] threadinfos;
     return;
   }
-  else if (numreceived < RECEIVE_RING_LENGTH-1) //didn't get a full buffer before job ended. Proceed with caution
+  else if (numreceived < receiveringlength-1) //didn't get a full buffer before job ended. Proceed with caution
   {
     cinfo << startl << "Processing buffer was not completely filled before job termination - ensuring all subintegrations are safely processed" << endl;
     //unlock the held mutex and instead lock the last one, where we should have made it to
@@ -246,9 +347,9 @@ void Core::execute()
       perr = pthread_mutex_unlock(&(procslots[numreceived].slotlocks[i]));
       if(perr != 0)
         csevere << startl << "Error in main thread attempting to unlock mutex " << numreceived << "/" << i << " when shutting down an underused Core node!" << endl;
-      perr = pthread_mutex_lock(&(procslots[RECEIVE_RING_LENGTH-1].slotlocks[i]));
+      perr = pthread_mutex_lock(&(procslots[receiveringlength-1].slotlocks[i]));
       if(perr != 0)
-        csevere << startl << "Error in main thread attempting to lock mutex " << RECEIVE_RING_LENGTH-1 << " of thread " << i << " during startup" << endl;
+        csevere << startl << "Error in main thread attempting to lock mutex " << receiveringlength-1 << " of thread " << i << " during startup" << endl;
     }
   }
 
@@ -256,9 +357,9 @@ void Core::execute()
   //RECEIVE_RING before we wake back up
   for(int i=0;i<numprocessthreads;i++)
   {
-    perr = pthread_mutex_lock(&(procslots[RECEIVE_RING_LENGTH-2].slotlocks[i]));
+    perr = pthread_mutex_lock(&(procslots[receiveringlength-2].slotlocks[i]));
     if(perr != 0)
-      csevere << startl << "Error in main thread attempting to lock mutex " << RECEIVE_RING_LENGTH-2 << " of thread " << i << " during startup" << endl;
+      csevere << startl << "Error in main thread attempting to lock mutex " << receiveringlength-2 << " of thread " << i << " during startup" << endl;
   }
 
   //now we have the lock on the last two slots in the ring.  Launch processthreads
@@ -279,7 +380,7 @@ void Core::execute()
   {
     while(!processthreadinitialised[i])
     {
-      perr = pthread_cond_wait(&processconds[i], &(procslots[RECEIVE_RING_LENGTH-1].slotlocks[i]));
+      perr = pthread_cond_wait(&processconds[i], &(procslots[receiveringlength-1].slotlocks[i]));
       if (perr != 0)
         csevere << startl << "Error waiting on processthreadinitialised condition!!!!" << endl;
     }
@@ -289,9 +390,9 @@ void Core::execute()
   //release that supplementary lock (2nd last in buffer)
   for(int i=0;i<numprocessthreads;i++)
   {
-    perr = pthread_mutex_unlock(&(procslots[RECEIVE_RING_LENGTH-2].slotlocks[i]));
+    perr = pthread_mutex_unlock(&(procslots[receiveringlength-2].slotlocks[i]));
     if(perr != 0)
-      csevere << startl << "Error in main thread attempting to lock mutex " << RECEIVE_RING_LENGTH-2 << " of thread " << i << " during startup" << endl;
+      csevere << startl << "Error in main thread attempting to lock mutex " << receiveringlength-2 << " of thread " << i << " during startup" << endl;
   }
 
   cverbose << startl << "Estimated memory usage by Core is now " << getEstimatedBytes()/(1024.0*1024.0) << " MB" << endl;
@@ -299,32 +400,31 @@ void Core::execute()
   while(!terminate) //the data is valid, so keep processing
   {
     //increment and receive some more data
-    numreceived += receivedata(numreceived % RECEIVE_RING_LENGTH, &terminate);
+    numreceived += receivedata(numreceived % receiveringlength, &terminate);
 
     //send off a message if we are back at the start of the buffer
-//    if(numreceived % RECEIVE_RING_LENGTH == 0)
-//      cverbose << startl << "CORE: " << numreceived-(numcomplete+1) << " unprocessed segments, 1 being processed, and " << RECEIVE_RING_LENGTH-(numreceived-numcomplete) << " to be sent" << endl;
+//    if(numreceived % receiveringlength == 0)
+//      cverbose << startl << "CORE: " << numreceived-(numcomplete+1) << " unprocessed segments, 1 being processed, and " << receiveringlength-(numreceived-numcomplete) << " to be sent" << endl;
 
     if(terminate)
       break;
 
-    //send the results back
-    MPI_Ssend(procslots[numreceived%RECEIVE_RING_LENGTH].results, procslots[numreceived%RECEIVE_RING_LENGTH].coreresultlength*2, MPI_FLOAT, fxcorr::MANAGERID, procslots[numreceived%RECEIVE_RING_LENGTH].resultsvalid, return_comm);
-    if(procslots[numreceived%RECEIVE_RING_LENGTH].configindex != lastconfigindex)
+    //start sending the results back - the send is completed (and the results zeroed) when this
+    //slot is next handed to the process threads, so receiving the next data overlaps with it
+    startResultSend(numreceived%receiveringlength);
+    if(procslots[numreceived%receiveringlength].configindex != lastconfigindex)
     {
       cverbose << startl << "After config change, estimated memory usage by Core is " << getEstimatedBytes()/(1024.0*1024.0) << " MB" << endl;
     }
-
-    //zero the results buffer for this slot and set the status back to valid
-    status = vectorZero_cf32(procslots[numreceived%RECEIVE_RING_LENGTH].results, procslots[numreceived%RECEIVE_RING_LENGTH].coreresultlength);
-    if(status != vecNoErr)
-      csevere << startl << "Error trying to zero results in Core!!!" << endl;
-    procslots[numreceived%RECEIVE_RING_LENGTH].resultsvalid = CR_VALIDVIS;
   }
 
-  tounlock = numreceived % RECEIVE_RING_LENGTH;
-  if(numreceived < RECEIVE_RING_LENGTH-1)
-    tounlock = RECEIVE_RING_LENGTH-1; //adjusted lock in the case of a short job
+  //the results from the slot sent last may still be in flight
+  for(int i=0;i<receiveringlength;i++)
+    completeResultSend(i);
+
+  tounlock = numreceived % receiveringlength;
+  if(numreceived < receiveringlength-1)
+    tounlock = receiveringlength-1; //adjusted lock in the case of a short job
 
   //Run through the shutdown sequence
   for(int i=0;i<numprocessthreads;i++)
@@ -336,14 +436,14 @@ void Core::execute()
   }
 
   adjust = 0;
-  countdown = RECEIVE_RING_LENGTH-1;
-  if(numreceived < RECEIVE_RING_LENGTH-1) {
-    adjust = (RECEIVE_RING_LENGTH-1)-numreceived;
+  countdown = receiveringlength-1;
+  if(numreceived < receiveringlength-1) {
+    adjust = (receiveringlength-1)-numreceived;
     countdown = numreceived;
   }
 
   //ensure all the results we have sitting around have been sent
-  for(int i=1;i<RECEIVE_RING_LENGTH;i++)
+  for(int i=1;i<receiveringlength;i++)
   {
     if(countdown == 0)
       break;
@@ -352,19 +452,28 @@ void Core::execute()
     for(int j=0;j<numprocessthreads;j++)
     {
       //Lock and unlock first to ensure the threads have finished working on this slot
-      perr = pthread_mutex_lock(&(procslots[(numreceived+i+adjust) % RECEIVE_RING_LENGTH].slotlocks[j]));
+      perr = pthread_mutex_lock(&(procslots[(numreceived+i+adjust) % receiveringlength].slotlocks[j]));
       if(perr != 0)
-        csevere << startl << "Error in Core " << mpiid << " attempt to unlock mutex" << (numreceived+i+adjust) % RECEIVE_RING_LENGTH << " of thread " << j << endl;
-      perr = pthread_mutex_unlock(&(procslots[(numreceived+i+adjust) % RECEIVE_RING_LENGTH].slotlocks[j]));
+        csevere << startl << "Error in Core " << mpiid << " attempt to unlock mutex" << (numreceived+i+adjust) % receiveringlength << " of thread " << j << endl;
+      perr = pthread_mutex_unlock(&(procslots[(numreceived+i+adjust) % receiveringlength].slotlocks[j]));
       if(perr != 0)
-        csevere << startl << "Error in Core " << mpiid << " attempt to unlock mutex" << (numreceived+i+adjust) % RECEIVE_RING_LENGTH << " of thread " << j << endl;
+        csevere << startl << "Error in Core " << mpiid << " attempt to unlock mutex" << (numreceived+i+adjust) % receiveringlength << " of thread " << j << endl;
     }
     //send the results
-    MPI_Ssend(procslots[(numreceived+i+adjust)%RECEIVE_RING_LENGTH].results, procslots[(numreceived+i+adjust)%RECEIVE_RING_LENGTH].coreresultlength*2, MPI_FLOAT, fxcorr::MANAGERID, procslots[(numreceived+i+adjust)%RECEIVE_RING_LENGTH].resultsvalid, return_comm);
+    startResultSend((numreceived+i+adjust)%receiveringlength);
+    completeResultSend((numreceived+i+adjust)%receiveringlength);
 
     countdown--;
   }
 
+  for(int i=0;i<receiveringlength;i++)
+  {
+    if(procslots[i].sendrequestinitialised)
+      MPI_Request_free(&(procslots[i].sendrequest));
+    procslots[i].sendrequestinitialised = false;
+  }
+  reportResultSendWaits();
+
 //  cinfo << startl << "CORE " << mpiid << " is about to join the processthreads" << endl;
 
   //join the process threads, they have to already be finished anyway
@@ -376,6 +485,25 @@ void Core::execute()
   }
   delete [] threadinfos;
 
+#ifndef HAVE_IPP
+  //if there was no wisdom to start with, save what this run measured for next time.  Write to a
+  //private file and rename it, since several Cores may be doing this at once
+  if(!fftwisdomimported && config->getFFTPlanning() != Configuration::FFTPLANESTIMATE)
+  {
+    ostringstream tmpwisdomfilename;
+    tmpwisdomfilename << config->getFFTWisdomFilename() << ".tmp." << mpiid;
+    status = vectorExportFFTWisdom(tmpwisdomfilename.str().c_str());
+    if(status == vecNoErr)
+    {
+      if(rename(tmpwisdomfilename.str().c_str(), config->getFFTWisdomFilename().c_str()) != 0)
+      {
+        cwarn << startl << "Core " << mpiid << " could not rename " << tmpwisdomfilename.str() << " to " << config->getFFTWisdomFilename() << endl;
+        remove(tmpwisdomfilename.str().c_str());
+      }
+    }
+  }
+#endif
+
 //  cinfo << startl << "CORE " << mpiid << " terminating" << endl;
 }
 
@@ -397,7 +525,7 @@ long long Core::getEstimatedBytes()
 
 void Core::loopprocess(int threadid)
 {
-  int perr, numprocessed, startblock, numblocks, lastconfigindex, numpolycos, maxchan, maxpolycos, stadumpchannels, strideplussteplen, maxrotatestrideplussteplength, maxxmaclength, slen;
+  int perr, numprocessed, startblock, numblocks, lastconfigindex, numpolycos, maxchan, maxpolycos, stadumpchannels, maxxmaclength, maxphasecentres;
   double sec;
   bool pulsarbin, somepulsarbin, somescrunch, dumpingsta, nowdumpingsta;
   processslot * currentslot;
@@ -424,25 +552,23 @@ void Core::loopprocess(int threadid)
   dumpingsta = false;
   maxpolycos = 0;
   maxchan = config->getMaxNumChannels();
-  slen = config->getRotateStrideLength(0);
-  maxrotatestrideplussteplength = slen + maxchan/slen;
   maxxmaclength = config->getXmacStrideLength(0);
+  maxphasecentres = config->getMaxPhaseCentres(0);
   for(int i=1;i<config->getNumConfigs();i++)
   {
-    slen = config->getRotateStrideLength(i);
-    strideplussteplen = slen + maxchan/slen;
-    if(strideplussteplen > maxrotatestrideplussteplength)
-      maxrotatestrideplussteplength = strideplussteplen;
     if(config->getXmacStrideLength(i) > maxxmaclength)
       maxxmaclength = config->getXmacStrideLength(i);
-  }
-  scratchspace->chanfreqs = vectorAlloc_f64(maxrotatestrideplussteplength);
-  scratchspace->rotator = vectorAlloc_cf32(maxrotatestrideplussteplength);
+    if(config->getMaxPhaseCentres(i) > maxphasecentres)
+      maxphasecentres = config->getMaxPhaseCentres(i);
+  }
+  scratchspace->phasecentredelay1 = vectorAlloc_f64(2*maxphasecentres);
+  scratchspace->phasecentredelay2 = vectorAlloc_f64(2*maxphasecentres);
+  scratchspace->differentialdelay = vectorAlloc_f64(2*maxphasecentres);
+  scratchspace->phasecentreturns = vectorAlloc_f64(4*maxphasecentres);
+  scratchspace->rotator = vectorAlloc_cf32(maxxmaclength);
   scratchspace->rotated = vectorAlloc_cf32(maxchan);
   scratchspace->channelsums = vectorAlloc_cf32(maxchan);
-  scratchspace->argument = vectorAlloc_f32(3*maxrotatestrideplussteplength);
-  // FIXME: explicitly calculate "28" below.
-  threadbytes[threadid] += 16*maxchan + 28*maxrotatestrideplussteplength;
+  threadbytes[threadid] += 16*maxchan + 8*maxxmaclength + 80*maxphasecentres;
 
   //work out whether we'll need to do any pulsar binning, and work out the maximum # channels (and # polycos if applicable)
   for(int i=0;i<config->getNumConfigs();i++)
@@ -465,7 +591,7 @@ void Core::loopprocess(int threadid)
     {
       scratchspace->pulsaraccumspace = new cf32******[config->getFreqTableLength()];
     }
-    createPulsarVaryingSpace(scratchspace->pulsaraccumspace, &(scratchspace->bins), procslots[0].configindex, -1, threadid); //don't need to delete old space
+    createPulsarVaryingSpace(scratchspace->pulsaraccumspace, &(scratchspace->bins), &(scratchspace->binruns), procslots[0].configindex, -1, threadid); //don't need to delete old space
   }
 
   //create the baselineweight and xmacstrideoffset arrays
@@ -481,17 +607,17 @@ void Core::loopprocess(int threadid)
 //  cinfo << startl << "Core thread id " << threadid << " will be processing from block " << startblock << ", length " << numblocks << endl;
 
   //lock the end section
-  perr = pthread_mutex_lock(&(procslots[RECEIVE_RING_LENGTH-1].slotlocks[threadid]));
+  perr = pthread_mutex_lock(&(procslots[receiveringlength-1].slotlocks[threadid]));
   if(perr != 0)
-    csevere << startl << "PROCESSTHREAD " << mpiid << "/" << threadid << " error trying lock mutex " << RECEIVE_RING_LENGTH-1 << endl;
+    csevere << startl << "PROCESSTHREAD " << mpiid << "/" << threadid << " error trying lock mutex " << receiveringlength-1 << endl;
 
   //grab the lock we really want, unlock the end section and signal the main thread we're ready to go
   perr = pthread_mutex_lock(&(procslots[0].slotlocks[threadid]));
   if(perr != 0)
     csevere << startl << "PROCESSTHREAD " << mpiid << "/" << threadid << " error trying lock mutex 0" << endl; 
-  perr = pthread_mutex_unlock(&(procslots[RECEIVE_RING_LENGTH-1].slotlocks[threadid]));
+  perr = pthread_mutex_unlock(&(procslots[receiveringlength-1].slotlocks[threadid]));
   if(perr != 0)
-    csevere << startl << "PROCESSTHREAD " << mpiid << "/" << threadid << " error trying unlock mutex " << RECEIVE_RING_LENGTH-1 << endl;
+    csevere << startl << "PROCESSTHREAD " << mpiid << "/" << threadid << " error trying unlock mutex " << receiveringlength-1 << endl;
   processthreadinitialised[threadid] = true;
   perr = pthread_cond_signal(&processconds[threadid]);
   if(perr != 0)
@@ -500,9 +626,9 @@ void Core::loopprocess(int threadid)
     cinfo << startl << "Core " << mpiid << " PROCESSTHREAD " << threadid+1 << "/" << numprocessthreads << " is about to start processing" << endl;
 
   //while valid, process data
-  while(procslots[(numprocessed)%RECEIVE_RING_LENGTH].keepprocessing)
+  while(procslots[(numprocessed)%receiveringlength].keepprocessing)
   {
-    currentslot = &(procslots[numprocessed%RECEIVE_RING_LENGTH]);
+    currentslot = &(procslots[numprocessed%receiveringlength]);
     if(pulsarbin)
     {
       sec = double(startseconds + model->getScanStartSec(currentslot->offsets[0], startmjd, startseconds) + currentslot->offsets[1]) + ((double)currentslot->offsets[2])/1000000000.0;
@@ -536,19 +662,19 @@ void Core::loopprocess(int threadid)
     }
 
     //process our section of responsibility for this time range
-    processdata(numprocessed++ % RECEIVE_RING_LENGTH, threadid, startblock, numblocks, modes, currentpolyco, scratchspace);
+    processdata(numprocessed++ % receiveringlength, threadid, startblock, numblocks, modes, currentpolyco, scratchspace);
 
     if(threadid == 0)
       numcomplete++;
 
-    currentslot = &(procslots[numprocessed%RECEIVE_RING_LENGTH]);
+    currentslot = &(procslots[numprocessed%receiveringlength]);
     //if the configuration changes from this segment to the next, change our setup accordingly
     if(currentslot->configindex != lastconfigindex)
     {
       cinfo << startl << "Core " << mpiid << " threadid " << threadid << ": changing config to " << currentslot->configindex << endl;
       updateconfig(lastconfigindex, currentslot->configindex, threadid, startblock, numblocks, numpolycos, pulsarbin, modes, polycos, false);
       cinfo << startl << "Core " << mpiid << " threadid " << threadid << ": config changed successfully - pulsarbin is now " << pulsarbin << endl;
-      createPulsarVaryingSpace(scratchspace->pulsaraccumspace, &(scratchspace->bins), currentslot->configindex, lastconfigindex, threadid);
+      createPulsarVaryingSpace(scratchspace->pulsaraccumspace, &(scratchspace->bins), &(scratchspace->binruns), currentslot->configindex, lastconfigindex, threadid);
       allocateConfigSpecificThreadArrays(scratchspace->baselineweight, scratchspace->baselineshiftdecorr, currentslot->configindex, lastconfigindex, threadid);
       lastconfigindex = currentslot->configindex;
     }
@@ -556,9 +682,9 @@ void Core::loopprocess(int threadid)
 
   //fallen out of loop, so must be finished.  Unlock held mutex
 //  cinfo << startl << "PROCESS " << mpiid << "/" << threadid << " process thread about to free resources and exit" << endl;
-  perr = pthread_mutex_unlock(&(procslots[numprocessed % RECEIVE_RING_LENGTH].slotlocks[threadid]));
+  perr = pthread_mutex_unlock(&(procslots[numprocessed % receiveringlength].slotlocks[threadid]));
   if (perr != 0)
-    csevere << startl << "PROCESSTHREAD " << mpiid << "/" << threadid << " error trying unlock mutex " << (numprocessed)%RECEIVE_RING_LENGTH << endl;
+    csevere << startl << "PROCESSTHREAD " << mpiid << "/" << threadid << " error trying unlock mutex " << (numprocessed)%receiveringlength << endl;
 
   //free resources
   for(int j=0;j<numdatastreams;j++)
@@ -573,19 +699,21 @@ void Core::loopprocess(int threadid)
     }
     delete [] polycos;
     vectorFree(scratchspace->pulsarscratchspace);
-    createPulsarVaryingSpace(scratchspace->pulsaraccumspace, &(scratchspace->bins), -1,
-    procslots[(numprocessed+1)%RECEIVE_RING_LENGTH].configindex, threadid);
+    createPulsarVaryingSpace(scratchspace->pulsaraccumspace, &(scratchspace->bins), &(scratchspace->binruns), -1,
+    procslots[(numprocessed+1)%receiveringlength].configindex, threadid);
     if(somescrunch)
     {
       delete [] scratchspace->pulsaraccumspace;
     }
   }
   vectorFree(scratchspace->threadcrosscorrs);
-  vectorFree(scratchspace->chanfreqs);
+  vectorFree(scratchspace->phasecentredelay1);
+  vectorFree(scratchspace->phasecentredelay2);
+  vectorFree(scratchspace->differentialdelay);
+  vectorFree(scratchspace->phasecentreturns);
   vectorFree(scratchspace->rotator);
   vectorFree(scratchspace->rotated);
   vectorFree(scratchspace->channelsums);
-  vectorFree(scratchspace->argument);
   if(scratchspace->starecordbuffer != 0) {
     free(scratchspace->starecordbuffer);
   }
@@ -602,6 +730,9 @@ int Core::receivedata(int index, bool * terminate)
   if(*terminate)
     return 0; //don't try to read, we've already finished
 
+  //timed by hand rather than with a StageTimer, so the wait for the previous result send is kept separate
+  unsigned long long receivestart = receiveprofile->start();
+
   //Get the instructions on the time offset from the FxManager node
   MPI_Recv(&(procslots[index].offsets), 3, MPI_INT, fxcorr::MANAGERID, MPI_ANY_TAG, return_comm, &mpistatus);
   if(mpistatus.MPI_TAG == CR_TERMINATE)
@@ -609,6 +740,7 @@ int Core::receivedata(int index, bool * terminate)
     *terminate = true;
 //    cinfo << startl << "Core " << mpiid << " has received a terminate signal!!!" << endl;
     procslots[index].keepprocessing = false;
+    receiveprofile->record(StageProfile::MPIRECEIVE, receivestart);
     return 0; //note return here!!!
   }
 
@@ -640,18 +772,31 @@ int Core::receivedata(int index, bool * terminate)
     MPI_Irecv(procslots[index].controlbuffer[i], controllength, MPI_INT, datastreamids[i], CR_PROCESSCONTROL, MPI_COMM_WORLD, &controlrequests[i]);
   }
 
+  //while the data arrives, work out the delay interpolators of every antenna and source for this subint.  These
+  //are only read by the process threads, so they all share them
+  procslots[index].delaytablevalid = model->calculateDelayInterpolatorTable(procslots[index].offsets[0], procslots[index].offsets[1] + double(procslots[index].offsets[2])/1000000000.0, double(config->getSubintNS(currentconfigindex))/1000000000.0, config->getBlocksPerSend(currentconfigindex), 2, procslots[index].delaytable);
+
   //wait for everything to arrive, store the length of the messages
   MPI_Waitall(numdatastreams, datarequests, msgstatuses);
   for(int i=0;i<numdatastreams;i++)
     MPI_Get_count(&(msgstatuses[i]), MPI_UNSIGNED_CHAR, &(procslots[index].datalengthbytes[i]));
   MPI_Waitall(numdatastreams, controlrequests, msgstatuses);
+  receiveprofile->record(StageProfile::MPIRECEIVE, receivestart);
+
+  //the results last sent from this slot must have gone before the process threads can use it again
+  completeResultSend(index);
+
+  //share out the blocks while we still hold every thread's lock on this slot, so that all of the work
+  //is there to be stolen from the moment the first thread starts on it
+  if(dynamicblocks)
+    initialiseBlockChunks(index);
 
   //lock the next slot, unlock the one we just finished with
   for(int i=0;i<numprocessthreads;i++)
   {
-    perr = pthread_mutex_lock(&(procslots[(index+1)%RECEIVE_RING_LENGTH].slotlocks[i]));
+    perr = pthread_mutex_lock(&(procslots[(index+1)%receiveringlength].slotlocks[i]));
     if(perr != 0)
-      csevere << startl << "CORE " << mpiid << " error trying lock mutex " << (index+1)%RECEIVE_RING_LENGTH << endl;
+      csevere << startl << "CORE " << mpiid << " error trying lock mutex " << (index+1)%receiveringlength << endl;
   }
 
   for(int i=0;i<numprocessthreads;i++)
@@ -664,20 +809,85 @@ int Core::receivedata(int index, bool * terminate)
   return 1;
 }
 
+void Core::startResultSend(int index)
+{
+  processslot * slot = &(procslots[index]);
+  int mpierr;
+
+  //the persistent request is tied to a length and tag, so set up a new one if either has changed
+  if(!slot->sendrequestinitialised || slot->sendlength != slot->coreresultlength*2 || slot->sendtag != slot->resultsvalid)
+  {
+    if(slot->sendrequestinitialised)
+      MPI_Request_free(&(slot->sendrequest));
+    slot->sendlength = slot->coreresultlength*2;
+    slot->sendtag = slot->resultsvalid;
+    mpierr = MPI_Ssend_init(slot->results, slot->sendlength, MPI_FLOAT, fxcorr::MANAGERID, slot->sendtag, return_comm, &(slot->sendrequest));
+    if(mpierr != MPI_SUCCESS)
+      csevere << startl << "Core " << mpiid << " could not create the result send request for slot " << index << " (MPI error " << mpierr << ")" << endl;
+    slot->sendrequestinitialised = true;
+  }
+  mpierr = MPI_Start(&(slot->sendrequest));
+  if(mpierr != MPI_SUCCESS)
+    csevere << startl << "Core " << mpiid << " could not start sending the results of slot " << index << " (MPI error " << mpierr << ")" << endl;
+  slot->sendpending = true;
+}
+
+void Core::completeResultSend(int index)
+{
+  processslot * slot = &(procslots[index]);
+  MPI_Status mpistatus;
+  unsigned long long waitstart, waitns;
+  int status;
+
+  if(!slot->sendpending)
+    return;
+
+  waitstart = StageProfile::now();
+  MPI_Wait(&(slot->sendrequest), &mpistatus);
+  waitns = StageProfile::now() - waitstart;
+  if(receiveprofile->isEnabled())
+    receiveprofile->add(StageProfile::MPISENDWAIT, waitns);
+  slot->sendpending = false;
+  slot->numsends++;
+  slot->sendwaitns += waitns;
+  if(waitns > slot->maxsendwaitns)
+    slot->maxsendwaitns = waitns;
+
+  //zero the results buffer for this slot and set the status back to valid.  Anything beyond
+  //the length sent is already zero, even if the config has since changed
+  status = vectorZero_cf32(slot->results, slot->sendlength/2);
+  if(status != vecNoErr)
+    csevere << startl << "Error trying to zero results in Core!!!" << endl;
+  slot->resultsvalid = CR_VALIDVIS;
+}
+
+void Core::reportResultSendWaits()
+{
+  for(int i=0;i<receiveringlength;i++)
+  {
+    if(procslots[i].numsends == 0)
+      continue;
+    cinfo << startl << "Core " << mpiid << " slot " << i << "/" << receiveringlength << ": " << procslots[i].numsends << " result sends, mean wait " << procslots[i].sendwaitns/(1.0e6*procslots[i].numsends) << " ms, max wait " << procslots[i].maxsendwaitns/1.0e6 << " ms" << endl;
+  }
+}
+
 void Core::processdata(int index, int threadid, int startblock, int numblocks, Mode ** modes, Polyco * currentpolyco, threadscratchspace * scratchspace)
 {
 #ifndef NEUTERED_DIFX
-  int status, i, numfftloops, numfftsprocessed;
-  int resultindex, cindex, ds1index, ds2index, binloop;
-  int xcblockcount, maxxcblocks, xcshiftcount;
-  int acblockcount, maxacblocks, acshiftcount;
-  int freqchannels;
-  int xmacstridelength, xmacpasses, xmacstart, destbin, destchan, localfreqindex;
+  int status, i, numfftsprocessed;
+  int resultindex, ds1index, ds2index, binloop;
+  int xcblockcount, maxxcblocks, xcstartblock;
+  int acblockcount, maxacblocks, acstartblock;
+  int chunkstart, chunkblocks, endblock, blocksprocessed;
+  int freqchannels, modesource;
+  int xmacstridelength, xmacpasses, xmacstart, destbin, localfreqindex;
   int dsfreqindex;
   char papol;
-  double offsetmins, blockns;
-  f32 bweight;
+  double offsetmins, blockns, blocktimesum;
+  f32 bweight, binweightsum;
+  f32 * accfloatresults;
   f64 * binweights;
+  const pulsarbinruns * runs;
   const Mode * m1, * m2;
   const cf32 * vis1;
   const cf32 * vis2;
@@ -686,6 +896,7 @@ void Core::processdata(int index, int threadid, int startblock, int numblocks, M
   int fftsize;
   int numBufferedFFTs;
   float weight1, weight2;
+  unsigned long long xmactime;
 #endif
   int perr;
 
@@ -700,6 +911,7 @@ void Core::processdata(int index, int threadid, int startblock, int numblocks, M
   else
     binweights = 0;
   numBufferedFFTs = config->getNumBufferedFFTs(procslots[index].configindex);
+  modesource = (model->getNumPhaseCentres(procslots[index].offsets[0]) == 1)?1:0; //the station-based delays use the only phase centre if there is one, else the pointing centre
 
   //set up the mode objects that will do the station-based processing
   for(int j=0;j<numdatastreams;j++)
@@ -708,7 +920,10 @@ void Core::processdata(int index, int threadid, int startblock, int numblocks, M
     modes[j]->zeroAutocorrelations();
     modes[j]->setValidFlags(&(procslots[index].controlbuffer[j][3]));
     modes[j]->setData(procslots[index].databuffer[j], procslots[index].datalengthbytes[j], procslots[index].controlbuffer[j][0], procslots[index].controlbuffer[j][1], procslots[index].controlbuffer[j][2]);
-    modes[j]->setOffsets(procslots[index].offsets[0], procslots[index].offsets[1], procslots[index].offsets[2]);
+    if(procslots[index].delaytablevalid)
+      modes[j]->setOffsets(procslots[index].offsets[0], procslots[index].offsets[1], procslots[index].offsets[2], &(procslots[index].delaytable[model->getDelayInterpolatorTableOffset(modesource, config->getDModelFileIndex(procslots[index].configindex, j), 2)]));
+    else
+      modes[j]->setOffsets(procslots[index].offsets[0], procslots[index].offsets[1], procslots[index].offsets[2]);
     modes[j]->setDumpKurtosis(scratchspace->dumpkurtosis);
     if(scratchspace->dumpkurtosis)
       modes[j]->zeroKurtosis();
@@ -768,14 +983,17 @@ void Core::processdata(int index, int threadid, int startblock, int numblocks, M
     }
   }
 
-  //set up variables which control the number of loops through buffered FFT results
+  //set up variables which control the loops through chunks of buffered FFT results
   xcblockcount = 0;
-  xcshiftcount = 0;
+  xcstartblock = startblock;
   acblockcount = 0;
-  acshiftcount = 0;
-  numfftloops = numblocks/numBufferedFFTs;
-  if(numblocks%numBufferedFFTs != 0)
-    numfftloops++;
+  acstartblock = startblock;
+  blocksprocessed = 0;
+  blocktimesum = 0.0;
+  chunkstart = startblock;
+  endblock = startblock + numblocks;
+  if(dynamicblocks)
+    endblock = config->getBlocksPerSend(procslots[index].configindex); //chunk queues were filled by receivedata
   blockns = ((double)(config->getSubintNS(procslots[index].configindex)))/((double)(config->getBlocksPerSend(procslots[index].configindex)));
 
   maxxcblocks = ((int)(model->getMaxNSBetweenXCAvg(procslots[index].offsets[0])/blockns));
@@ -792,20 +1010,49 @@ void Core::processdata(int index, int threadid, int startblock, int numblocks, M
     cverbose << startl << "Requested autocorrelation shift/average time of " << model->getMaxNSBetweenACAvg(procslots[index].offsets[0]) << " ns cannot be met with " << numBufferedFFTs << " FFTs being buffered; the time resolution which will be attained is " << maxacblocks*blockns << " ns" << endl;
   }
 
-  //process each chunk of FFTs in turn
-  for(int fftloop=0;fftloop<numfftloops;fftloop++)
+  //process each chunk of FFTs in turn - a contiguous run from startblock, or claimed one at a time if scheduling dynamically
+  while(true)
   {
+    if(dynamicblocks)
+    {
+      chunkstart = claimBlockChunk(index, threadid)*numBufferedFFTs;
+      if(chunkstart < 0)
+        break;
+    }
+    else if(chunkstart >= endblock)
+      break;
+    chunkblocks = numBufferedFFTs;
+    if(chunkstart + chunkblocks > endblock)
+      chunkblocks = endblock - chunkstart; //may not have to fully complete last chunk
+
+    //if this chunk doesn't continue the current XC/AC averaging period, close that period off first
+    if(xcblockcount > 0 && !continuesAveragingPeriod(xcstartblock, xcblockcount, chunkstart, chunkblocks, maxxcblocks))
+    {
+      uvshiftAndAverage(index, threadid, (xcstartblock+((double)xcblockcount)/2.0)*blockns, xcblockcount*blockns, currentpolyco, scratchspace);
+      xcblockcount = 0;
+    }
+    if(xcblockcount == 0 || chunkstart < xcstartblock)
+      xcstartblock = chunkstart;
+    if(acblockcount > 0 && !continuesAveragingPeriod(acstartblock, acblockcount, chunkstart, chunkblocks, maxacblocks))
+    {
+      averageAndSendAutocorrs(index, threadid, (acstartblock+((double)acblockcount)/2.0)*blockns, acblockcount*blockns, modes, scratchspace);
+      acblockcount = 0;
+      for(int j=0;j<numdatastreams;j++)
+        modes[j]->zeroAutocorrelations();
+    }
+    if(acblockcount == 0 || chunkstart < acstartblock)
+      acstartblock = chunkstart;
+    blocksprocessed += chunkblocks;
+    blocktimesum += chunkblocks*(chunkstart + chunkblocks/2.0); //sum of the block midpoints, which need not be contiguous
+
     numfftsprocessed = 0;   // not strictly needed, but to prevent compiler warning
     //do the station-based processing for this batch of FFT chunks
     for(int j=0;j<numdatastreams;j++)
     {
       numfftsprocessed = 0;
-      for(int fftsubloop=0;fftsubloop<numBufferedFFTs;fftsubloop++)
+      for(int fftsubloop=0;fftsubloop<chunkblocks;fftsubloop++)
       {
-        i = fftloop*numBufferedFFTs + fftsubloop + startblock;
-	if(i >= startblock+numblocks)
-	  break; //may not have to fully complete last fftloop
-        modes[j]->process(i, fftsubloop);
+        modes[j]->process(chunkstart + fftsubloop, fftsubloop);
         numfftsprocessed++;
       }
     }
@@ -815,13 +1062,19 @@ void Core::processdata(int index, int threadid, int startblock, int numblocks, M
     {
       for(int fftsubloop=0;fftsubloop<numBufferedFFTs; fftsubloop++)
       {
-        i = fftloop*numBufferedFFTs + fftsubloop + startblock;
+        i = chunkstart + fftsubloop;
         offsetmins = ((double)i)*blockns/60000000000.0;
         currentpolyco->getBins(offsetmins, scratchspace->bins[fftsubloop]);
+        for(int f=0;f<config->getFreqTableLength();f++)
+        {
+          if(config->isFrequencyUsed(procslots[index].configindex, f))
+            compressPulsarBins(scratchspace->bins[fftsubloop][f], config->getNumXmacStrides(procslots[index].configindex, f), config->getXmacStrideLength(procslots[index].configindex), &(scratchspace->binruns[fftsubloop][f]));
+        }
       }
     }
 
     //do the baseline-based processing for this batch of FFT chunks
+    xmactime = threadprofiles[threadid]->start();
     resultindex = 0;
     for(int f=0;f<config->getFreqTableLength();f++)
     {
@@ -874,7 +1127,16 @@ void Core::processdata(int index, int threadid, int startblock, int numblocks, M
           resultindex += freqchannels;
         }
       }
-      else if(config->isFrequencyUsed(procslots[index].configindex, f)) //normal processing
+      else if(config->getXmacMode(procslots[index].configindex) == Configuration::TILEDXMAC)
+      {
+        //tiled cross multiplication is done for all frequencies at once, below
+        break;
+      }
+      else if(config->isFrequencyUsed(procslots[index].configindex, f) && !procslots[index].pulsarbin) //normal processing
+      {
+        resultindex = crossMultiplyBaselines(config, procslots[index].configindex, f, chunkblocks, modes, scratchspace->threadcrosscorrs, resultindex);
+      }
+      else if(config->isFrequencyUsed(procslots[index].configindex, f)) //pulsar binning
       {
         //All baseline freq indices into the freq table are determined by the *first* datastream
         //in the event of correlating USB with LSB data.  Hence all Nyquist offsets/channels etc
@@ -899,13 +1161,9 @@ void Core::processdata(int index, int threadid, int startblock, int numblocks, M
 	      m2 = modes[ds2index];
 
               //do the baseline-based processing for this batch of FFT chunks
-              for(int fftsubloop=0;fftsubloop<numBufferedFFTs;fftsubloop++)
+              for(int fftsubloop=0;fftsubloop<chunkblocks;fftsubloop++)
               {
-	        i = fftloop*numBufferedFFTs + fftsubloop + startblock;
-	        if(i >= startblock+numblocks)
-		  break; //may not have to fully complete last fftloop
-
-                //add the desired results into the resultsbuffer, for each polarisation pair [and pulsar bin]
+                //add the desired results into the resultsbuffer, for each polarisation pair and pulsar bin
                 //loop through each polarisation for this frequency
                 for(int p=0;p<config->getBNumPolProducts(procslots[index].configindex,j,localfreqindex);p++)
                 {
@@ -916,55 +1174,42 @@ void Core::processdata(int index, int threadid, int startblock, int numblocks, M
                   weight1 = m1->getDataWeight(config->getBDataStream1RecordBandIndex(procslots[index].configindex, j, localfreqindex, p), fftsubloop);
                   weight2 = m2->getDataWeight(config->getBDataStream2RecordBandIndex(procslots[index].configindex, j, localfreqindex, p), fftsubloop);
 
-                  if(procslots[index].pulsarbin)
-                  {
-                    //multiply into scratch space
-                    status = vectorMul_cf32(vis1, vis2, scratchspace->pulsarscratchspace, xmacstridelength);
-                    if(status != vecNoErr)
-                      csevere << startl << "Error trying to xmac baseline " << j << " frequency " << localfreqindex << " polarisation product " << p << ", status " << status << endl;
+                  //multiply into scratch space
+                  status = vectorMul_cf32(vis1, vis2, scratchspace->pulsarscratchspace, xmacstridelength);
+                  if(status != vecNoErr)
+                    csevere << startl << "Error trying to xmac baseline " << j << " frequency " << localfreqindex << " polarisation product " << p << ", status " << status << endl;
 
-                    //if scrunching, add into temp accumulate space, otherwise add into normal space
-                    if(procslots[index].scrunchoutput)
-                    {
-                      bweight = weight1*weight2/freqchannels;
-                      destchan = xmacstart;
-                      for(int l=0;l<xmacstridelength;l++)
-                      {
-                        //the first zero (the source slot) is because we are limiting to one pulsar ephemeris for now
-                        destbin = scratchspace->bins[fftsubloop][f][destchan];
-                        scratchspace->pulsaraccumspace[f][x][j][0][p][destbin][l].re += scratchspace->pulsarscratchspace[l].re;
-                        scratchspace->pulsaraccumspace[f][x][j][0][p][destbin][l].im += scratchspace->pulsarscratchspace[l].im;
-                        scratchspace->baselineweight[f][0][j][p] += bweight*binweights[destbin];
-                        destchan++;
-                      }
-                    }
-                    else
+                  //if scrunching, add into temp accumulate space, otherwise add into normal space.  The weights are summed
+                  //channel by channel, in channel order, so that they come out exactly as when the bins were looked up per channel
+                  runs = &(scratchspace->binruns[fftsubloop][f]);
+                  bweight = weight1*weight2/freqchannels;
+                  if(procslots[index].scrunchoutput)
+                  {
+                    //the first zero (the source slot) is because we are limiting to one pulsar ephemeris for now
+                    accumulatePulsarBinRuns(scratchspace->pulsarscratchspace, scratchspace->pulsaraccumspace[f][x][j][0][p][0], xmacstridelength, runs, x);
+                    binweightsum = scratchspace->baselineweight[f][0][j][p];
+                    for(int r=runs->firstrun[x];r<runs->firstrun[x+1];r++)
                     {
-                      bweight = weight1*weight2/freqchannels;
-                      destchan = xmacstart;
-                      for(int l=0;l<xmacstridelength;l++)
-                      {
-                        destbin = scratchspace->bins[fftsubloop][f][destchan];
-                        //cindex = resultindex + (scratchspace->bins[freqindex][destchan]*config->getBNumPolProducts(procslots[index].configindex,j,localfreqindex) + p)*(freqchannels+1) + destchan;
-                        cindex = resultindex + (destbin*config->getBNumPolProducts(procslots[index].configindex,j,localfreqindex) + p)*xmacstridelength + l;
-                        scratchspace->threadcrosscorrs[cindex].re += scratchspace->pulsarscratchspace[l].re;
-                        scratchspace->threadcrosscorrs[cindex].im += scratchspace->pulsarscratchspace[l].im;
-                        scratchspace->baselineweight[f][destbin][j][p] += bweight;
-                        destchan++;
-                      }
+                      for(int l=0;l<runs->runlength[r];l++)
+                        binweightsum += bweight*binweights[runs->runbin[r]];
                     }
+                    scratchspace->baselineweight[f][0][j][p] = binweightsum;
                   }
                   else
                   {
-                    //not pulsar binning, so this is nice and simple - just cross multiply accumulate
-                    status = vectorAddProduct_cf32(vis1, vis2, &(scratchspace->threadcrosscorrs[resultindex+p*xmacstridelength]), xmacstridelength);
-
-                    if(status != vecNoErr)
-                      csevere << startl << "Error trying to xmac baseline " << j << " frequency " << localfreqindex << " polarisation product " << p << ", status " << status << endl;
+                    accumulatePulsarBinRuns(scratchspace->pulsarscratchspace, &(scratchspace->threadcrosscorrs[resultindex + p*xmacstridelength]), config->getBNumPolProducts(procslots[index].configindex,j,localfreqindex)*xmacstridelength, runs, x);
+                    for(int r=runs->firstrun[x];r<runs->firstrun[x+1];r++)
+                    {
+                      destbin = runs->runbin[r];
+                      binweightsum = scratchspace->baselineweight[f][destbin][j][p];
+                      for(int l=0;l<runs->runlength[r];l++)
+                        binweightsum += bweight;
+                      scratchspace->baselineweight[f][destbin][j][p] = binweightsum;
+                    }
                   }
                 }
               }
-	      if(procslots[index].pulsarbin && !procslots[index].scrunchoutput)
+	      if(!procslots[index].scrunchoutput)
 	        resultindex += config->getBNumPolProducts(procslots[index].configindex,j,localfreqindex)*procslots[index].numpulsarbins*xmacstridelength;
               else
 	        resultindex += config->getBNumPolProducts(procslots[index].configindex,j,localfreqindex)*xmacstridelength;
@@ -974,23 +1219,25 @@ void Core::processdata(int index, int threadid, int startblock, int numblocks, M
       }
     }
 
+    if(config->getXmacMode(procslots[index].configindex) == Configuration::TILEDXMAC && !config->phasedArrayOn(procslots[index].configindex))
+      crossMultiplyTiled(config, procslots[index].configindex, chunkblocks, modes, scratchspace->threadcrosscorrs);
+    threadprofiles[threadid]->record(StageProfile::XMAC, xmactime);
+
     xcblockcount += numfftsprocessed;
     if(xcblockcount == maxxcblocks)
     {
       //shift/average and then lock results and copy data
-      uvshiftAndAverage(index, threadid, (startblock+xcshiftcount*maxxcblocks+((double)maxxcblocks)/2.0)*blockns, maxxcblocks*blockns, currentpolyco, scratchspace);
-      //reset the xcblockcount, increment xcshiftcount
+      uvshiftAndAverage(index, threadid, (xcstartblock+((double)maxxcblocks)/2.0)*blockns, maxxcblocks*blockns, currentpolyco, scratchspace);
+      //reset the xcblockcount
       xcblockcount = 0;
-      xcshiftcount++;
     }
     acblockcount += numfftsprocessed;
     if(acblockcount == maxacblocks)
     {
       //shift/average and then lock results and copy data
-      averageAndSendAutocorrs(index, threadid, (startblock+acshiftcount*maxacblocks+((double)maxacblocks)/2.0)*blockns, maxacblocks*blockns, modes, scratchspace);
-      //reset the acblockcount, increment acshiftcount, zero the autocorrelations
+      averageAndSendAutocorrs(index, threadid, (acstartblock+((double)maxacblocks)/2.0)*blockns, maxacblocks*blockns, modes, scratchspace);
+      //reset the acblockcount, zero the autocorrelations
       acblockcount = 0;
-      acshiftcount++;
       for(int j=0;j<numdatastreams;j++)
         modes[j]->zeroAutocorrelations();
     }
@@ -998,11 +1245,8 @@ void Core::processdata(int index, int threadid, int startblock, int numblocks, M
     //finally, update the baselineweight if not doing any pulsar stuff
     if(!procslots[index].pulsarbin)
     {
-      for(int fftsubloop=0;fftsubloop<numBufferedFFTs;fftsubloop++)
+      for(int fftsubloop=0;fftsubloop<chunkblocks;fftsubloop++)
       {
-        i = fftloop*numBufferedFFTs + fftsubloop + startblock;
-        if(i >= startblock+numblocks)
-          break; //may not have to fully complete last fftloop
         for(int f=0;f<config->getFreqTableLength();f++)
         {
           if(config->isFrequencyUsed(procslots[index].configindex, f))
@@ -1043,22 +1287,28 @@ void Core::processdata(int index, int threadid, int startblock, int numblocks, M
         }
       }
     }
+    chunkstart += chunkblocks;
   }
 
   if(xcblockcount != 0) {
-    uvshiftAndAverage(index, threadid, (startblock+xcshiftcount*maxxcblocks+((double)xcblockcount)/2.0)*blockns, xcblockcount*blockns, currentpolyco, scratchspace);
+    uvshiftAndAverage(index, threadid, (xcstartblock+((double)xcblockcount)/2.0)*blockns, xcblockcount*blockns, currentpolyco, scratchspace);
   }
   if(acblockcount != 0) {
-    averageAndSendAutocorrs(index, threadid, (startblock+acshiftcount*maxacblocks+((double)acblockcount)/2.0)*blockns, acblockcount*blockns, modes, scratchspace);
+    averageAndSendAutocorrs(index, threadid, (acstartblock+((double)acblockcount)/2.0)*blockns, acblockcount*blockns, modes, scratchspace);
   }
-  if(scratchspace->dumpkurtosis) {
-    averageAndSendKurtosis(index, threadid, (startblock + numblocks/2.0)*blockns, numblocks*blockns, numblocks, modes, scratchspace);
+  if(scratchspace->dumpkurtosis && blocksprocessed > 0) {
+    averageAndSendKurtosis(index, threadid, (blocktimesum/blocksprocessed)*blockns, blocksprocessed*blockns, blocksprocessed, modes, scratchspace);
   }
 
   //lock the bweight copylock, so we're the only one adding to the result array (baseline weight section)
-  perr = pthread_mutex_lock(&(procslots[index].bweightcopylock));
-  if(perr != 0)
-    csevere << startl << "PROCESSTHREAD " << mpiid << "/" << threadid << " error trying lock bweight copy mutex!!!" << endl;
+  //unless we are accumulating into our own private result array, which is reduced into the slot below
+  accfloatresults = (f32*)getAccumulationResults(index, threadid);
+  if(!reduceresults)
+  {
+    perr = pthread_mutex_lock(&(procslots[index].bweightcopylock));
+    if(perr != 0)
+      csevere << startl << "PROCESSTHREAD " << mpiid << "/" << threadid << " error trying lock bweight copy mutex!!!" << endl;
+  }
 
   for(int f=0;f<config->getFreqTableLength();f++)
   {
@@ -1074,7 +1324,7 @@ void Core::processdata(int index, int threadid, int startblock, int numblocks, M
           {
             for(int j=0;j<config->getBNumPolProducts(procslots[index].configindex,i,localfreqindex);j++)
             {
-              procslots[index].floatresults[resultindex] += scratchspace->baselineweight[f][b][i][j];
+              accfloatresults[resultindex] += scratchspace->baselineweight[f][b][i][j];
               resultindex++;
             }
           }
@@ -1090,7 +1340,7 @@ void Core::processdata(int index, int threadid, int startblock, int numblocks, M
             resultindex = config->getCoreResultBShiftDecorrOffset(procslots[index].configindex, f, i)*2;
             for(int s=0;s<model->getNumPhaseCentres(procslots[index].offsets[0]);s++)
             {
-              procslots[index].floatresults[resultindex] += scratchspace->baselineshiftdecorr[f][i][s];
+              accfloatresults[resultindex] += scratchspace->baselineshiftdecorr[f][i][s];
               resultindex++;
             }
           }
@@ -1100,20 +1350,27 @@ void Core::processdata(int index, int threadid, int startblock, int numblocks, M
   }
 
   //unlock the bweight copylock
-  perr = pthread_mutex_unlock(&(procslots[index].bweightcopylock));
-  if(perr != 0)
-    csevere << startl << "PROCESSTHREAD " << mpiid << "/" << threadid << " error trying unlock copy mutex!!!" << endl;
+  if(!reduceresults)
+  {
+    perr = pthread_mutex_unlock(&(procslots[index].bweightcopylock));
+    if(perr != 0)
+      csevere << startl << "PROCESSTHREAD " << mpiid << "/" << threadid << " error trying unlock copy mutex!!!" << endl;
+  }
 
   //copy the PCal results
   copyPCalTones(index, threadid, modes);
 
+  //combine all threads' private result arrays into the slot, if that is how we are accumulating
+  if(reduceresults)
+    reduceThreadResults(index, threadid);
+
 //end the cutout of processing in "Neutered DiFX"
 #endif
 
   //grab the next slot lock
-  perr = pthread_mutex_lock(&(procslots[(index+1)%RECEIVE_RING_LENGTH].slotlocks[threadid]));
+  perr = pthread_mutex_lock(&(procslots[(index+1)%receiveringlength].slotlocks[threadid]));
   if(perr != 0)
-    csevere << startl << "PROCESSTHREAD " << mpiid << "/" << threadid << " error trying lock mutex " << (index+1)%RECEIVE_RING_LENGTH << endl;
+    csevere << startl << "PROCESSTHREAD " << mpiid << "/" << threadid << " error trying lock mutex " << (index+1)%receiveringlength << endl;
 
   //unlock the one we had
   perr = pthread_mutex_unlock(&(procslots[index].slotlocks[threadid]));
@@ -1121,14 +1378,254 @@ void Core::processdata(int index, int threadid, int startblock, int numblocks, M
     csevere << startl << "PROCESSTHREAD " << mpiid << "/" << threadid << " error trying unlock mutex " << index << endl;
 }
 
+void Core::initialiseBlockChunks(int index)
+{
+  int numchunks, numBufferedFFTs;
+  blockchunkqueue * queue;
+
+  //start off with the same even, contiguous split as static scheduling, just in units of chunks.  No process
+  //thread can be working on this slot, so the queue locks are not needed
+  numBufferedFFTs = config->getNumBufferedFFTs(procslots[index].configindex);
+  numchunks = (config->getBlocksPerSend(procslots[index].configindex) + numBufferedFFTs - 1)/numBufferedFFTs;
+  for(int i=0;i<numprocessthreads;i++)
+  {
+    queue = &(procslots[index].chunkqueues[i]);
+    queue->nextchunk = (i*numchunks)/numprocessthreads;
+    queue->endchunk = ((i+1)*numchunks)/numprocessthreads;
+  }
+}
+
+int Core::claimBlockChunk(int index, int threadid)
+{
+  int perr, chunk, victim;
+  blockchunkqueue * queue;
+
+  //first try our own queue
+  chunk = -1;
+  queue = &(procslots[index].chunkqueues[threadid]);
+  perr = pthread_mutex_lock(&(queue->lock));
+  if(perr != 0)
+    csevere << startl << "PROCESSTHREAD " << mpiid << "/" << threadid << " error trying lock block chunk queue!!!" << endl;
+  if(queue->nextchunk < queue->endchunk)
+    chunk = queue->nextchunk++;
+  perr = pthread_mutex_unlock(&(queue->lock));
+  if(perr != 0)
+    csevere << startl << "PROCESSTHREAD " << mpiid << "/" << threadid << " error trying unlock block chunk queue!!!" << endl;
+  if(chunk >= 0)
+    return chunk;
+
+  //otherwise steal from the back of someone else's, starting with whoever we stole from last time.  The queues
+  //are all filled before the slot is handed over, so this includes threads which haven't started on it yet
+  victim = laststolenfrom[threadid];
+  for(int i=0;i<numprocessthreads;i++)
+  {
+    if(victim != threadid)
+    {
+      queue = &(procslots[index].chunkqueues[victim]);
+      perr = pthread_mutex_lock(&(queue->lock));
+      if(perr != 0)
+        csevere << startl << "PROCESSTHREAD " << mpiid << "/" << threadid << " error trying lock block chunk queue of thread " << victim << "!!!" << endl;
+      if(queue->nextchunk < queue->endchunk)
+        chunk = --(queue->endchunk);
+      perr = pthread_mutex_unlock(&(queue->lock));
+      if(perr != 0)
+        csevere << startl << "PROCESSTHREAD " << mpiid << "/" << threadid << " error trying unlock block chunk queue of thread " << victim << "!!!" << endl;
+      if(chunk >= 0)
+      {
+        laststolenfrom[threadid] = victim;
+        return chunk;
+      }
+    }
+    victim = (victim+1)%numprocessthreads;
+  }
+
+  return -1;
+}
+
+bool Core::continuesAveragingPeriod(int runstart, int runblocks, int chunkstart, int chunkblocks, int periodblocks) const
+{
+  if(!dynamicblocks) //chunks always follow on, and the period is closed off when full
+    return (chunkstart == runstart + runblocks);
+
+  //stolen chunks are taken from the back of a queue, so may extend the run downwards
+  if(chunkstart != runstart + runblocks && chunkstart + chunkblocks != runstart)
+    return false;
+  return (chunkstart/periodblocks == runstart/periodblocks);
+}
+
+void Core::reduceThreadResults(int index, int threadid)
+{
+  int status, chunkstart, chunklength, resultlength;
+
+  //each thread looks after one contiguous chunk of the results, in every thread's array
+  resultlength = procslots[index].coreresultlength;
+  chunklength = (resultlength + numprocessthreads - 1)/numprocessthreads;
+  chunkstart = threadid*chunklength;
+  if(chunkstart > resultlength)
+    chunkstart = resultlength;
+  if(chunkstart + chunklength > resultlength)
+    chunklength = resultlength - chunkstart;
+
+  //wait until every thread has finished adding into its own array
+  pthread_barrier_wait(&reductionbarrier);
+
+  if(chunklength > 0)
+  {
+    //pairwise tree: after the pass with stride s, array t (t a multiple of 2s) holds the sum of arrays t to t+2s-1
+    for(int stride=1;stride<numprocessthreads;stride*=2)
+    {
+      for(int t=0;t+stride<numprocessthreads;t+=2*stride)
+      {
+        status = vectorAdd_cf32_I(threadresults[t+stride] + chunkstart, threadresults[t] + chunkstart, chunklength);
+        if(status != vecNoErr)
+          csevere << startl << "PROCESSTHREAD " << mpiid << "/" << threadid << " error trying to reduce results of thread " << t+stride << " into thread " << t << endl;
+      }
+    }
+
+    //no lock needed - no other thread touches this chunk of the slot results
+    status = vectorAdd_cf32_I(threadresults[0] + chunkstart, procslots[index].results + chunkstart, chunklength);
+    if(status != vecNoErr)
+      csevere << startl << "PROCESSTHREAD " << mpiid << "/" << threadid << " error trying to add reduced results into slot " << index << endl;
+    for(int t=0;t<numprocessthreads;t++)
+    {
+      status = vectorZero_cf32(threadresults[t] + chunkstart, chunklength);
+      if(status != vecNoErr)
+        csevere << startl << "PROCESSTHREAD " << mpiid << "/" << threadid << " error trying to zero results of thread " << t << endl;
+    }
+  }
+
+  //don't let anyone start on the next slot until all the chunks of their array have been read and zeroed
+  pthread_barrier_wait(&reductionbarrier);
+}
+
+int Core::crossMultiplyBaselines(Configuration * config, int configindex, int freqindex, int chunkblocks, Mode ** modes, cf32 * threadcrosscorrs, int resultindex)
+{
+  int status, xmacstridelength, xmacpasses, xmacstart, localfreqindex;
+  const Mode * m1, * m2;
+  const cf32 * vis1;
+  const cf32 * vis2;
+
+  xmacstridelength = config->getXmacStrideLength(configindex);
+  xmacpasses = config->getNumXmacStrides(configindex, freqindex);
+  for(int x=0;x<xmacpasses;x++)
+  {
+    xmacstart = x*xmacstridelength;
+    for(int j=0;j<config->getNumBaselines();j++)
+    {
+      //get the localfreqindex for this frequency
+      localfreqindex = config->getBLocalFreqIndex(configindex, j, freqindex);
+      if(localfreqindex < 0)
+        continue;
+
+      //get the two modes that contribute to this baseline
+      m1 = modes[config->getBOrderedDataStream1Index(configindex, j)];
+      m2 = modes[config->getBOrderedDataStream2Index(configindex, j)];
+      for(int fftsubloop=0;fftsubloop<chunkblocks;fftsubloop++)
+      {
+        for(int p=0;p<config->getBNumPolProducts(configindex,j,localfreqindex);p++)
+        {
+          vis1 = &(m1->getFreqs(config->getBDataStream1BandIndex(configindex, j, localfreqindex, p), fftsubloop)[xmacstart]);
+          vis2 = &(m2->getConjugatedFreqs(config->getBDataStream2BandIndex(configindex, j, localfreqindex, p), fftsubloop)[xmacstart]);
+          status = vectorAddProduct_cf32(vis1, vis2, &(threadcrosscorrs[resultindex+p*xmacstridelength]), xmacstridelength);
+          if(status != vecNoErr)
+            csevere << startl << "Error trying to xmac baseline " << j << " frequency " << localfreqindex << " polarisation product " << p << ", status " << status << endl;
+        }
+      }
+      resultindex += config->getBNumPolProducts(configindex,j,localfreqindex)*xmacstridelength;
+    }
+  }
+
+  return resultindex;
+}
+
+void Core::crossMultiplyTiled(Configuration * config, int configindex, int chunkblocks, Mode ** modes, cf32 * threadcrosscorrs)
+{
+  int status, tilechannels, tilelength, xmacstridelength, xmacpasses, xmacstart, numbaselines, numdatastreams;
+  int localfreqindex, ds1index, ds2index, tilekey, grouptilekey, groupstart, groupend, resultindex, baseline;
+  const Mode * m1, * m2;
+  const cf32 * vis1;
+  const cf32 * vis2;
+
+  numbaselines = config->getNumBaselines();
+  numdatastreams = config->getNumDataStreams();
+  xmacstridelength = config->getXmacStrideLength(configindex);
+  tilechannels = config->getXmacTileChannels(configindex);
+
+  for(int f=0;f<config->getFreqTableLength();f++)
+  {
+    if(!config->isFrequencyUsed(configindex, f))
+      continue;
+
+    xmacpasses = config->getNumXmacStrides(configindex, f);
+    for(int x=0;x<xmacpasses;x++)
+    {
+      xmacstart = x*xmacstridelength;
+      for(int c=0;c<xmacstridelength;c+=tilechannels)
+      {
+        tilelength = tilechannels;
+        if(c + tilelength > xmacstridelength)
+          tilelength = xmacstridelength - c;
+
+        //walk through the baselines one datastream tile pair at a time
+        groupstart = 0;
+        while(groupstart < numbaselines)
+        {
+          baseline = config->getXmacTiledBaseline(configindex, groupstart);
+          grouptilekey = (config->getBOrderedDataStream1Index(configindex, baseline)/Configuration::XMAC_TILE_STATIONS)*numdatastreams + config->getBOrderedDataStream2Index(configindex, baseline)/Configuration::XMAC_TILE_STATIONS;
+          groupend = groupstart+1;
+          while(groupend < numbaselines)
+          {
+            baseline = config->getXmacTiledBaseline(configindex, groupend);
+            tilekey = (config->getBOrderedDataStream1Index(configindex, baseline)/Configuration::XMAC_TILE_STATIONS)*numdatastreams + config->getBOrderedDataStream2Index(configindex, baseline)/Configuration::XMAC_TILE_STATIONS;
+            if(tilekey != grouptilekey)
+              break;
+            groupend++;
+          }
+
+          //keep the FFT loop outermost within the group, so the accumulation order
+          //for each visibility is identical to the per-baseline xmac
+          for(int fftsubloop=0;fftsubloop<chunkblocks;fftsubloop++)
+          {
+            for(int b=groupstart;b<groupend;b++)
+            {
+              baseline = config->getXmacTiledBaseline(configindex, b);
+              localfreqindex = config->getBLocalFreqIndex(configindex, baseline, f);
+              if(localfreqindex < 0)
+                continue;
+              ds1index = config->getBOrderedDataStream1Index(configindex, baseline);
+              ds2index = config->getBOrderedDataStream2Index(configindex, baseline);
+              m1 = modes[ds1index];
+              m2 = modes[ds2index];
+              resultindex = config->getThreadResultFreqOffset(configindex, f) + x*config->getCompleteStrideLength(configindex, f) + config->getThreadResultBaselineOffset(configindex, f, baseline);
+              for(int p=0;p<config->getBNumPolProducts(configindex, baseline, localfreqindex);p++)
+              {
+                vis1 = &(m1->getFreqs(config->getBDataStream1BandIndex(configindex, baseline, localfreqindex, p), fftsubloop)[xmacstart+c]);
+                vis2 = &(m2->getConjugatedFreqs(config->getBDataStream2BandIndex(configindex, baseline, localfreqindex, p), fftsubloop)[xmacstart+c]);
+                status = vectorAddProduct_cf32(vis1, vis2, &(threadcrosscorrs[resultindex+p*xmacstridelength+c]), tilelength);
+                if(status != vecNoErr)
+                  csevere << startl << "Error trying to xmac (tiled) baseline " << baseline << " frequency " << localfreqindex << " polarisation product " << p << ", status " << status << endl;
+              }
+            }
+          }
+          groupstart = groupend;
+        }
+      }
+    }
+  }
+}
+
 void Core::copyPCalTones(int index, int threadid, Mode ** modes)
 {
   int resultindex, localfreqindex, perr;
+  cf32 * accresults = getAccumulationResults(index, threadid);
 
   //lock the pcal copylock, so we're the only one adding to the result array (pcal section)
-  perr = pthread_mutex_lock(&(procslots[index].pcalcopylock));
-  if(perr != 0)
-    csevere << startl << "PROCESSTHREAD " << mpiid << "/" << threadid << " error trying lock pcal copy mutex!!!" << endl;
+  if(!reduceresults)
+  {
+    perr = pthread_mutex_lock(&(procslots[index].pcalcopylock));
+    if(perr != 0)
+      csevere << startl << "PROCESSTHREAD " << mpiid << "/" << threadid << " error trying lock pcal copy mutex!!!" << endl;
+  }
 
   //copy the pulse cal
   for(int i=0;i<numdatastreams;i++)
@@ -1142,8 +1639,8 @@ void Core::copyPCalTones(int index, int threadid, Mode ** modes)
         localfreqindex = config->getDLocalRecordedFreqIndex(procslots[index].configindex, i, j);
         for(int k=0;k<config->getDRecordedFreqNumPCalTones(procslots[index].configindex, i, localfreqindex);k++)
         {
-          procslots[index].results[resultindex].re += modes[i]->getPcal(j,k).re;
-          procslots[index].results[resultindex].im += modes[i]->getPcal(j,k).im;
+          accresults[resultindex].re += modes[i]->getPcal(j,k).re;
+          accresults[resultindex].im += modes[i]->getPcal(j,k).im;
 	  resultindex++;
         }
       }
@@ -1151,9 +1648,12 @@ void Core::copyPCalTones(int index, int threadid, Mode ** modes)
   }
 
   //unlock the thread pcal copylock
-  perr = pthread_mutex_unlock(&(procslots[index].pcalcopylock));
-  if(perr != 0)
-    csevere << startl << "PROCESSTHREAD " << mpiid << "/" << threadid << " error trying unlock pcal copy mutex!!!" << endl;
+  if(!reduceresults)
+  {
+    perr = pthread_mutex_unlock(&(procslots[index].pcalcopylock));
+    if(perr != 0)
+      csevere << startl << "PROCESSTHREAD " << mpiid << "/" << threadid << " error trying unlock pcal copy mutex!!!" << endl;
+  }
 }
 
 void Core::averageAndSendAutocorrs(int index, int threadid, double nsoffset, double nswidth, Mode ** modes, threadscratchspace * scratchspace)
@@ -1165,6 +1665,8 @@ void Core::averageAndSendAutocorrs(int index, int threadid, double nsoffset, dou
   bool datastreamsaveraged, writecrossautocorrs;
   f32 * acdata;
   DifxMessageSTARecord * starecord;
+  cf32 * accresults = getAccumulationResults(index, threadid);
+  f32 * accfloatresults = (f32*)accresults;
 
   datastreamsaveraged = false;
   writecrossautocorrs = modes[0]->writeCrossAutoCorrs();
@@ -1258,9 +1760,12 @@ void Core::averageAndSendAutocorrs(int index, int threadid, double nsoffset, dou
   }
 
   //lock the autocorr copylock, so we're the only one adding to the result array (datastream section)
-  perr = pthread_mutex_lock(&(procslots[index].autocorrcopylock));
-  if(perr != 0)
-    csevere << startl << "PROCESSTHREAD " << mpiid << "/" << threadid << " error trying lock autocorr copy mutex!!!" << endl;
+  if(!reduceresults)
+  {
+    perr = pthread_mutex_lock(&(procslots[index].autocorrcopylock));
+    if(perr != 0)
+      csevere << startl << "PROCESSTHREAD " << mpiid << "/" << threadid << " error trying lock autocorr copy mutex!!!" << endl;
+  }
 
   //copy the autocorrelations
   for(int j=0;j<numdatastreams;j++)
@@ -1272,7 +1777,7 @@ void Core::averageAndSendAutocorrs(int index, int threadid, double nsoffset, dou
       if(config->isFrequencyUsed(procslots[index].configindex, freqindex) || config->isEquivalentFrequencyUsed(procslots[index].configindex, freqindex)) {
         freqchannels = config->getFNumChannels(freqindex)/config->getFChannelsToAverage(freqindex);
         //put autocorrs in resultsbuffer
-        status = vectorAdd_cf32_I(modes[j]->getAutocorrelation(false, k), &procslots[index].results[resultindex], freqchannels);
+        status = vectorAdd_cf32_I(modes[j]->getAutocorrelation(false, k), &accresults[resultindex], freqchannels);
         if(status != vecNoErr)
           csevere << startl << "Error copying autocorrelations for datastream " << j << ", band " << k << endl;
         resultindex += freqchannels;
@@ -1285,7 +1790,7 @@ void Core::averageAndSendAutocorrs(int index, int threadid, double nsoffset, dou
         freqindex = config->getDTotalFreqIndex(procslots[index].configindex, j, k);
         if(config->isFrequencyUsed(procslots[index].configindex, freqindex) || config->isEquivalentFrequencyUsed(procslots[index].configindex, freqindex)) {
           freqchannels = config->getFNumChannels(freqindex)/config->getFChannelsToAverage(freqindex);
-          status = vectorAdd_cf32_I(modes[j]->getAutocorrelation(true, k), &procslots[index].results[resultindex], freqchannels);
+          status = vectorAdd_cf32_I(modes[j]->getAutocorrelation(true, k), &accresults[resultindex], freqchannels);
           if(status != vecNoErr)
             csevere << startl << "Error copying cross-polar autocorrelations for datastream " << j << ", band " << k << endl;
           resultindex += freqchannels;
@@ -1295,14 +1800,20 @@ void Core::averageAndSendAutocorrs(int index, int threadid, double nsoffset, dou
   }
 
   //unlock the thread autocorr copylock
-  perr = pthread_mutex_unlock(&(procslots[index].autocorrcopylock));
-  if(perr != 0)
-    csevere << startl << "PROCESSTHREAD " << mpiid << "/" << threadid << " error trying unlock autocorr copy mutex!!!" << endl;
+  if(!reduceresults)
+  {
+    perr = pthread_mutex_unlock(&(procslots[index].autocorrcopylock));
+    if(perr != 0)
+      csevere << startl << "PROCESSTHREAD " << mpiid << "/" << threadid << " error trying unlock autocorr copy mutex!!!" << endl;
+  }
 
   //lock the acweight copylock, so we're the only one adding to the result array (autocorr weight section)
-  perr = pthread_mutex_lock(&(procslots[index].acweightcopylock));
-  if(perr != 0)
-    csevere << startl << "PROCESSTHREAD " << mpiid << "/" << threadid << " error trying lock acweight copy mutex!!!" << endl;
+  if(!reduceresults)
+  {
+    perr = pthread_mutex_lock(&(procslots[index].acweightcopylock));
+    if(perr != 0)
+      csevere << startl << "PROCESSTHREAD " << mpiid << "/" << threadid << " error trying lock acweight copy mutex!!!" << endl;
+  }
 
   //copy the autocorr weights
   for(int j=0;j<numdatastreams;j++)
@@ -1321,13 +1832,13 @@ void Core::averageAndSendAutocorrs(int index, int threadid, double nsoffset, dou
           parentfreqindex = config->getDZoomFreqParentFreqIndex(procslots[index].configindex, j, localfreqindex);
           for(int l=0;l<numrecordedbands;l++) {
             if(config->getDLocalRecordedFreqIndex(procslots[index].configindex, j, l) == parentfreqindex && config->getDZoomBandPol(procslots[index].configindex, j, k-numrecordedbands) == config->getDRecordedBandPol(procslots[index].configindex, j, l)) {
-              procslots[index].floatresults[resultindex] += modes[j]->getWeight(false, l);
+              accfloatresults[resultindex] += modes[j]->getWeight(false, l);
             }
           }
         }
         else
         {
-          procslots[index].floatresults[resultindex] += modes[j]->getWeight(false, k);
+          accfloatresults[resultindex] += modes[j]->getWeight(false, k);
         }
         resultindex++;
       }
@@ -1348,13 +1859,13 @@ void Core::averageAndSendAutocorrs(int index, int threadid, double nsoffset, dou
             {
               if(config->getDLocalRecordedFreqIndex(procslots[index].configindex, j, l) == parentfreqindex && config->getDZoomBandPol(procslots[index].configindex, j, k-numrecordedbands) == config->getDRecordedBandPol(procslots[index].configindex, j, l))
               {
-                procslots[index].floatresults[resultindex] += modes[j]->getWeight(false, l);
+                accfloatresults[resultindex] += modes[j]->getWeight(false, l);
               }
             }
           }
           else
           {
-            procslots[index].floatresults[resultindex] += modes[j]->getWeight(false, k);
+            accfloatresults[resultindex] += modes[j]->getWeight(false, k);
           }
           resultindex++;
         }
@@ -1363,9 +1874,12 @@ void Core::averageAndSendAutocorrs(int index, int threadid, double nsoffset, dou
   }
 
   //unlock the acweight copylock
-  perr = pthread_mutex_unlock(&(procslots[index].acweightcopylock));
-  if(perr != 0)
-    csevere << startl << "PROCESSTHREAD " << mpiid << "/" << threadid << " error trying unlock acweight copy mutex!!!" << endl;
+  if(!reduceresults)
+  {
+    perr = pthread_mutex_unlock(&(procslots[index].acweightcopylock));
+    if(perr != 0)
+      csevere << startl << "PROCESSTHREAD " << mpiid << "/" << threadid << " error trying unlock acweight copy mutex!!!" << endl;
+  }
 }
 
 void Core::averageAndSendKurtosis(int index, int threadid, double nsoffset, double nswidth, int numblocks, Mode ** modes, threadscratchspace * scratchspace)
@@ -1426,6 +1940,7 @@ void Core::uvshiftAndAverage(int index, int threadid, double nsoffset, double ns
   int status, startbaselinefreq, atbaselinefreq, startbaseline, startfreq, endbaseline;
   int localfreqindex, baselinefreqs;
   int numxmacstrides, xmaclen;
+  StageTimer timer(threadprofiles[threadid], StageProfile::UVSHIFT);
 
   //first scale the pulsar data if necessary
   if(procslots[index].pulsarbin && procslots[index].scrunchoutput)
@@ -1585,26 +2100,29 @@ void Core::uvshiftAndAverage(int index, int threadid, double nsoffset, double ns
 
 void Core::uvshiftAndAverageBaselineFreq(int index, int threadid, double nsoffset, double nswidth, threadscratchspace * scratchspace, int freqindex, int baseline)
 {
-  int status, perr, threadbinloop, threadindex, threadstart, numstrides;
-  int localfreqindex, freqchannels, coreindex, coreoffset, corebinloop, channelinc, rotatorlength, dest;
+  int status, perr, threadbinloop, threadindex, threadstart, numstrides, numphasecentres, numpolproducts;
+  int localfreqindex, freqchannels, coreindex, coreoffset, corebinloop, channelinc, dest, phasecentrestride;
   int antenna1index, antenna2index;
-  int rotatestridelen, rotatesperstride, xmacstridelen, xmaccopylen, stridestoaverage, averagesperstride, averagelength;
-  double bandwidth, lofrequency, channelbandwidth, stepbandwidth;
-  double applieddelay, applieddelay1, applieddelay2, turns, edgeturns;
+  int xmacstridelen, xmaccopylen, stridestoaverage, averagesperstride, averagelength;
+  double bandwidth, lofrequency, channelbandwidth, delaytime, blockns;
+  double applieddelay, applieddelay1, applieddelay2, turns, phasorre, phasorim, steppedre;
   double delaywindow, maxphasechange, timesmeardecorr, delaydecorr;
   double pointingcentredelay1approx[2];
   double pointingcentredelay2approx[2];
-  double ** phasecentredelay1 = 0;
-  double ** phasecentredelay2 = 0;
-  double ** differentialdelay = 0;
+  f64 * phasecentredelay1 = scratchspace->phasecentredelay1;
+  f64 * phasecentredelay2 = scratchspace->phasecentredelay2;
+  f64 * differentialdelay = scratchspace->differentialdelay;
+  f64 * phasecentreturns = scratchspace->phasecentreturns;
+  f64 * delaytable;
   cf32* srcpointer;
   cf32 meanresult;
+  cf32 * accresults;
+  bool rotate;
 
-  applieddelay = 0.0;
   delaywindow = config->getFNumChannels(freqindex)/(config->getFreqTableBandwidth(freqindex)); //max lag (plus and minus)
   localfreqindex = config->getBLocalFreqIndex(procslots[index].configindex, baseline, freqindex);
   xmacstridelen = config->getXmacStrideLength(procslots[index].configindex);
-  rotatestridelen = config->getRotateStrideLength(procslots[index].configindex);
+  numphasecentres = model->getNumPhaseCentres(procslots[index].offsets[0]);
   threadbinloop = 1;
   corebinloop = 1;
   if(procslots[index].pulsarbin)
@@ -1614,189 +2132,150 @@ void Core::uvshiftAndAverageBaselineFreq(int index, int threadid, double nsoffse
 
   if (localfreqindex<0) return;
 
-  //allocate space for the phase centre delays if necessary, and calculate pointing centre delays
-  if(model->getNumPhaseCentres(procslots[index].offsets[0]) > 1)
-  {
-    phasecentredelay1 = new double*[model->getNumPhaseCentres(procslots[index].offsets[0])];
-    phasecentredelay2 = new double*[model->getNumPhaseCentres(procslots[index].offsets[0])];
-    differentialdelay = new double*[model->getNumPhaseCentres(procslots[index].offsets[0])];
-    for(int i=0;i<model->getNumPhaseCentres(procslots[index].offsets[0]);i++)
-    {
-      phasecentredelay1[i] = new double[2];
-      phasecentredelay2[i] = new double[2];
-      differentialdelay[i] = new double[2];
-    }
-
-    antenna1index = config->getDModelFileIndex(procslots[index].configindex, config->getBDataStream1Index(procslots[index].configindex, baseline));
-    antenna2index = config->getDModelFileIndex(procslots[index].configindex, config->getBDataStream2Index(procslots[index].configindex, baseline));
-
-    //get the pointing centre interpolator, validity range aribitrarily set to 1us (approximately the tangent)
-    model->calculateDelayInterpolator(procslots[index].offsets[0], procslots[index].offsets[1] + double(procslots[index].offsets[2]+nsoffset)/1000000000.0, 0.000001, 1, antenna1index, 0, 1, pointingcentredelay1approx);
-    model->calculateDelayInterpolator(procslots[index].offsets[0], procslots[index].offsets[1] + double(procslots[index].offsets[2]+nsoffset)/1000000000.0, 0.000001, 1, antenna2index, 0, 1, pointingcentredelay2approx);
-    for(int s=0;s<model->getNumPhaseCentres(procslots[index].offsets[0]);s++)
-    {
-      model->calculateDelayInterpolator(procslots[index].offsets[0], procslots[index].offsets[1] + double(procslots[index].offsets[2]+nsoffset)/1000000000.0, 0.000001, 1, antenna1index, s+1, 1, phasecentredelay1[s]);
-      model->calculateDelayInterpolator(procslots[index].offsets[0], procslots[index].offsets[1] + double(procslots[index].offsets[2]+nsoffset)/1000000000.0, 0.000001, 1, antenna2index, s+1, 1, phasecentredelay2[s]);
-
-      //work out the correct delay (and rate of delay) for this phase centre
-      applieddelay1 = phasecentredelay1[s][1] - pointingcentredelay1approx[1];
-      applieddelay2 = phasecentredelay2[s][1] - pointingcentredelay2approx[1];
-      //make correction for geometric rate over the shifted sample range
-      applieddelay1 += applieddelay1*pointingcentredelay1approx[0];
-      applieddelay2 += applieddelay2*pointingcentredelay2approx[0];
-      //cout << "Applied delay is " << applieddelay2 - applieddelay1 << ", correction is " << applieddelay2 - applieddelay1 - saveddelay << endl;
-      differentialdelay[s][1] = applieddelay2 - applieddelay1;
-      differentialdelay[s][0] = phasecentredelay2[s][0] + pointingcentredelay1approx[0] - (phasecentredelay1[s][0] + pointingcentredelay2approx[0]);
-      //cout << "Differential delay [" << s << "][1] = " << differentialdelay[s][1] << endl;
-      //cout << "Differential delay [" << s << "][0] = " << differentialdelay[s][0] << " since antenna 1 delays were " << phasecentredelay1[s][0] << ", " << pointingcentredelay1approx[0] << ", and antenna 2 delays were " << phasecentredelay2[s][0] << ", " << pointingcentredelay2approx[0] << endl;
-      //cout << "DD (ant 1) was " << phasecentredelay1[s][0] - pointingcentredelay1approx[0] << ", (ant 2) was " << phasecentredelay2[s][0] - pointingcentredelay2approx[0] << endl;
-    }
-  }
-
   freqchannels = config->getFNumChannels(freqindex);
   channelinc = config->getFChannelsToAverage(freqindex);
   bandwidth = config->getFreqTableBandwidth(freqindex);
   lofrequency = config->getFreqTableFreq(freqindex);
+  numpolproducts = config->getBNumPolProducts(procslots[index].configindex,baseline,localfreqindex);
   stridestoaverage = channelinc/xmacstridelen;
-  rotatesperstride = xmacstridelen/rotatestridelen;
   if(stridestoaverage == 0)
     stridestoaverage = 1;
   averagesperstride = xmacstridelen/channelinc;
   if(averagesperstride == 0)
     averagesperstride = 1;
   averagelength = xmacstridelen/averagesperstride;
-  numstrides = freqchannels/xmacstridelen;
+  numstrides = config->getNumXmacStrides(procslots[index].configindex, freqindex);
   channelbandwidth = bandwidth/double(freqchannels);
-  rotatorlength = rotatestridelen+numstrides*rotatesperstride;
-  stepbandwidth = rotatestridelen*channelbandwidth;
-  if(model->getNumPhaseCentres(procslots[index].offsets[0]) > 1)
+
+  //calculate the delays of each phase centre relative to the pointing centre, in the preallocated scratch space
+  if(numphasecentres > 1)
   {
-    if(config->getFreqTableLowerSideband(freqindex))
+    antenna1index = config->getDModelFileIndex(procslots[index].configindex, config->getBDataStream1Index(procslots[index].configindex, baseline));
+    antenna2index = config->getDModelFileIndex(procslots[index].configindex, config->getBDataStream2Index(procslots[index].configindex, baseline));
+    delaytime = procslots[index].offsets[1] + double(procslots[index].offsets[2]+nsoffset)/1000000000.0;
+    blockns = double(config->getSubintNS(procslots[index].configindex))/double(config->getBlocksPerSend(procslots[index].configindex));
+    delaytable = procslots[index].delaytablevalid?procslots[index].delaytable:0;
+
+    //get the pointing centre interpolator, validity range aribitrarily set to 1us (approximately the tangent).  Where
+    //possible take it from the subint's table rather than going back to the model polynomials
+    if(delaytable)
     {
-      for(int c=0;c<rotatestridelen;c++)
-        scratchspace->chanfreqs[c] = -(rotatestridelen-(c+1))*channelbandwidth;
-      for(int c=0;c<numstrides*rotatesperstride;c++)
-        scratchspace->chanfreqs[rotatestridelen+c] = -(numstrides*rotatesperstride-(c+1))*stepbandwidth;
+      Model::linearSubInterpolator(&(delaytable[model->getDelayInterpolatorTableOffset(0, antenna1index, 2)]), nsoffset/blockns, 1000.0/blockns, 1, pointingcentredelay1approx);
+      Model::linearSubInterpolator(&(delaytable[model->getDelayInterpolatorTableOffset(0, antenna2index, 2)]), nsoffset/blockns, 1000.0/blockns, 1, pointingcentredelay2approx);
     }
     else
     {
-      for(int c=0;c<rotatestridelen;c++) {
-        scratchspace->chanfreqs[c] = c*channelbandwidth;
+      model->calculateDelayInterpolator(procslots[index].offsets[0], delaytime, 0.000001, 1, antenna1index, 0, 1, pointingcentredelay1approx);
+      model->calculateDelayInterpolator(procslots[index].offsets[0], delaytime, 0.000001, 1, antenna2index, 0, 1, pointingcentredelay2approx);
+    }
+    for(int s=0;s<numphasecentres;s++)
+    {
+      if(delaytable)
+      {
+        Model::linearSubInterpolator(&(delaytable[model->getDelayInterpolatorTableOffset(s+1, antenna1index, 2)]), nsoffset/blockns, 1000.0/blockns, 1, &(phasecentredelay1[2*s]));
+        Model::linearSubInterpolator(&(delaytable[model->getDelayInterpolatorTableOffset(s+1, antenna2index, 2)]), nsoffset/blockns, 1000.0/blockns, 1, &(phasecentredelay2[2*s]));
       }
-      for(int c=0;c<numstrides*rotatesperstride;c++) {
-        scratchspace->chanfreqs[rotatestridelen+c] = c*stepbandwidth;
+      else
+      {
+        model->calculateDelayInterpolator(procslots[index].offsets[0], delaytime, 0.000001, 1, antenna1index, s+1, 1, &(phasecentredelay1[2*s]));
+        model->calculateDelayInterpolator(procslots[index].offsets[0], delaytime, 0.000001, 1, antenna2index, s+1, 1, &(phasecentredelay2[2*s]));
       }
+
+      //work out the correct delay (and rate of delay) for this phase centre
+      applieddelay1 = phasecentredelay1[2*s+1] - pointingcentredelay1approx[1];
+      applieddelay2 = phasecentredelay2[2*s+1] - pointingcentredelay2approx[1];
+      //make correction for geometric rate over the shifted sample range
+      applieddelay1 += applieddelay1*pointingcentredelay1approx[0];
+      applieddelay2 += applieddelay2*pointingcentredelay2approx[0];
+      differentialdelay[2*s+1] = applieddelay2 - applieddelay1;
+      differentialdelay[2*s] = phasecentredelay2[2*s] + pointingcentredelay1approx[0] - (phasecentredelay1[2*s] + pointingcentredelay2approx[0]);
+
+      //the phase shift is linear in channel number: store the turns at channel 0 and per channel, and the unit phasor
+      //per channel which generates the rotator by recurrence
+      applieddelay = differentialdelay[2*s+1];
+      turns = applieddelay*lofrequency;
+      if(config->getFreqTableLowerSideband(freqindex))
+        turns -= applieddelay*(freqchannels-1)*channelbandwidth;
+      phasecentreturns[4*s] = turns - floor(turns);
+      phasecentreturns[4*s+1] = applieddelay*channelbandwidth;
+      phasecentreturns[4*s+2] = cos(TWO_PI*phasecentreturns[4*s+1]);
+      phasecentreturns[4*s+3] = sin(TWO_PI*phasecentreturns[4*s+1]);
     }
   }
 
   coreindex = config->getCoreResultBaselineOffset(procslots[index].configindex, freqindex, baseline);
+  phasecentrestride = corebinloop*numpolproducts*freqchannels/channelinc;
+  threadstart = config->getThreadResultFreqOffset(procslots[index].configindex, freqindex) + config->getThreadResultBaselineOffset(procslots[index].configindex, freqindex, baseline);
 
-  //lock the mutex for this segment of the copying
-  perr = pthread_mutex_lock(&(procslots[index].viscopylocks[freqindex][baseline]));
-  if(perr != 0)
-    csevere << startl << "PROCESSTHREAD " << threadid << " error trying lock copy mutex for frequency table entry " << freqindex << ", baseline " << baseline << "!!!" << endl;
+  //lock the mutex for this segment of the copying (not needed if accumulating into our private result array)
+  accresults = getAccumulationResults(index, threadid);
+  if(!reduceresults)
+  {
+    perr = pthread_mutex_lock(&(procslots[index].viscopylocks[freqindex][baseline]));
+    if(perr != 0)
+      csevere << startl << "PROCESSTHREAD " << threadid << " error trying lock copy mutex for frequency table entry " << freqindex << ", baseline " << baseline << "!!!" << endl;
+  }
 
-  //actually do the rotation (if necessary), averaging (if necessary) and copying
-  for(int s=0;s<model->getNumPhaseCentres(procslots[index].offsets[0]);s++)
+  //actually do the rotation (if necessary), averaging (if necessary) and copying.  Each xmac stride of every
+  //product and bin is visited once per phase centre while it is still in cache, and the rotator for the
+  //stride is generated by a phasor recurrence (reseeded at the start of each stride) rather than sin/cos
+  for(int x=0;x<numstrides;x++)
   {
-    if(model->getNumPhaseCentres(procslots[index].offsets[0]) > 1)
+    for(int s=0;s<numphasecentres;s++)
     {
-      //work out the correct rotator for this frequency and phase centre
-      //cout << "phasecentredelay1[" << s << "] is " << phasecentredelay1[s][1] << endl;
-      //cout << "phasecentredelay2[" << s << "] is " << phasecentredelay2[s][1] << endl;
-      //cout << "pointingcentredelay1 is " << pointingcentredelay1 << endl;
-      //cout << "pointingcentredelay2 is " << pointingcentredelay2 << endl;
-      //applieddelay1 = phasecentredelay1[s][1] - pointingcentredelay1approx[1];
-      //applieddelay2 = phasecentredelay2[s][1] - pointingcentredelay2approx[1];
-      //make correction for geometric rate over the shifted sample range
-      //applieddelay1 += applieddelay1*pointingcentredelay1approx[0];
-      //applieddelay2 += applieddelay2*pointingcentredelay2approx[0];
-      //cout << "Applied delay is " << applieddelay2 - applieddelay1 << ", correction is " << applieddelay2 - applieddelay1 - saveddelay << endl;
-      //applieddelay = applieddelay2 - applieddelay1;
-      applieddelay = differentialdelay[s][1];
-      if(fabs(applieddelay) > 1.0e-20)
+      rotate = (numphasecentres > 1 && fabs(differentialdelay[2*s+1]) > 1.0e-20);
+      if(rotate)
       {
-        edgeturns = applieddelay*lofrequency;
-        edgeturns -= floor(edgeturns);
-        for(int r=0;r<rotatestridelen;r++)
-        {
-          turns = applieddelay*scratchspace->chanfreqs[r] + edgeturns;
-          scratchspace->argument[r] = (turns-floor(turns))*TWO_PI;
-        }
-        for(int r=rotatestridelen;r<rotatorlength;r++)
+        turns = phasecentreturns[4*s] + x*xmacstridelen*phasecentreturns[4*s+1];
+        turns = (turns - floor(turns))*TWO_PI;
+        phasorre = cos(turns);
+        phasorim = sin(turns);
+        for(int c=0;c<xmacstridelen;c++)
         {
-          turns = applieddelay*scratchspace->chanfreqs[r];
-          scratchspace->argument[r] = (turns-floor(turns))*TWO_PI;
+          scratchspace->rotator[c].re = (f32)phasorre;
+          scratchspace->rotator[c].im = (f32)phasorim;
+          steppedre = phasorre*phasecentreturns[4*s+2] - phasorim*phasecentreturns[4*s+3];
+          phasorim = phasorre*phasecentreturns[4*s+3] + phasorim*phasecentreturns[4*s+2];
+          phasorre = steppedre;
         }
-        status = vectorSinCos_f32(scratchspace->argument, &(scratchspace->argument[rotatorlength]), &(scratchspace->argument[2*rotatorlength]), rotatorlength);
-        if(status != vecNoErr)
-          csevere << startl << "Error in phase shift, sin/cos!!!" << status << endl;
-        status = vectorRealToComplex_f32(&(scratchspace->argument[2*rotatorlength]), &(scratchspace->argument[rotatorlength]), scratchspace->rotator, rotatorlength);
-        if(status != vecNoErr)
-          csevere << startl << "Error in phase shift, real to complex!!!" << status << endl;
       }
-    }
 
-    threadstart = config->getThreadResultFreqOffset(procslots[index].configindex, freqindex) + config->getThreadResultBaselineOffset(procslots[index].configindex, freqindex, baseline);
-    //cout << "Threadstart is " << threadstart << " since threadresultfreqoffset is " << config->getThreadResultFreqOffset(procslots[index].configindex, freqindex) << endl;
-    for(int x=0;x<config->getNumXmacStrides(procslots[index].configindex, freqindex);x++)
-    {
       threadindex = threadstart+x*config->getCompleteStrideLength(procslots[index].configindex, freqindex);
       for(int b=0;b<threadbinloop;b++)
       {
-        for(int k=0;k<config->getBNumPolProducts(procslots[index].configindex,baseline,localfreqindex);k++)
+        for(int k=0;k<numpolproducts;k++)
         {
           if(corebinloop > 1)
-            coreoffset = ((b*config->getBNumPolProducts(procslots[index].configindex,baseline,localfreqindex)+k)*freqchannels + x*xmacstridelen)/channelinc;
+            coreoffset = ((b*numpolproducts+k)*freqchannels + x*xmacstridelen)/channelinc;
           else
             coreoffset = (k*freqchannels + x*xmacstridelen)/channelinc;
-          if(model->getNumPhaseCentres(procslots[index].offsets[0]) > 1 && fabs(applieddelay) > 1.0e-20)
-          {
-            if(procslots[index].pulsarbin && procslots[index].scrunchoutput)
-              srcpointer = scratchspace->pulsaraccumspace[freqindex][x][baseline][0][k][b];
-            else
-              srcpointer = &(scratchspace->threadcrosscorrs[threadindex]);
-            //cout << "About to rotate from threadindex " << threadindex << " (cf max thread result length " << config->getMaxThreadResultLength() << ") for which the 10th offset re value is " << scratchspace->threadcrosscorrs[threadindex+10].re << endl;
-            for(int r=0;r<rotatesperstride;r++)
-            {
-              //atrotate = (r + x*rotatesperstride)*rotatestridelength;
-              status = vectorMul_cf32(scratchspace->rotator, &(srcpointer[r*rotatestridelen]), &(scratchspace->rotated[r*rotatestridelen]), rotatestridelen);
-              if(status != vecNoErr)
-                csevere << startl << "Error in phase shift, multiplication1!!!" << status << endl;
-              status = vectorMulC_cf32_I(scratchspace->rotator[rotatestridelen+r+x*rotatesperstride], &(scratchspace->rotated[r*rotatestridelen]), rotatestridelen);
-              if(status != vecNoErr)
-                csevere << startl << "Error in phase shift, multiplication2!!!" << status << endl;
-            }
-            srcpointer = scratchspace->rotated;
-          }
+          if(procslots[index].pulsarbin && procslots[index].scrunchoutput)
+            srcpointer = scratchspace->pulsaraccumspace[freqindex][x][baseline][0][k][b];
           else
+            srcpointer = &(scratchspace->threadcrosscorrs[threadindex]);
+          dest = coreindex + s*phasecentrestride + coreoffset;
+
+          if(rotate)
           {
-            if(procslots[index].pulsarbin && procslots[index].scrunchoutput)
-              srcpointer = scratchspace->pulsaraccumspace[freqindex][x][baseline][0][k][b];
-            else
-              srcpointer = &(scratchspace->threadcrosscorrs[threadindex]);
+            //rotate, average (or just copy) in one pass
+            accumulateRotatedStride(srcpointer, scratchspace->rotator, &(accresults[dest]), xmacstridelen, channelinc, averagesperstride, averagelength, stridestoaverage);
           }
-
-          //now average (or just copy) from the designated pointer to the main result buffer
-          if(channelinc == 1) //this frequency is not averaged
+          else if(channelinc == 1) //this frequency is not averaged
           {
             xmaccopylen = xmacstridelen;
-            status = vectorAdd_cf32_I(srcpointer, &(procslots[index].results[coreindex+coreoffset]), xmaccopylen);
+            status = vectorAdd_cf32_I(srcpointer, &(accresults[dest]), xmaccopylen);
             if(status != vecNoErr)
               cerror << startl << "Error trying to copy frequency index " << freqindex << ", baseline " << baseline << " when not averaging in frequency" << endl;
           }
           else //this frequency *is* averaged - deal with it
           {
-            dest = coreindex+coreoffset;
             for(int l=0;l<averagesperstride;l++)
             {
-              //status = vectorMean_cf32(srcpointer + l*channelinc, channelinc, &(scratchspace->channelsums[l]), vecAlgHintFast);
-              //cout << "about to average from " << srcpointer[l*averagelength].re << " for length " << averagelength << endl;
               status = vectorMean_cf32(srcpointer + l*averagelength, averagelength, &meanresult, vecAlgHintFast);
               if(status != vecNoErr)
                 cerror << startl << "Error trying to average frequency " << freqindex << ", baseline " << baseline << endl;
-              procslots[index].results[dest].re += meanresult.re/stridestoaverage;
-              procslots[index].results[dest].im += meanresult.im/stridestoaverage;
+              accresults[dest].re += meanresult.re/stridestoaverage;
+              accresults[dest].im += meanresult.im/stridestoaverage;
               dest++;
             }
           }
@@ -1804,24 +2283,26 @@ void Core::uvshiftAndAverageBaselineFreq(int index, int threadid, double nsoffse
         }
       }
     }
-    coreindex += corebinloop*config->getBNumPolProducts(procslots[index].configindex,baseline,localfreqindex)*freqchannels/channelinc;
   }
 
   //unlock the mutex for this segment of the copying
-  perr = pthread_mutex_unlock(&(procslots[index].viscopylocks[freqindex][baseline]));
-  if(perr != 0)
-    csevere << startl << "PROCESSTHREAD " << threadid << " error trying unlock copy mutex for frequency table entry " << freqindex << ", baseline " << baseline << "!!! Perr is " << perr << endl;
+  if(!reduceresults)
+  {
+    perr = pthread_mutex_unlock(&(procslots[index].viscopylocks[freqindex][baseline]));
+    if(perr != 0)
+      csevere << startl << "PROCESSTHREAD " << threadid << " error trying unlock copy mutex for frequency table entry " << freqindex << ", baseline " << baseline << "!!! Perr is " << perr << endl;
+  }
 
   //calculate the decorrelation for each freq/baseline/source
-  if(model->getNumPhaseCentres(procslots[index].offsets[0]) > 1)
+  if(numphasecentres > 1)
   {
-    for(int s=0;s<model->getNumPhaseCentres(procslots[index].offsets[0]);s++)
+    for(int s=0;s<numphasecentres;s++)
     {
       timesmeardecorr = 1.0;
       delaydecorr = 1.0;
-      if(fabs(differentialdelay[s][0]) > 1e-18)
+      if(fabs(differentialdelay[2*s]) > 1e-18)
       {
-        maxphasechange  = TWO_PI*differentialdelay[s][0]*(nswidth/1000.0)*config->getFreqTableFreq(freqindex);
+        maxphasechange  = TWO_PI*differentialdelay[2*s]*(nswidth/1000.0)*config->getFreqTableFreq(freqindex);
         timesmeardecorr = sin(maxphasechange/2.0) / (maxphasechange/2.0);
         if(timesmeardecorr < 0.0) {
           // use Brian Kernighan's bit counting trick to see if shifterrorcount is a power of two, print only the first few and then increasingly less
@@ -1831,12 +2312,9 @@ void Core::uvshiftAndAverageBaselineFreq(int index, int threadid, double nsoffse
           scratchspace->shifterrorcount++;
         }
       }
-      if(fabs(differentialdelay[s][1]) > 1e-18)
+      if(fabs(differentialdelay[2*s+1]) > 1e-18)
       {
-        //maxphasechange  = TWO_PI*differentialdelay[s][1]*config->getFreqTableBandwidth(freqindex)/config->getFNumChannels(freqindex);
-        //cout << "BW smearing: max phase change is " << maxphasechange << endl;
-        //bwsmeardecorr   = sin(maxphasechange/2.0) / (maxphasechange/2.0);
-        delaydecorr     = 1.0 - fabs(differentialdelay[s][1] / delaywindow);
+        delaydecorr     = 1.0 - fabs(differentialdelay[2*s+1] / delaywindow);
         if(delaydecorr < 0.0) {
           // use Brian Kernighan's bit counting trick to see if shifterrorcount is a power of two, print only the first few and then increasingly less
           if(scratchspace->shifterrorcount < 10 || (scratchspace->shifterrorcount & (scratchspace->shifterrorcount-1)) == 0)
@@ -1844,31 +2322,45 @@ void Core::uvshiftAndAverageBaselineFreq(int index, int threadid, double nsoffse
           delaydecorr = 0;
           scratchspace->shifterrorcount++;
         }
-        //cout << "1.0 - Time smear decorr is " << 1.0-timesmeardecorr << ", 1.0 - bw smear decorr is " << 1.0-bwsmeardecorr << ", 1.0 - delaydecorr is " << 1.0-delaydecorr << "(diff. delay is " << differentialdelay[s][1] << ", delay window is " << delaywindow << ")" << endl;
       }
-      //scratchspace->baselineshiftdecorr[freqindex][baseline][s] += nswidth*timesmeardecorr*bwsmeardecorr*delaydecorr;
       scratchspace->baselineshiftdecorr[freqindex][baseline][s] += nswidth*timesmeardecorr*delaydecorr;
     }
   }
+}
+
+void Core::accumulateRotatedStride(const cf32 * src, const cf32 * rotator, cf32 * dest, int xmacstridelen, int channelinc, int averagesperstride, int averagelength, int stridestoaverage)
+{
+  f32 sumre, sumim, scale;
+
+  if(channelinc == 1)
+  {
+    for(int c=0;c<xmacstridelen;c++)
+    {
+      dest[c].re += src[c].re*rotator[c].re - src[c].im*rotator[c].im;
+      dest[c].im += src[c].re*rotator[c].im + src[c].im*rotator[c].re;
+    }
+    return;
+  }
 
-  //free the phasecentredelay vectors if necessary
-  if(phasecentredelay1)
+  scale = 1.0/(f32(averagelength)*stridestoaverage);
+  for(int l=0;l<averagesperstride;l++)
   {
-    for(int i=0;i<model->getNumPhaseCentres(procslots[index].offsets[0]);i++)
+    sumre = 0.0;
+    sumim = 0.0;
+    for(int c=l*averagelength;c<(l+1)*averagelength;c++)
     {
-      delete [] phasecentredelay1[i];
-      delete [] phasecentredelay2[i];
-      delete [] differentialdelay[i];
+      sumre += src[c].re*rotator[c].re - src[c].im*rotator[c].im;
+      sumim += src[c].re*rotator[c].im + src[c].im*rotator[c].re;
     }
-    delete [] phasecentredelay1;
-    delete [] phasecentredelay2;
-    delete [] differentialdelay;
+    dest[l].re += sumre*scale;
+    dest[l].im += sumim*scale;
   }
 }
 
-void Core::createPulsarVaryingSpace(cf32******* pulsaraccumspace, s32**** bins, int newconfigindex, int oldconfigindex, int threadid)
+void Core::createPulsarVaryingSpace(cf32******* pulsaraccumspace, s32**** bins, pulsarbinruns *** binruns, int newconfigindex, int oldconfigindex, int threadid)
 {
-  int status, freqchannels, localfreqindex;
+  int status, freqchannels, localfreqindex, numbins, numpolproducts, xmacstridelength;
+  cf32 * accumblock;
 
   cdebug << startl << "Just entering Core::createPulsarVaryingSpace" << endl;
   if(oldconfigindex >= 0 && config->pulsarBinOn(oldconfigindex))
@@ -1882,12 +2374,17 @@ void Core::createPulsarVaryingSpace(cf32******* pulsaraccumspace, s32**** bins,
 	{
 	  freqchannels = config->getFNumChannels(f);
 	  vectorFree((*bins)[i][f]);
-          threadbytes[threadid] -= 4*freqchannels;
+          vectorFree((*binruns)[i][f].runbin);
+          vectorFree((*binruns)[i][f].runlength);
+          vectorFree((*binruns)[i][f].firstrun);
+          threadbytes[threadid] -= 4*(3*freqchannels + config->getNumXmacStrides(oldconfigindex, f) + 1);
 	}
       }
       delete [] (*bins)[i];
+      delete [] (*binruns)[i];
     }
     delete [] *bins;
+    delete [] *binruns;
     cdebug << startl << "Finished deleting old bins..." << endl;
     if(config->scrunchOutputOn(oldconfigindex))
     {
@@ -1907,15 +2404,12 @@ void Core::createPulsarVaryingSpace(cf32******* pulsaraccumspace, s32**** bins,
               {
                 for(int s=0;s<1;s++) //forced to single pulsar ephemeris for now
                 {
-                  for(int j=0;j<config->getBNumPolProducts(oldconfigindex,i,localfreqindex);j++)
-                  {
-                    for(int k=0;k<config->getNumPulsarBins(oldconfigindex);k++)
-                    {
-                      threadbytes[threadid] -= 8*freqchannels;
-                      vectorFree(pulsaraccumspace[f][x][i][s][j][k]);
-                    }
+                  //all bins of all polarisation products share one block, starting at the first
+                  numpolproducts = config->getBNumPolProducts(oldconfigindex,i,localfreqindex);
+                  threadbytes[threadid] -= 8*numpolproducts*config->getNumPulsarBins(oldconfigindex)*config->getXmacStrideLength(oldconfigindex);
+                  vectorFree(pulsaraccumspace[f][x][i][s][0][0]);
+                  for(int j=0;j<numpolproducts;j++)
                     delete [] pulsaraccumspace[f][x][i][s][j];
-                  }
                   delete [] pulsaraccumspace[f][x][i][s];
                 }
               }
@@ -1932,16 +2426,22 @@ void Core::createPulsarVaryingSpace(cf32******* pulsaraccumspace, s32**** bins,
   if(newconfigindex >= 0 && config->pulsarBinOn(newconfigindex))
   {
     *bins = new s32**[config->getNumBufferedFFTs(newconfigindex)];
+    *binruns = new pulsarbinruns*[config->getNumBufferedFFTs(newconfigindex)];
     for(int i=0;i<config->getNumBufferedFFTs(newconfigindex);i++)
     {
       (*bins)[i] = new s32*[config->getFreqTableLength()];
+      (*binruns)[i] = new pulsarbinruns[config->getFreqTableLength()];
       for(int f=0;f<config->getFreqTableLength();f++)
       {
         if(config->isFrequencyUsed(newconfigindex, f))
 	{
 	  freqchannels = config->getFNumChannels(f);
           (*bins)[i][f] = vectorAlloc_s32(freqchannels);
-	  threadbytes[threadid] += 4*freqchannels;
+          //at most one run per channel
+          (*binruns)[i][f].runbin = vectorAlloc_s32(freqchannels);
+          (*binruns)[i][f].runlength = vectorAlloc_s32(freqchannels);
+          (*binruns)[i][f].firstrun = vectorAlloc_s32(config->getNumXmacStrides(newconfigindex, f) + 1);
+	  threadbytes[threadid] += 4*(3*freqchannels + config->getNumXmacStrides(newconfigindex, f) + 1);
 	}
       }
     }
@@ -1965,22 +2465,25 @@ void Core::createPulsarVaryingSpace(cf32******* pulsaraccumspace, s32**** bins,
                 //for(int s=0;s<config->getMaxPhaseCentres(newconfigindex);s++)
                 for(int s=0;s<1;s++) //forced to single pulsar ephemeris for now
                 {
-                  pulsaraccumspace[f][x][i][s] = new cf32**[config->getBNumPolProducts(newconfigindex,i,localfreqindex)];
-                  for(int j=0;j<config->getBNumPolProducts(newconfigindex,i,localfreqindex);j++)
+                  //one contiguous block per baseline, laid out [polproduct][bin][channel]
+                  numpolproducts = config->getBNumPolProducts(newconfigindex,i,localfreqindex);
+                  numbins = config->getNumPulsarBins(newconfigindex);
+                  xmacstridelength = config->getXmacStrideLength(newconfigindex);
+                  accumblock = vectorAlloc_cf32(numpolproducts*numbins*xmacstridelength);
+                  if(accumblock == NULL) {
+                    cfatal << startl << "Could not allocate pulsar scratch space (out of memory?) - I must abort!" << endl;
+                    MPI_Abort(MPI_COMM_WORLD, 1);
+                  }
+                  threadbytes[threadid] += 8*numpolproducts*numbins*xmacstridelength;
+                  status = vectorZero_cf32(accumblock, numpolproducts*numbins*xmacstridelength);
+                  if(status != vecNoErr)
+                    csevere << startl << "Error trying to zero pulsaraccumspace!!!" << endl;
+                  pulsaraccumspace[f][x][i][s] = new cf32**[numpolproducts];
+                  for(int j=0;j<numpolproducts;j++)
                   {
-                    pulsaraccumspace[f][x][i][s][j] = new cf32*[config->getNumPulsarBins(newconfigindex)];
-                    for(int k=0;k<config->getNumPulsarBins(newconfigindex);k++)
-                    {
-                      pulsaraccumspace[f][x][i][s][j][k] = vectorAlloc_cf32(config->getXmacStrideLength(newconfigindex));
-                      if(pulsaraccumspace[f][x][i][s][j][k] == NULL) {
-                        cfatal << startl << "Could not allocate pulsar scratch space (out of memory?) - I must abort!" << endl;
-                        MPI_Abort(MPI_COMM_WORLD, 1);
-                      }
-                      threadbytes[threadid] += 8*config->getXmacStrideLength(newconfigindex);
-                      status = vectorZero_cf32(pulsaraccumspace[f][x][i][s][j][k], config->getXmacStrideLength(newconfigindex));
-                      if(status != vecNoErr)
-                        csevere << startl << "Error trying to zero pulsaraccumspace!!!" << endl;
-                    }
+                    pulsaraccumspace[f][x][i][s][j] = new cf32*[numbins];
+                    for(int k=0;k<numbins;k++)
+                      pulsaraccumspace[f][x][i][s][j][k] = accumblock + (j*numbins + k)*xmacstridelength;
                   }
                 }
               }
@@ -1993,6 +2496,59 @@ void Core::createPulsarVaryingSpace(cf32******* pulsaraccumspace, s32**** bins,
   cdebug << startl << "Finished allocating new pulsar scratch space" << endl;
 }
 
+void Core::compressPulsarBins(const s32 * chanbins, int numxmacstrides, int xmacstridelength, pulsarbinruns * runs)
+{
+  int numruns, chan, endchan, runlength, bin;
+
+  numruns = 0;
+  for(int x=0;x<numxmacstrides;x++)
+  {
+    runs->firstrun[x] = numruns;
+    chan = x*xmacstridelength;
+    endchan = chan + xmacstridelength;
+    while(chan < endchan)
+    {
+      bin = chanbins[chan];
+      runlength = 1;
+      while(chan + runlength < endchan && chanbins[chan + runlength] == bin)
+        runlength++;
+      runs->runbin[numruns] = bin;
+      runs->runlength[numruns] = runlength;
+      numruns++;
+      chan += runlength;
+    }
+  }
+  runs->firstrun[numxmacstrides] = numruns;
+}
+
+void Core::accumulatePulsarBinRuns(const cf32 * src, cf32 * dest, int binpitch, const pulsarbinruns * runs, int xmacstride)
+{
+  int status, runlength;
+  cf32 * binaccum;
+
+  for(int r=runs->firstrun[xmacstride];r<runs->firstrun[xmacstride+1];r++)
+  {
+    runlength = runs->runlength[r];
+    binaccum = dest + runs->runbin[r]*binpitch;
+    if(runlength >= MIN_VECTOR_BIN_RUN)
+    {
+      status = vectorAdd_cf32_I(src, binaccum, runlength);
+      if(status != vecNoErr)
+        csevere << startl << "Error trying to accumulate pulsar bin " << runs->runbin[r] << ", status " << status << endl;
+    }
+    else
+    {
+      for(int l=0;l<runlength;l++)
+      {
+        binaccum[l].re += src[l].re;
+        binaccum[l].im += src[l].im;
+      }
+    }
+    src += runlength;
+    dest += runlength;
+  }
+}
+
 void Core::allocateConfigSpecificThreadArrays(f32 **** baselineweight, f32 *** baselineshiftdecorr, int newconfigindex, int oldconfigindex, int threadid)
 {
   int localfreqindex, binloop;
@@ -2119,6 +2675,7 @@ void Core::updateconfig(int oldconfigindex, int configindex, int threadid, int &
       MPI_Abort(MPI_COMM_WORLD, 1);
     }
     threadbytes[threadid] += modes[i]->getEstimatedBytes();
+    modes[i]->setProfile(threadprofiles[threadid]);
   }
 
   //cdebug << startl << "New modes created, now for pulsar stuff if applicable" << endl;
@@ -32,8 +32,13 @@
 #include "configuration.h"
 #include "mode.h"
 #include "difxmessage.h"
+#include "profiler.h"
 #include <pthread.h>
 
+#ifdef __APPLE__
+#include "pthreadbarrier_osx.h"
+#endif
+
 /**
 @class Core
 @brief Accepts messages containing raw data, does the correlation, and sends off visibilities
@@ -67,12 +72,38 @@ public:
   */
   long long getEstimatedBytes();
 
-  /// The number of elements in the send/receive circular buffer
-  static const int RECEIVE_RING_LENGTH;
-
   /// The minimum weight for filterbank STA data to be sent
   static const double MINIMUM_FILTERBANK_WEIGHT;
 
+  /// The shortest run of channels in one pulsar bin which is accumulated with a vector add rather than channel by channel
+  static const int MIN_VECTOR_BIN_RUN;
+
+ /**
+  * Cross-multiplies and accumulates one batch of buffered FFTs for all baselines of one frequency, one baseline at a
+  * time.  This is the xmac used by processdata when neither pulsar binning nor phased array output is requested
+  * @param config The configuration object
+  * @param configindex The index of the configuration being correlated
+  * @param freqindex The index in the frequency table of the frequency to cross-multiply
+  * @param chunkblocks The number of FFT blocks in the batch of buffered FFTs
+  * @param modes The Mode objects which hold the station-based processing results
+  * @param threadcrosscorrs The thread's cross-correlation results
+  * @param resultindex The index in threadcrosscorrs of the first result of this frequency
+  * @return The index in threadcrosscorrs following the last result of this frequency
+  */
+  static int crossMultiplyBaselines(Configuration * config, int configindex, int freqindex, int chunkblocks, Mode ** modes, cf32 * threadcrosscorrs, int resultindex);
+
+ /**
+  * Cross-multiplies and accumulates one batch of buffered FFTs for all baselines, tiled over groups of datastreams
+  * and over channels so each station's spectra are reused from cache for every baseline of a tile.  Results are
+  * accumulated into the same threadcrosscorrs layout as crossMultiplyBaselines
+  * @param config The configuration object
+  * @param configindex The index of the configuration being correlated
+  * @param chunkblocks The number of FFT blocks in the batch of buffered FFTs
+  * @param modes The Mode objects which hold the station-based processing results
+  * @param threadcrosscorrs The thread's cross-correlation results
+  */
+  static void crossMultiplyTiled(Configuration * config, int configindex, int chunkblocks, Mode ** modes, cf32 * threadcrosscorrs);
+
 protected:
  /** 
   * Launches a new processing thread, which will work on a portion of the time slice every time an element in the circular buffer is processed
@@ -81,6 +112,14 @@ protected:
   static void * launchNewProcessThread(void * tdata);
 
 private:
+  /// A process thread's share of the chunks (of numBufferedFFTs blocks) of one time slice, when blocks are scheduled dynamically.  The owning
+  /// thread claims chunks from the front, other threads which have run out of work steal them from the back
+  typedef struct {
+    pthread_mutex_t lock;
+    int nextchunk;
+    int endchunk;
+  } blockchunkqueue;
+
   /// Structure containing all the information necessary to describe one element in the circular send/receive buffer, and all the necessary space to
   /// store data and results
   typedef struct {
@@ -105,21 +144,42 @@ private:
     pthread_mutex_t bweightcopylock;
     pthread_mutex_t acweightcopylock;
     pthread_mutex_t pcalcopylock;
+    blockchunkqueue * chunkqueues;
+    f64 * delaytable; //[scansource][antenna][3] quadratic delay interpolators over the subint, in blocks, filled by the main thread
+    bool delaytablevalid;
+    MPI_Request sendrequest;  //persistent request returning results to the FxManager, valid for sendlength/sendtag
+    bool sendrequestinitialised;
+    bool sendpending;
+    int sendlength;
+    int sendtag;
+    long long numsends;
+    unsigned long long sendwaitns, maxsendwaitns;
   } processslot;
 
+  /// The pulsar bins of the channels of one frequency for one FFT, compressed into runs of consecutive channels which fall in the same
+  /// bin.  Runs never cross an xmac stride boundary
+  typedef struct {
+    s32 * runbin;     //[run] the bin of each run
+    s32 * runlength;  //[run] the number of channels in each run
+    s32 * firstrun;   //[xmacstride+1] the first run of each xmac stride, plus the total number of runs
+  } pulsarbinruns;
+
   ///Structure containing all of the pointers to scratch space for a single thread
   typedef struct {
     f32 **** baselineweight; //[freq][pulsarbin][baseline][pol]
     f32 *** baselineshiftdecorr; //[freq][baseline][phasecentre]
     cf32 * threadcrosscorrs;
     s32 *** bins; //[fftsubloop][freq][channel]
+    pulsarbinruns ** binruns; //[fftsubloop][freq]
     cf32* pulsarscratchspace;
-    cf32******* pulsaraccumspace; //[freq][stride][baseline][source][polproduct][bin][channel]
-    f64 * chanfreqs;
+    cf32******* pulsaraccumspace; //[freq][stride][baseline][source][polproduct][bin][channel], contiguous for each [freq][stride][baseline][source]
+    f64 * phasecentredelay1; //[phasecentre][2] delay interpolator of the first antenna of a baseline
+    f64 * phasecentredelay2; //[phasecentre][2] delay interpolator of the second antenna of a baseline
+    f64 * differentialdelay; //[phasecentre][2] differential delay rate and delay, relative to the pointing centre
+    f64 * phasecentreturns;  //[phasecentre][4] shift phase at channel 0, per channel, and the per channel unit phasor
     cf32 * rotated;
-    cf32 * rotator;
+    cf32 * rotator; //[xmacstride]
     cf32 * channelsums;
-    f32 * argument;
     int shifterrorcount;
     DifxMessageSTARecord * starecordbuffer;
     bool dumpsta;
@@ -136,11 +196,31 @@ private:
   * Allocates or deallocates the required scratch space for pulsar binning which varies with config
   * @param pulsaraccumspace The array of scratch space [freq][xmacstride][baseline][src][pol][bin][chan]
   * @param bins Pointer to the array for bins
+  * @param binruns Pointer to the array for the bins compressed into runs of channels
   * @param newconfigindex The index of the config which is to be used
   * @param oldconfigindex The index of the config which was previously being used
   * @param threadid The thread for which this will be done
   */
-  void createPulsarVaryingSpace(cf32******* pulsaraccumspace, s32**** bins, int newconfigindex, int oldconfigindex, int threadid);
+  void createPulsarVaryingSpace(cf32******* pulsaraccumspace, s32**** bins, pulsarbinruns *** binruns, int newconfigindex, int oldconfigindex, int threadid);
+
+ /**
+  * Compresses the pulsar bins of each channel of one frequency into runs of consecutive channels in the same bin
+  * @param chanbins The bin of each channel
+  * @param numxmacstrides The number of xmac strides for this frequency
+  * @param xmacstridelength The number of channels in an xmac stride
+  * @param runs The runs to fill in
+  */
+  void compressPulsarBins(const s32 * chanbins, int numxmacstrides, int xmacstridelength, pulsarbinruns * runs);
+
+ /**
+  * Adds one xmac stride of visibilities into per-bin accumulators, a run of channels at a time
+  * @param src The visibilities for this xmac stride
+  * @param dest The accumulator for bin 0; the accumulator for bin b starts at dest + b*binpitch
+  * @param binpitch The separation of the accumulators for consecutive bins
+  * @param runs The runs of channels for this frequency and FFT
+  * @param xmacstride The xmac stride being accumulated
+  */
+  void accumulatePulsarBinRuns(const cf32 * src, cf32 * dest, int binpitch, const pulsarbinruns * runs, int xmacstride);
 
  /**
   * Allocates or deallocates the required space for thread-specific arrays which vary in size with config
@@ -166,18 +246,63 @@ private:
   */
   int receivedata(int index, bool * terminate);
 
+ /**
+  * Starts sending the results in the given index of the circular send/receive buffer back to the FxManager, without waiting for the send to complete
+  * @param index The index in the circular send/receive buffer whose results should be sent
+  */
+  void startResultSend(int index);
+
+ /**
+  * Waits for any send of results from the given index of the circular send/receive buffer to complete, then zeroes the results so the slot can be reused
+  * @param index The index in the circular send/receive buffer whose send should be completed
+  */
+  void completeResultSend(int index);
+
+ /**
+  * Logs the number of result sends from each slot of the circular send/receive buffer and how long the Core waited for them
+  */
+  void reportResultSendWaits();
+
  /**
   * Processes a single thread's section of a single subintegration
   * @param index The index in the circular send/receive buffer to be processed
   * @param threadid The id of the thread which is doing the processing
-  * @param startblock The first FFT block which is this thread's responsibility
-  * @param numblocks The number of FFT blocks which this thread will take care of
+  * @param startblock The first FFT block which is this thread's responsibility (ignored if scheduling blocks dynamically)
+  * @param numblocks The number of FFT blocks which this thread will take care of (ignored if scheduling blocks dynamically)
   * @param modes The Mode objects which handle the station-based processing
   * @param currentpolyco The correct Polyco object for this time slice - null if not pulsar binning
   * @param scratchspace Space for all of the intermediate results for this thread
   */
   void processdata(int index, int threadid, int startblock, int numblocks, Mode ** modes, Polyco * currentpolyco, threadscratchspace * scratchspace);
 
+
+ /**
+  * Gives every process thread its contiguous share of the chunks of a time slice to start from, when scheduling blocks
+  * dynamically.  Called before the slot is handed to the process threads
+  * @param index The index in the circular send/receive buffer to be processed
+  */
+  void initialiseBlockChunks(int index);
+
+ /**
+  * Claims the next chunk of blocks for a process thread: from its own queue if possible, otherwise stolen from the end of another
+  * thread's queue (preferring the thread it last stole from, so stolen chunks tend to stay contiguous)
+  * @param index The index in the circular send/receive buffer being processed
+  * @param threadid The id of the thread which is doing the processing
+  * @return The index of the claimed chunk, or -1 if no work remains in this time slice
+  */
+  int claimBlockChunk(int index, int threadid);
+
+ /**
+  * Works out whether a chunk of blocks can be added to a running XC or AC average, ie it is contiguous with it and (when
+  * scheduling blocks dynamically, when the averaging periods are fixed relative to the start of the time slice) in the same period
+  * @param runstart The first block of the running average
+  * @param runblocks The number of blocks in the running average
+  * @param chunkstart The first block of the chunk
+  * @param chunkblocks The number of blocks in the chunk
+  * @param periodblocks The length of an averaging period in blocks
+  */
+  bool continuesAveragingPeriod(int runstart, int runblocks, int chunkstart, int chunkblocks, int periodblocks) const;
+
  /**
   * Averages the autocorrelations down, sends off STA dumps down a socket if required and copies to coreresults
   * @param index The index in the circular send/receive buffer to be processed
@@ -232,6 +357,36 @@ private:
   */
   void uvshiftAndAverageBaselineFreq(int index, int threadid, double nsoffset, double nswidth, threadscratchspace * scratchspace, int freqindex, int baseline);
 
+ /**
+  * Phase rotates one xmac stride of visibilities and adds it, averaged in frequency if necessary, to the results
+  * @param src The visibilities of the stride
+  * @param rotator The phase rotation of each channel of the stride
+  * @param dest The first result (averaged channel) the stride contributes to
+  * @param xmacstridelen The number of channels in the stride
+  * @param channelinc The number of channels averaged into each result channel
+  * @param averagesperstride The number of result channels the stride contributes to
+  * @param averagelength The number of channels averaged into each of those result channels from this stride
+  * @param stridestoaverage The number of strides which contribute to each result channel
+  */
+  void accumulateRotatedStride(const cf32 * src, const cf32 * rotator, cf32 * dest, int xmacstridelen, int channelinc, int averagesperstride, int averagelength, int stridestoaverage);
+
+ /**
+  * Returns the array a process thread should add its results for a slot into: the slot's own results (which must then be
+  * protected by the appropriate copylock) or, when accumulating by reduction, the thread's private result array
+  * @param index The index in the circular send/receive buffer being processed
+  * @param threadid The id of the thread which is doing the processing
+  */
+  inline cf32 * getAccumulationResults(int index, int threadid) { return reduceresults?threadresults[threadid]:procslots[index].results; }
+
+ /**
+  * Sums the private result arrays of all process threads into the slot results, and zeroes them ready for the next slot.
+  * Must be called by every process thread for every slot; each thread reduces its own contiguous chunk of the result
+  * array, adding the thread arrays pairwise in a fixed binary tree so the summation order is deterministic
+  * @param index The index in the circular send/receive buffer being processed
+  * @param threadid The id of the thread which is doing the processing
+  */
+  void reduceThreadResults(int index, int threadid);
+
  /**
   * Updates all the parameters for processing thread when the configuration changes
   * @param oldconfigindex The index of the configuration we are changing from
@@ -253,6 +408,7 @@ private:
   MPI_Request * datarequests;
   MPI_Request * controlrequests;
   MPI_Status * msgstatuses;
+  int receiveringlength, delaytablelength;
   int numdatastreams, numbaselines, databytes, controllength, numreceived, numcomplete, currentconfigindex, numprocessthreads, maxthreadresultlength;
   long long maxcoreresultlength;
   int startmjd, startseconds;
@@ -263,6 +419,14 @@ private:
   pthread_t * processthreads;
   pthread_cond_t * processconds;
   bool * processthreadinitialised;
+  bool fftwisdomimported;
+  bool reduceresults;
+  bool dynamicblocks;
+  int * laststolenfrom;
+  cf32 ** threadresults;
+  pthread_barrier_t reductionbarrier;
+  StageProfile ** threadprofiles;
+  StageProfile * receiveprofile;
   Model * model;
 };
 
@@ -60,6 +60,7 @@ DataStream::DataStream(const Configuration * conf, int snum, int id, int ncores,
   for(int i=0;i<numcores;i++)
     coreids[i] = cids[i];
   model = config->getModel();
+  readprofile = StageProfiler::createProfile();
   activescan = 0;
   activesec = 0;
   activens = 0;
@@ -1885,6 +1886,7 @@ void DataStream::diskToMemory(int buffersegment)
 
   //do the buffer housekeeping
   waitForBuffer(buffersegment);
+  StageTimer timer(readprofile, StageProfile::DISKREAD);
 
   //get the right place to read to
   if(datamuxer) {
@@ -40,6 +40,7 @@
 #include "architecture.h"
 #include "configuration.h"
 #include "datamuxer.h"
+#include "profiler.h"
 #include "switchedpower.h"
 
 using namespace std;
@@ -183,6 +184,7 @@ protected:
   readinfo * bufferinfo;
   const Configuration * config;
   Model * model;
+  StageProfile * readprofile;
   string ** datafilenames;
   ifstream input;
   SwitchedPower *switchedpower;
@@ -0,0 +1,202 @@
+/***************************************************************************
+ *   Copyright (C) 2006-2020 by Adam Deller                                *
+ *                                                                         *
+ *   This program is free software: you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation, either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+//===========================================================================
+// SVN properties (DO NOT CHANGE)
+//
+// $Id$
+// $HeadURL$
+// $LastChangedRevision$
+// $Author$
+// $LastChangedDate$
+//
+//============================================================================
+#ifndef FUSEDUNPACK_H
+#define FUSEDUNPACK_H
+
+#include "architecture.h"
+
+// Unpackers which go straight from packed samples to the per-band f32 arrays used by Mode, in one pass and
+// without an intermediate s16 buffer.  The band count (and for byte unpackers the bits per sample) are
+// template parameters so that the inner loops have fixed trip counts and can be unrolled/vectorised; the
+// select functions return the instantiation for a given setup, or a generic/NULL one for unusual setups.
+
+// Lookup-table unpack, as for Mode::unpack: each u16 of packed data selects a row of samplesperlookup
+// s16 values (time-major, band-minor), which are scaled to floats exactly as vectorSplitScaled_s16f32 does.
+// The first skip values of the first row are dropped; nsamp samples per band are written.
+typedef void (*fusedlookupfn)(const s16 *lookup, const u16 *packed, int samplesperlookup, int skip, int nsamp, f32 **dest, int nbands);
+
+template <int NBANDS>
+inline void fusedLookupUnpack(const s16 *lookup, const u16 *packed, int samplesperlookup, int skip, int nsamp, f32 **dest, int nbands)
+{
+  const f32 scale = 2.0/((f32)MAX_S16-(f32)MIN_S16);
+  const s16 *row;
+  int i, t = 0;
+
+  packed += skip/samplesperlookup;
+  i = skip%samplesperlookup;
+  if(samplesperlookup%NBANDS == 0 && i%NBANDS == 0)
+  {
+    //every row holds whole time samples
+    while(t < nsamp)
+    {
+      row = &lookup[(*packed++)*samplesperlookup];
+      for(;i<samplesperlookup && t<nsamp;i+=NBANDS,t++)
+      {
+        for(int b=0;b<NBANDS;b++)
+          dest[b][t] = -1.0f + scale*((f32)row[i+b] - (f32)MIN_S16);
+      }
+      i = 0;
+    }
+  }
+  else
+  {
+    int b = 0;
+    while(t < nsamp)
+    {
+      row = &lookup[(*packed++)*samplesperlookup];
+      for(;i<samplesperlookup && t<nsamp;i++)
+      {
+        dest[b][t] = -1.0f + scale*((f32)row[i] - (f32)MIN_S16);
+        if(++b == NBANDS)
+        {
+          b = 0;
+          t++;
+        }
+      }
+      i = 0;
+    }
+  }
+}
+
+inline void fusedLookupUnpackGeneric(const s16 *lookup, const u16 *packed, int samplesperlookup, int skip, int nsamp, f32 **dest, int nbands)
+{
+  const f32 scale = 2.0/((f32)MAX_S16-(f32)MIN_S16);
+  const s16 *row;
+  int i, b = 0, t = 0;
+
+  packed += skip/samplesperlookup;
+  i = skip%samplesperlookup;
+  while(t < nsamp)
+  {
+    row = &lookup[(*packed++)*samplesperlookup];
+    for(;i<samplesperlookup && t<nsamp;i++)
+    {
+      dest[b][t] = -1.0f + scale*((f32)row[i] - (f32)MIN_S16);
+      if(++b == nbands)
+      {
+        b = 0;
+        t++;
+      }
+    }
+    i = 0;
+  }
+}
+
+inline fusedlookupfn selectFusedLookupUnpacker(int nbands)
+{
+  switch(nbands)
+  {
+    case 1: return fusedLookupUnpack<1>;
+    case 2: return fusedLookupUnpack<2>;
+    case 4: return fusedLookupUnpack<4>;
+    case 8: return fusedLookupUnpack<8>;
+    case 16: return fusedLookupUnpack<16>;
+    default: return fusedLookupUnpackGeneric;
+  }
+}
+
+// Byte-table unpack, for formats (VDIF) with samples packed least significant bits first and bands
+// fastest: lut holds the 8/NBITS float values of each possible byte.  src must point at the byte holding
+// the first sample; nsamp samples per band are written to dest[b][destoffset...].
+typedef void (*fusedbytefn)(const u8 *src, const f32 *lut, int nsamp, f32 **dest, int destoffset);
+
+template <int NBITS, int NBANDS>
+inline void fusedByteUnpack(const u8 *src, const f32 *lut, int nsamp, f32 **dest, int destoffset)
+{
+  const int SAMPLESPERBYTE = 8/NBITS;
+  f32 * d[NBANDS];
+  const f32 * fp;
+
+  for(int b=0;b<NBANDS;b++)
+    d[b] = dest[b] + destoffset;
+
+  if(NBANDS*NBITS >= 8)
+  {
+    //one or more whole bytes per time sample
+    const int BYTESPERSAMPLE = (NBANDS*NBITS >= 8)?NBANDS*NBITS/8:1;
+    for(int t=0;t<nsamp;t++)
+    {
+      for(int j=0;j<BYTESPERSAMPLE;j++)
+      {
+        fp = lut + src[j]*SAMPLESPERBYTE;
+        for(int k=0;k<SAMPLESPERBYTE;k++)
+          d[j*SAMPLESPERBYTE + k][t] = fp[k];
+      }
+      src += BYTESPERSAMPLE;
+    }
+  }
+  else
+  {
+    //several time samples per byte
+    const int TIMESPERBYTE = (NBANDS*NBITS < 8)?8/(NBANDS*NBITS):1;
+    int t = 0;
+    for(;t+TIMESPERBYTE<=nsamp;t+=TIMESPERBYTE)
+    {
+      fp = lut + (*src++)*SAMPLESPERBYTE;
+      for(int k=0;k<TIMESPERBYTE;k++)
+      {
+        for(int b=0;b<NBANDS;b++)
+          d[b][t+k] = fp[k*NBANDS + b];
+      }
+    }
+    if(t < nsamp)
+    {
+      fp = lut + (*src)*SAMPLESPERBYTE;
+      for(int k=0;t+k<nsamp;k++)
+      {
+        for(int b=0;b<NBANDS;b++)
+          d[b][t+k] = fp[k*NBANDS + b];
+      }
+    }
+  }
+}
+
+inline fusedbytefn selectFusedByteUnpacker(int nbits, int nbands)
+{
+  switch(nbits*100 + nbands)
+  {
+    case 201: return fusedByteUnpack<2,1>;
+    case 202: return fusedByteUnpack<2,2>;
+    case 204: return fusedByteUnpack<2,4>;
+    case 208: return fusedByteUnpack<2,8>;
+    case 216: return fusedByteUnpack<2,16>;
+    case 401: return fusedByteUnpack<4,1>;
+    case 402: return fusedByteUnpack<4,2>;
+    case 404: return fusedByteUnpack<4,4>;
+    case 408: return fusedByteUnpack<4,8>;
+    case 416: return fusedByteUnpack<4,16>;
+    case 801: return fusedByteUnpack<8,1>;
+    case 802: return fusedByteUnpack<8,2>;
+    case 804: return fusedByteUnpack<8,4>;
+    case 808: return fusedByteUnpack<8,8>;
+    case 816: return fusedByteUnpack<8,16>;
+    default: return 0;
+  }
+}
+
+#endif
+// vim: shiftwidth=2:softtabstop=2:expandtab
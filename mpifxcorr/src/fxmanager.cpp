@@ -152,7 +152,8 @@ FxManager::FxManager(Configuration * conf, int ncores, int * dids, int * cids, i
     corecounts[i] = 0;
     recentcorecounts[i] = 0;
   }
-  coretimes = new int**[Core::RECEIVE_RING_LENGTH];
+  coreringlength = config->getCoreRingLength();
+  coretimes = new int**[coreringlength];
   numsent = new int[numcores];
   extrareceived = new int[numcores];
   for(int i=0;i<numcores;i++)
@@ -161,7 +162,7 @@ FxManager::FxManager(Configuration * conf, int ncores, int * dids, int * cids, i
     extrareceived[i] = 0;
     coreids[i] = cids[i];
   }
-  for(int i=0;i<Core::RECEIVE_RING_LENGTH;i++)
+  for(int i=0;i<coreringlength;i++)
   {
     coretimes[i] = new int*[numcores];
     for(int j=0;j<numcores;j++)
@@ -244,7 +245,7 @@ FxManager::FxManager(Configuration * conf, int ncores, int * dids, int * cids, i
 
 FxManager::~FxManager()
 {
-  for(int i=0;i<Core::RECEIVE_RING_LENGTH;i++)
+  for(int i=0;i<coreringlength;i++)
   {
     for(int j=0;j<numcores;j++)
       delete [] coretimes[i][j];
@@ -333,7 +334,7 @@ void FxManager::execute()
         if((1000000000-senddata[3]) <= nsincrement/2)
           break;
       }
-      if(sendcount < Core::RECEIVE_RING_LENGTH*numcores) {//still in the "filling up" phase
+      if(sendcount < coreringlength*numcores) {//still in the "filling up" phase
         senddata[0] = coreids[((int)sendcount)%numcores];
         sendData(senddata, ((int)sendcount)%numcores);
       }
@@ -341,7 +342,7 @@ void FxManager::execute()
         receiveData(true);
       }
       sendcount++;
-      if(sendcount == Core::RECEIVE_RING_LENGTH*numcores) //just finished "filling up"
+      if(sendcount == coreringlength*numcores) //just finished "filling up"
         signal(SIGINT, &interrupthandler);
       if(!visibilityconfigok) { //problem with finding a polyco, probably
         cfatal << startl << "Manager aborting correlation due to visibility configuration problem!" << endl;
@@ -358,7 +359,7 @@ void FxManager::execute()
   terminate();
   
   //receive the final data from each core
-  for(int i=0;i<Core::RECEIVE_RING_LENGTH;i++)
+  for(int i=0;i<coreringlength;i++)
   {
     for(int j=0;j<numcores;j++) {
       if(sendcount==0)
@@ -409,9 +410,9 @@ void FxManager::sendData(int data[], int coreindex)
     //send the commands to the Datastreams
     MPI_Ssend(data, 4, MPI_INT, datastreamids[j], DS_PROCESS, MPI_COMM_WORLD);
   }
-  coretimes[numsent[coreindex]%Core::RECEIVE_RING_LENGTH][coreindex][0] = data[1];
-  coretimes[numsent[coreindex]%Core::RECEIVE_RING_LENGTH][coreindex][1] = data[2];
-  coretimes[numsent[coreindex]%Core::RECEIVE_RING_LENGTH][coreindex][2] = data[3];
+  coretimes[numsent[coreindex]%coreringlength][coreindex][0] = data[1];
+  coretimes[numsent[coreindex]%coreringlength][coreindex][1] = data[2];
+  coretimes[numsent[coreindex]%coreringlength][coreindex][2] = data[3];
   numsent[coreindex]++;
   data[3] += (nsincrement%1000000000);
   data[2] += (nsincrement/1000000000);
@@ -465,8 +466,8 @@ void FxManager::receiveData(bool resend)
 
   corecounts[sourceid]++;
   recentcorecounts[sourceid]++;
-  infoindex = (numsent[sourceid]+extrareceived[sourceid])%Core::RECEIVE_RING_LENGTH;
-  if(numsent[sourceid] < Core::RECEIVE_RING_LENGTH)
+  infoindex = (numsent[sourceid]+extrareceived[sourceid])%coreringlength;
+  if(numsent[sourceid] < coreringlength)
     infoindex = extrareceived[sourceid];
   subintscan = coretimes[infoindex][sourceid][0];
   scantime = coretimes[infoindex][sourceid][1] + coretimes[infoindex][sourceid][2]/1000000000.0;
@@ -613,7 +614,7 @@ void FxManager::initialiseOutput()
       maxphasecentres = config->getMaxPhaseCentres(i);
   }
 
-  if(config->getOutputFormat() == Configuration::DIFX)
+  if(config->getOutputFormat() == Configuration::DIFX || config->getOutputFormat() == Configuration::DIFXINDEXED)
   {
     //create the directory if it does not exist
     if(opendir(config->getOutputFilename().c_str()) == NULL)
@@ -634,7 +635,10 @@ void FxManager::initialiseOutput()
     {
       for(int b=0;b<maxbinfiles;b++)
       {
-        sprintf(filename, "%s/DIFX_%05d_%06d.s%04d.b%04d", config->getOutputFilename().c_str(), config->getStartMJD(), config->getStartSeconds(), s, b);
+        if(config->getOutputFormat() == Configuration::DIFXINDEXED)
+          sprintf(filename, "%s/DIFXI_%05d_%06d.s%04d.b%04d", config->getOutputFilename().c_str(), config->getStartMJD(), config->getStartSeconds(), s, b);
+        else
+          sprintf(filename, "%s/DIFX_%05d_%06d.s%04d.b%04d", config->getOutputFilename().c_str(), config->getStartMJD(), config->getStartSeconds(), s, b);
         ifstream testfile(filename);
         if (testfile) {
           cfatal << startl << "Output DIFX file " << filename << " already exists.  ABORTING!" << endl;
@@ -643,6 +647,13 @@ void FxManager::initialiseOutput()
         else {
           output.open(filename, ios::trunc);
           output.close();
+          //the index of an indexed file starts out empty too; the file header is added with the first integration
+          if(config->getOutputFormat() == Configuration::DIFXINDEXED)
+          {
+            strcat(filename, ".idx");
+            output.open(filename, ios::trunc);
+            output.close();
+          }
         }
       }
     }
@@ -712,8 +723,8 @@ int FxManager::locateVisIndex(int coreid)
   Visibility * vis;
 
   vblength = config->getVisBufferLength();
-  infoindex = (numsent[coreid]+extrareceived[coreid]) % Core::RECEIVE_RING_LENGTH;
-  if(numsent[coreid] < Core::RECEIVE_RING_LENGTH)
+  infoindex = (numsent[coreid]+extrareceived[coreid]) % coreringlength;
+  if(numsent[coreid] < coreringlength)
     infoindex = extrareceived[coreid];
 
   corescan = coretimes[infoindex][coreid][0];
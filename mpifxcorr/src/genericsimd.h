@@ -0,0 +1,573 @@
+/***************************************************************************
+ *   Copyright (C) 2006-2020 by Adam Deller                                *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+// Hand vectorised versions of the hottest generic (non-IPP) vector routines.
+// Only included by architecture.h when ARCH == GENERIC.  The SSE2, AVX2 and
+// AVX-512 kernels are compiled with per-function target attributes, so no
+// special compiler flags are needed; the best set supported by the CPU is
+// chosen on first use.  Setting the environment variable DIFX_GENERIC_SIMD
+// to one of "scalar", "sse2", "avx2" or "avx512" caps the level that is used.
+//
+// The complex multiply and split/scale kernels follow the operation order of
+// the scalar generic* routines in single precision, with FMA contraction
+// switched off, and test/genericsimd_test.cpp requires them to match such a
+// reference exactly.  Builds that allow FMAs (e.g. -march=native) may fuse the
+// scalar routines, which can then differ by an ulp or two.  The sin/cos kernel
+// uses a Cephes-style polynomial (accurate to a few ulp for |x| < 8192);
+// vectors containing larger arguments fall back to sinf/cosf.
+
+#ifndef GENERICSIMD_H
+#define GENERICSIMD_H
+
+#include <stdlib.h>
+#include <string.h>
+
+enum genericSimdLevel {GENERICSIMD_SCALAR=0, GENERICSIMD_SSE2, GENERICSIMD_AVX2, GENERICSIMD_AVX512};
+
+typedef vecStatus (*genericAddProduct_32fc_fn)(const cf32 *, const cf32 *, cf32 *, int);
+typedef vecStatus (*genericMul_32fc_fn)(const cf32 *, const cf32 *, cf32 *, int);
+typedef vecStatus (*genericMul_32fc_I_fn)(const cf32 *, cf32 *, int);
+typedef vecStatus (*genericSinCos_32f_fn)(const f32 *, f32 *, f32 *, int);
+typedef vecStatus (*genericSplitScaled_16s32f_fn)(const s16 *, f32 **, int, int);
+
+typedef struct {
+  genericSimdLevel level;
+  genericAddProduct_32fc_fn addProduct_32fc;
+  genericMul_32fc_fn mul_32fc;
+  genericMul_32fc_I_fn mul_32fc_I;
+  genericSinCos_32f_fn sinCos_32f;
+  genericSplitScaled_16s32f_fn splitScaled_16s32f;
+} genericSimdKernels;
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define GENERICSIMD_X86 1
+#include <immintrin.h>
+
+#define GENERICSIMD_TARGET_SSE2   __attribute__((target("sse2")))
+#define GENERICSIMD_TARGET_AVX2   __attribute__((target("avx2")))
+#define GENERICSIMD_TARGET_AVX512 __attribute__((target("avx512f")))
+
+// AVX-512 implies FMA, and GCC would otherwise fuse the multiplies and adds of
+// both the intrinsics and the scalar tails below, changing the rounding
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#else
+#pragma GCC push_options
+#pragma GCC optimize ("fp-contract=off")
+#endif
+
+// Cephes single precision sin/cos constants
+#define GENERICSIMD_FOPI      1.27323954473516f
+#define GENERICSIMD_DP1       0.78515625f
+#define GENERICSIMD_DP2       2.4187564849853515625e-4f
+#define GENERICSIMD_DP3       3.77489497744594108e-8f
+#define GENERICSIMD_SINCOF_P0 -1.9515295891e-4f
+#define GENERICSIMD_SINCOF_P1 8.3321608736e-3f
+#define GENERICSIMD_SINCOF_P2 -1.6666654611e-1f
+#define GENERICSIMD_COSCOF_P0 2.443315711809948e-5f
+#define GENERICSIMD_COSCOF_P1 -1.388731625493765e-3f
+#define GENERICSIMD_COSCOF_P2 4.166664568298827e-2f
+#define GENERICSIMD_SINCOS_MAXARG 8192.0f
+
+/******************************** SSE2 ********************************/
+
+// [ar ai] * [br bi] for two complex values, with the same rounding as the scalar code
+GENERICSIMD_TARGET_SSE2 inline __m128 genericSimdCMul_sse2(__m128 a, __m128 b)
+{
+  const __m128 negre = _mm_castsi128_ps(_mm_set_epi32(0, (int)0x80000000, 0, (int)0x80000000));
+  __m128 bre = _mm_shuffle_ps(b, b, _MM_SHUFFLE(2,2,0,0));
+  __m128 bim = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3,3,1,1));
+  __m128 aswap = _mm_shuffle_ps(a, a, _MM_SHUFFLE(2,3,0,1));
+  __m128 t1 = _mm_mul_ps(a, bre);
+  __m128 t2 = _mm_xor_ps(_mm_mul_ps(aswap, bim), negre);
+  return _mm_add_ps(t1, t2);
+}
+
+GENERICSIMD_TARGET_SSE2 inline vecStatus genericSimdAddProduct_32fc_sse2(const cf32 *src1, const cf32 *src2, cf32 *accumulator, int length)
+{
+  int i;
+  for(i=0;i+2<=length;i+=2)
+  {
+    __m128 a = _mm_loadu_ps((const float *)(src1 + i));
+    __m128 b = _mm_loadu_ps((const float *)(src2 + i));
+    __m128 acc = _mm_loadu_ps((const float *)(accumulator + i));
+    _mm_storeu_ps((float *)(accumulator + i), _mm_add_ps(acc, genericSimdCMul_sse2(a, b)));
+  }
+  return genericAddProduct_32fc(src1 + i, src2 + i, accumulator + i, length - i);
+}
+
+GENERICSIMD_TARGET_SSE2 inline vecStatus genericSimdMul_32fc_sse2(const cf32 *src1, const cf32 *src2, cf32 *dest, int length)
+{
+  int i;
+  for(i=0;i+2<=length;i+=2)
+  {
+    __m128 a = _mm_loadu_ps((const float *)(src1 + i));
+    __m128 b = _mm_loadu_ps((const float *)(src2 + i));
+    _mm_storeu_ps((float *)(dest + i), genericSimdCMul_sse2(a, b));
+  }
+  return genericMul_32fc(src1 + i, src2 + i, dest + i, length - i);
+}
+
+GENERICSIMD_TARGET_SSE2 inline vecStatus genericSimdMul_32fc_I_sse2(const cf32 *src, cf32 *srcdest, int length)
+{
+  int i;
+  for(i=0;i+2<=length;i+=2)
+  {
+    __m128 a = _mm_loadu_ps((const float *)(srcdest + i));
+    __m128 b = _mm_loadu_ps((const float *)(src + i));
+    _mm_storeu_ps((float *)(srcdest + i), genericSimdCMul_sse2(a, b));
+  }
+  return genericMul_32fc_I(src + i, srcdest + i, length - i);
+}
+
+GENERICSIMD_TARGET_SSE2 inline vecStatus genericSimdSinCos_32f_sse2(const f32 *src, f32 *sin, f32 *cos, int length)
+{
+  const __m128 signmask = _mm_castsi128_ps(_mm_set1_epi32((int)0x80000000));
+  int i;
+  for(i=0;i+4<=length;i+=4)
+  {
+    __m128 x = _mm_loadu_ps(src + i);
+    __m128 signsin = _mm_and_ps(x, signmask);
+    x = _mm_andnot_ps(signmask, x);
+    if(_mm_movemask_ps(_mm_cmpgt_ps(x, _mm_set1_ps(GENERICSIMD_SINCOS_MAXARG))) != 0)
+    {
+      genericSinCos_32f(src + i, sin + i, cos + i, 4);
+      continue;
+    }
+    __m128i j = _mm_cvttps_epi32(_mm_mul_ps(x, _mm_set1_ps(GENERICSIMD_FOPI)));
+    j = _mm_and_si128(_mm_add_epi32(j, _mm_set1_epi32(1)), _mm_set1_epi32(~1));
+    __m128 y = _mm_cvtepi32_ps(j);
+    __m128 polymask = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(j, _mm_set1_epi32(2)), _mm_setzero_si128()));
+    signsin = _mm_xor_ps(signsin, _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(j, _mm_set1_epi32(4)), 29)));
+    __m128 signcos = _mm_castsi128_ps(_mm_slli_epi32(_mm_andnot_si128(_mm_sub_epi32(j, _mm_set1_epi32(2)), _mm_set1_epi32(4)), 29));
+    x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(GENERICSIMD_DP1)));
+    x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(GENERICSIMD_DP2)));
+    x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(GENERICSIMD_DP3)));
+    __m128 z = _mm_mul_ps(x, x);
+    __m128 yc = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(GENERICSIMD_COSCOF_P0), z), _mm_set1_ps(GENERICSIMD_COSCOF_P1));
+    yc = _mm_add_ps(_mm_mul_ps(yc, z), _mm_set1_ps(GENERICSIMD_COSCOF_P2));
+    yc = _mm_mul_ps(_mm_mul_ps(yc, z), z);
+    yc = _mm_add_ps(_mm_sub_ps(yc, _mm_mul_ps(z, _mm_set1_ps(0.5f))), _mm_set1_ps(1.0f));
+    __m128 ys = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(GENERICSIMD_SINCOF_P0), z), _mm_set1_ps(GENERICSIMD_SINCOF_P1));
+    ys = _mm_add_ps(_mm_mul_ps(ys, z), _mm_set1_ps(GENERICSIMD_SINCOF_P2));
+    ys = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(ys, z), x), x);
+    __m128 s = _mm_or_ps(_mm_and_ps(polymask, ys), _mm_andnot_ps(polymask, yc));
+    __m128 c = _mm_or_ps(_mm_and_ps(polymask, yc), _mm_andnot_ps(polymask, ys));
+    _mm_storeu_ps(sin + i, _mm_xor_ps(s, signsin));
+    _mm_storeu_ps(cos + i, _mm_xor_ps(c, signcos));
+  }
+  return genericSinCos_32f(src + i, sin + i, cos + i, length - i);
+}
+
+GENERICSIMD_TARGET_SSE2 inline vecStatus genericSimdSplitScaled_16s32f_sse2(const s16 *src, f32 **dest, int numchannels, int chanlen)
+{
+  f32 scale1 = 2.0/((f32)MAX_S16-(f32)MIN_S16);
+  const __m128 offset = _mm_set1_ps((f32)MIN_S16);
+  const __m128 scale = _mm_set1_ps(scale1);
+  const __m128 minusone = _mm_set1_ps(-1.0f);
+  int n = 0;
+
+  if(numchannels == 1)
+  {
+    for(;n+8<=chanlen;n+=8)
+    {
+      __m128i v = _mm_loadu_si128((const __m128i *)(src + n));
+      __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+      __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+      _mm_storeu_ps(dest[0] + n,     _mm_add_ps(minusone, _mm_mul_ps(scale, _mm_sub_ps(_mm_cvtepi32_ps(lo), offset))));
+      _mm_storeu_ps(dest[0] + n + 4, _mm_add_ps(minusone, _mm_mul_ps(scale, _mm_sub_ps(_mm_cvtepi32_ps(hi), offset))));
+    }
+  }
+  else if(numchannels == 2)
+  {
+    for(;n+4<=chanlen;n+=4)
+    {
+      __m128i v = _mm_loadu_si128((const __m128i *)(src + 2*n));
+      __m128i c0 = _mm_srai_epi32(_mm_slli_epi32(v, 16), 16);
+      __m128i c1 = _mm_srai_epi32(v, 16);
+      _mm_storeu_ps(dest[0] + n, _mm_add_ps(minusone, _mm_mul_ps(scale, _mm_sub_ps(_mm_cvtepi32_ps(c0), offset))));
+      _mm_storeu_ps(dest[1] + n, _mm_add_ps(minusone, _mm_mul_ps(scale, _mm_sub_ps(_mm_cvtepi32_ps(c1), offset))));
+    }
+  }
+  for(;n<chanlen;n++)
+    for(int m=0;m<numchannels;m++)
+      dest[m][n] = -1.0+scale1*((f32)src[n*numchannels+m]-(f32)MIN_S16);
+  return vecNoErr;
+}
+
+/******************************** AVX2 ********************************/
+
+GENERICSIMD_TARGET_AVX2 inline __m256 genericSimdCMul_avx2(__m256 a, __m256 b)
+{
+  __m256 bre = _mm256_moveldup_ps(b);
+  __m256 bim = _mm256_movehdup_ps(b);
+  __m256 aswap = _mm256_shuffle_ps(a, a, _MM_SHUFFLE(2,3,0,1));
+  return _mm256_addsub_ps(_mm256_mul_ps(a, bre), _mm256_mul_ps(aswap, bim));
+}
+
+GENERICSIMD_TARGET_AVX2 inline vecStatus genericSimdAddProduct_32fc_avx2(const cf32 *src1, const cf32 *src2, cf32 *accumulator, int length)
+{
+  int i;
+  for(i=0;i+4<=length;i+=4)
+  {
+    __m256 a = _mm256_loadu_ps((const float *)(src1 + i));
+    __m256 b = _mm256_loadu_ps((const float *)(src2 + i));
+    __m256 acc = _mm256_loadu_ps((const float *)(accumulator + i));
+    _mm256_storeu_ps((float *)(accumulator + i), _mm256_add_ps(acc, genericSimdCMul_avx2(a, b)));
+  }
+  return genericAddProduct_32fc(src1 + i, src2 + i, accumulator + i, length - i);
+}
+
+GENERICSIMD_TARGET_AVX2 inline vecStatus genericSimdMul_32fc_avx2(const cf32 *src1, const cf32 *src2, cf32 *dest, int length)
+{
+  int i;
+  for(i=0;i+4<=length;i+=4)
+  {
+    __m256 a = _mm256_loadu_ps((const float *)(src1 + i));
+    __m256 b = _mm256_loadu_ps((const float *)(src2 + i));
+    _mm256_storeu_ps((float *)(dest + i), genericSimdCMul_avx2(a, b));
+  }
+  return genericMul_32fc(src1 + i, src2 + i, dest + i, length - i);
+}
+
+GENERICSIMD_TARGET_AVX2 inline vecStatus genericSimdMul_32fc_I_avx2(const cf32 *src, cf32 *srcdest, int length)
+{
+  int i;
+  for(i=0;i+4<=length;i+=4)
+  {
+    __m256 a = _mm256_loadu_ps((const float *)(srcdest + i));
+    __m256 b = _mm256_loadu_ps((const float *)(src + i));
+    _mm256_storeu_ps((float *)(srcdest + i), genericSimdCMul_avx2(a, b));
+  }
+  return genericMul_32fc_I(src + i, srcdest + i, length - i);
+}
+
+GENERICSIMD_TARGET_AVX2 inline vecStatus genericSimdSinCos_32f_avx2(const f32 *src, f32 *sin, f32 *cos, int length)
+{
+  const __m256 signmask = _mm256_castsi256_ps(_mm256_set1_epi32((int)0x80000000));
+  int i;
+  for(i=0;i+8<=length;i+=8)
+  {
+    __m256 x = _mm256_loadu_ps(src + i);
+    __m256 signsin = _mm256_and_ps(x, signmask);
+    x = _mm256_andnot_ps(signmask, x);
+    if(_mm256_movemask_ps(_mm256_cmp_ps(x, _mm256_set1_ps(GENERICSIMD_SINCOS_MAXARG), _CMP_GT_OQ)) != 0)
+    {
+      genericSinCos_32f(src + i, sin + i, cos + i, 8);
+      continue;
+    }
+    __m256i j = _mm256_cvttps_epi32(_mm256_mul_ps(x, _mm256_set1_ps(GENERICSIMD_FOPI)));
+    j = _mm256_and_si256(_mm256_add_epi32(j, _mm256_set1_epi32(1)), _mm256_set1_epi32(~1));
+    __m256 y = _mm256_cvtepi32_ps(j);
+    __m256 polymask = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(j, _mm256_set1_epi32(2)), _mm256_setzero_si256()));
+    signsin = _mm256_xor_ps(signsin, _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(j, _mm256_set1_epi32(4)), 29)));
+    __m256 signcos = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_andnot_si256(_mm256_sub_epi32(j, _mm256_set1_epi32(2)), _mm256_set1_epi32(4)), 29));
+    x = _mm256_sub_ps(x, _mm256_mul_ps(y, _mm256_set1_ps(GENERICSIMD_DP1)));
+    x = _mm256_sub_ps(x, _mm256_mul_ps(y, _mm256_set1_ps(GENERICSIMD_DP2)));
+    x = _mm256_sub_ps(x, _mm256_mul_ps(y, _mm256_set1_ps(GENERICSIMD_DP3)));
+    __m256 z = _mm256_mul_ps(x, x);
+    __m256 yc = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(GENERICSIMD_COSCOF_P0), z), _mm256_set1_ps(GENERICSIMD_COSCOF_P1));
+    yc = _mm256_add_ps(_mm256_mul_ps(yc, z), _mm256_set1_ps(GENERICSIMD_COSCOF_P2));
+    yc = _mm256_mul_ps(_mm256_mul_ps(yc, z), z);
+    yc = _mm256_add_ps(_mm256_sub_ps(yc, _mm256_mul_ps(z, _mm256_set1_ps(0.5f))), _mm256_set1_ps(1.0f));
+    __m256 ys = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(GENERICSIMD_SINCOF_P0), z), _mm256_set1_ps(GENERICSIMD_SINCOF_P1));
+    ys = _mm256_add_ps(_mm256_mul_ps(ys, z), _mm256_set1_ps(GENERICSIMD_SINCOF_P2));
+    ys = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(ys, z), x), x);
+    __m256 s = _mm256_blendv_ps(yc, ys, polymask);
+    __m256 c = _mm256_blendv_ps(ys, yc, polymask);
+    _mm256_storeu_ps(sin + i, _mm256_xor_ps(s, signsin));
+    _mm256_storeu_ps(cos + i, _mm256_xor_ps(c, signcos));
+  }
+  return genericSimdSinCos_32f_sse2(src + i, sin + i, cos + i, length - i);
+}
+
+GENERICSIMD_TARGET_AVX2 inline vecStatus genericSimdSplitScaled_16s32f_avx2(const s16 *src, f32 **dest, int numchannels, int chanlen)
+{
+  f32 scale1 = 2.0/((f32)MAX_S16-(f32)MIN_S16);
+  const __m256 offset = _mm256_set1_ps((f32)MIN_S16);
+  const __m256 scale = _mm256_set1_ps(scale1);
+  const __m256 minusone = _mm256_set1_ps(-1.0f);
+  int n = 0;
+
+  if(numchannels == 1)
+  {
+    for(;n+8<=chanlen;n+=8)
+    {
+      __m256i v = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(src + n)));
+      _mm256_storeu_ps(dest[0] + n, _mm256_add_ps(minusone, _mm256_mul_ps(scale, _mm256_sub_ps(_mm256_cvtepi32_ps(v), offset))));
+    }
+  }
+  else if(numchannels == 2)
+  {
+    for(;n+8<=chanlen;n+=8)
+    {
+      __m256i v = _mm256_loadu_si256((const __m256i *)(src + 2*n));
+      __m256i c0 = _mm256_srai_epi32(_mm256_slli_epi32(v, 16), 16);
+      __m256i c1 = _mm256_srai_epi32(v, 16);
+      _mm256_storeu_ps(dest[0] + n, _mm256_add_ps(minusone, _mm256_mul_ps(scale, _mm256_sub_ps(_mm256_cvtepi32_ps(c0), offset))));
+      _mm256_storeu_ps(dest[1] + n, _mm256_add_ps(minusone, _mm256_mul_ps(scale, _mm256_sub_ps(_mm256_cvtepi32_ps(c1), offset))));
+    }
+  }
+  for(;n<chanlen;n++)
+    for(int m=0;m<numchannels;m++)
+      dest[m][n] = -1.0+scale1*((f32)src[n*numchannels+m]-(f32)MIN_S16);
+  return vecNoErr;
+}
+
+/******************************* AVX-512 *******************************/
+
+// GCC 12 gives spurious "may be used uninitialized" warnings from inside avx512fintrin.h
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+GENERICSIMD_TARGET_AVX512 inline __m512 genericSimdCMul_avx512(__m512 a, __m512 b)
+{
+  __m512 bre = _mm512_moveldup_ps(b);
+  __m512 bim = _mm512_movehdup_ps(b);
+  __m512 aswap = _mm512_shuffle_ps(a, a, _MM_SHUFFLE(2,3,0,1));
+  __m512 t1 = _mm512_mul_ps(a, bre);
+  __m512 t2 = _mm512_mul_ps(aswap, bim);
+  // subtract in the real (even) lanes, add in the imaginary (odd) lanes
+  return _mm512_mask_sub_ps(_mm512_add_ps(t1, t2), (__mmask16)0x5555, t1, t2);
+}
+
+GENERICSIMD_TARGET_AVX512 inline vecStatus genericSimdAddProduct_32fc_avx512(const cf32 *src1, const cf32 *src2, cf32 *accumulator, int length)
+{
+  int i;
+  for(i=0;i+8<=length;i+=8)
+  {
+    __m512 a = _mm512_loadu_ps((const float *)(src1 + i));
+    __m512 b = _mm512_loadu_ps((const float *)(src2 + i));
+    __m512 acc = _mm512_loadu_ps((const float *)(accumulator + i));
+    _mm512_storeu_ps((float *)(accumulator + i), _mm512_add_ps(acc, genericSimdCMul_avx512(a, b)));
+  }
+  return genericSimdAddProduct_32fc_avx2(src1 + i, src2 + i, accumulator + i, length - i);
+}
+
+GENERICSIMD_TARGET_AVX512 inline vecStatus genericSimdMul_32fc_avx512(const cf32 *src1, const cf32 *src2, cf32 *dest, int length)
+{
+  int i;
+  for(i=0;i+8<=length;i+=8)
+  {
+    __m512 a = _mm512_loadu_ps((const float *)(src1 + i));
+    __m512 b = _mm512_loadu_ps((const float *)(src2 + i));
+    _mm512_storeu_ps((float *)(dest + i), genericSimdCMul_avx512(a, b));
+  }
+  return genericSimdMul_32fc_avx2(src1 + i, src2 + i, dest + i, length - i);
+}
+
+GENERICSIMD_TARGET_AVX512 inline vecStatus genericSimdMul_32fc_I_avx512(const cf32 *src, cf32 *srcdest, int length)
+{
+  int i;
+  for(i=0;i+8<=length;i+=8)
+  {
+    __m512 a = _mm512_loadu_ps((const float *)(srcdest + i));
+    __m512 b = _mm512_loadu_ps((const float *)(src + i));
+    _mm512_storeu_ps((float *)(srcdest + i), genericSimdCMul_avx512(a, b));
+  }
+  return genericSimdMul_32fc_I_avx2(src + i, srcdest + i, length - i);
+}
+
+GENERICSIMD_TARGET_AVX512 inline vecStatus genericSimdSinCos_32f_avx512(const f32 *src, f32 *sin, f32 *cos, int length)
+{
+  const __m512i signmask = _mm512_set1_epi32((int)0x80000000);
+  int i;
+  for(i=0;i+16<=length;i+=16)
+  {
+    __m512i xi = _mm512_castps_si512(_mm512_loadu_ps(src + i));
+    __m512i signsin = _mm512_and_si512(xi, signmask);
+    __m512 x = _mm512_castsi512_ps(_mm512_andnot_si512(signmask, xi));
+    if(_mm512_cmp_ps_mask(x, _mm512_set1_ps(GENERICSIMD_SINCOS_MAXARG), _CMP_GT_OQ) != 0)
+    {
+      genericSinCos_32f(src + i, sin + i, cos + i, 16);
+      continue;
+    }
+    __m512i j = _mm512_cvttps_epi32(_mm512_mul_ps(x, _mm512_set1_ps(GENERICSIMD_FOPI)));
+    j = _mm512_and_si512(_mm512_add_epi32(j, _mm512_set1_epi32(1)), _mm512_set1_epi32(~1));
+    __m512 y = _mm512_cvtepi32_ps(j);
+    __mmask16 polymask = _mm512_cmpeq_epi32_mask(_mm512_and_si512(j, _mm512_set1_epi32(2)), _mm512_setzero_si512());
+    signsin = _mm512_xor_si512(signsin, _mm512_slli_epi32(_mm512_and_si512(j, _mm512_set1_epi32(4)), 29));
+    __m512i signcos = _mm512_slli_epi32(_mm512_andnot_si512(_mm512_sub_epi32(j, _mm512_set1_epi32(2)), _mm512_set1_epi32(4)), 29);
+    x = _mm512_sub_ps(x, _mm512_mul_ps(y, _mm512_set1_ps(GENERICSIMD_DP1)));
+    x = _mm512_sub_ps(x, _mm512_mul_ps(y, _mm512_set1_ps(GENERICSIMD_DP2)));
+    x = _mm512_sub_ps(x, _mm512_mul_ps(y, _mm512_set1_ps(GENERICSIMD_DP3)));
+    __m512 z = _mm512_mul_ps(x, x);
+    __m512 yc = _mm512_add_ps(_mm512_mul_ps(_mm512_set1_ps(GENERICSIMD_COSCOF_P0), z), _mm512_set1_ps(GENERICSIMD_COSCOF_P1));
+    yc = _mm512_add_ps(_mm512_mul_ps(yc, z), _mm512_set1_ps(GENERICSIMD_COSCOF_P2));
+    yc = _mm512_mul_ps(_mm512_mul_ps(yc, z), z);
+    yc = _mm512_add_ps(_mm512_sub_ps(yc, _mm512_mul_ps(z, _mm512_set1_ps(0.5f))), _mm512_set1_ps(1.0f));
+    __m512 ys = _mm512_add_ps(_mm512_mul_ps(_mm512_set1_ps(GENERICSIMD_SINCOF_P0), z), _mm512_set1_ps(GENERICSIMD_SINCOF_P1));
+    ys = _mm512_add_ps(_mm512_mul_ps(ys, z), _mm512_set1_ps(GENERICSIMD_SINCOF_P2));
+    ys = _mm512_add_ps(_mm512_mul_ps(_mm512_mul_ps(ys, z), x), x);
+    __m512 s = _mm512_mask_blend_ps(polymask, yc, ys);
+    __m512 c = _mm512_mask_blend_ps(polymask, ys, yc);
+    _mm512_storeu_ps(sin + i, _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(s), signsin)));
+    _mm512_storeu_ps(cos + i, _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(c), signcos)));
+  }
+  return genericSimdSinCos_32f_avx2(src + i, sin + i, cos + i, length - i);
+}
+
+GENERICSIMD_TARGET_AVX512 inline vecStatus genericSimdSplitScaled_16s32f_avx512(const s16 *src, f32 **dest, int numchannels, int chanlen)
+{
+  f32 scale1 = 2.0/((f32)MAX_S16-(f32)MIN_S16);
+  const __m512 offset = _mm512_set1_ps((f32)MIN_S16);
+  const __m512 scale = _mm512_set1_ps(scale1);
+  const __m512 minusone = _mm512_set1_ps(-1.0f);
+  int n = 0;
+
+  if(numchannels == 1)
+  {
+    for(;n+16<=chanlen;n+=16)
+    {
+      __m512i v = _mm512_cvtepi16_epi32(_mm256_loadu_si256((const __m256i *)(src + n)));
+      _mm512_storeu_ps(dest[0] + n, _mm512_add_ps(minusone, _mm512_mul_ps(scale, _mm512_sub_ps(_mm512_cvtepi32_ps(v), offset))));
+    }
+  }
+  else if(numchannels == 2)
+  {
+    for(;n+16<=chanlen;n+=16)
+    {
+      __m512i v = _mm512_loadu_si512((const void *)(src + 2*n));
+      __m512i c0 = _mm512_srai_epi32(_mm512_slli_epi32(v, 16), 16);
+      __m512i c1 = _mm512_srai_epi32(v, 16);
+      _mm512_storeu_ps(dest[0] + n, _mm512_add_ps(minusone, _mm512_mul_ps(scale, _mm512_sub_ps(_mm512_cvtepi32_ps(c0), offset))));
+      _mm512_storeu_ps(dest[1] + n, _mm512_add_ps(minusone, _mm512_mul_ps(scale, _mm512_sub_ps(_mm512_cvtepi32_ps(c1), offset))));
+    }
+  }
+  for(;n<chanlen;n++)
+    for(int m=0;m<numchannels;m++)
+      dest[m][n] = -1.0+scale1*((f32)src[n*numchannels+m]-(f32)MIN_S16);
+  return vecNoErr;
+}
+
+#pragma GCC diagnostic pop
+
+#if !defined(__clang__)
+#pragma GCC pop_options
+#endif
+
+#endif /* x86 with GCC-compatible compiler */
+
+/************************* Detection and dispatch *************************/
+
+// Highest level supported by this CPU (and build), before any user cap
+inline genericSimdLevel genericSimdDetectLevel()
+{
+#ifdef GENERICSIMD_X86
+  __builtin_cpu_init();
+  if(__builtin_cpu_supports("avx512f"))
+    return GENERICSIMD_AVX512;
+  if(__builtin_cpu_supports("avx2"))
+    return GENERICSIMD_AVX2;
+  if(__builtin_cpu_supports("sse2"))
+    return GENERICSIMD_SSE2;
+#endif
+  return GENERICSIMD_SCALAR;
+}
+
+inline const char * genericSimdLevelName(genericSimdLevel level)
+{
+  switch(level)
+  {
+    case GENERICSIMD_SSE2:   return "sse2";
+    case GENERICSIMD_AVX2:   return "avx2";
+    case GENERICSIMD_AVX512: return "avx512";
+    default:                 return "scalar";
+  }
+}
+
+// Fill in the kernel table for a given level; the level must not exceed genericSimdDetectLevel()
+inline genericSimdKernels genericSimdSelectKernels(genericSimdLevel level)
+{
+  genericSimdKernels k;
+
+  k.level = GENERICSIMD_SCALAR;
+  k.addProduct_32fc = genericAddProduct_32fc;
+  k.mul_32fc = genericMul_32fc;
+  k.mul_32fc_I = genericMul_32fc_I;
+  k.sinCos_32f = genericSinCos_32f;
+  k.splitScaled_16s32f = genericSplitScaled_16s32f;
+#ifdef GENERICSIMD_X86
+  if(level >= GENERICSIMD_SSE2)
+  {
+    k.level = GENERICSIMD_SSE2;
+    k.addProduct_32fc = genericSimdAddProduct_32fc_sse2;
+    k.mul_32fc = genericSimdMul_32fc_sse2;
+    k.mul_32fc_I = genericSimdMul_32fc_I_sse2;
+    k.sinCos_32f = genericSimdSinCos_32f_sse2;
+    k.splitScaled_16s32f = genericSimdSplitScaled_16s32f_sse2;
+  }
+  if(level >= GENERICSIMD_AVX2)
+  {
+    k.level = GENERICSIMD_AVX2;
+    k.addProduct_32fc = genericSimdAddProduct_32fc_avx2;
+    k.mul_32fc = genericSimdMul_32fc_avx2;
+    k.mul_32fc_I = genericSimdMul_32fc_I_avx2;
+    k.sinCos_32f = genericSimdSinCos_32f_avx2;
+    k.splitScaled_16s32f = genericSimdSplitScaled_16s32f_avx2;
+  }
+  if(level >= GENERICSIMD_AVX512)
+  {
+    k.level = GENERICSIMD_AVX512;
+    k.addProduct_32fc = genericSimdAddProduct_32fc_avx512;
+    k.mul_32fc = genericSimdMul_32fc_avx512;
+    k.mul_32fc_I = genericSimdMul_32fc_I_avx512;
+    k.sinCos_32f = genericSimdSinCos_32f_avx512;
+    k.splitScaled_16s32f = genericSimdSplitScaled_16s32f_avx512;
+  }
+#endif
+  return k;
+}
+
+inline genericSimdKernels genericSimdInitKernels()
+{
+  genericSimdLevel level = genericSimdDetectLevel();
+  const char * cap = getenv("DIFX_GENERIC_SIMD");
+
+  if(cap != 0)
+  {
+    for(int l=GENERICSIMD_SCALAR;l<=GENERICSIMD_AVX512;l++)
+    {
+      if(strcmp(cap, genericSimdLevelName((genericSimdLevel)l)) == 0 && l < level)
+        level = (genericSimdLevel)l;
+    }
+  }
+  return genericSimdSelectKernels(level);
+}
+
+// The kernel table in use by this process, chosen once on first call
+inline const genericSimdKernels & genericSimdGetKernels()
+{
+  static const genericSimdKernels kernels = genericSimdInitKernels();
+  return kernels;
+}
+
+inline vecStatus genericSimdAddProduct_32fc(const cf32 *src1, const cf32 *src2, cf32 *accumulator, int length)
+{ return genericSimdGetKernels().addProduct_32fc(src1, src2, accumulator, length); }
+inline vecStatus genericSimdMul_32fc(const cf32 *src1, const cf32 *src2, cf32 *dest, int length)
+{ return genericSimdGetKernels().mul_32fc(src1, src2, dest, length); }
+inline vecStatus genericSimdMul_32fc_I(const cf32 *src, cf32 *srcdest, int length)
+{ return genericSimdGetKernels().mul_32fc_I(src, srcdest, length); }
+inline vecStatus genericSimdSinCos_32f(const f32 *src, f32 *sin, f32 *cos, int length)
+{ return genericSimdGetKernels().sinCos_32f(src, sin, cos, length); }
+inline vecStatus genericSimdSplitScaled_16s32f(const s16 *src, f32 **dest, int numchannels, int chanlen)
+{ return genericSimdGetKernels().splitScaled_16s32f(src, dest, numchannels, chanlen); }
+
+#endif /* GENERICSIMD_H */
+// vim: shiftwidth=2:softtabstop=2:expandtab
@@ -549,6 +549,7 @@ void Mark5BDataStream::diskToMemory(int buffersegment)
 
 	//do the buffer housekeeping
 	waitForBuffer(buffersegment);
+	StageTimer timer(readprofile, StageProfile::DISKREAD);
 
 	// This function call abstracts away all the details.  The result is multiplexed data populating the 
 	// desired buffer segment.
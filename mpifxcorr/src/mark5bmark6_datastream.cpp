@@ -401,6 +401,7 @@ void Mark5BMark6DataStream::mark6ToMemory(int buffersegment)
 
 	//do the buffer housekeeping
 	waitForBuffer(buffersegment);
+	StageTimer timer(readprofile, StageProfile::DISKREAD);
 
 	// This function call abstracts away all the details.  The result is multiplexed data populating the 
 	// desired buffer segment.
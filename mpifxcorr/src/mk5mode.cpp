@@ -29,6 +29,8 @@
 #include "mk5.h"
 #include "alert.h"
 
+#define FILL_PATTERN 0x11223344UL
+
 Mk5Mode::Mk5Mode(Configuration * conf, int confindex, int dsindex, int recordedbandchan, int chanstoavg, int bpersend, int gsamples, int nrecordedfreqs, double recordedbw, double * recordedfreqclkoffs, double * recordedfreqclkoffsdelta, double * recordedfreqphaseoffs, double * recordedfreqlooffs, int nrecordedbands, int nzoombands, int nbits, Configuration::datasampling sampling, Configuration::complextype tcomplex, bool fbank, bool linear2circular, int fringerotorder, int arraystridelen, bool cacorrs, int framebytes, int framesamples, Configuration::dataformat format)
   : Mode(conf, confindex, dsindex, recordedbandchan, chanstoavg, bpersend, gsamples, nrecordedfreqs, recordedbw, recordedfreqclkoffs, recordedfreqclkoffsdelta, recordedfreqphaseoffs, recordedfreqlooffs, nrecordedbands, nzoombands, nbits, sampling, tcomplex, recordedbandchan*2+4, fbank, linear2circular, fringerotorder, arraystridelen, cacorrs, recordedbw*2)
 {
@@ -36,6 +38,9 @@ Mk5Mode::Mk5Mode(Configuration * conf, int confindex, int dsindex, int recordedb
 
   fanout = config->genMk5FormatName(format, nrecordedbands, recordedbw, nbits, sampling, framebytes, conf->getDDecimationFactor(confindex, dsindex), config->getDAlignmentSeconds(confindex, dsindex), conf->getDNumMuxThreads(confindex, dsindex), formatname);
   invalid = 0;
+  fusedunpacker = 0;
+  fusedlut = 0;
+  checkfillpattern = !conf->isNetwork(dsindex);
 
   if(fanout < 0)
     initok = false;
@@ -88,6 +93,33 @@ Mk5Mode::Mk5Mode(Configuration * conf, int confindex, int dsindex, int recordedb
           }
         }
       }
+
+      //common VDIF setups are unpacked directly rather than through mark5access
+      if((format == Configuration::VDIF || format == Configuration::VDIFL || format == Configuration::INTERLACEDVDIF) && !usecomplex && mark5stream->decimation == 1)
+        fusedunpacker = selectFusedByteUnpacker(nbits, nrecordedbands);
+      if(fusedunpacker)
+      {
+        //same levels as the mark5access VDIF decoder
+        int samplesperbyte = 8/nbits;
+        const f32 lut4level[4] = {-OPTIMAL_2BIT_HIGH, -1.0, 1.0, OPTIMAL_2BIT_HIGH};
+        const f32 FourBit1sigma = 2.95f;
+        fusedlut = vectorAlloc_f32(256*samplesperbyte);
+        estimatedbytes += sizeof(f32)*256*samplesperbyte;
+        for(int b=0;b<256;b++)
+        {
+          for(int i=0;i<samplesperbyte;i++)
+          {
+            int l = (b >> (nbits*i)) & ((1 << nbits) - 1);
+            if(nbits == 2)
+              fusedlut[b*samplesperbyte + i] = lut4level[l];
+            else if(nbits == 4)
+              fusedlut[b*samplesperbyte + i] = (l - 8)/FourBit1sigma;
+            else
+              fusedlut[b*samplesperbyte + i] = (l - 128)/3.3;
+          }
+        }
+        cverbose << startl << "Mk5Mode for datastream " << dsindex << " will use the fused " << nbits << "-bit, " << nrecordedbands << " band VDIF unpacker" << endl;
+      }
     }
   }
 }
@@ -95,6 +127,8 @@ Mk5Mode::Mk5Mode(Configuration * conf, int confindex, int dsindex, int recordedb
 Mk5Mode::~Mk5Mode()
 {
   delete_mark5_stream(mark5stream);
+  if(fusedlut)
+    vectorFree(fusedlut);
   if(invalid)
   {
     delete [] invalid;
@@ -114,6 +148,10 @@ float Mk5Mode::unpack(int sampleoffset, int subloopindex)
   {
     goodsamples = mark5_unpack_complex_with_offset(mark5stream, data, unpackstartsamples, (mark5_float_complex**)unpackedcomplexarrays, samplestounpack);
   }
+  else if(fusedunpacker)
+  {
+    goodsamples = fusedUnpack(unpackstartsamples, samplestounpack);
+  }
   else
   {
     goodsamples = mark5_unpack_with_offset(mark5stream, data, unpackstartsamples, unpackedarrays, samplestounpack);
@@ -175,4 +213,38 @@ float Mk5Mode::unpack(int sampleoffset, int subloopindex)
 
   return goodsamples/(float)unpacksamples;
 }
+
+float Mk5Mode::fusedUnpack(int startsample, int nsamp)
+{
+  const u32 * header;
+  const u32 * payload;
+  int framesample, numframesamples, nblank;
+  int payloadwords = mark5stream->databytes/4;
+  int frame = startsample/framesamples;
+
+  framesample = startsample%framesamples;
+  nblank = 0;
+  for(int o=0;o<nsamp;o+=numframesamples)
+  {
+    numframesamples = framesamples - framesample;
+    if(numframesamples > nsamp - o)
+      numframesamples = nsamp - o;
+    header = (const u32 *)(data + ((long long)frame)*mark5stream->framebytes);
+    payload = (const u32 *)((const u8 *)header + mark5stream->payloadoffset);
+    if(header[2] == 0 || (header[0] >> 31) || (checkfillpattern && ((payload[0] == FILL_PATTERN && payload[1] == FILL_PATTERN) || (payload[payloadwords-2] == FILL_PATTERN && payload[payloadwords-1] == FILL_PATTERN))))
+    {
+      for(int b=0;b<numrecordedbands;b++)
+        vectorZero_f32(&(unpackedarrays[b][o]), numframesamples);
+      nblank += numframesamples;
+    }
+    else
+    {
+      fusedunpacker((const u8 *)payload + (framesample*numbits*numrecordedbands)/8, fusedlut, numframesamples, unpackedarrays, o);
+    }
+    framesample = 0;
+    frame++;
+  }
+
+  return (float)(nsamp - nblank);
+}
 // vim: shiftwidth=2:softtabstop=2:expandtab
@@ -81,8 +81,20 @@ class Mk5Mode : public Mode
   */
     virtual float unpack(int sampleoffset, int subloopindex);
 
+ /**
+   * Unpacks VDIF frames straight from the data array with a fused byte-table unpacker instead of mark5access.
+   * Frames flagged invalid, or starting/ending with fill pattern, are zeroed and not counted
+   * @return The number of good samples unpacked
+   * @param startsample The offset in number of time samples into the data array (must start a byte)
+   * @param nsamp The number of samples to unpack
+  */
+    float fusedUnpack(int startsample, int nsamp);
+
     int framesamples, framebytes, samplestounpack, fanout;
     struct mark5_stream *mark5stream;
+    fusedbytefn fusedunpacker; // null if mark5access is to be used for unpacking
+    f32 * fusedlut;
+    bool checkfillpattern;
     int *invalid; // stores per-band invalid data counts after each unpack (VDIF and CODIF only)
 };
 
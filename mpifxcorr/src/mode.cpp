@@ -35,9 +35,11 @@
 
 //using namespace std;
 const float Mode::TINY = 0.000000001;
+const double Mode::SPECTRAL_PCAL_MAX_ROTATION = 0.0001;
 
 #if (ARCH == GENERIC)
 pthread_mutex_t FFTinitMutex = PTHREAD_MUTEX_INITIALIZER;
+unsigned int genericFFTPlanFlags = FFTW_ESTIMATE;
 #endif
 
 Mode::Mode(Configuration * conf, int confindex, int dsindex, int recordedbandchan, int chanstoavg, int bpersend, int gsamples, int nrecordedfreqs, double recordedbw, double * recordedfreqclkoffs, double * recordedfreqclkoffsdelta, double * recordedfreqphaseoffs, double * recordedfreqlooffs, int nrecordedbands, int nzoombands, int nbits, Configuration::datasampling sampling, Configuration::complextype tcomplex, int unpacksamp, bool fbank, bool linear2circular, int fringerotorder, int arraystridelen, bool cacorrs, double bclock)
@@ -77,6 +79,7 @@ Mode::Mode(Configuration * conf, int confindex, int dsindex, int recordedbandcha
   }
   perbandweights = 0;
   model = config->getModel();
+  profile = StageProfiler::disabledProfile();
   initok = true;
   intclockseconds = int(floor(config->getDClockCoeff(configindex, dsindex, 0)/1000000.0 + 0.5));
   if (usecomplex) fftchannels /=2;
@@ -208,8 +211,8 @@ Mode::Mode(Configuration * conf, int confindex, int dsindex, int recordedbandcha
     }
 
     lookup = vectorAlloc_s16((MAX_U16+1)*samplesperlookup);
-    linearunpacked = vectorAlloc_s16(numlookups*samplesperlookup);
-    estimatedbytes += 2*(numlookups*samplesperlookup + (MAX_U16+1)*samplesperlookup);
+    fusedlookupunpacker = selectFusedLookupUnpacker(numrecordedbands);
+    estimatedbytes += 2*(MAX_U16+1)*samplesperlookup;
 
     //initialise the fft info
     order = 0;
@@ -410,8 +413,24 @@ Mode::Mode(Configuration * conf, int confindex, int dsindex, int recordedbandcha
   }
   // Phase cal stuff
   PCal::setMinFrequencyResolution(1e6);
+  spectralpcal = false;
   if(config->getDPhaseCalIntervalMHz(configindex, datastreamindex))
   {
+    //tones can be taken from the station FFT spectra if every tone of every band falls onto a channel
+    if(config->getPCalExtraction() == Configuration::SPECTRALPCAL)
+    {
+      spectralpcal = !usecomplex;
+      for(int i=0;i<numrecordedbands && spectralpcal;i++)
+      {
+        localfreqindex = conf->getDLocalRecordedFreqIndex(confindex, dsindex, i);
+        spectralpcal = PCal::canExtractFromSpectrum(1e6*recordedbandwidth,
+                                  1e6*config->getDPhaseCalIntervalMHz(configindex, datastreamindex),
+                                  config->getDRecordedFreqPCalOffsetsHz(configindex, dsindex, localfreqindex), recordedbandchannels,
+                                  config->getDRecordedLowerSideband(configindex, dsindex, localfreqindex));
+      }
+      if(!spectralpcal)
+        cwarn << startl << "DIFX_PCAL_EXTRACTION=SPECTRAL needs real-sampled data with every pcal tone on a channel; extracting pcal in the time domain for datastream " << dsindex << endl;
+    }
     pcalresults = new cf32*[numrecordedbands];
     extractor = new PCal*[numrecordedbands];
     pcalnbins = new int[numrecordedbands];
@@ -419,7 +438,13 @@ Mode::Mode(Configuration * conf, int confindex, int dsindex, int recordedbandcha
     {
       localfreqindex = conf->getDLocalRecordedFreqIndex(confindex, dsindex, i);
       pcalresults[i] = new cf32[conf->getDRecordedFreqNumPCalTones(configindex, dsindex, localfreqindex)];
-      extractor[i] = PCal::getNew(1e6*recordedbandwidth,
+      if(spectralpcal)
+        extractor[i] = PCal::getNewSpectral(1e6*recordedbandwidth,
+                                  1e6*config->getDPhaseCalIntervalMHz(configindex, datastreamindex),
+                                  config->getDRecordedFreqPCalOffsetsHz(configindex, dsindex, localfreqindex), recordedbandchannels,
+                                  config->getDRecordedLowerSideband(configindex, dsindex, localfreqindex));
+      else
+        extractor[i] = PCal::getNew(1e6*recordedbandwidth,
                                   1e6*config->getDPhaseCalIntervalMHz(configindex, datastreamindex),
                                   config->getDRecordedFreqPCalOffsetsHz(configindex, dsindex, localfreqindex), 0,
                                   sampling, tcomplex);
@@ -547,7 +572,6 @@ Mode::~Mode()
   }
 
   vectorFree(lookup);
-  vectorFree(linearunpacked);
   vectorFree(fftbuffer);
 
   vectorFree(subfracsamparg);
@@ -615,7 +639,7 @@ Mode::~Mode()
 
 float Mode::unpack(int sampleoffset, int subloopindex)
 {
-  int status, leftoversamples, stepin = 0;
+  int leftoversamples, stepin = 0;
 
   if(bytesperblockdenominator/bytesperblocknumerator == 0)
     leftoversamples = 0;
@@ -626,22 +650,8 @@ float Mode::unpack(int sampleoffset, int subloopindex)
     stepin = unpackstartsamples%(samplesperblock*bytesperblockdenominator);
   u16 * packed = (u16 *)(&(data[((unpackstartsamples/samplesperblock)*bytesperblocknumerator)/bytesperblockdenominator]));
 
-  //copy from the lookup table to the linear unpacked array
-  for(int i=0;i<numlookups;i++)
-  {
-    status = vectorCopy_s16(&lookup[packed[i]*samplesperlookup], &linearunpacked[i*samplesperlookup], samplesperlookup);
-    if(status != vecNoErr) {
-      csevere << startl << "Error in lookup for unpacking!!!" << status << endl;
-      return 0;
-    }
-  }
-
-  //split the linear unpacked array into the separate subbands
-  status = vectorSplitScaled_s16f32(&(linearunpacked[stepin*numrecordedbands]), unpackedarrays, numrecordedbands, unpacksamples);
-  if(status != vecNoErr) {
-    csevere << startl << "Error in splitting linearunpacked!!!" << status << endl;
-    return 0;
-  }
+  //look up each u16 and write the samples straight into the separate subbands
+  fusedlookupunpacker(lookup, packed, samplesperlookup, stepin*numrecordedbands, unpacksamples, unpackedarrays, numrecordedbands);
 
   return 1.0;
 }
@@ -655,7 +665,10 @@ void Mode::process(int index, int subloopindex)  //frac sample error is in micro
   f32* currentstepchannelfreqs;
   f32* currentsubchannelfreqs;
   int indices[10];
-  bool looff, isfraclooffset;
+  bool looff, isfraclooffset, pcalfromspectrum;
+  cf32 pcalrotation;
+  double pcalrotationturns;
+  unsigned long long stagetime;
   //cout << "For Mode of datastream " << datastreamindex << ", index " << index << ", validflags is " << validflags[index/FLAGS_PER_INT] << ", after shift you get " << ((validflags[index/FLAGS_PER_INT] >> (index%FLAGS_PER_INT)) & 0x01) << endl;
 
   //since these data weights can be retreived after this processing ends, reset them to a default of zero in case they don't get updated
@@ -714,14 +727,19 @@ void Mode::process(int index, int subloopindex)  //frac sample error is in micro
     }
     return;
   }
+  stagetime = profile->start();
   if(nearestsample == -1)
   {
     nearestsample = 0;
     dataweight[subloopindex] = unpack(nearestsample, subloopindex);
+    profile->record(StageProfile::UNPACK, stagetime);
   }
   else if(nearestsample < unpackstartsamples || nearestsample > unpackstartsamples + unpacksamples - fftchannels)
+  {
     //need to unpack more data
     dataweight[subloopindex] = unpack(nearestsample, subloopindex);
+    profile->record(StageProfile::UNPACK, stagetime);
+  }
 
  /*
   * After DiFX-2.4, it is proposed to change the handling of lower sideband and dual sideband data, such
@@ -776,6 +794,8 @@ void Mode::process(int index, int subloopindex)  //frac sample error is in micro
       for(int i=0;i<numrecordedbands;i++)
       {
         extractor[i]->adjustSampleOffset(datasamples+nearestsample);
+        if (spectralpcal) //tones are read from the FFT output below
+          continue;
         if (!usecomplex)
 	        status = extractor[i]->extractAndIntegrate (&(unpackedarrays[i][nearestsample
 	                 - unpackstartsamples]), fftchannels);
@@ -785,6 +805,7 @@ void Mode::process(int index, int subloopindex)  //frac sample error is in micro
         if(status != true)
           csevere << startl << "Error in phase cal extractAndIntegrate" << endl;
       }
+      profile->record(StageProfile::PCAL, stagetime);
   }
 
   integerdelay = 0;
@@ -839,6 +860,8 @@ void Mode::process(int index, int subloopindex)  //frac sample error is in micro
       break;
   }
 
+  profile->record(StageProfile::FRINGEROTATE, stagetime);
+
   // Do the main work here
   // Loop over each frequency and to the fringe rotation and FFT of the data
 
@@ -1050,6 +1073,30 @@ void Mode::process(int index, int subloopindex)  //frac sample error is in micro
         break;
     }
 
+    profile->record(StageProfile::FRINGEROTATE, stagetime);
+
+    // Phase cal tones read from the FFT output carry the phase of the time-domain fringe rotator at the
+    // FFT centre, and are moved off their channels by the rotation over one FFT.  Only when that is
+    // negligible are the spectra used; otherwise the samples go to the time-domain extractor.
+    if(spectralpcal) {
+      pcalrotation.re = 1.0;
+      pcalrotation.im = 0.0;
+      pcalfromspectrum = true;
+      if(fringerotationorder > 0) {
+        cf32 r0 = complexrotator[fftchannels/2 - 1];
+        cf32 r1 = complexrotator[fftchannels/2];
+        f32 rmag;
+
+        pcalrotationturns = atan2(r1.im*r0.re - r1.re*r0.im, r1.re*r0.re + r1.im*r0.im)*fftchannels/TWO_PI;
+        pcalfromspectrum = (fabs(pcalrotationturns) < SPECTRAL_PCAL_MAX_ROTATION);
+        pcalrotation.re = r0.re + r1.re;
+        pcalrotation.im = r0.im + r1.im;
+        rmag = sqrt(pcalrotation.re*pcalrotation.re + pcalrotation.im*pcalrotation.im);
+        pcalrotation.re /= rmag;
+        pcalrotation.im /= rmag;
+      }
+    }
+
     // Note recordedfreqclockoffsetsdata will usually be zero, but avoiding if statement
     status = vectorMulC_f32(currentsubchannelfreqs, fracsampleerror - recordedfreqclockoffsets[i] + recordedfreqclockoffsetsdelta[i]/2, subfracsamparg, arraystridelength);
     if(status != vecNoErr) {
@@ -1144,6 +1191,7 @@ void Mode::process(int index, int subloopindex)  //frac sample error is in micro
 	csevere << startl << "Error doing the first bit of the time-saving complex multiplication in frac sample correction!!!" << endl;
 
     }
+    profile->record(StageProfile::FRACSAMPLE, stagetime);
 
     for(int j=0;j<numrecordedbands;j++)  // Loop over all recorded bands looking for the matching frequency we should be dealing with
     {
@@ -1195,6 +1243,7 @@ void Mode::process(int index, int subloopindex)  //frac sample error is in micro
               if(status != vecNoErr)
               	csevere << startl << "Error in fringe rotation!!!" << status << endl;
             }
+            profile->record(StageProfile::FRINGEROTATE, stagetime);
             if(isfft) {
               status = vectorFFT_CtoC_cf32(complexunpacked, fftd, pFFTSpecC, fftbuffer);
               if(status != vecNoErr)
@@ -1242,6 +1291,18 @@ void Mode::process(int index, int subloopindex)  //frac sample error is in micro
               csevere << startl << "Error copying FFT results!!!" << endl;
             break;
         }
+        profile->record(StageProfile::FFT, stagetime);
+
+        if(spectralpcal)
+        {
+          if(pcalfromspectrum)
+            status = extractor[j]->extractAndIntegrateSpectrum(fftoutputs[j][subloopindex], pcalrotation, fftchannels);
+          else
+            status = extractor[j]->extractAndIntegrate(&(unpackedarrays[j][nearestsample - unpackstartsamples]), fftchannels);
+          if(status != true)
+            csevere << startl << "Error in phase cal extraction from FFT output" << endl;
+          profile->record(StageProfile::PCAL, stagetime);
+        }
 
 	// At this point in the code the array fftoutputs[j] contains complex-valued voltage spectra with the following properties:
 	//
@@ -1274,6 +1335,7 @@ void Mode::process(int index, int subloopindex)  //frac sample error is in micro
           status = vectorAdd_f32_I(kscratch, s2[j], recordedbandchannels);
           if(status != vecNoErr)
             csevere << startl << "Error in kurtosis s2 accumulation!" << endl;
+          profile->record(StageProfile::AUTOCORR, stagetime);
         }
 
         //do the frac sample correct (+ phase shifting if applicable, + fringe rotate if its post-f)
@@ -1284,6 +1346,7 @@ void Mode::process(int index, int subloopindex)  //frac sample error is in micro
 	}
 	if(status != vecNoErr)
 	  csevere << startl << "Error in application of frac sample correction!!!" << status << endl;
+        profile->record(StageProfile::FRACSAMPLE, stagetime);
 
         //do the conjugation
         status = vectorConj_cf32(fftoutputs[j][subloopindex], conjfftoutputs[j][subloopindex], recordedbandchannels);
@@ -1306,6 +1369,7 @@ void Mode::process(int index, int subloopindex)  //frac sample error is in micro
 	    weights[0][j] += dataweight[subloopindex];
           }
 	}
+        profile->record(StageProfile::AUTOCORR, stagetime);
       }
     }
 
@@ -1336,6 +1400,7 @@ void Mode::process(int index, int subloopindex)  //frac sample error is in micro
 	  vectorSub_cf32(conjfftoutputs[LcpIndex][subloopindex], conjfftoutputs[RcpIndex][subloopindex], tmpvec, recordedbandchannels);
 	  vectorAdd_cf32_I(conjfftoutputs[LcpIndex][subloopindex], conjfftoutputs[RcpIndex][subloopindex], recordedbandchannels);
 	  vectorCopy_cf32(tmpvec, conjfftoutputs[LcpIndex][subloopindex], recordedbandchannels);
+	  profile->record(StageProfile::AUTOCORR, stagetime);
 
 	  break; 
       } else if (phasepoloffset) {
@@ -1393,6 +1458,7 @@ void Mode::process(int index, int subloopindex)  //frac sample error is in micro
         }
       }
     }
+    profile->record(StageProfile::AUTOCORR, stagetime);
   }
 }
 
@@ -1523,6 +1589,11 @@ void Mode::zeroKurtosis()
 }
 
 void Mode::setOffsets(int scan, int seconds, int ns)
+{
+  setOffsets(scan, seconds, ns, 0);
+}
+
+void Mode::setOffsets(int scan, int seconds, int ns, const f64 * subintinterpolator)
 {
   bool foundok;
   int srcindex;
@@ -1543,9 +1614,19 @@ void Mode::setOffsets(int scan, int seconds, int ns)
   else
     srcindex = 0;
 
-  f64 timespan = blockspersend*2*recordedbandchannels*sampletime/1e6;
-  if (usecomplex) timespan/=2;
-  foundok = model->calculateDelayInterpolator(currentscan, (double)offsetseconds + ((double)offsetns)/1000000000.0, timespan, blockspersend, config->getDModelFileIndex(configindex, datastreamindex), srcindex, 2, interpolator);
+  if(subintinterpolator)
+  {
+    interpolator[0] = subintinterpolator[0];
+    interpolator[1] = subintinterpolator[1];
+    interpolator[2] = subintinterpolator[2];
+    foundok = true;
+  }
+  else
+  {
+    f64 timespan = blockspersend*2*recordedbandchannels*sampletime/1e6;
+    if (usecomplex) timespan/=2;
+    foundok = model->calculateDelayInterpolator(currentscan, (double)offsetseconds + ((double)offsetns)/1000000000.0, timespan, blockspersend, config->getDModelFileIndex(configindex, datastreamindex), srcindex, 2, interpolator);
+  }
   interpolator[2] -= 1000000*intclockseconds;
 
   if(!foundok) {
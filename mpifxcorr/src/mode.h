@@ -30,6 +30,8 @@
 #include "architecture.h"
 #include "configuration.h"
 #include "pcal.h"
+#include "profiler.h"
+#include "fusedunpack.h"
 #include <iostream>
 #include <fstream>
 #include <cstdlib>
@@ -127,6 +129,15 @@ Mode(Configuration * conf, int confindex, int dsindex, int recordedbandchan, int
   */
   void setOffsets(int scan, int seconds, int ns);
 
+ /**
+  * Stores the times for the first FFT chunk to be processed, using a delay interpolator already calculated for this subintegration
+  * @param scan The current scan
+  * @param seconds The offset in seconds from the start of the scan
+  * @param ns The offset in nanoseconds from the integer second
+  * @param subintinterpolator The quadratic delay interpolator of this datastream over the subintegration, in blocks, or NULL to calculate it here
+  */
+  void setOffsets(int scan, int seconds, int ns, const f64 * subintinterpolator);
+
  /**
   * Averages the autocorrelations down in frequency
   */
@@ -190,6 +201,11 @@ Mode(Configuration * conf, int confindex, int dsindex, int recordedbandchan, int
   */
   inline void setDumpKurtosis(bool dk) { dumpkurtosis = dk; }
 
+ /**
+  * @param p The StageProfile of the thread which calls process() on this Mode
+  */
+  inline void setProfile(StageProfile * p) { profile = p; }
+
  /**
   * Returns a pointer to the FFT'd data of the specified product
   * @param outputband The band to get
@@ -217,6 +233,9 @@ Mode(Configuration * conf, int confindex, int dsindex, int recordedbandchan, int
   /** Constant for comparing two floats for equality (for freqs and bandwidths etc) */
   static const float TINY;
 
+  /** Largest fringe rotation over one FFT (turns) for which pcal tones are read from the spectra of pre-F rotated data */
+  static const double SPECTRAL_PCAL_MAX_ROTATION;
+
   /**
    * Returns a single pcal result.
    * @param outputband The band to get
@@ -262,7 +281,7 @@ protected:
   bool deltapoloffsets, phasepoloffset;
   u8  *   data;
   s16 *   lookup;
-  s16 *   linearunpacked;
+  fusedlookupfn fusedlookupunpacker;
   f32 **  unpackedarrays;
   cf32 **  unpackedcomplexarrays;
   cf32*** fftoutputs;
@@ -277,6 +296,7 @@ protected:
   u8 * fftbuffer;
   vecHintAlg hint;
   Model * model;
+  StageProfile * profile;
   f64 * interpolator;
 
   //new arrays for strided complex multiply for fringe rotation and fractional sample correction
@@ -289,6 +309,7 @@ protected:
   int * pcalnbins;
   cf32 ** pcalresults;
   PCal ** extractor;
+  bool spectralpcal;  // extractors take the tones from the FFT output (DIFX_PCAL_EXTRACTION=SPECTRAL)
   
   f64 * subtoff;
   f64 * subtval;
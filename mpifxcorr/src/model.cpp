@@ -298,6 +298,88 @@ bool Model::calculateDelayInterpolator(int scanindex, f64 offsettime, f64 timesp
   return true;
 }
 
+bool Model::calculateDelayInterpolatorTable(int scanindex, f64 offsettime, f64 timespan, int numincrements, int order, f64 * table)
+{
+  int scansample, polyoffset, numsources, firstsample, lastsample;
+  double deltat;
+  double delaysamples[3];
+  f64 * poly;
+  f64 * coeffs;
+  f64 tpowerarray[3][MAX_POLY_ORDER+1];
+
+  //check that order is ok
+  if(order < 0 || order > 2) {
+    csevere << startl << "Model delay interpolator table asked to produce " << order << "th order output - can only do 0, 1 or 2!" << endl;
+    return false;
+  }
+
+  //work out the correct sample and offset for the midrange of the timespan, as for calculateDelayInterpolator
+  polyoffset = (modelmjd - scantable[scanindex].polystartmjd)*86400 + modelstartseconds + scantable[scanindex].offsetseconds - scantable[scanindex].polystartseconds;
+  scansample = int((offsettime+polyoffset)/double(modelincsecs));
+  if(scansample == scantable[scanindex].nummodelsamples && ((offsettime+polyoffset - scansample*modelincsecs) < 1e-6))
+    scansample--;
+  if(scansample < 0 || scansample >= scantable[scanindex].nummodelsamples) {
+    cwarn << startl << "Model delay interpolator table was asked to produce results for scan " << scanindex << " from outside the scans valid range (worked out scansample " << scansample << ", when numsamples was " << scantable[scanindex].nummodelsamples << ")" << endl;
+    return false;
+  }
+
+  //the powers of time at the start, middle and end of the timespan are the same for every antenna and source
+  //(zero-th order only needs the middle)
+  firstsample = (order == 0)?1:0;
+  lastsample = (order == 0)?1:2;
+  for(int i=firstsample;i<=lastsample;i++)
+  {
+    deltat = offsettime+polyoffset+i*timespan/2.0 - scansample*modelincsecs;
+    tpowerarray[i][0] = 1.0;
+    for(int j=0;j<polyorder;j++)
+      tpowerarray[i][j+1] = tpowerarray[i][j]*deltat;
+  }
+
+  numsources = scantable[scanindex].numphasecentres+1;
+  for(int s=0;s<numsources;s++)
+  {
+    for(int a=0;a<numstations;a++)
+    {
+      poly = scantable[scanindex].delay[scansample][s][a];
+      coeffs = &(table[getDelayInterpolatorTableOffset(s, a, order)]);
+      for(int i=firstsample;i<=lastsample;i++)
+      {
+        delaysamples[i] = 0.0;
+        for(int j=0;j<=polyorder;j++)
+          delaysamples[i] += tpowerarray[i][j]*poly[j];
+      }
+      if(order == 0) {
+        coeffs[0] = delaysamples[1];
+      }
+      else if(order == 1) {
+        coeffs[0] = (delaysamples[2]-delaysamples[0])/numincrements;
+        coeffs[1] = delaysamples[0] + (delaysamples[1] - (coeffs[0]*numincrements/2.0 + delaysamples[0]))/3.0;
+      }
+      else {
+        coeffs[0] = (2.0*delaysamples[0]-4.0*delaysamples[1]+2.0*delaysamples[2])/(numincrements*numincrements);
+        coeffs[1] = (-3.0*delaysamples[0]+4.0*delaysamples[1]-delaysamples[2])/numincrements;
+        coeffs[2] = delaysamples[0];
+      }
+    }
+  }
+
+  return true;
+}
+
+void Model::linearSubInterpolator(const f64 * quadratic, f64 startincrement, f64 spanincrements, int numincrements, f64 * linear)
+{
+  double delaysamples[3];
+
+  //evaluate the quadratic at the start, middle and end of the span, and combine them as calculateDelayInterpolator does
+  for(int i=0;i<3;i++)
+  {
+    double x = startincrement + i*spanincrements/2.0;
+    delaysamples[i] = quadratic[0]*x*x + quadratic[1]*x + quadratic[2];
+  }
+  linear[0] = (delaysamples[2]-delaysamples[0])/numincrements;
+  linear[1] = delaysamples[0] + (delaysamples[1] - (linear[0]*numincrements/2.0 + delaysamples[0]))/3.0;
+}
+
 bool Model::addClockTerms(string antennaname, double refmjd, int order, double * terms, bool isupdate)
 {
   double clockdistance;
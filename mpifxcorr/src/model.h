@@ -179,6 +179,46 @@ class Model{
      */
     bool calculateDelayInterpolator(int scanindex, f64 offsettime, f64 timespan, int increments, int antennaindex, int scansourceindex, int order, f64 * delaycoeffs);
 
+    /**
+     * Calculates the delay interpolators of every antenna and every source of a scan for one timespan in one pass, as
+     * calculateDelayInterpolator would for each of them.  Intended to be filled once per subintegration and then read
+     * by all the threads processing it
+     * @param scanindex The scan
+     * @param offsettime Offset in seconds from the start of the scan, to start of timespan
+     * @param timespan Timespan the interpolation should attempt to match, in seconds
+     * @param increments The number of increments across timespan (ie the x value range, 0->numincrements)
+     * @param order The order of the interpolators (0, 1, or 2)
+     * @param table The coefficients, to be filled in: [scansource][antenna][order+1], see getDelayInterpolatorTableOffset
+     * @return true = success, false = failure (offset wasn't within scan, probably)
+     */
+    bool calculateDelayInterpolatorTable(int scanindex, f64 offsettime, f64 timespan, int increments, int order, f64 * table);
+
+    /**
+     * Returns the length of the table filled by calculateDelayInterpolatorTable for a scan
+     * @param scanindex The scan
+     * @param order The order of the interpolators
+     */
+    inline int getDelayInterpolatorTableLength(int scanindex, int order) const { return (scantable[scanindex].numphasecentres+1)*numstations*(order+1); }
+
+    /**
+     * Returns the offset of the coefficients of one antenna and source in a table filled by calculateDelayInterpolatorTable
+     * @param scansourceindex The source index within the scan
+     * @param antennaindex The antenna
+     * @param order The order of the interpolators
+     */
+    inline int getDelayInterpolatorTableOffset(int scansourceindex, int antennaindex, int order) const { return (scansourceindex*numstations + antennaindex)*(order+1); }
+
+    /**
+     * Produces, from a quadratic interpolator, the linear interpolator that calculateDelayInterpolator would give for a
+     * shorter timespan inside it
+     * @param quadratic The quadratic interpolator (as from calculateDelayInterpolator with order 2)
+     * @param startincrement The start of the shorter timespan, in increments of the quadratic interpolator
+     * @param spanincrements The length of the shorter timespan, in increments of the quadratic interpolator
+     * @param increments The number of increments across the shorter timespan
+     * @param linear The linear coefficients, to be filled in
+     */
+    static void linearSubInterpolator(const f64 * quadratic, f64 startincrement, f64 spanincrements, int increments, f64 * linear);
+
     /**
      * Adds the clock model for a given antenna
      * @param antennaname The name of the antenna to add the clock model for
@@ -38,6 +38,7 @@
 #include "fxmanager.h"
 #include "core.h"
 #include "datastream.h"
+#include "profiler.h"
 #include "mk5.h"
 #include "nativemk5.h"
 #include "mark5bfile.h"
@@ -61,6 +62,14 @@
 #include "alert.h"
 #include <errno.h>
 
+//MPI_Abort is called from all over mpifxcorr, often straight after an error message.  Intercept it (through the
+//MPI profiling interface) so that difxmessages still waiting in the send queue go out before the process dies
+extern "C" int MPI_Abort(MPI_Comm comm, int errorcode)
+{
+  difxMessageFlushSendQueue();
+  return PMPI_Abort(comm, errorcode);
+}
+
 //act on an XML command message which was received
 bool actOnCommand(Configuration * config, DifxMessageGeneric * difxmessage) {
   string paramname, paramvalue;
@@ -304,6 +313,9 @@ int main(int argc, char *argv[])
   generateIdentifier(argv[1], difxMessageID);
   difxMessageInit(myID, difxMessageID);
   difxMessageSetInputFilename(argv[1]);
+  //send messages from a background thread so processing threads never wait on the network
+  if(isDifxMessageInUse())
+    difxMessageStartSendThread((getenv("DIFX_MESSAGE_SEND_COALESCE") != 0)?DIFX_MESSAGE_SEND_COALESCE:0);
   if(myID == 0)
   {
     if(isDifxMessageInUse() && !nocommandthread)
@@ -348,6 +360,7 @@ int main(int argc, char *argv[])
       cfatal << startl << "Invoke with mpifxcorr <inputfilename> [-M<monhostname>:port[:monitor_skip]] [-rNewStartSec] [--nocommandthread]" << endl;
       MPI_Barrier(world);
       MPI_Finalize();
+      difxMessageStopSendThread();
       return EXIT_FAILURE;
     }
   }
@@ -367,6 +380,9 @@ int main(int argc, char *argv[])
     return EXIT_FAILURE;
   }
 
+  //start the stage profiler, if DIFX_PROFILE asks for it
+  StageProfiler::initialise(config, myID);
+
   //handle difxmessage setup for sending and receiving
   if (isDifxMessageInUse() && !nocommandthread) { 
     // CJP - PTHREAD_CREATE_JOINABLE is the default
@@ -394,6 +410,7 @@ int main(int argc, char *argv[])
     cfatal << startl << "Must be invoked with at least " << fxcorr::FIRSTTELESCOPEID + numdatastreams + 1 << " processors (was invoked with " << numprocs << " processors) - aborting!" << endl;
     MPI_Barrier(world);
     MPI_Finalize();
+    difxMessageStopSendThread();
     return EXIT_FAILURE;
   }
 
@@ -476,6 +493,7 @@ int main(int argc, char *argv[])
       cinfo << startl << "Estimated memory usage by Core: " << core->getEstimatedBytes()/1048576.0 << " MB" << endl;
       core->execute();
     }
+    StageProfiler::finish(world);
     MPI_Barrier(world);
   }
 
@@ -511,6 +529,7 @@ int main(int argc, char *argv[])
   			// It is currently commented out to prevent hang on exit
 
   cinfo << startl << "MPI ID " << myID << " says BYE!" << endl;
+  difxMessageStopSendThread();
   return EXIT_SUCCESS;
 }
 // vim: shiftwidth=2:softtabstop=2:expandtab
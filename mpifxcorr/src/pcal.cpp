@@ -87,6 +87,11 @@ using namespace std;
     #define cdebug  std::cout
     const char startl[] = "";
     // #define VERBOSE_UNIT_TEST
+    #if (ARCH == GENERIC)
+    // normally defined in mode.cpp
+    pthread_mutex_t FFTinitMutex = PTHREAD_MUTEX_INITIALIZER;
+    unsigned int genericFFTPlanFlags = FFTW_ESTIMATE;
+    #endif
 #endif
 
 #ifndef PCAL_DEBUG
@@ -194,6 +199,55 @@ PCal* PCal::getNew(double bandwidth_hz, double pcal_spacing_hz, int pcal_offset_
     return new PCalExtractorShifting(bandwidth_hz, pcal_spacing_hz, pcal_offset_hz, sampleoffset);
 }
 
+/**
+ * Factory that returns a new PCal extractor object working on the spectra of
+ * the correlator FFT of real-valued samples (see extractAndIntegrateSpectrum()).
+ * @param bandwidth_hz     Bandwidth of the input signal in Hertz
+ * @param pcal_spacing_hz  Spacing of the PCal signal, comb spacing, typically 1e6 Hertz
+ * @param pcal_offset_hz   Offset of the first PCal signal from 0Hz/DC, typically 10e3 Hertz
+ * @param nchannels        Number of spectral channels across the band (half the FFT length)
+ * @param lsb              True if the spectra are of a lower sideband, i.e., conjugated and flipped
+ * @return new PCal extractor class instance, or NULL if not all tones fall onto a channel
+ */
+PCal* PCal::getNewSpectral(double bandwidth_hz, double pcal_spacing_hz, int pcal_offset_hz, int nchannels, bool lsb)
+{
+    if (!canExtractFromSpectrum(bandwidth_hz, pcal_spacing_hz, pcal_offset_hz, nchannels, lsb))
+        return NULL;
+
+    return new PCalExtractorSpectral(bandwidth_hz, pcal_spacing_hz, pcal_offset_hz, nchannels, lsb);
+}
+
+/**
+ * Checks whether every tone of the band falls exactly onto one of the nchannels
+ * spectral channels, as required by getNewSpectral(). The channel must also be
+ * present in the spectrum, which for USB lacks the upper band edge and for LSB
+ * lacks DC.
+ */
+bool PCal::canExtractFromSpectrum(double bandwidth_hz, double pcal_spacing_hz, int pcal_offset_hz, int nchannels, bool lsb)
+{
+    if (pcal_offset_hz < 0 || pcal_spacing_hz <= 0.0 || bandwidth_hz <= 0.0 || nchannels <= 0)
+        return false;
+
+    double chan_hz = bandwidth_hz / nchannels;
+    double first_hz = (pcal_offset_hz == 0) ? pcal_spacing_hz : (double)pcal_offset_hz;
+    int first_bin = (int)(first_hz/chan_hz + 0.5);
+    int tone_step = (int)(pcal_spacing_hz/chan_hz + 0.5);
+    if (tone_step < 1 || std::abs(first_bin*chan_hz - first_hz) > 1e-6*chan_hz
+                      || std::abs(tone_step*chan_hz - pcal_spacing_hz) > 1e-6*chan_hz)
+        return false;
+
+    int Nt = calcNumTones(bandwidth_hz, (double)pcal_offset_hz, pcal_spacing_hz);
+    if (pcal_offset_hz == 0)
+        Nt--; // tone at DC carries no phase
+    if (Nt <= 0)
+        return false;
+
+    int last_bin = first_bin + (Nt-1)*tone_step;
+    if (lsb)
+        return (first_bin >= 1 && last_bin <= nchannels);
+    return (last_bin <= nchannels-1);
+}
+
 /////////////////////////////////////////////////////////////////////////////////////////////////////////
 // BASE CLASS: Static helper funcs
 /////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -238,6 +292,16 @@ PCal::PCal()
     _estimatedbytes = 0;
 }
 
+/**
+ * Process the spectrum of one FFT. Only extractors made by getNewSpectral() support this.
+ * @return false
+ */
+bool PCal::extractAndIntegrateSpectrum(cf32 const* spectrum, const cf32 rotation, const size_t len)
+{
+    cerror << startl << "PCal::extractAndIntegrateSpectrum called on an extractor that takes only time-domain samples!" << endl;
+    return false;
+}
+
 /////////////////////////////////////////////////////////////////////////////////////////////////////////
 // BASE CLASS: reference extractor, very slow but should be accurate
 /////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -320,7 +384,7 @@ bool PCal::extractAndIntegrate_reference(f32 const* data, const size_t len, cf32
         }
     }
 
-    vectorFree(dftspec);
+    vectorFreeDFTC_cf32(dftspec);
     if (dftworkbuf) vectorFree(dftworkbuf);
     return true;
 }
@@ -1369,6 +1433,177 @@ void PCal::extract_continuous(f32* data, size_t len)
 
 #endif
 
+/////////////////////////////////////////////////////////////////////////////////////////////////////////
+// DERIVED CLASS: extraction of PCal signals from the correlator FFT spectra of real samples
+/////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+PCalExtractorSpectral::PCalExtractorSpectral(double bandwidth_hz, double pcal_spacing_hz, int pcal_offset_hz,
+int nchannels, bool lsb)
+{
+    double chan_hz = bandwidth_hz / nchannels;
+
+    /* Derive config */
+    _fs_hz          = 2 * bandwidth_hz;
+    _pcalspacing_hz = pcal_spacing_hz;
+    _pcaloffset_hz  = pcal_offset_hz;
+    _N_tones        = calcNumTones(bandwidth_hz, (double)_pcaloffset_hz, _pcalspacing_hz);
+    if (_pcaloffset_hz == 0)
+        _N_tones--; // -1 is to exclude tone at 0 Hertz
+    _N_bins         = 2 * nchannels;
+    _nchannels      = nchannels;
+    _first_bin      = (int)(((_pcaloffset_hz == 0) ? _pcalspacing_hz : _pcaloffset_hz)/chan_hz + 0.5);
+    _tone_step      = (int)(_pcalspacing_hz/chan_hz + 0.5);
+    _lsb            = lsb;
+    _cfg = new pcal_config_pimpl();
+
+    /* FFTs that cannot be used go to the extractor that would have been used otherwise */
+    _timedomain = PCal::getNew(bandwidth_hz, pcal_spacing_hz, pcal_offset_hz, 0, Configuration::REAL, Configuration::SINGLE);
+    if (_timedomain->getLength() != _N_tones)
+        csevere << startl << "PCalExtractorSpectral: time-domain extractor has " << _timedomain->getLength()
+                << " tones rather than " << _N_tones << endl;
+
+    _cfg->pcal_complex = vectorAlloc_cf32(_N_tones);
+    _cfg->dft_out      = vectorAlloc_cf32(_N_tones);
+    _estimatedbytes    = 2*_N_tones*sizeof(cf32) + _timedomain->getEstimatedBytes();
+    this->clear();
+
+    if (PCAL_DEBUG)
+        cdebug << startl << "PCalExtractorSpectral: _Ntones = " << _N_tones << ", first channel = " << _first_bin
+               << ", tone step = " << _tone_step << " channels of " << _nchannels << endl;
+}
+
+PCalExtractorSpectral::~PCalExtractorSpectral()
+{
+    vectorFree(_cfg->pcal_complex);
+    vectorFree(_cfg->dft_out);
+    delete _timedomain;
+    delete _cfg;
+}
+
+/**
+ * Clear the extracted and accumulated PCal data by setting it to zero.
+ */
+void PCalExtractorSpectral::clear()
+{
+    _samplecount = 0;
+    _finalized   = false;
+    _cfg->pcal_index = 0;
+    vectorZero_cf32(_cfg->pcal_complex, _N_tones);
+    _timedomain->clear();
+}
+
+/**
+ * Adjust the sample offset of the next FFT spectrum or chunk of samples.
+ * @param sampleoffset sample offset of data passed to next extractAndIntegrate*() call
+ */
+void PCalExtractorSpectral::adjustSampleOffset(const size_t sampleoffset)
+{
+    _cfg->pcal_index = sampleoffset % _N_bins;
+    _timedomain->adjustSampleOffset(sampleoffset);
+}
+
+/**
+ * Process a chunk of time-continuous single channel data that is not suitable
+ * for spectral extraction. It is passed on to a time-domain extractor.
+ *
+ * @param samples Chunk of the input signal consisting of 'float' samples
+ * @param len     Length of the input signal chunk
+ * @return true on success, false if results were frozen by calling getFinalPCal()
+ */
+bool PCalExtractorSpectral::extractAndIntegrate(f32 const* samples, const size_t len)
+{
+    if (_finalized) {
+        cerror << startl << "PCalExtractorSpectral::extractAndIntegrate on finalized class!" << endl;
+        return false;
+    }
+    return _timedomain->extractAndIntegrate(samples, len);
+}
+
+/**
+ * Picks the tones out of the spectrum of one FFT and accumulates them.
+ *
+ * Channel b of an FFT that starts at sample s0 of the stream holds the tone
+ * at b times the channel spacing with its phase advanced by 2pi*b*s0/len
+ * relative to the start of the stream; that is taken out before accumulation,
+ * which makes the result identical to a time-domain extraction over the same samples.
+ *
+ * If the samples were fringe rotated before the FFT, the tones are moved off
+ * their channels by the fringe rate times the FFT duration and pick up the
+ * rotator phase. The latter is removed with the rotator value at the FFT centre;
+ * the caller should use extractAndIntegrate() instead for FFTs where the former
+ * is more than a tiny fraction of a channel.
+ *
+ * @param spectrum Channels 0..len/2-1 of the FFT, flipped and conjugated for LSB, before any fractional sample correction
+ * @param rotation Time-domain fringe rotator at the centre of the FFT (1 if the samples were not rotated)
+ * @param len      Number of samples transformed by the FFT
+ * @return true on success, false if results were frozen by calling getFinalPCal()
+ */
+bool PCalExtractorSpectral::extractAndIntegrateSpectrum(cf32 const* spectrum, const cf32 rotation, const size_t len)
+{
+    if (_finalized) {
+        cerror << startl << "PCalExtractorSpectral::extractAndIntegrateSpectrum on finalized class!" << endl;
+        return false;
+    }
+    if (len != (size_t)_N_bins) {
+        cerror << startl << "PCalExtractorSpectral::extractAndIntegrateSpectrum got a " << len << "-point FFT; expected " << _N_bins << endl;
+        return false;
+    }
+
+    /* Phase of the first tone and increment between tones, reduced exactly using integers */
+    size_t s0 = _cfg->pcal_index;
+    double arg  = -2*M_PI * double((_first_bin * s0) % len) / double(len);
+    double darg = -2*M_PI * double((_tone_step * s0) % len) / double(len);
+    double wre = cos(arg), wim = sin(arg);
+    double dwre = cos(darg), dwim = sin(darg);
+    cf32* accu = _cfg->pcal_complex;
+
+    for (int n = 0; n < _N_tones; n++) {
+        int bin = _first_bin + n*_tone_step;
+        f32 re, im;
+        if (_lsb) {
+            /* LSB channel N-bin holds the conjugate of the tone at bin */
+            const cf32 &v = spectrum[_nchannels - bin];
+            re = v.re*rotation.re + v.im*rotation.im;
+            im = v.re*rotation.im - v.im*rotation.re;
+        } else {
+            const cf32 &v = spectrum[bin];
+            re = v.re*rotation.re + v.im*rotation.im;
+            im = v.im*rotation.re - v.re*rotation.im;
+        }
+        accu[n].re += re*wre - im*wim;
+        accu[n].im += re*wim + im*wre;
+
+        double t = wre*dwre - wim*dwim;
+        wim = wre*dwim + wim*dwre;
+        wre = t;
+    }
+
+    _samplecount += len;
+    return true;
+}
+
+/**
+ * Computes the final extraction result. No more data can be added.
+ * The PCal extraction results are copied into the specified output array.
+ *
+ * @param out Pointer to user PCal array with getLength() values
+ * @return number of samples that were integrated for the result
+ */
+uint64_t PCalExtractorSpectral::getFinalPCal(cf32* out)
+{
+    if (!_finalized)
+    {
+        _finalized = true;
+        uint64_t n = _timedomain->getFinalPCal(_cfg->dft_out);
+        if (n > 0) {
+            vectorAdd_cf32_I(_cfg->dft_out, _cfg->pcal_complex, _N_tones);
+            _samplecount += n;
+        }
+    }
+    vectorCopy_cf32(_cfg->pcal_complex, out, _N_tones);
+    return _samplecount;
+}
+
 /////////////////////////////////////////////////////////////////////////////////////////////////////////
 // DERIVED CLASS: PCal class that returns only known dummy values.
 /////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -1479,7 +1714,10 @@ void print_32fc(const cf32* v, const size_t len);
 void print_32fc_phase(const cf32* v, const size_t len);
 void compare_32fc_phase(const cf32* v, const size_t len, f32 angle, f32 step);
 void test_pcal_case(long samplecount, long bandwidth, long offset, long spacing, long sampleoffset, const char* extname);
-void test_pcal_auto();
+void test_pcal_spectral(long samplecount, long bandwidth, long offset, long spacing, long sampleoffset, int nchannels, bool lsb);
+int test_pcal_auto();
+
+static int spectral_failures = 0;
 
 int main(int argc, char** argv)
 {
@@ -1492,7 +1730,8 @@ int main(int argc, char** argv)
            << "           spacingHz    : spacing of PCal tones in Hz\n"
            << "           offsetHz     : distance of first tone from 0 Hz\n"
            << "           sampleoffset : non-zero to test sample adjuster, 0 otherwise\n"
-           << "           class        : specify extractor explicitly ('trivial', 'shift', 'implicit' or 'dummy')\n\n";
+           << "           class        : specify extractor explicitly ('trivial', 'shift', 'implicit' or 'dummy'),\n"
+           << "                          or 'spectral<N>' to extract from N-channel USB spectra ('lspectral<N>' for LSB)\n\n";
       return -1;
    }
 
@@ -1512,19 +1751,24 @@ int main(int argc, char** argv)
       long sampleoffset = atof(argv[5]);
       cerr << "Settings: nsamp=" << samplecount << ", BWHz=" << bandwidth << " spcHz=" << spacing
            << ", offHz=" << offset << ", sampOff=" << sampleoffset << "\n";
-      if (argc > 6)
+      if (argc > 6 && !strncasecmp(argv[6], "spectral", 8))
+         test_pcal_spectral(samplecount, bandwidth, offset, spacing, sampleoffset, atoi(argv[6]+8), false);
+      else if (argc > 6 && !strncasecmp(argv[6], "lspectral", 9))
+         test_pcal_spectral(samplecount, bandwidth, offset, spacing, sampleoffset, atoi(argv[6]+9), true);
+      else if (argc > 6)
          test_pcal_case(samplecount, bandwidth, offset, spacing, sampleoffset, argv[6]);
       else
          test_pcal_case(samplecount, bandwidth, offset, spacing, sampleoffset, "auto");
    } else {
       cerr << "Running through several test cases\n";
-      test_pcal_auto();
+      return test_pcal_auto();
    }
 
-   return 0;
+   return (spectral_failures > 0) ? 1 : 0;
 }
 
-void test_pcal_auto()
+/* Returns non-zero if any of the (automatically checked) spectral extraction cases failed */
+int test_pcal_auto()
 {
    long sampleoffset = 11;
    long samplecount  = 32e3;
@@ -1533,20 +1777,20 @@ void test_pcal_auto()
       const char* mode;
    };
    tcase_t cases[] = {
-      // BW   1st tone  spacing
-      { 16e6,       0,      1e6,   "auto" },
-      { 16e6,       0,      1e6,   "implicit" }, // fails, could be made to work
-      {  3e6,       0,      2e6,   "auto" },
-      { 16e6,    10e3,      1e6,   "auto" },
-      { 16e6,    10e3,      3e6,   "auto" },
-      { 16e6,    10e3,      5e6,   "auto" },
-      { 16e6,       0,      5e6,   "auto" },
-      { 16e6,       0,      5e6,   "implicit" }, // fails, could be made to work (merger of implicit&trivial)
-      {  1e6,    10e3,      5e6,   "auto" },
-      {  1e6,    10e3,        0,   "auto" },
-      {  1e6,       0,        0,   "auto" },
-      {  1e6,     2e6,        0,   "auto" },
-      { 32e3,     2e6,    100e3,   "auto" },
+      // BW        1st tone   spacing
+      { 16000000L,        0L,  1000000L, "auto" },
+      { 16000000L,        0L,  1000000L, "implicit" }, // fails, could be made to work
+      {  3000000L,        0L,  2000000L, "auto" },
+      { 16000000L,    10000L,  1000000L, "auto" },
+      { 16000000L,    10000L,  3000000L, "auto" },
+      { 16000000L,    10000L,  5000000L, "auto" },
+      { 16000000L,        0L,  5000000L, "auto" },
+      { 16000000L,        0L,  5000000L, "implicit" }, // fails, could be made to work (merger of implicit&trivial)
+      {  1000000L,    10000L,  5000000L, "auto" },
+      {  1000000L,    10000L,        0L, "auto" },
+      {  1000000L,        0L,        0L, "auto" },
+      {  1000000L,  2000000L,        0L, "auto" },
+      {    32000L,  2000000L,   100000L, "auto" },
    };
 
    /* Go through test cases; doesn't yet check PASS/FAIL automatically though! */
@@ -1555,7 +1799,27 @@ void test_pcal_auto()
       test_pcal_case(samplecount, cases[i].bandwidth, cases[i].offset, cases[i].spacing, sampleoffset, cases[i].mode);
    }
 
-   return;
+   /* Extraction from FFT spectra, against the reference extractor */
+   struct scase_t {
+      long bandwidth, offset, spacing;
+      int nchannels;
+   };
+   scase_t scases[] = {
+      // BW        1st tone   spacing   channels
+      { 16000000L,    10000L,  1000000L, 1600 },
+      { 16000000L,   500000L,  1000000L,  128 },
+      { 16000000L,   250000L,   500000L,   64 },
+      { 16000000L,    10000L,  1000000L,  128 }, // not supported: tones between channels
+      {  8000000L,   100000L,  1000000L,  400 },
+   };
+   int Nscases = sizeof(scases) / sizeof(struct scase_t);
+   for (int i = 0; i < Nscases; i++) {
+      test_pcal_spectral(samplecount + 123, scases[i].bandwidth, scases[i].offset, scases[i].spacing, sampleoffset, scases[i].nchannels, false);
+      test_pcal_spectral(samplecount + 123, scases[i].bandwidth, scases[i].offset, scases[i].spacing, sampleoffset, scases[i].nchannels, true);
+   }
+   cerr << "Spectral extraction: " << spectral_failures << " case(s) failed\n";
+
+   return (spectral_failures > 0) ? 1 : 0;
 }
 
 void test_pcal_case(long samplecount, long bandwidth, long offset, long spacing, long sampleoffset, const char* extname)
@@ -1582,7 +1846,8 @@ void test_pcal_case(long samplecount, long bandwidth, long offset, long spacing,
       extractor = new PCalExtractorDummy(bandwidth, spacing, offset, sampleoffset);
    } else {
       cerr << "Using pcal extractor factory to select suitable extractor\n";
-      extractor = PCal::getNew(bandwidth, spacing, offset, sampleoffset, usecomplex);
+      extractor = PCal::getNew(bandwidth, spacing, offset, sampleoffset,
+                               usecomplex ? Configuration::COMPLEX : Configuration::REAL, Configuration::SINGLE);
       using_auto = true;
    }
    if (!using_auto) {
@@ -1670,6 +1935,111 @@ void test_pcal_case(long samplecount, long bandwidth, long offset, long spacing,
    return;
 }
 
+/* Tones are taken from the real-to-complex FFT spectra of consecutive nchannels*2 sample segments, like
+   the spectra of Mode::process() before fractional sample correction, and the samples left over are
+   passed to the time-domain extractor. The sum must match both the reference extractor and the
+   time-domain extractor that Mode would otherwise use (PCal::getNew()) over all samples. */
+void test_pcal_spectral(long samplecount, long bandwidth, long offset, long spacing, long sampleoffset, int nchannels, bool lsb)
+{
+   const float tone_phase_start = -90.0f;
+   const float tone_phase_slope = 5.0f;
+   const size_t fftlen = 2*nchannels;
+   const cf32 norotation = { 1.0f, 0.0f };
+
+   cerr << "Spectral extraction: BWHz=" << bandwidth << " spcHz=" << spacing << ", offHz=" << offset
+        << ", " << nchannels << " " << (lsb ? "LSB" : "USB") << " channels\n";
+   PCal* extractor = PCal::getNewSpectral(bandwidth, spacing, offset, nchannels, lsb);
+   if (extractor == NULL) {
+      cerr << "Tones do not all fall onto spectral channels: not supported\n\n";
+      return;
+   }
+
+   /* Test signal as in test_pcal_case() */
+   int numtones = extractor->getLength();
+   cf32* out = vectorAlloc_cf32(numtones);
+   cf32* ref = vectorAlloc_cf32(numtones);
+   float* data = vectorAlloc_f32(samplecount);
+   for (long n=0; n<samplecount; n++) {
+      data[n] = 0;
+      for (int tone=0; tone<numtones; tone++) {
+          double phi = 2*M_PI * (offset + tone*spacing) / (2*bandwidth) * (n+sampleoffset);
+          data[n] = data[n] + sin(phi + tone*tone_phase_slope*(M_PI/180));
+      }
+   }
+
+   int wbufsize = 0;
+   u8* dftworkbuf;
+   vecDFTSpecR_f32* dftspec;
+   vecStatus s = vectorInitDFTR_f32(&dftspec, fftlen, vecFFT_NoReNorm, vecAlgHintAccurate, &wbufsize, &dftworkbuf);
+   if (s != vecNoErr)
+      cerr << "Error in DFT initialisation " << vectorGetStatusString(s) << "\n";
+   cf32* spectrum = vectorAlloc_cf32(fftlen);
+   cf32* lsbspectrum = vectorAlloc_cf32(nchannels);
+
+   size_t n = 0;
+   for (; n + fftlen <= (size_t)samplecount; n += fftlen) {
+      vectorDFT_RtoC_f32(data + n, (f32*)spectrum, dftspec, dftworkbuf);
+      if (lsb)
+         vectorConjFlip_cf32(&(spectrum[1]), lsbspectrum, nchannels);
+      extractor->adjustSampleOffset(sampleoffset + n);
+      extractor->extractAndIntegrateSpectrum(lsb ? lsbspectrum : spectrum, norotation, fftlen);
+   }
+   if (n < (size_t)samplecount) {
+      extractor->adjustSampleOffset(sampleoffset + n);
+      extractor->extractAndIntegrate(data + n, samplecount - n);
+   }
+   uint64_t usedsamplecount = extractor->getFinalPCal(out);
+
+   extractor->clear();
+   extractor->extractAndIntegrate_reference(data, samplecount, ref, sampleoffset);
+
+   /* The same samples through the time-domain extractor, as set up by Mode without spectral extraction */
+   PCal* timedomain = PCal::getNew(bandwidth, spacing, offset, 0, Configuration::REAL, Configuration::SINGLE);
+   cf32* td = vectorAlloc_cf32(numtones);
+   bool ok = (timedomain->getLength() == numtones);
+   timedomain->adjustSampleOffset(sampleoffset);
+   timedomain->extractAndIntegrate(data, samplecount);
+   timedomain->getFinalPCal(td);
+
+   f32 maxphase = 0.0f, maxamp = 0.0f, maxtdphase = 0.0f, maxtdamp = 0.0f;
+   for (int i=0; i<numtones; i++) {
+      f32 aout = sqrt(out[i].re*out[i].re + out[i].im*out[i].im);
+      f32 dphi = (180/M_PI)*std::atan2(out[i].im*ref[i].re - out[i].re*ref[i].im, out[i].re*ref[i].re + out[i].im*ref[i].im);
+      f32 aref = sqrt(ref[i].re*ref[i].re + ref[i].im*ref[i].im);
+      maxphase = std::max(maxphase, std::abs(dphi));
+      maxamp = std::max(maxamp, std::abs(aout/aref - 1.0f));
+      if (ok) {
+         f32 dtdphi = (180/M_PI)*std::atan2(out[i].im*td[i].re - out[i].re*td[i].im, out[i].re*td[i].re + out[i].im*td[i].im);
+         f32 atd = sqrt(td[i].re*td[i].re + td[i].im*td[i].im);
+         maxtdphase = std::max(maxtdphase, std::abs(dtdphi));
+         maxtdamp = std::max(maxtdamp, std::abs(aout/atd - 1.0f));
+      }
+   }
+   ok = ok && usedsamplecount == (uint64_t)samplecount && maxphase < 0.01 && maxamp < 1e-4 && maxtdphase < 0.01 && maxtdamp < 1e-4;
+   if (!ok)
+      spectral_failures++;
+   cerr << "used " << usedsamplecount << " of " << samplecount << " samples\n";
+   compare_32fc_phase(out, numtones, tone_phase_start, tone_phase_slope);
+   cerr << "Spectral versus reference: max phase difference " << maxphase << " deg, max relative amplitude difference " << maxamp << "\n";
+   if (timedomain->getLength() != numtones)
+      cerr << "Time-domain extractor keeps " << timedomain->getLength() << " tones, spectral " << numtones << "\n";
+   else
+      cerr << "Spectral versus time domain: max phase difference " << maxtdphase << " deg, max relative amplitude difference " << maxtdamp << "\n";
+   cerr << (ok ? "PASS\n" : "FAIL\n") << "\n";
+
+   delete timedomain;
+   vectorFree(td);
+
+   vectorFreeDFTR_f32(dftspec);
+   vectorFree(dftworkbuf);
+   vectorFree(spectrum);
+   vectorFree(lsbspectrum);
+   vectorFree(data);
+   vectorFree(out);
+   vectorFree(ref);
+   delete extractor;
+}
+
 void print_32f(const f32* v, const size_t len) {
    for (size_t i=0; i<len; i++) { cerr << std::scientific << v[i] << " "; }
 }
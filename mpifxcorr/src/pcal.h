@@ -51,6 +51,14 @@
  *   Only certain bins of this spectrum contain the tones.
  *   These bins are gathered together for the final output values.
  *
+ * Spectral extractor:
+ *   When every tone falls exactly onto a channel of the FFT that the correlator
+ *   already computes, the tones can be read from those spectra instead of
+ *   making a separate pass over the samples. Each tone bin is referenced back
+ *   to the start of the sample stream and accumulated. FFTs for which this
+ *   would not be accurate (strong time-domain fringe rotation) are handed to a
+ *   conventional time-domain extractor, and the two results are summed.
+ *
  * All extractors return amplitude and phase of the tones.
  *
  * The output data could also be analyzed in the time domain where the relative,
@@ -64,6 +72,7 @@
  * @license  GNU GPL v3
  *
  * Changelog:
+ *   17oct2026 - added extraction from the correlator FFT spectra
  *   29jun2020 - extended the support for extraction from complex samples
  *   18Mar2014 - added support for extraction from complex samples
  *   27Mar2012 - better count of tones in band, added corner cases like no tones in band, zero spacing
@@ -87,6 +96,7 @@ class PCalExtractorShifting;
 class PCalExtractorImplicitShift;
 class PCalExtractorComplex;
 class PCalExtractorComplexImplicitShift;
+class PCalExtractorSpectral;
 class PCalExtractorDummy; //NOTE added for testing
 class pcal_config_pimpl;
 
@@ -118,6 +128,24 @@ class PCal {
        */
       static PCal* getNew(double bandwidth_hz, double pcal_spacing_hz, int pcal_offset_hz, const size_t sampleoffset, Configuration::datasampling data_type, Configuration::complextype band_type);
 
+      /**
+       * Factory that returns a new PCal extractor object working on the spectra of
+       * the correlator FFT of real-valued samples (see extractAndIntegrateSpectrum()).
+       * @param bandwidth_hz     Bandwidth of the input signal in Hertz
+       * @param pcal_spacing_hz  Spacing of the PCal signal, comb spacing, typically 1e6 Hertz
+       * @param pcal_offset_hz   Offset of the first PCal signal from 0Hz/DC, typically 10e3 Hertz
+       * @param nchannels        Number of spectral channels across the band (half the FFT length)
+       * @param lsb              True if the spectra are of a lower sideband, i.e., conjugated and flipped
+       * @return new PCal extractor class instance, or NULL if not all tones fall onto a channel
+       */
+      static PCal* getNewSpectral(double bandwidth_hz, double pcal_spacing_hz, int pcal_offset_hz, int nchannels, bool lsb);
+
+      /**
+       * Checks whether every tone of the band falls exactly onto one of the nchannels
+       * spectral channels, as required by getNewSpectral().
+       */
+      static bool canExtractFromSpectrum(double bandwidth_hz, double pcal_spacing_hz, int pcal_offset_hz, int nchannels, bool lsb);
+
      /**
       * Return number of tones that fit the band, including any
       * tones that fall onto DC or the upper band edge.
@@ -161,6 +189,18 @@ class PCal {
        */
       virtual bool extractAndIntegrate(f32 const* samples, const size_t len) = 0;
 
+      /**
+       * Process the spectrum of one FFT of time-continuous single channel data,
+       * the FFT starting at the sample set through adjustSampleOffset().
+       * Only extractors made by getNewSpectral() support this.
+       *
+       * @param spectrum Channels 0..len/2-1 of the FFT, flipped and conjugated for LSB, before any fractional sample correction
+       * @param rotation Time-domain fringe rotator at the centre of the FFT (1 if the samples were not rotated)
+       * @param len      Number of samples transformed by the FFT
+       * @return true on success, false if not supported or results were frozen by calling getFinalPCal()
+       */
+      virtual bool extractAndIntegrateSpectrum(cf32 const* spectrum, const cf32 rotation, const size_t len);
+
       /**
        * Get data-seconds contributing to the current PCal results.
        * @return amount of integrated data in seconds
@@ -246,6 +286,7 @@ class PCal {
    friend class PCalExtractorImplicitShift;
    friend class PCalExtractorComplex;
    friend class PCalExtractorComplexImplicitShift;
+   friend class PCalExtractorSpectral;
 
    //NOTE added for testing
    friend class PCalExtractorDummy;
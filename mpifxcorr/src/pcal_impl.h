@@ -57,6 +57,7 @@
  *   05Oct2009 - added support for arbitrary input segment lengths
  *   08oct2009 - added Briskens rotationless method
  *   19Mar2014 - added support for extraction from complex samples
+ *   17oct2026 - added extraction from the correlator FFT spectra
  *
  ********************************************************************************************************/
 
@@ -369,6 +370,67 @@ class PCalExtractorComplex : public PCal {
       uint64_t getFinalPCal(cf32* out);
 };
 
+/////////////////////////////////////////////////////////////////////////////////////////////////////////
+// DERIVED CLASS: extraction of PCal signals from the correlator FFT spectra of real samples
+/////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class PCalExtractorSpectral : public PCal {
+   public:
+      PCalExtractorSpectral(double bandwidth_hz, double pcal_spacing_hz, int pcal_offset_hz, int nchannels, bool lsb);
+      ~PCalExtractorSpectral();
+   private:
+      PCalExtractorSpectral& operator= (const PCalExtractorSpectral& o); /* no copy */
+      PCalExtractorSpectral(const PCalExtractorSpectral& o); /* no copy */
+
+   private:
+      int  _nchannels;   // spectral channels per FFT, i.e. half the FFT length
+      int  _first_bin;   // channel of the first tone
+      int  _tone_step;   // channels between tones
+      bool _lsb;
+      PCal* _timedomain; // takes the FFTs that are not suitable for spectral extraction
+
+   public:
+      /**
+       * Clear the extracted and accumulated PCal data by setting it to zero.
+       */
+      void clear();
+
+      /**
+       * Adjust the sample offset of the next FFT spectrum or chunk of samples.
+       * @param sampleoffset sample offset of data passed to next extractAndIntegrate*() call
+       */
+      void adjustSampleOffset(const size_t sampleoffset);
+
+      /**
+       * Process a chunk of time-continuous single channel data that is not suitable
+       * for spectral extraction. It is passed on to a time-domain extractor.
+       *
+       * @param samples Chunk of the input signal consisting of 'float' samples
+       * @param len     Length of the input signal chunk
+       * @return true on success, false if results were frozen by calling getFinalPCal()
+       */
+      bool extractAndIntegrate(f32 const* samples, const size_t len);
+
+      /**
+       * Picks the tones out of the spectrum of one FFT and accumulates them.
+       *
+       * @param spectrum Channels 0..len/2-1 of the FFT, flipped and conjugated for LSB, before any fractional sample correction
+       * @param rotation Time-domain fringe rotator at the centre of the FFT (1 if the samples were not rotated)
+       * @param len      Number of samples transformed by the FFT
+       * @return true on success, false if results were frozen by calling getFinalPCal()
+       */
+      bool extractAndIntegrateSpectrum(cf32 const* spectrum, const cf32 rotation, const size_t len);
+
+      /**
+       * Computes the final extraction result. No more data can be added.
+       * The PCal extraction results are copied into the specified output array.
+       *
+       * @param out Pointer to user PCal array with getLength() values
+       * @return number of samples that were integrated for the result
+       */
+      uint64_t getFinalPCal(cf32* out);
+};
+
 class PCalExtractorDummy : public PCal {
   public:
     PCalExtractorDummy(double bandwidth_hz, double pcal_spacing_hz, int pcal_offset_hz, 
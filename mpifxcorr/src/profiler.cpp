@@ -0,0 +1,242 @@
+/***************************************************************************
+ *   Copyright (C) 2006-2020 by Adam Deller                                *
+ *                                                                         *
+ *   This program is free software: you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation, either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+//===========================================================================
+// SVN properties (DO NOT CHANGE)
+//
+// $Id$
+// $HeadURL$
+// $LastChangedRevision$
+// $Author$
+// $LastChangedDate$
+//
+//============================================================================
+#include <errno.h>
+#include <fstream>
+#include <iomanip>
+#include <string.h>
+#include <sys/time.h>
+#include <difxmessage.h>
+#include "profiler.h"
+#include "alert.h"
+
+const char StageProfile::STAGE_NAMES[NUMSTAGES][16] = {"UNPACK", "PCAL", "FRINGEROTATE", "FFT", "FRACSAMPLE", "AUTOCORR", "XMAC", "UVSHIFT", "MPIRECEIVE", "MPISENDWAIT", "DISKREAD", "VISWRITE"};
+
+bool StageProfiler::enabled = false;
+bool StageProfiler::reporterrunning = false;
+bool StageProfiler::keepreporting = false;
+int StageProfiler::interval = 0;
+int StageProfiler::processid = 0;
+string StageProfiler::filename;
+std::vector<StageProfile*> StageProfiler::profiles;
+pthread_mutex_t StageProfiler::profileslock = PTHREAD_MUTEX_INITIALIZER;
+pthread_mutex_t StageProfiler::reporterlock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t StageProfiler::reportercond = PTHREAD_COND_INITIALIZER;
+pthread_t StageProfiler::reporterthread;
+
+StageProfile::StageProfile(bool enable)
+  : enabled(enable)
+{
+  memset(counts, 0, sizeof(counts));
+  memset(totalns, 0, sizeof(totalns));
+  memset(histogram, 0, sizeof(histogram));
+}
+
+void StageProfile::addTo(long long * sumcounts, long long * sumtotalns, long long * sumhistogram) const
+{
+  for(int s=0;s<NUMSTAGES;s++)
+  {
+    sumcounts[s] += __atomic_load_n(&counts[s], __ATOMIC_RELAXED);
+    sumtotalns[s] += __atomic_load_n(&totalns[s], __ATOMIC_RELAXED);
+    for(int b=0;b<NUM_HISTOGRAM_BINS;b++)
+      sumhistogram[s*NUM_HISTOGRAM_BINS + b] += __atomic_load_n(&histogram[s][b], __ATOMIC_RELAXED);
+  }
+}
+
+void StageProfiler::initialise(const Configuration * config, int mpiid)
+{
+  int perr;
+
+  interval = config->getProfileInterval();
+  enabled = (interval > 0);
+  processid = mpiid;
+  filename = config->getProfileFilename();
+  if(!enabled)
+    return;
+
+  cinfo << startl << "Stage profiling enabled, reporting every " << interval << " s" << endl;
+  keepreporting = true;
+  perr = pthread_create(&reporterthread, NULL, StageProfiler::launchReporter, NULL);
+  if(perr != 0)
+    cerror << startl << "Error in launching stage profile reporting thread - profiles will only be written at the end of the job" << endl;
+  else
+    reporterrunning = true;
+}
+
+StageProfile * StageProfiler::createProfile()
+{
+  StageProfile * profile;
+
+  if(!enabled)
+    return disabledProfile();
+  profile = new StageProfile(true);
+  pthread_mutex_lock(&profileslock);
+  profiles.push_back(profile);
+  pthread_mutex_unlock(&profileslock);
+
+  return profile;
+}
+
+StageProfile * StageProfiler::disabledProfile()
+{
+  static StageProfile disabled(false);
+
+  return &disabled;
+}
+
+void StageProfiler::sum(long long * sumcounts, long long * sumtotalns, long long * sumhistogram)
+{
+  memset(sumcounts, 0, StageProfile::NUMSTAGES*sizeof(long long));
+  memset(sumtotalns, 0, StageProfile::NUMSTAGES*sizeof(long long));
+  memset(sumhistogram, 0, StageProfile::NUMSTAGES*StageProfile::NUM_HISTOGRAM_BINS*sizeof(long long));
+  pthread_mutex_lock(&profileslock);
+  for(size_t i=0;i<profiles.size();i++)
+    profiles[i]->addTo(sumcounts, sumtotalns, sumhistogram);
+  pthread_mutex_unlock(&profileslock);
+}
+
+void StageProfiler::report()
+{
+  long long sumcounts[StageProfile::NUMSTAGES];
+  long long sumtotalns[StageProfile::NUMSTAGES];
+  long long sumhistogram[StageProfile::NUMSTAGES*StageProfile::NUM_HISTOGRAM_BINS];
+
+  sum(sumcounts, sumtotalns, sumhistogram);
+  for(int s=0;s<StageProfile::NUMSTAGES;s++)
+  {
+    if(sumcounts[s] > 0)
+      difxMessageSendDifxDiagnosticStageProfile(-1, StageProfile::STAGE_NAMES[s], sumcounts[s], sumtotalns[s]/1000.0, StageProfile::NUM_HISTOGRAM_BINS, &(sumhistogram[s*StageProfile::NUM_HISTOGRAM_BINS]));
+  }
+}
+
+void * StageProfiler::launchReporter(void * arg)
+{
+  struct timeval tv;
+  struct timespec deadline;
+
+  pthread_mutex_lock(&reporterlock);
+  while(keepreporting)
+  {
+    gettimeofday(&tv, NULL);
+    deadline.tv_sec = tv.tv_sec + interval;
+    deadline.tv_nsec = tv.tv_usec*1000;
+    while(keepreporting && pthread_cond_timedwait(&reportercond, &reporterlock, &deadline) != ETIMEDOUT);
+    if(keepreporting)
+    {
+      pthread_mutex_unlock(&reporterlock);
+      report();
+      pthread_mutex_lock(&reporterlock);
+    }
+  }
+  pthread_mutex_unlock(&reporterlock);
+
+  return 0;
+}
+
+void StageProfiler::finish(MPI_Comm comm)
+{
+  int perr, anyenabled, localenabled, myid, numprocesses;
+  long long sumcounts[StageProfile::NUMSTAGES];
+  long long sumtotalns[StageProfile::NUMSTAGES];
+  long long sumhistogram[StageProfile::NUMSTAGES*StageProfile::NUM_HISTOGRAM_BINS];
+  long long allcounts[StageProfile::NUMSTAGES];
+  long long alltotalns[StageProfile::NUMSTAGES];
+  long long allhistogram[StageProfile::NUMSTAGES*StageProfile::NUM_HISTOGRAM_BINS];
+
+  if(reporterrunning)
+  {
+    pthread_mutex_lock(&reporterlock);
+    keepreporting = false;
+    pthread_cond_signal(&reportercond);
+    pthread_mutex_unlock(&reporterlock);
+    perr = pthread_join(reporterthread, NULL);
+    if(perr != 0)
+      csevere << startl << "Error in closing stage profile reporting thread!!!" << endl;
+    reporterrunning = false;
+  }
+
+  //every process takes part even if only some had profiling switched on
+  localenabled = enabled?1:0;
+  MPI_Allreduce(&localenabled, &anyenabled, 1, MPI_INT, MPI_MAX, comm);
+  if(!anyenabled)
+    return;
+
+  MPI_Comm_rank(comm, &myid);
+  MPI_Comm_size(comm, &numprocesses);
+  sum(sumcounts, sumtotalns, sumhistogram);
+  if(enabled)
+    report();
+  MPI_Reduce(sumcounts, allcounts, StageProfile::NUMSTAGES, MPI_LONG_LONG, MPI_SUM, 0, comm);
+  MPI_Reduce(sumtotalns, alltotalns, StageProfile::NUMSTAGES, MPI_LONG_LONG, MPI_SUM, 0, comm);
+  MPI_Reduce(sumhistogram, allhistogram, StageProfile::NUMSTAGES*StageProfile::NUM_HISTOGRAM_BINS, MPI_LONG_LONG, MPI_SUM, 0, comm);
+  if(myid == 0)
+    writeProfileFile(allcounts, alltotalns, allhistogram, numprocesses);
+
+  pthread_mutex_lock(&profileslock);
+  for(size_t i=0;i<profiles.size();i++)
+    delete profiles[i];
+  profiles.clear();
+  pthread_mutex_unlock(&profileslock);
+  enabled = false;
+}
+
+void StageProfiler::writeProfileFile(const long long * sumcounts, const long long * sumtotalns, const long long * sumhistogram, int numprocesses)
+{
+  long long grandtotal = 0;
+
+  ofstream output(filename.c_str(), ios::trunc);
+  if(!output.is_open() || output.bad())
+  {
+    cerror << startl << "Could not open stage profile file " << filename << " for writing" << endl;
+    return;
+  }
+
+  for(int s=0;s<StageProfile::NUMSTAGES;s++)
+    grandtotal += sumtotalns[s];
+
+  output << "# mpifxcorr stage profile, summed over " << numprocesses << " processes and all their threads" << endl;
+  output << "# STAGE          COUNT        TOTAL(s)   MEAN(us)  FRACTION" << endl;
+  for(int s=0;s<StageProfile::NUMSTAGES;s++)
+  {
+    output << setw(14) << left << StageProfile::STAGE_NAMES[s] << right;
+    output << setw(12) << sumcounts[s] << " ";
+    output << fixed << setprecision(3) << setw(14) << sumtotalns[s]/1.0e9 << " ";
+    output << setw(10) << ((sumcounts[s] > 0)?sumtotalns[s]/(1000.0*sumcounts[s]):0.0) << " ";
+    output << setw(9) << ((grandtotal > 0)?((double)sumtotalns[s])/grandtotal:0.0) << endl;
+  }
+  output << "#" << endl;
+  output << "# Histograms: STAGE followed by the number of timings in bin i, covering [2^i, 2^(i+1)) ns" << endl;
+  for(int s=0;s<StageProfile::NUMSTAGES;s++)
+  {
+    output << StageProfile::STAGE_NAMES[s];
+    for(int b=0;b<StageProfile::NUM_HISTOGRAM_BINS;b++)
+      output << " " << sumhistogram[s*StageProfile::NUM_HISTOGRAM_BINS + b];
+    output << endl;
+  }
+  output.close();
+  cinfo << startl << "Wrote stage profile to " << filename << endl;
+}
+// vim: shiftwidth=2:softtabstop=2:expandtab
@@ -0,0 +1,186 @@
+/***************************************************************************
+ *   Copyright (C) 2006-2020 by Adam Deller                                *
+ *                                                                         *
+ *   This program is free software: you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation, either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+//===========================================================================
+// SVN properties (DO NOT CHANGE)
+//
+// $Id$
+// $HeadURL$
+// $LastChangedRevision$
+// $Author$
+// $LastChangedDate$
+//
+//============================================================================
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <mpi.h>
+#include <pthread.h>
+#include <time.h>
+#include <vector>
+#include "configuration.h"
+
+/**
+@class StageProfile
+@brief Timing counters for the hot stages of the correlator, written by a single thread
+
+Each instrumented object (a Core process thread, a DataStream reader, ...) owns a StageProfile obtained from
+StageProfiler::createProfile, which only ever has one thread recording into it.  A duration is recorded with a
+couple of relaxed stores, so the reporting thread can read the counters at any time without locks.  When profiling
+is disabled all objects share one disabled profile and recording is a single test.
+
+@author Adam Deller
+*/
+class StageProfile{
+public:
+  /// The stages which are timed
+  enum stage {UNPACK, PCAL, FRINGEROTATE, FFT, FRACSAMPLE, AUTOCORR, XMAC, UVSHIFT, MPIRECEIVE, MPISENDWAIT, DISKREAD, VISWRITE, NUMSTAGES};
+
+  /// Number of histogram bins - bin i counts durations of [2^i, 2^(i+1)) ns, the last bin anything longer
+  static const int NUM_HISTOGRAM_BINS = 32;
+
+  /// Names of the stages, as used in the profile file and difxmessages
+  static const char STAGE_NAMES[NUMSTAGES][16];
+
+ /**
+  * Constructor: zeroes all counters
+  * @param enable Whether this profile records anything
+  */
+  StageProfile(bool enable);
+
+  /// Returns the current time in ns from a monotonic clock
+  static inline unsigned long long now() { struct timespec ts; clock_gettime(CLOCK_MONOTONIC, &ts); return ((unsigned long long)ts.tv_sec)*1000000000ULL + ts.tv_nsec; }
+
+  inline bool isEnabled() const { return enabled; }
+
+  /// Returns a start time for a following record(), or 0 if not enabled
+  inline unsigned long long start() const { return enabled?now():0; }
+
+ /**
+  * Records the time since since against a stage, and moves since on to now so consecutive stages can be chained
+  * @param s The stage to which the time is attributed
+  * @param since The start time (from start() or a previous record()), updated to the current time
+  */
+  inline void record(stage s, unsigned long long & since)
+  {
+    if(!enabled)
+      return;
+    unsigned long long t = now();
+    add(s, t - since);
+    since = t;
+  }
+
+ /**
+  * Adds one duration to the counters of a stage
+  * @param s The stage to which the time is attributed
+  * @param ns The duration in ns
+  */
+  inline void add(stage s, unsigned long long ns)
+  {
+    int bin = (ns > 1)?(63 - __builtin_clzll(ns)):0;
+    if(bin >= NUM_HISTOGRAM_BINS)
+      bin = NUM_HISTOGRAM_BINS-1;
+    //single writer: plain load/store, atomic only so that the reporting thread never sees a torn value
+    __atomic_store_n(&counts[s], __atomic_load_n(&counts[s], __ATOMIC_RELAXED) + 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&totalns[s], __atomic_load_n(&totalns[s], __ATOMIC_RELAXED) + ns, __ATOMIC_RELAXED);
+    __atomic_store_n(&histogram[s][bin], __atomic_load_n(&histogram[s][bin], __ATOMIC_RELAXED) + 1, __ATOMIC_RELAXED);
+  }
+
+ /**
+  * Adds a snapshot of the counters into arrays summing several profiles
+  * @param sumcounts Number of records per stage [NUMSTAGES]
+  * @param sumtotalns Total ns per stage [NUMSTAGES]
+  * @param sumhistogram Histogram per stage [NUMSTAGES*NUM_HISTOGRAM_BINS]
+  */
+  void addTo(long long * sumcounts, long long * sumtotalns, long long * sumhistogram) const;
+
+private:
+  bool enabled;
+  unsigned long long counts[NUMSTAGES];
+  unsigned long long totalns[NUMSTAGES];
+  unsigned long long histogram[NUMSTAGES][NUM_HISTOGRAM_BINS];
+};
+
+/**
+@class StageTimer
+@brief Records the time from construction to destruction against one stage of a StageProfile
+
+@author Adam Deller
+*/
+class StageTimer{
+public:
+  StageTimer(StageProfile * p, StageProfile::stage s) : profile(p), timedstage(s) { starttime = profile->start(); }
+  ~StageTimer() { profile->record(timedstage, starttime); }
+
+private:
+  StageProfile * profile;
+  StageProfile::stage timedstage;
+  unsigned long long starttime;
+};
+
+/**
+@class StageProfiler
+@brief Owns all the StageProfiles of an mpifxcorr process, reports them periodically and writes the job profile
+
+Profiling is switched on by setting DIFX_PROFILE to a reporting interval in seconds.  Every interval the summed
+profiles of the process are sent as StageProfile difxmessage diagnostics (cumulative, so a lost packet loses
+nothing), and at the end of the job they are summed over all MPI processes and written by the manager to
+<job>.profile next to the .input file.
+
+@author Adam Deller
+*/
+class StageProfiler{
+public:
+ /**
+  * Sets up profiling for this process and, if enabled, starts the reporting thread
+  * @param config The Configuration for the job
+  * @param mpiid The MPI id of this process
+  */
+  static void initialise(const Configuration * config, int mpiid);
+
+ /**
+  * Returns a new profile for use by one thread (owned by the StageProfiler), or the shared disabled profile
+  */
+  static StageProfile * createProfile();
+
+  /// Returns the shared profile which never records anything
+  static StageProfile * disabledProfile();
+
+ /**
+  * Stops the reporting thread, sums the profiles of all processes and writes the job profile file.  Must be
+  * called by every process in comm
+  * @param comm The communicator containing all mpifxcorr processes
+  */
+  static void finish(MPI_Comm comm);
+
+private:
+  static void * launchReporter(void * arg);
+  static void sum(long long * sumcounts, long long * sumtotalns, long long * sumhistogram);
+  static void report();
+  static void writeProfileFile(const long long * sumcounts, const long long * sumtotalns, const long long * sumhistogram, int numprocesses);
+
+  static bool enabled, reporterrunning, keepreporting;
+  static int interval, processid;
+  static string filename;
+  static std::vector<StageProfile*> profiles;
+  static pthread_mutex_t profileslock;
+  static pthread_mutex_t reporterlock;
+  static pthread_cond_t reportercond;
+  static pthread_t reporterthread;
+};
+
+#endif
+// vim: shiftwidth=2:softtabstop=2:expandtab
@@ -0,0 +1,152 @@
+#include <iostream>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include "architecture.h"
+#include "fusedunpack.h"
+
+// Checks the fused unpackers against straightforward references: the
+// lookup-table unpacker against a copy of each lookup row into a linear s16
+// array followed by the generic split/scale (as Mode::unpack used to do), and
+// the byte-table unpackers against decoding one sample at a time from the
+// packed bits.  Odd skips and lengths exercise the partial rows/bytes.
+//
+// ./fusedunpack_test
+
+static const int MAXSAMPLES = 1000;
+static const int TESTLENGTHS[] = {1, 3, 4, 7, 33, 999, 1000};
+static const int NUMTESTLENGTHS = sizeof(TESTLENGTHS)/sizeof(int);
+static const int MAXBANDS = 16;
+static const f32 TOLERANCE = 1.0e-6;
+
+static int failures = 0;
+
+static void report(const char * what, int nbits, int nbands, int length, bool ok)
+{
+  if(!ok)
+  {
+    std::cout << "FAIL: " << what << " nbits=" << nbits << " nbands=" << nbands << " length=" << length << std::endl;
+    failures++;
+  }
+}
+
+static void testlookup(int nbands, int samplesperlookup)
+{
+  s16 * lookup = new s16[(MAX_U16+1)*samplesperlookup];
+  u16 * packed = new u16[MAXSAMPLES*MAXBANDS/samplesperlookup + 2];
+  s16 * linear = new s16[(MAXSAMPLES*MAXBANDS/samplesperlookup + 2)*samplesperlookup];
+  f32 ref[MAXBANDS][MAXSAMPLES], out[MAXBANDS][MAXSAMPLES];
+  f32 * outp[MAXBANDS];
+  const f32 scale = 2.0/((f32)MAX_S16-(f32)MIN_S16);
+  fusedlookupfn fn = selectFusedLookupUnpacker(nbands);
+  int numpacked = MAXSAMPLES*MAXBANDS/samplesperlookup + 2;
+
+  for(int b=0;b<MAXBANDS;b++)
+    outp[b] = out[b];
+  for(int i=0;i<(MAX_U16+1)*samplesperlookup;i++)
+    lookup[i] = (s16)(rand() & 0xFFFF);
+  for(int i=0;i<numpacked;i++)
+  {
+    packed[i] = (u16)(rand() & 0xFFFF);
+    memcpy(&linear[i*samplesperlookup], &lookup[packed[i]*samplesperlookup], samplesperlookup*sizeof(s16));
+  }
+
+  for(int t=0;t<NUMTESTLENGTHS;t++)
+  {
+    int length = TESTLENGTHS[t];
+    for(int skip=0;skip<samplesperlookup;skip+=nbands)
+    {
+      bool ok = true;
+      if(length*nbands + skip > numpacked*samplesperlookup)
+        continue;
+      for(int n=0;n<length;n++)
+        for(int b=0;b<nbands;b++)
+          ref[b][n] = -1.0f + scale*((f32)linear[skip + n*nbands + b] - (f32)MIN_S16);
+      fn(lookup, packed, samplesperlookup, skip, length, outp, nbands);
+      for(int b=0;b<nbands;b++)
+        for(int n=0;n<length;n++)
+          if(fabs(ref[b][n] - out[b][n]) > TOLERANCE)
+            ok = false;
+      report("fusedLookupUnpack", 16/samplesperlookup, nbands, length, ok);
+    }
+  }
+
+  delete [] lookup;
+  delete [] packed;
+  delete [] linear;
+}
+
+static void testbytes(int nbits, int nbands)
+{
+  int samplesperbyte = 8/nbits;
+  f32 * lut = new f32[256*samplesperbyte];
+  f32 levels[256];
+  u8 packed[MAXSAMPLES*MAXBANDS];
+  f32 ref[MAXBANDS][MAXSAMPLES+3], out[MAXBANDS][MAXSAMPLES+3];
+  f32 * outp[MAXBANDS];
+  fusedbytefn fn = selectFusedByteUnpacker(nbits, nbands);
+
+  if(!fn)
+  {
+    report("selectFusedByteUnpacker", nbits, nbands, 0, false);
+    delete [] lut;
+    return;
+  }
+  for(int b=0;b<MAXBANDS;b++)
+    outp[b] = out[b];
+  for(int l=0;l<(1 << nbits);l++)
+    levels[l] = (f32)(rand() - RAND_MAX/2)/RAND_MAX;
+  for(int i=0;i<256;i++)
+    for(int j=0;j<samplesperbyte;j++)
+      lut[i*samplesperbyte + j] = levels[(i >> (j*nbits)) & ((1 << nbits) - 1)];
+  for(int i=0;i<MAXSAMPLES*MAXBANDS;i++)
+    packed[i] = (u8)(rand() & 0xFF);
+
+  for(int t=0;t<NUMTESTLENGTHS;t++)
+  {
+    int length = TESTLENGTHS[t];
+    bool ok = true;
+    for(int n=0;n<length;n++)
+    {
+      for(int b=0;b<nbands;b++)
+      {
+        int bit = (n*nbands + b)*nbits;
+        int value = (packed[bit/8] >> (bit%8)) & ((1 << nbits) - 1);
+        ref[b][n+3] = levels[value];
+      }
+    }
+    fn(packed, lut, length, outp, 3);
+    for(int b=0;b<nbands;b++)
+      for(int n=0;n<length;n++)
+        if(ref[b][n+3] != out[b][n+3])
+          ok = false;
+    report("fusedByteUnpack", nbits, nbands, length, ok);
+  }
+
+  delete [] lut;
+}
+
+int main(int argc, const char** argv)
+{
+  srand(42);
+  for(int nbands=1;nbands<=MAXBANDS;nbands++)
+  {
+    if(8%nbands == 0)
+      testlookup(nbands, 8);
+    if(16%nbands == 0)
+      testlookup(nbands, 16);
+  }
+  testlookup(3, 8);
+  for(int nbits=2;nbits<=8;nbits*=2)
+    for(int nbands=1;nbands<=MAXBANDS;nbands*=2)
+      testbytes(nbits, nbands);
+
+  if(failures > 0)
+  {
+    std::cout << failures << " test(s) failed" << std::endl;
+    return EXIT_FAILURE;
+  }
+  std::cout << "All tests passed" << std::endl;
+
+  return EXIT_SUCCESS;
+}
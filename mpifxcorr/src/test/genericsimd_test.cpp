@@ -0,0 +1,211 @@
+// The references below must round exactly as written, so keep the compiler
+// from fusing their multiplies and adds
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#else
+#pragma GCC optimize ("fp-contract=off")
+#endif
+
+#include <iostream>
+#include <cfloat>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include "architecture.h"
+
+// Checks every run-time selectable vector kernel set against single
+// precision references that use the same operation order as the scalar
+// generic routines.  The complex multiplies and the s16 split/scale must be
+// bit-identical, and any mismatch fails.  The one exception is a build that
+// lets the compiler generate FMAs (e.g. -march=native): then the scalar tails
+// of the kernels may be fused, and results need only agree to within
+// FMAULPS ulp of the larger partial product.  sin/cos use a polynomial and
+// must agree with sinf/cosf to within a small absolute tolerance.
+//
+// ./genericsimd_test
+
+#if (ARCH == GENERIC)
+
+static const int TESTLENGTHS[] = {0, 1, 3, 7, 8, 15, 16, 17, 31, 64, 129, 1000};
+static const int NUMTESTLENGTHS = sizeof(TESTLENGTHS)/sizeof(int);
+static const int MAXLENGTH = 1000;
+static const f32 SINCOSTOLERANCE = 2.0e-6;
+#ifdef __FMA__
+static const f32 FMAULPS = 2.0;
+#else
+static const f32 FMAULPS = 0.0;
+#endif
+
+static int failures = 0;
+
+static void report(const char * what, genericSimdLevel level, int length, bool ok)
+{
+  if(!ok)
+  {
+    std::cout << "FAIL: " << what << " level=" << genericSimdLevelName(level) << " length=" << length << std::endl;
+    failures++;
+  }
+}
+
+// Exact match, or within FMAULPS ulp of magnitude[i] when FMAs are allowed
+static bool close(const f32 * ref, const f32 * out, const f32 * magnitude, int length, const char * what)
+{
+  for(int i=0;i<length;i++)
+  {
+    if(ref[i] != out[i] && fabs(ref[i] - out[i]) > FMAULPS*FLT_EPSILON*magnitude[i])
+    {
+      std::cout << "  " << what << "[" << i << "] ref=" << ref[i] << " got=" << out[i] << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+static void refMul(const cf32 * a, const cf32 * b, cf32 * dest, f32 * magnitude, int length)
+{
+  for(int i=0;i<length;i++)
+  {
+    f32 rr = a[i].re*b[i].re, ii = a[i].im*b[i].im;
+    f32 ri = a[i].re*b[i].im, ir = a[i].im*b[i].re;
+    dest[i].re = rr - ii;
+    dest[i].im = ri + ir;
+    magnitude[2*i] = fmax(fabs(rr), fabs(ii));
+    magnitude[2*i+1] = fmax(fabs(ri), fabs(ir));
+  }
+}
+
+static f32 randf(f32 range)
+{
+  return range*(2.0f*(f32)rand()/(f32)RAND_MAX - 1.0f);
+}
+
+static void fillcf32(cf32 * v, int length)
+{
+  for(int i=0;i<length;i++)
+  {
+    v[i].re = randf(100.0f);
+    v[i].im = randf(100.0f);
+  }
+}
+
+static void testlevel(genericSimdLevel level)
+{
+  genericSimdKernels k = genericSimdSelectKernels(level);
+  cf32 a[MAXLENGTH], b[MAXLENGTH], prod[MAXLENGTH], ref[MAXLENGTH], out[MAXLENGTH];
+  f32 magnitude[2*MAXLENGTH];
+  f32 arg[MAXLENGTH], refsin[MAXLENGTH], refcos[MAXLENGTH], outsin[MAXLENGTH], outcos[MAXLENGTH];
+  f32 refsplit[4][MAXLENGTH], outsplit[4][MAXLENGTH];
+  f32 splitmagnitude[MAXLENGTH];
+  f32 * outsplitp[4] = {outsplit[0], outsplit[1], outsplit[2], outsplit[3]};
+  s16 raw[4*MAXLENGTH];
+  const f32 splitscale = 2.0/((f32)MAX_S16-(f32)MIN_S16);
+
+  for(int i=0;i<MAXLENGTH;i++)
+    splitmagnitude[i] = 1.0f;
+
+  std::cout << "Testing kernel set " << genericSimdLevelName(k.level) << std::endl;
+  for(int t=0;t<NUMTESTLENGTHS;t++)
+  {
+    int length = TESTLENGTHS[t];
+
+    fillcf32(a, length);
+    fillcf32(b, length);
+    refMul(a, b, prod, magnitude, length);
+    fillcf32(ref, length);
+    memcpy(out, ref, length*sizeof(cf32));
+    for(int i=0;i<length;i++)
+    {
+      ref[i].re += prod[i].re;
+      ref[i].im += prod[i].im;
+      magnitude[2*i] = fmax(magnitude[2*i], fabs(ref[i].re));
+      magnitude[2*i+1] = fmax(magnitude[2*i+1], fabs(ref[i].im));
+    }
+    k.addProduct_32fc(a, b, out, length);
+    report("AddProduct_32fc", level, length, close((f32*)ref, (f32*)out, magnitude, 2*length, "AddProduct_32fc"));
+
+    refMul(a, b, ref, magnitude, length);
+    k.mul_32fc(a, b, out, length);
+    report("Mul_32fc", level, length, close((f32*)ref, (f32*)out, magnitude, 2*length, "Mul_32fc"));
+
+    memcpy(out, a, length*sizeof(cf32));
+    k.mul_32fc_I(b, out, length);
+    report("Mul_32fc_I", level, length, close((f32*)ref, (f32*)out, magnitude, 2*length, "Mul_32fc_I"));
+
+    // phases as used for fringe rotation, plus a few beyond the polynomial range
+    for(int i=0;i<length;i++)
+      arg[i] = randf(200.0f);
+    if(length > 5)
+    {
+      arg[0] = 0.0f;
+      arg[1] = -0.0f;
+      arg[2] = 1.0e5f;
+      arg[3] = -3.0e4f;
+      arg[4] = (f32)(TWO_PI/4.0);
+    }
+    genericSinCos_32f(arg, refsin, refcos, length);
+    k.sinCos_32f(arg, outsin, outcos, length);
+    bool ok = true;
+    for(int i=0;i<length;i++)
+    {
+      if(fabs(refsin[i] - outsin[i]) > SINCOSTOLERANCE || fabs(refcos[i] - outcos[i]) > SINCOSTOLERANCE)
+      {
+        std::cout << "  sincos(" << arg[i] << ") ref=" << refsin[i] << "," << refcos[i] << " got=" << outsin[i] << "," << outcos[i] << std::endl;
+        ok = false;
+      }
+    }
+    report("SinCos_32f", level, length, ok);
+
+    for(int numchannels=1;numchannels<=4;numchannels++)
+    {
+      for(int i=0;i<numchannels*length;i++)
+        raw[i] = (s16)(rand() & 0xFFFF);
+      raw[0] = MIN_S16;
+      raw[1] = MAX_S16;
+      for(int n=0;n<length;n++)
+      {
+        for(int m=0;m<numchannels;m++)
+        {
+          f32 diff = (f32)raw[n*numchannels+m] - (f32)MIN_S16;
+          refsplit[m][n] = -1.0f + splitscale*diff;
+        }
+      }
+      k.splitScaled_16s32f(raw, outsplitp, numchannels, length);
+      ok = true;
+      for(int m=0;m<numchannels;m++)
+        if(!close(refsplit[m], outsplit[m], splitmagnitude, length, "SplitScaled_16s32f"))
+          ok = false;
+      report("SplitScaled_16s32f", level, length, ok);
+    }
+  }
+}
+
+int main(int argc, const char** argv)
+{
+  genericSimdLevel maxlevel = genericSimdDetectLevel();
+
+  srand(42);
+  std::cout << "Highest supported kernel set: " << genericSimdLevelName(maxlevel) << std::endl;
+  std::cout << "Kernel set in use: " << genericSimdLevelName(genericSimdGetKernels().level) << std::endl;
+  for(int l=GENERICSIMD_SCALAR;l<=maxlevel;l++)
+    testlevel((genericSimdLevel)l);
+
+  if(failures > 0)
+  {
+    std::cout << failures << " test(s) failed" << std::endl;
+    return EXIT_FAILURE;
+  }
+  std::cout << "All tests passed" << std::endl;
+
+  return EXIT_SUCCESS;
+}
+
+#else
+
+int main(int argc, const char** argv)
+{
+  std::cout << "genericsimd_test: nothing to test, not a GENERIC architecture build" << std::endl;
+
+  return EXIT_SUCCESS;
+}
+
+#endif
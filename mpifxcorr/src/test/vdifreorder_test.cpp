@@ -0,0 +1,361 @@
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "vdifreorder.h"
+
+// Replays a 4 thread VDIF stream through the reorder ring, with frames
+// displaced by up to DISPLACEMENT frame periods, some dropped, some duplicated
+// and some from an unwanted thread, and checks that the ring puts out every
+// frame set in order with the dropped frames replaced by invalid headers.
+// The stream is replayed twice: from memory, where all counts are exact, and
+// over a UDP socket on the loopback interface into slot sized reads, as the
+// network datastream does.  If the socket cannot be set up that part is
+// skipped.  A short stream with a gap and a jump checks the gap filling and
+// the restart.
+//
+// ./vdifreorder_test
+
+static const int FRAMEBYTES = 1056;
+static const int FRAMESPERSECOND = 1000;
+static const int NTHREADS = 4;
+static const int THREADIDS[NTHREADS] = {0, 1, 3, 5};
+static const int WRONGTHREADID = 7;
+static const int STARTSECOND = 1000;
+static const int NSETS = 5000;			// spans a second boundary several times
+static const int DEPTH = 64;
+static const int DISPLACEMENT = 48;		// < DEPTH, so nothing should arrive late
+static const int SLOTFRAMES = 400;
+
+static int failures = 0;
+
+struct Frame
+{
+	long long key;
+	int set, thread;
+};
+
+static void check(const char * what, bool ok)
+{
+	if(!ok)
+	{
+		std::cout << "FAIL: " << what << std::endl;
+		failures++;
+	}
+}
+
+static bool earlier(const Frame & a, const Frame & b)
+{
+	return a.key < b.key;
+}
+
+static unsigned char pattern(int set, int threadid, int i)
+{
+	return (unsigned char)(set*7 + threadid*13 + i);
+}
+
+static void makeframe(unsigned char * frame, int set, int threadid)
+{
+	vdif_header * vh = (vdif_header *)frame;
+
+	memset(frame, 0, VDIF_HEADER_BYTES);
+	vh->seconds = STARTSECOND + set/FRAMESPERSECOND;
+	vh->frame = set % FRAMESPERSECOND;
+	vh->framelength8 = FRAMEBYTES/8;
+	vh->threadid = threadid;
+	vh->nbits = 1;
+	for(int i=VDIF_HEADER_BYTES;i<FRAMEBYTES;i++)
+		frame[i] = pattern(set, threadid, i);
+}
+
+// The replay schedule: each frame moved later by a random number of frame periods, then every
+// 37th dropped, every 53rd sent twice and every 97th followed by a frame from an unwanted thread
+static std::vector<Frame> makeschedule(int * ndropped, int * nduplicated, int * nwrongthread)
+{
+	std::vector<Frame> frames, schedule;
+
+	for(int s=0;s<NSETS;s++)
+	{
+		for(int t=0;t<NTHREADS;t++)
+		{
+			Frame f;
+			f.set = s;
+			f.thread = THREADIDS[t];
+			f.key = ((long long)s + rand() % (DISPLACEMENT + 1))*NTHREADS + t;
+			frames.push_back(f);
+		}
+	}
+	std::stable_sort(frames.begin(), frames.end(), earlier);
+
+	*ndropped = *nduplicated = *nwrongthread = 0;
+	for(size_t i=0;i<frames.size();i++)
+	{
+		// never drop from the last set, so the end of the output is known
+		if(i % 37 == 11 && frames[i].set < NSETS-1)
+		{
+			(*ndropped)++;
+			continue;
+		}
+		schedule.push_back(frames[i]);
+		if(i % 53 == 7)
+		{
+			schedule.push_back(frames[i]);
+			(*nduplicated)++;
+		}
+		if(i % 97 == 3)
+		{
+			Frame w = frames[i];
+			w.thread = WRONGTHREADID;
+			schedule.push_back(w);
+			(*nwrongthread)++;
+		}
+	}
+
+	return schedule;
+}
+
+// Walks the released frames, which must continue from set *nextset with the threads in order
+static void verify(const char * what, const unsigned char * data, int nframes, int * nextset, long long * nvalid, long long * ninvalid)
+{
+	bool ordered = true, intact = true;
+
+	for(int n=0;n<nframes;n++)
+	{
+		const unsigned char * frame = data + (long long)n*FRAMEBYTES;
+		const vdif_header * vh = (const vdif_header *)frame;
+		int t = n % NTHREADS;
+		int set = (vh->seconds - STARTSECOND)*FRAMESPERSECOND + vh->frame;
+
+		if(set != *nextset || (int)vh->threadid != THREADIDS[t])
+			ordered = false;
+		if(vh->invalid)
+			(*ninvalid)++;
+		else
+		{
+			(*nvalid)++;
+			for(int i=VDIF_HEADER_BYTES;i<FRAMEBYTES;i++)
+				if(frame[i] != pattern(set, vh->threadid, i))
+				{
+					intact = false;
+					break;
+				}
+		}
+		if(t == NTHREADS-1)
+			(*nextset)++;
+	}
+	if(!ordered)
+		std::cout << what << ": frames out of order near set " << *nextset << std::endl;
+	check(what, ordered && intact);
+}
+
+static void replaymemory()
+{
+	std::vector<Frame> schedule;
+	int ndropped, nduplicated, nwrongthread;
+	unsigned char frame[FRAMEBYTES];
+	unsigned char * slot = new unsigned char[SLOTFRAMES*FRAMEBYTES];
+	VDIFReorderRing ring(FRAMEBYTES, FRAMESPERSECOND, NTHREADS, THREADIDS, DEPTH);
+	int nextset = 0, filled, slotbytes = SLOTFRAMES*FRAMEBYTES;
+	long long nvalid = 0, ninvalid = 0;
+	size_t i = 0;
+
+	schedule = makeschedule(&ndropped, &nduplicated, &nwrongthread);
+
+	// fill slot after slot, as VDIFNetworkDataStream::readreorderedVDIF does
+	do
+	{
+		filled = 0;
+		for(;;)
+		{
+			filled += ring.release(slot + filled, slotbytes - filled, false);
+			if(slotbytes - filled < ring.getSetBytes())
+				break;
+			if(i >= schedule.size())
+			{
+				filled += ring.release(slot + filled, slotbytes - filled, true);
+				break;
+			}
+			makeframe(frame, schedule[i].set, schedule[i].thread);
+			if(ring.insert(frame) != VDIFReorderRing::FULL)
+				i++;
+		}
+		verify("memory replay", slot, filled/FRAMEBYTES, &nextset, &nvalid, &ninvalid);
+	} while(filled > 0);
+
+	std::cout << "Memory replay: nFrame=" << ring.getNumFrames() << " nReordered=" << ring.getNumReordered() << " maxReorderDepth=" << ring.getMaxReorderDepth() << " nLate=" << ring.getNumLate() << " nDuplicate=" << ring.getNumDuplicate() << " nWrongThread=" << ring.getNumWrongThread() << " nFilled=" << ring.getNumFilled() << std::endl;
+	check("memory replay: all sets released", nextset == NSETS);
+	check("memory replay: filled frames are the dropped frames", ring.getNumFilled() == ndropped && ninvalid == ndropped);
+	check("memory replay: all other frames released", nvalid == (long long)NSETS*NTHREADS - ndropped && ring.getNumFrames() == nvalid);
+	// a second copy arriving after its set went out (complete) counts as late; nothing else may be late
+	check("memory replay: duplicates", ring.getNumDuplicate() + ring.getNumLate() == nduplicated);
+	check("memory replay: wrong thread", ring.getNumWrongThread() == nwrongthread);
+	check("memory replay: reordering seen", ring.getNumReordered() > 0 && ring.getMaxReorderDepth() <= DISPLACEMENT);
+
+	delete [] slot;
+}
+
+// An in-order stream with a 300 frame gap, which is filled with invalid frames, then a 5 second
+// jump, after which the ring starts again at the new time
+static void replaygaps()
+{
+	unsigned char frame[FRAMEBYTES];
+	unsigned char * out = new unsigned char[2000*NTHREADS*FRAMEBYTES];
+	VDIFReorderRing ring(FRAMEBYTES, FRAMESPERSECOND, NTHREADS, THREADIDS, DEPTH);
+	int sets[] = {0, 100, 400, 500, 5500, 5600};	// pairs of [start, end)
+	int filled = 0, nextset = 0, outbytes = 2000*NTHREADS*FRAMEBYTES;
+	long long nvalid = 0, ninvalid = 0;
+
+	for(int p=0;p<6;p+=2)
+		for(int set=sets[p];set<sets[p+1];set++)
+			for(int t=0;t<NTHREADS;t++)
+			{
+				makeframe(frame, set, THREADIDS[t]);
+				while(ring.insert(frame) == VDIFReorderRing::FULL)
+					filled += ring.release(out + filled, outbytes - filled, false);
+				filled += ring.release(out + filled, outbytes - filled, false);
+			}
+	filled += ring.release(out + filled, outbytes - filled, true);
+
+	verify("gap replay before jump", out, 500*NTHREADS, &nextset, &nvalid, &ninvalid);
+	check("gap replay: gap filled", nvalid == 200*NTHREADS && ninvalid == 300*NTHREADS);
+	nextset = 5500;
+	verify("gap replay after jump", out + 500*NTHREADS*FRAMEBYTES, filled/FRAMEBYTES - 500*NTHREADS, &nextset, &nvalid, &ninvalid);
+	check("gap replay: resync", nextset == 5600 && ring.getNumResync() == 1 && ring.getNumFilled() == 300*NTHREADS);
+
+	delete [] out;
+}
+
+struct SenderArgs
+{
+	int port;
+	const std::vector<Frame> * schedule;
+};
+
+static void * sender(void * arg)
+{
+	const SenderArgs * a = (const SenderArgs *)arg;
+	struct sockaddr_in addr;
+	unsigned char frame[FRAMEBYTES];
+	int s;
+
+	s = socket(AF_INET, SOCK_DGRAM, 0);
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(a->port);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	for(size_t i=0;i<a->schedule->size();i++)
+	{
+		makeframe(frame, (*a->schedule)[i].set, (*a->schedule)[i].thread);
+		sendto(s, frame, FRAMEBYTES, 0, (struct sockaddr *)&addr, sizeof(addr));
+		if(i % 64 == 63)
+			usleep(2000);	// stay well inside the socket buffer
+	}
+	close(s);
+
+	return 0;
+}
+
+// As VDIFNetworkDataStream::readreorderedVDIF, with one datagram per recv
+static int readslot(int s, VDIFReorderRing & ring, unsigned char * slot, unsigned char * pending, bool * havepending)
+{
+	int slotbytes = SLOTFRAMES*FRAMEBYTES;
+	int filled = 0;
+
+	for(;;)
+	{
+		filled += ring.release(slot + filled, slotbytes - filled, false);
+		if(slotbytes - filled < ring.getSetBytes())
+			break;
+		if(!*havepending)
+		{
+			if(recv(s, pending, FRAMEBYTES, 0) != FRAMEBYTES)
+			{
+				filled += ring.release(slot + filled, slotbytes - filled, true);
+				break;
+			}
+			*havepending = true;
+		}
+		if(ring.insert(pending) != VDIFReorderRing::FULL)
+			*havepending = false;
+	}
+
+	return filled;
+}
+
+static void replayloopback()
+{
+	std::vector<Frame> schedule;
+	int ndropped, nduplicated, nwrongthread;
+	unsigned char pending[FRAMEBYTES];
+	unsigned char * slot = new unsigned char[SLOTFRAMES*FRAMEBYTES];
+	VDIFReorderRing ring(FRAMEBYTES, FRAMESPERSECOND, NTHREADS, THREADIDS, DEPTH);
+	struct sockaddr_in addr;
+	socklen_t addrlen = sizeof(addr);
+	struct timeval tv;
+	int s, filled, bufbytes = 16*1024*1024, nextset = 0;
+	long long nvalid = 0, ninvalid = 0;
+	bool havepending = false;
+	SenderArgs args;
+	pthread_t senderthread;
+
+	schedule = makeschedule(&ndropped, &nduplicated, &nwrongthread);
+
+	s = socket(AF_INET, SOCK_DGRAM, 0);
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if(s < 0 || bind(s, (struct sockaddr *)&addr, sizeof(addr)) < 0 || getsockname(s, (struct sockaddr *)&addr, &addrlen) < 0)
+	{
+		std::cout << "Loopback replay skipped: cannot set up a UDP socket" << std::endl;
+		delete [] slot;
+		return;
+	}
+	tv.tv_sec = 0;
+	tv.tv_usec = 500000;
+	setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+	setsockopt(s, SOL_SOCKET, SO_RCVBUF, &bufbytes, sizeof(bufbytes));
+
+	args.port = ntohs(addr.sin_port);
+	args.schedule = &schedule;
+	pthread_create(&senderthread, 0, sender, &args);
+	do
+	{
+		filled = readslot(s, ring, slot, pending, &havepending);
+		verify("loopback replay", slot, filled/FRAMEBYTES, &nextset, &nvalid, &ninvalid);
+	} while(filled > 0);
+	pthread_join(senderthread, 0);
+	close(s);
+
+	// the loopback interface may itself drop datagrams, so allow for more missing frames
+	std::cout << "Loopback replay: nFrame=" << ring.getNumFrames() << " nReordered=" << ring.getNumReordered() << " maxReorderDepth=" << ring.getMaxReorderDepth() << " nLate=" << ring.getNumLate() << " nDuplicate=" << ring.getNumDuplicate() << " nWrongThread=" << ring.getNumWrongThread() << " nFilled=" << ring.getNumFilled() << std::endl;
+	check("loopback replay: sets released", nextset > 0 && nextset <= NSETS);
+	check("loopback replay: only duplicates late", ring.getNumDuplicate() + ring.getNumLate() <= nduplicated);
+	check("loopback replay: counts agree", ring.getNumFrames() == nvalid && ring.getNumFilled() == ninvalid && nvalid + ninvalid == (long long)nextset*NTHREADS);
+	check("loopback replay: dropped frames filled", ninvalid >= (nextset == NSETS ? ndropped : 0));
+
+	delete [] slot;
+}
+
+int main(int argc, const char** argv)
+{
+	srand(42);
+	replaymemory();
+	replaygaps();
+	replayloopback();
+
+	if(failures > 0)
+	{
+		std::cout << failures << " test(s) failed" << std::endl;
+		return EXIT_FAILURE;
+	}
+	std::cout << "All tests passed" << std::endl;
+
+	return EXIT_SUCCESS;
+}
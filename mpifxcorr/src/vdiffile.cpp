@@ -97,6 +97,19 @@ VDIFDataStream::VDIFDataStream(const Configuration * conf, int snum, int id, int
 	minleftoverdata = 20000;
 
 	resetvdifmuxstatistics(&vstats);
+	muxpool = 0;
+	if(conf->getVDIFMuxThreads() > 1)
+	{
+		muxpool = newvdifmuxpool(conf->getVDIFMuxThreads());
+		if(muxpool == 0)
+		{
+			cerror << startl << "Could not create a pool of " << conf->getVDIFMuxThreads() << " VDIF multiplexing threads; will multiplex in the read thread only" << endl;
+		}
+		else
+		{
+			cinfo << startl << "VDIF multiplexing will use " << getvdifmuxpoolthreads(muxpool) << " threads" << endl;
+		}
+	}
 	nthreads = 0; // no threads identified yet
 	threads = 0;  // null pointer indicating not yet initialized
 	invalidtime = 0;
@@ -145,6 +158,7 @@ VDIFDataStream::~VDIFDataStream()
 	}
 	delete [] readthreadmutex;
 	delete [] slotMutexOwner;
+	deletevdifmuxpool(muxpool);
 
 	cinfo << startl << "VDIF multiplexing statistics: nValidFrame=" << vstats.nValidFrame << " nInvalidFrame=" << vstats.nInvalidFrame << " nDiscardedFrame=" << vstats.nDiscardedFrame << " nWrongThread=" << vstats.nWrongThread << " nSkippedByte=" << vstats.nSkippedByte << " nFillByte=" << vstats.nFillByte << " nDuplicateFrame=" << vstats.nDuplicateFrame << " bytesProcessed=" << vstats.bytesProcessed << " nGoodFrame=" << vstats.nGoodFrame << " nCall=" << vstats.nCall << endl;
 	if(vstats.nWrongThread > 0)
@@ -742,7 +756,7 @@ int VDIFDataStream::dataRead(int buffersegment)
 	bytesvisible = muxend - muxindex;
 
 	// multiplex and corner turn the data
-	muxReturn = vdifmux(destination, readbytes, readbuffer+muxindex, bytesvisible, &vm, startOutputFrameNumber, &vstats);
+	muxReturn = vdifmuxparallel(destination, readbytes, readbuffer+muxindex, bytesvisible, &vm, startOutputFrameNumber, &vstats, muxpool);
 
 	if(muxReturn <= 0)
 	{
@@ -895,6 +909,7 @@ void VDIFDataStream::diskToMemory(int buffersegment)
 
 	//do the buffer housekeeping
 	waitForBuffer(buffersegment);
+	StageTimer timer(readprofile, StageProfile::DISKREAD);
 
 	// This function call abstracts away all the details.  The result is multiplexed data populating the 
 	// desired buffer segment.
@@ -109,6 +109,7 @@ protected:
   int nSort, nGap;  // muxer tuning parameters
   struct vdif_mux vm;
   struct vdif_mux_statistics vstats;
+  struct vdif_mux_pool *muxpool;	// threads sharing the corner turning; 0 if the read thread muxes alone
   long long startOutputFrameNumber;
   int invalidtime;
   double jobEndMJD;
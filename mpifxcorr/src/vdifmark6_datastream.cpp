@@ -68,6 +68,15 @@ void VDIFMark6DataStream::closeMark6()
 	if(mark6gather != 0)
 	{
 		sendMark6Activity(MARK6_STATE_CLOSE, bytecount, vdifmjd, mbyterate * 8.0);
+		for(int f = 0; f < mark6gather->nFile; ++f)
+		{
+			const Mark6File *F = mark6gather->mk6Files + f;
+
+			if(F->nBlockRead > 0)
+			{
+				cinfo << startl << "Mark6 file " << F->fileName << ": " << F->nBlockRead << " blocks, " << (F->nByteRead/1000000) << " MB read at " << ((F->readSeconds > 0.0) ? F->nByteRead*1.0e-6/F->readSeconds : 0.0) << " MB/s; gatherer waited " << F->nReadWait << " times for " << F->waitSeconds << " s" << endl;
+			}
+		}
 		closeMark6Gatherer(mark6gather);
 	}
 	mark6gather = 0;
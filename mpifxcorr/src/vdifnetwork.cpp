@@ -31,6 +31,10 @@
 #include <cmath>
 #include <sys/time.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
+#ifdef __linux__
+#include <linux/if_packet.h>
+#endif
 #include <mpi.h>
 #include <unistd.h>
 #include <vdifio.h>
@@ -68,6 +72,32 @@ VDIFNetworkDataStream::VDIFNetworkDataStream(const Configuration * conf, int snu
 	cinfo << startl << "VDIFNetworkDataStream::VDIFNetworkDataStream: Set readbuffersize to " << readbuffersize << endl;
 	cinfo << startl << "mdb = " << conf->getMaxDataBytes(streamnum) << "  rbslots=" << readbufferslots << "  readbufferslotsize=" << readbufferslotsize << endl;
 
+	// set up batched receive of raw packets
+	rxmsgs = 0;
+	rxiov = 0;
+	rxscratch = 0;
+	nRxBatch = nRxPacket = nRxRejected = nRxKernelDrop = 0;
+	maxRxBatch = 0;
+	nRxDropWarn = 0;
+#ifdef __linux__
+	networkbatch = conf->getNetworkBatch();
+#else
+	networkbatch = 1;
+#endif
+	if(raw && networkbatch > 1)
+	{
+		rxmsgs = new struct mmsghdr[networkbatch];
+		rxiov = new struct iovec[3*networkbatch];
+		rxscratch = new char[MaxRawPacketSize];
+		memset(rxmsgs, 0, networkbatch*sizeof(struct mmsghdr));
+		cinfo << startl << "Raw network packets will be received up to " << networkbatch << " at a time" << endl;
+	}
+
+	// the reorder ring needs the thread map, so it is made in initialiseFile()
+	reorderring = 0;
+	stagingbuffer = 0;
+	stagingbytes = staginglength = stagingindex = 0;
+
 	// set up network reader thread
 	networkthreadstop = false;
 	lockstart = lockend = lastslot = -2;
@@ -115,23 +145,68 @@ VDIFNetworkDataStream::~VDIFNetworkDataStream()
 	}
 	delete [] networkthreadmutex;
 	pthread_barrier_destroy(&networkthreadbarrier);
+
+	if(nRxBatch > 0)
+	{
+		cinfo << startl << "Raw network receive statistics: nBatch=" << nRxBatch << " nPacket=" << nRxPacket << " meanBatch=" << (double)nRxPacket/nRxBatch << " maxBatch=" << maxRxBatch << " nRejected=" << nRxRejected << " nKernelDrop=" << nRxKernelDrop << endl;
+	}
+	delete [] rxmsgs;
+	delete [] rxiov;
+	delete [] rxscratch;
+
+	if(reorderring)
+	{
+		cinfo << startl << "VDIF reorder statistics: nFrame=" << reorderring->getNumFrames() << " nReordered=" << reorderring->getNumReordered() << " maxReorderDepth=" << reorderring->getMaxReorderDepth() << " nLate=" << reorderring->getNumLate() << " nDuplicate=" << reorderring->getNumDuplicate() << " nWrongThread=" << reorderring->getNumWrongThread() << " nFilled=" << reorderring->getNumFilled() << " nResync=" << reorderring->getNumResync() << endl;
+		delete reorderring;
+	}
+	delete [] stagingbuffer;
+}
+
+void VDIFNetworkDataStream::checkvdifclock(const vdif_header *vh)
+{
+	if( (vh->frame == 0) && (vh->threadid == 0) && (vh->seconds % 10 == 0) )
+	{
+		/* first frame of the 10 second interval.  Compare with local clock time for kicks */
+		struct timespec ck;
+		double deltat;		// [sec]
+
+#ifdef __MACH__                 // OS X does not have clock_gettime, use gettimeofday
+		struct timeval now;
+		int status;
+		status = gettimeofday(&now, NULL);
+		ck.tv_sec = now.tv_sec;
+		ck.tv_nsec = now.tv_usec*1000;
+#else
+		clock_gettime(CLOCK_REALTIME, &ck);
+#endif
+		deltat = (ck.tv_sec % 10) - (vh->seconds % 10);
+		deltat += ck.tv_nsec*1.0e-9;
+		if(deltat < -3.0)
+		{
+			deltat += 10.0;
+		}
+		if(deltat > 5)
+		{
+			deltat -= 10.0;
+		}
+		int p = cinfo.precision();
+		cinfo.precision(6);
+		cinfo << startl << "VDIF clock is " << deltat << " seconds behind system clock for antenna " << stationname << endl;
+		cinfo.precision(p);
+	}
 }
 
 int VDIFNetworkDataStream::readrawnetworkVDIF(int sock, char* ptr, int bytestoread, unsigned int* nread, int packetsize, int stripbytes)
 {
-	const int MaxPacketSize = 20000;
 	int length;
 	int goodbytes = packetsize - stripbytes;
 	char *ptr0 = ptr;
 	char *end = ptr + bytestoread - goodbytes;
-	char workbuffer[MaxPacketSize];
-	const vdif_header *vh;
+	char workbuffer[MaxRawPacketSize];
 
-	vh = reinterpret_cast<const vdif_header *>(workbuffer + stripbytes);
-
-	if(packetsize > MaxPacketSize)
+	if(packetsize > MaxRawPacketSize)
 	{
-		cfatal << startl << "Error: readrawnetworkVDIF wants to read packets of size " << packetsize << " where MaxPacketSize=" << MaxPacketSize << endl;
+		cfatal << startl << "Error: readrawnetworkVDIF wants to read packets of size " << packetsize << " where MaxPacketSize=" << MaxRawPacketSize << endl;
 		MPI_Abort(MPI_COMM_WORLD, 1);
 	}
 
@@ -139,7 +214,7 @@ int VDIFNetworkDataStream::readrawnetworkVDIF(int sock, char* ptr, int bytestore
 
 	while(ptr <= end)
 	{
-		length = recvfrom(sock, workbuffer, MaxPacketSize, 0, 0, 0);
+		length = recvfrom(sock, workbuffer, MaxRawPacketSize, 0, 0, 0);
 		if(length <= 0)
 		{
 			// timeout on read?
@@ -148,47 +223,208 @@ int VDIFNetworkDataStream::readrawnetworkVDIF(int sock, char* ptr, int bytestore
 		else if(length == packetsize)
 		{
 			memcpy(ptr, workbuffer + stripbytes, goodbytes);
+			checkvdifclock(reinterpret_cast<const vdif_header *>(ptr));
 			ptr += goodbytes;
+		}
+	}
+
+	if(nread)
+	{
+		*nread = ptr - ptr0;
+	}
+
+	return 1;
+}
+
+/* As readrawnetworkVDIF but takes up to networkbatch packets per system call.  Each packet is
+ * scattered by the kernel straight into place: the stripped header bytes and anything beyond
+ * packetsize go to a scratch buffer and the payload goes into the next free frame of the slot.
+ * A packet of the wrong size leaves a hole that is closed up by moving the later frames down.
+ */
+int VDIFNetworkDataStream::readrawnetworkVDIFbatch(int sock, char* ptr, int bytestoread, unsigned int* nread, int packetsize, int stripbytes)
+{
+#ifdef __linux__
+	int goodbytes = packetsize - stripbytes;
+	char *ptr0 = ptr;
+	int nfree = bytestoread / goodbytes;		// number of frames that still fit in the slot
+	int nBatch = 0, nPacket = 0, nRejected = 0;
+	unsigned int nKernelDrop = 0;
+	struct tpacket_stats st;
+	socklen_t stlen = sizeof(st);
+
+	if(packetsize > MaxRawPacketSize)
+	{
+		cfatal << startl << "Error: readrawnetworkVDIFbatch wants to read packets of size " << packetsize << " where MaxPacketSize=" << MaxRawPacketSize << endl;
+		MPI_Abort(MPI_COMM_WORLD, 1);
+	}
+
+	*nread = 0;
 
-			if( (vh->frame == 0) && (vh->threadid == 0) && (vh->seconds % 10 == 0) )
+	while(nfree > 0)
+	{
+		int n, m;
+		char *dest;
+
+		n = (nfree < networkbatch) ? nfree : networkbatch;
+		for(int i = 0; i < n; ++i)
+		{
+			struct iovec *iov = rxiov + 3*i;
+
+			iov[0].iov_base = rxscratch;
+			iov[0].iov_len = stripbytes;
+			iov[1].iov_base = ptr + i*goodbytes;
+			iov[1].iov_len = goodbytes;
+			iov[2].iov_base = rxscratch;
+			iov[2].iov_len = MaxRawPacketSize;
+			rxmsgs[i].msg_hdr.msg_iov = (stripbytes > 0) ? iov : iov + 1;
+			rxmsgs[i].msg_hdr.msg_iovlen = (stripbytes > 0) ? 3 : 2;
+		}
+
+		// wait (up to the socket timeout) for the first packet, then take whatever else is queued
+		m = recvmmsg(sock, rxmsgs, n, MSG_WAITFORONE, 0);
+		if(m <= 0)
+		{
+			// timeout on read?
+			break;
+		}
+		++nBatch;
+		nPacket += m;
+		if(m > maxRxBatch)
+		{
+			maxRxBatch = m;
+		}
+
+		dest = ptr;
+		for(int i = 0; i < m; ++i)
+		{
+			char *src = ptr + i*goodbytes;
+
+			if(rxmsgs[i].msg_len != static_cast<unsigned int>(packetsize) || (rxmsgs[i].msg_hdr.msg_flags & MSG_TRUNC))
+			{
+				++nRejected;
+				continue;
+			}
+			if(dest != src)
 			{
-				/* first frame of the 10 second interval.  Compare with local clock time for kicks */
-				struct timespec ck;
-				double deltat;		// [sec]
+				memmove(dest, src, goodbytes);
+			}
+			checkvdifclock(reinterpret_cast<const vdif_header *>(dest));
+			dest += goodbytes;
+		}
+		ptr = dest;
+		nfree = (ptr0 + bytestoread - ptr) / goodbytes;
+	}
 
-#ifdef __MACH__                 // OS X does not have clock_gettime, use gettimeofday
-				struct timeval now;
-				int status;
-				status = gettimeofday(&now, NULL);
-				ck.tv_sec = now.tv_sec;
-				ck.tv_nsec = now.tv_usec*1000;
+	// reading the packet socket statistics also resets them, so this is the count since the last slot
+	if(getsockopt(sock, SOL_PACKET, PACKET_STATISTICS, &st, &stlen) == 0)
+	{
+		nKernelDrop = st.tp_drops;
+	}
+
+	nRxBatch += nBatch;
+	nRxPacket += nPacket;
+	nRxRejected += nRejected;
+	nRxKernelDrop += nKernelDrop;
+
+	if(nKernelDrop > 0)
+	{
+		++nRxDropWarn;
+		if( (nRxDropWarn & (nRxDropWarn - 1)) == 0)
+		{
+			cwarn << startl << "Kernel dropped " << nKernelDrop << " raw packets while filling a read slot for antenna " << stationname << "; nBatch=" << nBatch << " nPacket=" << nPacket << " maxBatch=" << maxRxBatch << " N=" << nRxDropWarn << endl;
+		}
+	}
+	cverbose << startl << "Raw network slot: nBatch=" << nBatch << " nPacket=" << nPacket << " meanBatch=" << ((nBatch > 0) ? (double)nPacket/nBatch : 0.0) << " nRejected=" << nRejected << " nKernelDrop=" << nKernelDrop << endl;
+
+	if(nread)
+	{
+		*nread = ptr - ptr0;
+	}
+
+	return 1;
 #else
-				clock_gettime(CLOCK_REALTIME, &ck);
+	return readrawnetworkVDIF(sock, ptr, bytestoread, nread, packetsize, stripbytes);
 #endif
-				deltat = (ck.tv_sec % 10) - (vh->seconds % 10);
-				deltat += ck.tv_nsec*1.0e-9;
-				if(deltat < -3.0)
+}
+
+/* Fills the slot with frames in time order.  Frames are received into a staging buffer as
+ * usual and then placed in the reorder ring by their time and thread; whole frame sets come out
+ * of the ring once complete or once they are too old to wait for.  Frames left in the staging
+ * buffer when the slot is full are used for the next slot.
+ */
+int VDIFNetworkDataStream::readreorderedVDIF(int sock, char* ptr, int bytestoread, unsigned int* nread, int packetsize, int stripbytes)
+{
+	int framebytes = reorderring->getFrameBytes();
+	int setbytes = reorderring->getSetBytes();
+	long long nLate0 = reorderring->getNumLate();
+	long long nFilled0 = reorderring->getNumFilled();
+	long long nFrame0 = reorderring->getNumFrames();
+	unsigned char *dest = reinterpret_cast<unsigned char *>(ptr);
+	int filled = 0;
+	int status = 1;
+
+	for(;;)
+	{
+		filled += reorderring->release(dest + filled, bytestoread - filled, false);
+		if(bytestoread - filled < setbytes)
+		{
+			break;
+		}
+		if(stagingindex >= staginglength)
+		{
+			unsigned int bytes = 0;
+
+			if(raw)
+			{
+				if(rxmsgs)
 				{
-					deltat += 10.0;
+					status = readrawnetworkVDIFbatch(sock, reinterpret_cast<char *>(stagingbuffer), stagingbytes, &bytes, packetsize, stripbytes);
 				}
-				if(deltat > 5)
+				else
 				{
-					deltat -= 10.0;
+					status = readrawnetworkVDIF(sock, reinterpret_cast<char *>(stagingbuffer), stagingbytes, &bytes, packetsize, stripbytes);
 				}
-				int p = cinfo.precision();
-				cinfo.precision(6);
-				cinfo << startl << "VDIF clock is " << deltat << " seconds behind system clock for antenna " << stationname << endl;
-				cinfo.precision(p);
 			}
+			else
+			{
+				status = readnetwork(sock, reinterpret_cast<char *>(stagingbuffer), stagingbytes, &bytes);
+			}
+			staginglength = bytes - (bytes % framebytes);
+			stagingindex = 0;
+			if(staginglength == 0)
+			{
+				// nothing more arrived: stop waiting for the frames still missing
+				filled += reorderring->release(dest + filled, bytestoread - filled, true);
+				break;
+			}
+		}
+		while(stagingindex < staginglength)
+		{
+			if(reorderring->insert(stagingbuffer + stagingindex) == VDIFReorderRing::FULL)
+			{
+				break;
+			}
+			stagingindex += framebytes;
 		}
 	}
 
+	if(reorderring->getNumLate() > nLate0 || reorderring->getNumFilled() > nFilled0)
+	{
+		int nLossWarn = reorderring->countLossWarning();
+
+		if( (nLossWarn & (nLossWarn - 1)) == 0)
+		{
+			cwarn << startl << "VDIF reorder for antenna " << stationname << ": " << (reorderring->getNumFilled() - nFilled0) << " frames missing and " << (reorderring->getNumLate() - nLate0) << " arrived too late in this slot; totals nFilled=" << reorderring->getNumFilled() << " nLate=" << reorderring->getNumLate() << " maxReorderDepth=" << reorderring->getMaxReorderDepth() << " N=" << nLossWarn << endl;
+		}
+	}
+	cverbose << startl << "VDIF reorder slot: nFrame=" << (reorderring->getNumFrames() - nFrame0) << " nReordered=" << reorderring->getNumReordered() << " maxReorderDepth=" << reorderring->getMaxReorderDepth() << " nResync=" << reorderring->getNumResync() << endl;
+
 	if(nread)
 	{
-		*nread = ptr - ptr0;
+		*nread = filled;
 	}
 
-	return 1;
+	return status;
 }
 
 // this function implements the network reader.  It is continuously either filling data into a ring buffer or waiting for a mutex to clear.
@@ -227,7 +463,12 @@ void VDIFNetworkDataStream::networkthreadfunction()
 			int status;
 
 			// This is where the actual read from the network happens
-			if(tcp || udp)
+			if(reorderring)
+			{
+				// Raw socket or UDP, with frames put back in time order
+				status = readreorderedVDIF(socketnumber, (char *)(readbuffer + readbufferwriteslot*readbufferslotsize), readbufferslotsize, &bytes, packetsize, stripbytes);
+			}
+			else if(tcp || udp)
 			{
 				// TCP or regular UDP
 				status = readnetwork(socketnumber, (char *)(readbuffer + readbufferwriteslot*readbufferslotsize), readbufferslotsize, &bytes);
@@ -235,7 +476,14 @@ void VDIFNetworkDataStream::networkthreadfunction()
 			else if(raw)
 			{
 				// Raw socket or trimmed UDP
-				status = readrawnetworkVDIF(socketnumber, (char *)(readbuffer + readbufferwriteslot*readbufferslotsize), readbufferslotsize, &bytes, packetsize, stripbytes);
+				if(rxmsgs)
+				{
+					status = readrawnetworkVDIFbatch(socketnumber, (char *)(readbuffer + readbufferwriteslot*readbufferslotsize), readbufferslotsize, &bytes, packetsize, stripbytes);
+				}
+				else
+				{
+					status = readrawnetworkVDIF(socketnumber, (char *)(readbuffer + readbufferwriteslot*readbufferslotsize), readbufferslotsize, &bytes, packetsize, stripbytes);
+				}
 			}
 
 			if(bytes == 0)
@@ -355,6 +603,21 @@ void VDIFNetworkDataStream::initialiseFile(int configindex, int fileindex)
 
 	cinfo << startl << "VDIFNetworkDataStream::initialiseFile format=" << formatname << endl;
 
+	if(config->getVDIFReorderDepth() > 0 && (raw || udp) && reorderring == 0)
+	{
+		// ~1/8 of a read slot is received at a time before being sorted into the ring
+		stagingbytes = readbufferslotsize/8;
+		stagingbytes -= stagingbytes % inputframebytes;
+		if(stagingbytes < inputframebytes)
+		{
+			stagingbytes = inputframebytes;
+		}
+		stagingbuffer = new unsigned char[stagingbytes];
+		staginglength = stagingindex = 0;
+		reorderring = new VDIFReorderRing(inputframebytes, framespersecond, nthreads, threads, config->getVDIFReorderDepth());
+		cinfo << startl << "VDIF frames will be reordered over up to " << config->getVDIFReorderDepth() << " frame periods" << endl;
+	}
+
 	/* update all the configs to ensure that the nsincs and
 	 * headerbytes are correct
 	 */
@@ -455,7 +718,7 @@ int VDIFNetworkDataStream::dataRead(int buffersegment)
 //cverbose << "About to mux " << readbytes << " from slot(s) " << n1 << "-" << n2 << endl;
 
 	// multiplex and corner turn the data
-	muxReturn = vdifmux(destination, readbytes, readbuffer+muxindex, bytesvisible, &vm, startOutputFrameNumber, &vstats);
+	muxReturn = vdifmuxparallel(destination, readbytes, readbuffer+muxindex, bytesvisible, &vm, startOutputFrameNumber, &vstats, muxpool);
 
 	if(muxReturn <= 0)
 	{
@@ -482,7 +745,7 @@ int VDIFNetworkDataStream::dataRead(int buffersegment)
 
 		muxindex += vm.frameGranularity*vm.inputFrameSize;
 		bytesvisible -= vm.frameGranularity*vm.inputFrameSize;
-		muxReturn = vdifmux(destination, readbytes, readbuffer+muxindex, bytesvisible, &vm, startOutputFrameNumber, &vstats);
+		muxReturn = vdifmuxparallel(destination, readbytes, readbuffer+muxindex, bytesvisible, &vm, startOutputFrameNumber, &vstats, muxpool);
 		if(muxReturn < 0)
 		{
 			dataremaining = false;
@@ -35,12 +35,16 @@
 #include "config.h"
 
 #include "vdiffile.h"
+#include "vdifreorder.h"
 #include <difxmessage.h>
 
 #ifdef __APPLE__
 #include "pthreadbarrier_osx.h"
 #endif
 
+struct mmsghdr;
+struct iovec;
+
 class VDIFNetworkDataStream : public VDIFDataStream
 {
 public:
@@ -51,10 +55,15 @@ protected:
 	virtual int dataRead(int buffersegment);
 	static void *launchnetworkthreadfunction(void *self);
 	int readrawnetworkVDIF(int sock, char* ptr, int bytestoread, unsigned int* nread, int packetsize, int stripbytes);
+	int readrawnetworkVDIFbatch(int sock, char* ptr, int bytestoread, unsigned int* nread, int packetsize, int stripbytes);
+	int readreorderedVDIF(int sock, char* ptr, int bytestoread, unsigned int* nread, int packetsize, int stripbytes);
+	void checkvdifclock(const vdif_header *vh);
 	void networkthreadfunction();
 	virtual void loopnetworkread();
 
 private:
+	static const int MaxRawPacketSize = 20000;
+
 	int readbufferslots;
 	unsigned int readbufferslotsize;
 	pthread_t networkthread;
@@ -69,6 +78,21 @@ private:
 	// network parameters
 	int sock;
 	int skipbytes;		// number of bytes to trim off beginning of packets
+
+	// batched raw receive (Linux recvmmsg); used when networkbatch > 1
+	int networkbatch;	// maximum packets per recvmmsg call
+	struct mmsghdr *rxmsgs;
+	struct iovec *rxiov;	// 3 per packet: stripped header, payload (in readbuffer), oversize tail
+	char *rxscratch;	// sink for the stripped headers and oversize tails
+	long long nRxBatch, nRxPacket, nRxRejected, nRxKernelDrop;
+	int maxRxBatch;
+	int nRxDropWarn;	// read slots with kernel drops; warnings are given for the 1st, 2nd, 4th, ...
+
+	// reordering of frames by time (DIFX_VDIF_REORDER_DEPTH); raw and UDP only
+	VDIFReorderRing *reorderring;
+	unsigned char *stagingbuffer;	// frames as received, waiting to go into the reorder ring
+	int stagingbytes;
+	int staginglength, stagingindex;
 };
 
 #endif
@@ -0,0 +1,241 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by Walter Brisken                                  *
+ *                                                                         *
+ *   This program is free software: you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation, either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+//===========================================================================
+// SVN properties (DO NOT CHANGE)
+//
+// $Id$
+// $HeadURL$
+// $LastChangedRevision$
+// $Author$
+// $LastChangedDate$
+//
+//============================================================================
+
+#include <cstring>
+#include "vdifreorder.h"
+
+VDIFReorderRing::VDIFReorderRing(int framebytes, int framespersecond, int nthreads, const int *threadids, int depth) :
+	framebytes(framebytes), framespersecond(framespersecond), nthreads(nthreads), depth(depth)
+{
+	if(this->depth < 1)
+	{
+		this->depth = 1;
+	}
+	ringsets = 2*(this->depth + 1);
+
+	this->threadids = new int[nthreads];
+	for(int t = 0; t <= MaxThreadId; ++t)
+	{
+		threadposition[t] = -1;
+	}
+	for(int t = 0; t < nthreads; ++t)
+	{
+		this->threadids[t] = threadids[t];
+		if(threadids[t] >= 0 && threadids[t] <= MaxThreadId)
+		{
+			threadposition[threadids[t]] = t;
+		}
+	}
+
+	ring = new unsigned char[(long long)ringsets*nthreads*framebytes];
+	present = new unsigned char[ringsets*nthreads];
+	setcount = new int[ringsets];
+	memset(present, 0, ringsets*nthreads);
+	memset(setcount, 0, ringsets*sizeof(int));
+
+	head = newest = blocked = -1;
+	nReleased = 0;
+	resync = false;
+	memset(templateheader, 0, VDIF_HEADER_BYTES);
+	templateheaderbytes = VDIF_HEADER_BYTES;
+
+	nFrame = nReordered = nLate = nDuplicate = nWrongThread = nFilled = nResync = 0;
+	maxReorderDepth = 0;
+	nLossWarn = 0;
+}
+
+VDIFReorderRing::~VDIFReorderRing()
+{
+	delete [] ring;
+	delete [] present;
+	delete [] setcount;
+	delete [] threadids;
+}
+
+VDIFReorderRing::InsertResult VDIFReorderRing::insert(const unsigned char *frame)
+{
+	const vdif_header *vh = reinterpret_cast<const vdif_header *>(frame);
+	int t, r;
+	long long s;
+
+	t = threadposition[vh->threadid];
+	if(t < 0)
+	{
+		++nWrongThread;
+
+		return WRONGTHREAD;
+	}
+	if(resync)
+	{
+		// the ring has to be emptied by release() first
+		return FULL;
+	}
+
+	s = static_cast<long long>(vh->seconds)*framespersecond + vh->frame;
+
+	if(head < 0)
+	{
+		head = newest = s;
+		templateheaderbytes = getVDIFHeaderBytes(vh);
+		memcpy(templateheader, frame, templateheaderbytes);
+	}
+	else if(s < head && nReleased == 0 && newest - s < ringsets)
+	{
+		// nothing released yet, so the stream can still start earlier than its first frame
+		head = s;
+	}
+	else if(s < head)
+	{
+		if(head - s > ringsets)
+		{
+			// stream went back in time
+			resync = true;
+
+			return FULL;
+		}
+		++nLate;
+
+		return LATE;
+	}
+	else if(s - newest > framespersecond)
+	{
+		// more than a second ahead: don't fill that gap, start again
+		resync = true;
+
+		return FULL;
+	}
+	else if(s - head >= ringsets)
+	{
+		if(s > blocked)
+		{
+			blocked = s;
+		}
+
+		return FULL;
+	}
+
+	r = s % ringsets;
+	if(present[r*nthreads + t])
+	{
+		++nDuplicate;
+
+		return DUPLICATE;
+	}
+	memcpy(ring + (static_cast<long long>(r)*nthreads + t)*framebytes, frame, framebytes);
+	present[r*nthreads + t] = 1;
+	++setcount[r];
+	++nFrame;
+
+	if(s < newest)
+	{
+		++nReordered;
+		if(newest - s > maxReorderDepth)
+		{
+			maxReorderDepth = newest - s;
+		}
+	}
+	else
+	{
+		newest = s;
+	}
+
+	return INSERTED;
+}
+
+void VDIFReorderRing::releaseset(unsigned char *dest)
+{
+	int r = head % ringsets;
+
+	for(int t = 0; t < nthreads; ++t)
+	{
+		if(present[r*nthreads + t])
+		{
+			memcpy(dest, ring + (static_cast<long long>(r)*nthreads + t)*framebytes, framebytes);
+			present[r*nthreads + t] = 0;
+		}
+		else
+		{
+			// only the header of a missing frame is written; invalid frames are never decoded
+			vdif_header *vh = reinterpret_cast<vdif_header *>(dest);
+
+			memcpy(dest, templateheader, templateheaderbytes);
+			vh->seconds = head / framespersecond;
+			vh->frame = head % framespersecond;
+			vh->threadid = threadids[t];
+			setVDIFFrameInvalid(vh, 1);
+			++nFilled;
+		}
+		dest += framebytes;
+	}
+	setcount[r] = 0;
+}
+
+int VDIFReorderRing::release(unsigned char *dest, int maxbytes, bool flush)
+{
+	int setbytes = nthreads*framebytes;
+	int bytes = 0;
+
+	while(head >= 0 && bytes + setbytes <= maxbytes)
+	{
+		bool makeroom = (blocked >= 0 && blocked - head >= ringsets);
+
+		if(head > newest)
+		{
+			// nothing left in the ring; carry on only to fill a gap before a blocked frame
+			if(!makeroom || resync)
+			{
+				break;
+			}
+		}
+		else if(!(flush || resync || makeroom || newest - head >= depth))
+		{
+			// a complete set may go, except at the start where earlier frames may still come
+			if(setcount[head % ringsets] < nthreads || nReleased == 0)
+			{
+				break;
+			}
+		}
+		releaseset(dest + bytes);
+		bytes += setbytes;
+		++head;
+		++nReleased;
+	}
+
+	if(blocked >= 0 && blocked - head < ringsets)
+	{
+		blocked = -1;
+	}
+	if(resync && head > newest)
+	{
+		head = newest = blocked = -1;
+		nReleased = 0;
+		resync = false;
+		++nResync;
+	}
+
+	return bytes;
+}
@@ -0,0 +1,124 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by Walter Brisken                                  *
+ *                                                                         *
+ *   This program is free software: you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation, either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+//===========================================================================
+// SVN properties (DO NOT CHANGE)
+//
+// $Id$
+// $HeadURL$
+// $LastChangedRevision$
+// $Author$
+// $LastChangedDate$
+//
+//============================================================================
+#ifndef __VDIFREORDER_H__
+#define __VDIFREORDER_H__
+
+#include <vdifio.h>
+
+/**
+@class VDIFReorderRing
+@brief Puts VDIF frames from a network stream back into time order
+
+Each frame is copied to the ring position given by its second, frame number and thread, so frames
+may arrive in any order within the reorder depth.  Frames are released in order, one frame set
+(one frame from each wanted thread) at a time.  A set is released once it is complete, or once
+frames more than depth frame periods newer have arrived; any frame still missing then is replaced
+by a header-only copy of a received header with the invalid bit set.  Frames arriving after their
+set was released are counted and discarded.  A jump of more than one second (or backwards beyond
+the ring) releases everything held and restarts the ring at the new time.
+*/
+class VDIFReorderRing
+{
+public:
+	enum InsertResult
+	{
+		INSERTED = 0,
+		FULL,		///< frame does not fit until release() is called; offer it again afterwards
+		LATE,		///< its frame set has already been released
+		DUPLICATE,
+		WRONGTHREAD
+	};
+
+	/**
+	 * @param framebytes Size of one VDIF frame including header
+	 * @param framespersecond Frames per second per thread
+	 * @param nthreads Number of threads to keep
+	 * @param threadids The VDIF thread ids to keep; frame sets are released in this thread order
+	 * @param depth How many frame periods to wait for a late frame
+	 */
+	VDIFReorderRing(int framebytes, int framespersecond, int nthreads, const int *threadids, int depth);
+	~VDIFReorderRing();
+
+	/**
+	 * Copies one frame into its place in the ring
+	 * @param frame Pointer to the frame, which must be framebytes long
+	 * @return One of InsertResult
+	 */
+	InsertResult insert(const unsigned char *frame);
+
+	/**
+	 * Copies whole frame sets that are ready to dest, in time order
+	 * @param dest Destination
+	 * @param maxbytes Room at dest; only whole frame sets are written
+	 * @param flush If true, release everything held, filling any missing frames
+	 * @return Number of bytes written to dest
+	 */
+	int release(unsigned char *dest, int maxbytes, bool flush);
+
+	inline int getFrameBytes() const { return framebytes; }
+	inline int getSetBytes() const { return nthreads*framebytes; }
+	inline long long getNumFrames() const { return nFrame; }
+	inline long long getNumReordered() const { return nReordered; }
+	inline long long getNumLate() const { return nLate; }
+	inline long long getNumDuplicate() const { return nDuplicate; }
+	inline long long getNumWrongThread() const { return nWrongThread; }
+	inline long long getNumFilled() const { return nFilled; }
+	inline long long getNumResync() const { return nResync; }
+	inline int getMaxReorderDepth() const { return maxReorderDepth; }
+
+	/**
+	 * Counts one more read slot in which frames were lost, for rate limiting warnings about them
+	 * @return Number of such slots so far, including this one
+	 */
+	inline int countLossWarning() { return ++nLossWarn; }
+
+private:
+	static const int MaxThreadId = 1023;	// threadid is a 10 bit field
+
+	void releaseset(unsigned char *dest);
+
+	int framebytes, framespersecond, nthreads, depth;
+	int ringsets;			// ring length in frame sets
+	int *threadids;
+	int threadposition[MaxThreadId+1];	// position within a frame set, or -1 if not wanted
+	unsigned char *ring;		// [ringsets][nthreads][framebytes]
+	unsigned char *present;		// [ringsets][nthreads]
+	int *setcount;			// number of frames present in each set
+	long long head;			// oldest set not yet released; -1 until the first frame
+	long long newest;		// newest set with a frame in the ring
+	long long blocked;		// newest set that was refused with FULL; -1 if none
+	long long nReleased;		// sets released since the ring (re)started
+	bool resync;
+	unsigned char templateheader[VDIF_HEADER_BYTES];
+	int templateheaderbytes;
+
+	long long nFrame, nReordered, nLate, nDuplicate, nWrongThread, nFilled, nResync;
+	int maxReorderDepth;		// in frame periods
+	int nLossWarn;			// see countLossWarning()
+};
+
+#endif
@@ -30,6 +30,9 @@
 #include "core.h"
 #include "datastream.h"
 #include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <climits>
 #include <cerrno>
 #include <cmath>
 #include <set>
@@ -43,6 +46,9 @@
 #include <difxmessage.h>
 #include "alert.h"
 
+//source of the padding between aligned pieces of the indexed output format
+static const char indexedzeropadding[Visibility::INDEXED_ALIGNMENT] = {0};
+
 Visibility::Visibility(Configuration * conf, int id, int numvis, char * dbuffer, int dbufferlen, int eseconds, int scan, int scanstartsec, int startns, const string * pnames)
   : config(conf), visID(id), currentscan(scan), currentstartseconds(scanstartsec), currentstartns(startns), numvisibilities(numvis), executeseconds(eseconds), todiskbufferlength(dbufferlen), polnames(pnames), todiskbuffer(dbuffer)
 {
@@ -51,6 +57,7 @@ Visibility::Visibility(Configuration * conf, int id, int numvis, char * dbuffer,
   //cverbose << startl << "About to create visibility " << id << "/" << numvis << endl;
   estimatedbytes = 0;
   model = config->getModel();
+  writeprofile = StageProfiler::createProfile();
 
   maxproducts = config->getMaxProducts();
   autocorrwidth = 1;
@@ -87,6 +94,17 @@ Visibility::Visibility(Configuration * conf, int id, int numvis, char * dbuffer,
   }
   todiskmemptrs = new int[maxfiles];
   estimatedbytes += maxfiles*4;
+  indexedtables = 0;
+  indexedwritelist = 0;
+  indexedheaders = 0;
+  indexedblockbytes = 0;
+  if(config->getOutputFormat() == Configuration::DIFXINDEXED)
+  {
+    indexedtables = new vector<indexedrecord>[maxfiles];
+    indexedwritelist = new vector<struct iovec>[maxfiles];
+    indexedheaders = new indexedintegrationheader[maxfiles];
+    indexedblockbytes = new u64[maxfiles];
+  }
 
   //set up the initial time period this Visibility will be responsible for
   offsetns = offsetns + offsetnsperintegration;
@@ -141,6 +159,14 @@ Visibility::~Visibility()
   int pulsarwidth;
 
   vectorFree(results);
+  delete [] todiskmemptrs;
+  if(indexedtables)
+  {
+    delete [] indexedtables;
+    delete [] indexedwritelist;
+    delete [] indexedheaders;
+    delete [] indexedblockbytes;
+  }
   for(int i=0;i<numdatastreams;i++)
     delete [] autocorrcalibs[i];
   delete [] autocorrcalibs;
@@ -374,6 +400,8 @@ void Visibility::writedata()
     return; //NOTE EXIT HERE!!!
   }
 
+  StageTimer timer(writeprofile, StageProfile::VISWRITE);
+
   if(config->pulsarBinOn(currentconfigindex) && !config->scrunchOutputOn(currentconfigindex))
     binloop = config->getNumPulsarBins(currentconfigindex);
   else
@@ -612,6 +640,8 @@ void Visibility::writedata()
   //all calibrated, now just need to write out
   if(config->getOutputFormat() == Configuration::DIFX)
     writedifx(dumpmjd, dumpseconds);
+  else if(config->getOutputFormat() == Configuration::DIFXINDEXED)
+    writedifxindexed(dumpmjd, dumpseconds);
   else
     writeascii(dumpmjd, dumpseconds);
 
@@ -716,22 +746,14 @@ void Visibility::writeascii(int dumpmjd, double dumpseconds)
 void Visibility::writedifx(int dumpmjd, double dumpseconds)
 {
   ofstream output;
-  ofstream pcaloutput;
   char filename[256];
-  char pcalfilename[256];
-  char pcalstr[256];
-  string pcalline;
   int binloop, freqindex, numpolproducts, resultindex, freqchannels;
-  int year, month, day;
   int ant1index, ant2index, sourceindex, baselinenumber, numfiles, filecount;
-  float tonefreq;
   float currentweight;
-  double scanoffsetsecs, pcalmjd;
+  double scanoffsetsecs;
   bool modelok;
-  bool nonzero;
   double buvw[3]; //the u,v and w for this baseline at this time
   char polpair[3]; //the polarisation eg RR, LL
-  const char noToneAvailable[] = " -1 0 0 0";
 
   if(currentscan >= model->getNumScans()) {
     cwarn << startl << "Visibility will not write out time " << dumpmjd << "/" << dumpseconds << " since currentscan is " << currentscan << " and numscans is " << model->getNumScans() << endl;
@@ -893,6 +915,297 @@ void Visibility::writedifx(int dumpmjd, double dumpseconds)
       csevere << startl << "Error trying to write more data to " << filename << " : " << strerror(errno) << "!!" << endl;
   }
 
+  writepcal(dumpmjd, dumpseconds);
+}
+
+void Visibility::writedifxindexed(int dumpmjd, double dumpseconds)
+{
+  char filename[256];
+  int binloop, freqindex, numpolproducts, resultindex, freqchannels;
+  int ant1index, ant2index, sourceindex, baselinenumber, numfiles, filecount;
+  int fd, numiov, iovindex, tablebytes, writeerrno;
+  float currentweight;
+  double scanoffsetsecs;
+  bool modelok, writeok;
+  double buvw[3]; //the u,v and w for this baseline at this time
+  char polpair[3]; //the polarisation eg RR, LL
+  off_t fileoffset;
+  ssize_t written;
+  indexedfileheader fileheader;
+  indexedindexentry indexentry;
+  vector<struct iovec> * iov;
+
+  if(currentscan >= model->getNumScans()) {
+    cwarn << startl << "Visibility will not write out time " << dumpmjd << "/" << dumpseconds << " since currentscan is " << currentscan << " and numscans is " << model->getNumScans() << endl;
+    return;
+  }
+
+  if(config->pulsarBinOn(currentconfigindex) && !config->scrunchOutputOn(currentconfigindex))
+    binloop = config->getNumPulsarBins(currentconfigindex);
+  else
+    binloop = 1;
+
+  //the first three pieces of each write list are kept for the integration header, record table and its padding
+  numfiles = binloop*model->getNumPhaseCentres(currentscan);
+  for(int f=0;f<numfiles;f++)
+  {
+    indexedtables[f].clear();
+    indexedwritelist[f].resize(3);
+    indexedblockbytes[f] = 0;
+  }
+
+  //work out the time of this integration
+  dumpmjd = expermjd + (experseconds + model->getScanStartSec(currentscan, expermjd, experseconds) + currentstartseconds)/86400;
+  dumpseconds = double((experseconds + model->getScanStartSec(currentscan, expermjd, experseconds) + currentstartseconds)%86400) + ((double)currentstartns)/1000000000.0 + config->getIntTime(currentconfigindex)/2.0;
+
+  //collect the cross correlations, without copying the spectra
+  for(int i=0;i<numbaselines;i++)
+  {
+    baselinenumber = config->getBNumber(currentconfigindex, i);
+    for(int j=0;j<config->getBNumFreqs(currentconfigindex,i);j++)
+    {
+      freqindex = config->getBFreqIndex(currentconfigindex, i, j);
+      resultindex = config->getCoreResultBaselineOffset(currentconfigindex, freqindex, i);
+      freqchannels = config->getFNumChannels(freqindex)/config->getFChannelsToAverage(freqindex);
+      numpolproducts = config->getBNumPolProducts(currentconfigindex, i, j);
+      filecount = 0;
+      for(int s=0;s<model->getNumPhaseCentres(currentscan);s++)
+      {
+        sourceindex = model->getPhaseCentreSourceIndex(currentscan, s);
+        scanoffsetsecs = currentstartseconds + ((double)currentstartns)/1e9 + config->getIntTime(currentconfigindex)/2.0;
+        ant1index = config->getDModelFileIndex(currentconfigindex, config->getBOrderedDataStream1Index(currentconfigindex, i));
+        ant2index = config->getDModelFileIndex(currentconfigindex, config->getBOrderedDataStream2Index(currentconfigindex, i));
+        modelok = model->interpolateUVW(currentscan, scanoffsetsecs, ant1index, ant2index, s+1, buvw);
+        if(!modelok)
+          csevere << startl << "Could not calculate the UVW for this integration!!!" << endl;
+        for(int b=0;b<binloop;b++)
+        {
+          for(int k=0;k<numpolproducts;k++)
+          {
+            config->getBPolPair(currentconfigindex, i, j, k, polpair);
+            if(baselineweights[i][j][b][k] > 0.0)
+            {
+              if(model->getNumPhaseCentres(currentscan) > 1)
+                currentweight = baselineweights[i][j][b][k]*baselineshiftdecorrs[i][j][s];
+              else
+                currentweight = baselineweights[i][j][b][k];
+              addIndexedRecord(filecount, baselinenumber, freqindex, sourceindex, b, polpair, currentweight, buvw, &(results[resultindex]), freqchannels);
+            }
+            resultindex += freqchannels;
+          }
+          filecount++;
+        }
+      }
+    }
+  }
+
+  //then the autocorrelations, which all go in the first file as for the DIFX format
+  if(model->getNumPhaseCentres(currentscan) == 1)
+    sourceindex = model->getPhaseCentreSourceIndex(currentscan, 0);
+  else
+    sourceindex = model->getPointingCentreSourceIndex(currentscan);
+  if(config->writeAutoCorrs(currentconfigindex))
+  {
+    buvw[0] = 0.0;
+    buvw[1] = 0.0;
+    buvw[2] = 0.0;
+    for(int i=0;i<numdatastreams;i++)
+    {
+      baselinenumber = 257*(config->getDTelescopeIndex(currentconfigindex, i)+1);
+      resultindex = config->getCoreResultAutocorrOffset(currentconfigindex, i);
+      for(int j=0;j<autocorrwidth;j++)
+      {
+        for(int k=0;k<config->getDNumTotalBands(currentconfigindex, i); k++)
+        {
+          freqindex = config->getDTotalFreqIndex(currentconfigindex, i, k);
+          if(config->anyUsbXLsb(currentconfigindex) && config->getFreqTableLowerSideband(freqindex) && config->getFreqTableCorrelatedAgainstUpper(freqindex))
+          {
+            freqindex = config->getOppositeSidebandFreqIndex(freqindex);
+            if(freqindex < 0)
+            {
+              freqindex = config->getDTotalFreqIndex(currentconfigindex, i, k);
+            }
+          }
+          if(config->isFrequencyUsed(currentconfigindex, freqindex) || config->isEquivalentFrequencyUsed(currentconfigindex, freqindex)) {
+            freqchannels = config->getFNumChannels(freqindex)/config->getFChannelsToAverage(freqindex);
+            if(autocorrweights[i][j][k] > 0.0)
+            {
+              if(k<config->getDNumRecordedBands(currentconfigindex, i))
+                polpair[0] = config->getDRecordedBandPol(currentconfigindex, i, k);
+              else
+                polpair[0] = config->getDZoomBandPol(currentconfigindex, i, k-config->getDNumRecordedBands(currentconfigindex, i));
+              if(j==0)
+                polpair[1] = polpair[0];
+              else
+                polpair[1] = config->getOppositePol(polpair[0]);
+              addIndexedRecord(0, baselinenumber, freqindex, sourceindex, 0, polpair, autocorrweights[i][j][k], buvw, &(results[resultindex]), freqchannels);
+            }
+            resultindex += freqchannels;
+          }
+        }
+      }
+    }
+  }
+
+  //now write each file out: header, record table and spectra in one vectored write, then the index entry
+  filecount = 0;
+  for(int s=0;s<model->getNumPhaseCentres(currentscan);s++)
+  {
+    for(int b=0;b<binloop;b++)
+    {
+      if(indexedtables[filecount].size() == 0)
+      {
+        filecount++;
+        continue;
+      }
+
+      //the spectra follow the table, so their offsets can only be finalised now
+      tablebytes = indexedtables[filecount].size()*sizeof(indexedrecord);
+      tablebytes += (INDEXED_ALIGNMENT - (sizeof(indexedintegrationheader) + tablebytes)%INDEXED_ALIGNMENT)%INDEXED_ALIGNMENT;
+      for(size_t r=0;r<indexedtables[filecount].size();r++)
+        indexedtables[filecount][r].dataoffset += sizeof(indexedintegrationheader) + tablebytes;
+
+      indexedintegrationheader & header = indexedheaders[filecount];
+      memset(&header, 0, sizeof(indexedintegrationheader));
+      header.syncword = INDEXED_INTEGRATION_SYNC_WORD;
+      header.numrecords = indexedtables[filecount].size();
+      header.mjd = dumpmjd;
+      header.configindex = currentconfigindex;
+      header.seconds = dumpseconds;
+      header.blockbytes = sizeof(indexedintegrationheader) + tablebytes + indexedblockbytes[filecount];
+      header.phasecentre = s;
+      header.pulsarbin = b;
+
+      iov = &(indexedwritelist[filecount]);
+      (*iov)[0].iov_base = &header;
+      (*iov)[0].iov_len = sizeof(indexedintegrationheader);
+      (*iov)[1].iov_base = &(indexedtables[filecount][0]);
+      (*iov)[1].iov_len = indexedtables[filecount].size()*sizeof(indexedrecord);
+      (*iov)[2].iov_base = (void*)indexedzeropadding;
+      (*iov)[2].iov_len = tablebytes - (*iov)[1].iov_len;
+
+      sprintf(filename, "%s/DIFXI_%05d_%06d.s%04d.b%04d", config->getOutputFilename().c_str(), expermjd, experseconds, s, b);
+      fd = open(filename, O_WRONLY | O_CREAT | O_APPEND, 0644);
+      if(fd < 0)
+      {
+        csevere << startl << "Error trying to open " << filename << " : " << strerror(errno) << "!!" << endl;
+        filecount++;
+        continue;
+      }
+      writeok = true;
+      writeerrno = 0;
+      fileoffset = lseek(fd, 0, SEEK_END);
+      if(fileoffset == 0)
+      {
+        memset(&fileheader, 0, sizeof(indexedfileheader));
+        fileheader.syncword = INDEXED_FILE_SYNC_WORD;
+        fileheader.version = INDEXED_FORMAT_VERSION;
+        fileheader.alignment = INDEXED_ALIGNMENT;
+        fileheader.integrationheaderbytes = sizeof(indexedintegrationheader);
+        fileheader.recordbytes = sizeof(indexedrecord);
+        fileheader.indexentrybytes = sizeof(indexedindexentry);
+        written = write(fd, &fileheader, sizeof(indexedfileheader));
+        writeok = (written == (ssize_t)sizeof(indexedfileheader));
+        if(!writeok)
+          writeerrno = (written < 0) ? errno : EIO;
+        fileoffset = sizeof(indexedfileheader);
+      }
+
+      //writev takes at most IOV_MAX pieces and may write only part of what it is given
+      iovindex = 0;
+      while(writeok && iovindex < (int)iov->size())
+      {
+        numiov = iov->size() - iovindex;
+        if(numiov > IOV_MAX)
+          numiov = IOV_MAX;
+        written = writev(fd, &((*iov)[iovindex]), numiov);
+        if(written < 0)
+        {
+          if(errno == EINTR)
+            continue;
+          writeok = false;
+          writeerrno = errno; //close() below may change errno
+          break;
+        }
+        while(iovindex < (int)iov->size() && written >= (ssize_t)(*iov)[iovindex].iov_len)
+        {
+          written -= (*iov)[iovindex].iov_len;
+          iovindex++;
+        }
+        if(written > 0)
+        {
+          (*iov)[iovindex].iov_base = (char*)(*iov)[iovindex].iov_base + written;
+          (*iov)[iovindex].iov_len -= written;
+        }
+      }
+      close(fd);
+      if(!writeok)
+      {
+        csevere << startl << "Error trying to write more data to " << filename << " : " << strerror(writeerrno) << "!!" << endl;
+        filecount++;
+        continue;
+      }
+
+      indexentry.mjd = dumpmjd;
+      indexentry.numrecords = header.numrecords;
+      indexentry.seconds = dumpseconds;
+      indexentry.offset = fileoffset;
+      indexentry.blockbytes = header.blockbytes;
+      strcat(filename, ".idx");
+      fd = open(filename, O_WRONLY | O_CREAT | O_APPEND, 0644);
+      if(fd < 0 || write(fd, &indexentry, sizeof(indexedindexentry)) != (ssize_t)sizeof(indexedindexentry))
+        csevere << startl << "Error trying to write more index entries to " << filename << " : " << strerror(errno) << "!!" << endl;
+      if(fd >= 0)
+        close(fd);
+      filecount++;
+    }
+  }
+
+  writepcal(dumpmjd, dumpseconds);
+}
+
+void Visibility::addIndexedRecord(int filecount, int baselinenum, int freqindex, int sourceindex, int pulsarbin, const char polpair[3], float weight, const double buvw[3], cf32 * spectrum, int numchannels)
+{
+  vector<struct iovec> & iov = indexedwritelist[filecount];
+  indexedrecord record;
+  struct iovec piece;
+  int bytes, padding;
+
+  bytes = numchannels*sizeof(cf32);
+  padding = (INDEXED_ALIGNMENT - bytes%INDEXED_ALIGNMENT)%INDEXED_ALIGNMENT;
+
+  memset(&record, 0, sizeof(indexedrecord));
+  record.baselinenum = baselinenum;
+  record.freqindex = freqindex;
+  record.sourceindex = sourceindex;
+  record.pulsarbin = pulsarbin;
+  record.polpair[0] = polpair[0];
+  record.polpair[1] = polpair[1];
+  record.numchannels = numchannels;
+  record.weight = weight;
+  record.uvw[0] = buvw[0];
+  record.uvw[1] = buvw[1];
+  record.uvw[2] = buvw[2];
+  record.dataoffset = indexedblockbytes[filecount]; //relative to the end of the table for now
+  indexedtables[filecount].push_back(record);
+
+  //consecutive spectra are usually adjacent in results, in which case they go out as one piece
+  if(iov.size() > 3 && (char*)iov.back().iov_base + iov.back().iov_len == (char*)spectrum)
+    iov.back().iov_len += bytes;
+  else
+  {
+    piece.iov_base = spectrum;
+    piece.iov_len = bytes;
+    iov.push_back(piece);
+  }
+  if(padding > 0)
+  {
+    piece.iov_base = (void*)indexedzeropadding;
+    piece.iov_len = padding;
+    iov.push_back(piece);
+  }
+  indexedblockbytes[filecount] += bytes + padding;
+}
 
 /* Pulse cal data format is described here.
 
@@ -924,6 +1237,18 @@ The four columns are:
 4. Imag part of pulse cal tone
 
 */
+void Visibility::writepcal(int dumpmjd, double dumpseconds)
+{
+  ofstream pcaloutput;
+  char pcalfilename[256];
+  char pcalstr[256];
+  string pcalline;
+  int resultindex;
+  int year, month, day;
+  float tonefreq;
+  double pcalmjd;
+  bool nonzero;
+  const char noToneAvailable[] = " -1 0 0 0";
 
   //now each pcal (if necessary)
   config->mjd2ymd(dumpmjd, year, month, day);
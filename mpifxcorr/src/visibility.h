@@ -28,8 +28,11 @@
 #define VISIBILITY_H
 
 #include <string>
+#include <vector>
+#include <sys/uio.h>
 #include "architecture.h"
 #include "datastream.h"
+#include "profiler.h"
 
 /**
 @class Visibility 
@@ -137,6 +140,63 @@ public:
   ///Version of the binary header
   static const int BINARY_HEADER_VERSION = 1;
 
+  ///Alignment (bytes) of integration blocks, record tables and spectra in the indexed output format
+  static const int INDEXED_ALIGNMENT = 64;
+
+  ///Sync words at the start of an indexed output file and of each integration block in it
+  static const unsigned int INDEXED_FILE_SYNC_WORD = 0x44495846;        // "FXID" read as little-endian bytes
+  static const unsigned int INDEXED_INTEGRATION_SYNC_WORD = 0x54494446; // "FDIT"
+
+  ///Version of the indexed output format
+  static const int INDEXED_FORMAT_VERSION = 1;
+
+  ///Header at the start of an indexed output file (.vis), padded to INDEXED_ALIGNMENT bytes
+  typedef struct {
+    u32 syncword;
+    s32 version;
+    s32 alignment;
+    s32 integrationheaderbytes;
+    s32 recordbytes;
+    s32 indexentrybytes;
+    u8 padding[40];
+  } indexedfileheader;
+
+  ///Header of one integration block: followed by numrecords indexedrecords, then the aligned spectra
+  typedef struct {
+    u32 syncword;
+    s32 numrecords;
+    s32 mjd;
+    s32 configindex;
+    f64 seconds;
+    u64 blockbytes;   //total length of the block, header included, so the next block starts this far on
+    s32 phasecentre;
+    s32 pulsarbin;
+    u8 padding[24];
+  } indexedintegrationheader;
+
+  ///One baseline/frequency/polarisation product of an integration
+  typedef struct {
+    s32 baselinenum;
+    s32 freqindex;
+    s32 sourceindex;
+    s32 pulsarbin;
+    char polpair[2];
+    s16 flag;
+    s32 numchannels;
+    f64 weight;
+    f64 uvw[3];
+    u64 dataoffset;   //offset of the spectrum (numchannels cf32) from the start of the integration block
+  } indexedrecord;
+
+  ///One entry of the time index (.idx) written alongside each indexed output file
+  typedef struct {
+    s32 mjd;
+    s32 numrecords;
+    f64 seconds;
+    u64 offset;       //offset of the integration block in the .vis file
+    u64 blockbytes;
+  } indexedindexentry;
+
   void copyVisData(char **buf, int *bufsize, int *nbuf);
 
 private:
@@ -181,6 +241,26 @@ private:
   */
   void writedifx(int dumpmjd, double dumpseconds);
 
+/**
+  * Writes the visibilities to disk in the indexed format: for each output file, a header and fixed size record
+  * table for the integration followed by the aligned spectra, all with one vectored write, plus an entry in the
+  * time index file
+  */
+  void writedifxindexed(int dumpmjd, double dumpseconds);
+
+/**
+  * Adds one spectrum to the record table and write list of an indexed output file
+  * @param filecount The output file (phase centre/pulsar bin) the spectrum belongs to
+  * @param spectrum The visibilities
+  * @param numchannels The number of channels in the spectrum
+  */
+  void addIndexedRecord(int filecount, int baselinenum, int freqindex, int sourceindex, int pulsarbin, const char polpair[3], float weight, const double buvw[3], cf32 * spectrum, int numchannels);
+
+/**
+  * Writes the pulse cal results of this integration to the PCAL files
+  */
+  void writepcal(int dumpmjd, double dumpseconds);
+
 /**
   * Writes the ascii header for a visibility point in a DiFX format output file
   */
@@ -202,12 +282,17 @@ private:
   cf32 * results;
   char * todiskbuffer;
   int * todiskmemptrs;
+  std::vector<indexedrecord> * indexedtables;   //[file] record table of the integration being written
+  std::vector<struct iovec> * indexedwritelist; //[file] pieces of the integration block, in file order
+  indexedintegrationheader * indexedheaders;   //[file] header of the integration being written
+  u64 * indexedblockbytes;                      //[file] length of the spectra of the integration so far
   f32 * floatresults;
   f32 *** binweightsums;
   cf32 *** binscales;
   f32 * binweightdivisor;
   int ** pulsarbins;
   Model * model;
+  StageProfile * writeprofile;
   Polyco * polyco;
 };
 
@@ -0,0 +1,184 @@
+/***************************************************************************
+ *   Copyright (C) 2006-2020 by Adam Deller                                *
+ *                                                                         *
+ *   This program is free software: you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation, either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+//===========================================================================
+// SVN properties (DO NOT CHANGE)
+//
+// $Id$
+// $HeadURL$
+// $LastChangedRevision$
+// $Author$
+// $LastChangedDate$
+//
+//============================================================================
+
+// Pre-generates the FFTW wisdom file (<job>.fftwisdom, next to the .input
+// file) that mpifxcorr Core processes load at startup.  Every Mode that the
+// correlation would create is built once here, so all the FFT sizes it uses
+// get planned.  Only useful for builds using FFTW rather than IPP, and only
+// read when DIFX_FFTW_PLANNING selects MEASURE or PATIENT planning.
+
+#include <mpi.h>
+#include <stdlib.h>
+#include <difxmessage.h>
+#include <difxmessage/difxmessageinternal.h>
+#include "architecture.h"
+#include "configuration.h"
+#include "mode.h"
+#include "alert.h"
+#include "config.h"
+
+void usage(const char *pgm)
+{
+  cerr << "Usage: " << pgm << " [options] <inputfilename> ..." << endl;
+  cerr << endl;
+  cerr << "Writes <job>.fftwisdom next to each .input file, covering all FFT sizes the job uses." << endl;
+  cerr << "Existing wisdom in that file is kept and extended.  mpifxcorr only loads it when" << endl;
+  cerr << "DIFX_FFTW_PLANNING is set to MEASURE or PATIENT." << endl;
+  cerr << endl;
+  cerr << "Options can be:" << endl;
+  cerr << "  -h : print help info" << endl;
+  cerr << "  -e : plan with FFTW_ESTIMATE (only useful for testing)" << endl;
+  cerr << "  -m : plan with FFTW_MEASURE" << endl;
+  cerr << "  -p : plan with FFTW_PATIENT [default]" << endl;
+  cerr << "  -v : be verbose" << endl;
+  cerr << endl;
+}
+
+int main(int argc, char *argv[])
+{
+  int nFile = 0;
+  int nBad = 0;
+  bool verbose = false;
+  Configuration::fftplanning planning = Configuration::FFTPLANPATIENT;
+  Configuration * config;
+  Mode * mode;
+
+  if(argc < 2)
+  {
+    usage(argv[0]);
+
+    return EXIT_FAILURE;
+  }
+
+#ifdef HAVE_IPP
+  cerr << "This build uses IPP, which has no FFT wisdom; nothing to do." << endl;
+
+  return EXIT_SUCCESS;
+#endif
+
+  for(int a = 1; a < argc; ++a)
+  {
+    if(strcmp(argv[a], "-h") == 0)
+    {
+      usage(argv[0]);
+
+      return EXIT_SUCCESS;
+    }
+    else if(strcmp(argv[a], "-e") == 0)
+    {
+      planning = Configuration::FFTPLANESTIMATE;
+    }
+    else if(strcmp(argv[a], "-m") == 0)
+    {
+      planning = Configuration::FFTPLANMEASURE;
+    }
+    else if(strcmp(argv[a], "-p") == 0)
+    {
+      planning = Configuration::FFTPLANPATIENT;
+    }
+    else if(strcmp(argv[a], "-v") == 0)
+    {
+      verbose = true;
+    }
+    else
+    {
+      if(nFile == 0)
+      {
+        csevere.setAlertLevel(DIFX_ALERT_LEVEL_DO_NOT_SEND);
+        cerror.setAlertLevel(DIFX_ALERT_LEVEL_DO_NOT_SEND);
+        cwarn.setAlertLevel(DIFX_ALERT_LEVEL_DO_NOT_SEND);
+        cinfo.setAlertLevel(DIFX_ALERT_LEVEL_DO_NOT_SEND);
+        cverbose.setAlertLevel(DIFX_ALERT_LEVEL_DO_NOT_SEND);
+        cdebug.setAlertLevel(DIFX_ALERT_LEVEL_DO_NOT_SEND);
+        difxMessagePort = -1;
+      }
+
+      ++nFile;
+
+      config = new Configuration(argv[a], 0);
+      if(!config->consistencyOK())
+      {
+        cerr << "Config encountered inconsistent setup in config file " << argv[a] << " - skipping" << endl;
+        ++nBad;
+        delete config;
+        continue;
+      }
+
+      switch(planning)
+      {
+        case Configuration::FFTPLANESTIMATE:
+          vectorSetFFTPlanFlags(vecFFTPlanEstimate);
+          break;
+        case Configuration::FFTPLANMEASURE:
+          vectorSetFFTPlanFlags(vecFFTPlanMeasure);
+          break;
+        default:
+          vectorSetFFTPlanFlags(vecFFTPlanPatient);
+          break;
+      }
+      if(vectorImportFFTWisdom(config->getFFTWisdomFilename().c_str()) == vecNoErr && verbose)
+        cout << "Extending existing wisdom in " << config->getFFTWisdomFilename() << endl;
+
+      //creating each Mode plans all of the FFTs/DFTs it (and its pcal extractors) will use
+      for(int c = 0; c < config->getNumConfigs(); ++c)
+      {
+        for(int d = 0; d < config->getNumDataStreams(); ++d)
+        {
+          if(verbose)
+            cout << "Planning FFTs for config " << c << " datastream " << d << endl;
+          mode = config->getMode(c, d);
+          if(mode == NULL || !mode->initialisedOK())
+          {
+            cerr << "Could not create Mode for config " << c << " datastream " << d << " of " << argv[a] << endl;
+            ++nBad;
+          }
+          delete mode;
+        }
+      }
+
+      if(vectorExportFFTWisdom(config->getFFTWisdomFilename().c_str()) != vecNoErr)
+      {
+        cerr << "Could not write wisdom file " << config->getFFTWisdomFilename() << endl;
+        ++nBad;
+      }
+      else
+      {
+        cout << "Wrote " << config->getFFTWisdomFilename() << endl;
+      }
+      delete config;
+    }
+  }
+
+  if(nBad == 0)
+  {
+    return EXIT_SUCCESS;
+  }
+  else
+  {
+    return EXIT_FAILURE;
+  }
+}
@@ -0,0 +1,658 @@
+/***************************************************************************
+ *   Copyright (C) 2006-2020 by Adam Deller                                *
+ *                                                                         *
+ *   This program is free software: you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation, either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+//===========================================================================
+// SVN properties (DO NOT CHANGE)
+//
+// $Id$
+// $HeadURL$
+// $LastChangedRevision$
+// $Author$
+// $LastChangedDate$
+//
+//============================================================================
+
+// Single process benchmark of the correlator kernel.  For each point of a
+// sweep over FFT size, number of bands, bits per sample, fringe rotation
+// order and xmac mode (per-baseline or tiled) a synthetic job
+// (.input/.calc/.im/.threads) is written, the Modes it needs are created, and
+// VDIF frames made the same way as for a FAKE data source are fed through
+// Mode::process and Core's cross-multiply for that xmac mode, without any
+// MPI.  Combinations of bands and bits that mark5access cannot decode are
+// skipped.  Throughput per stage is reported in station samples per second,
+// so runs of the IPP and FFTW builds can be compared.
+
+#include <mpi.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <vdifio.h>
+#include <mark5access.h>
+#include <difxmessage.h>
+#include <difxmessage/difxmessageinternal.h>
+#include "architecture.h"
+#include "configuration.h"
+#include "mode.h"
+#include "core.h"
+#include "mpifxcorr.h"
+#include "profiler.h"
+#include "alert.h"
+#include "config.h"
+
+static const double BENCH_BANDWIDTH_MHZ = 16.0;
+static const int BENCH_FRAME_PAYLOAD_BYTES = 8000;
+static const int BENCH_START_MJD = 58000;
+static const double BENCH_SUBINT_NS = 8000000.0;
+static const int BENCH_MAX_BUFFERED_FFTS = 10;
+
+static const StageProfile::stage REPORTED_STAGES[] = {StageProfile::UNPACK, StageProfile::FRINGEROTATE, StageProfile::FFT, StageProfile::FRACSAMPLE, StageProfile::AUTOCORR, StageProfile::XMAC};
+static const int NUM_REPORTED_STAGES = sizeof(REPORTED_STAGES)/sizeof(StageProfile::stage);
+
+typedef struct {
+  int numchannels;
+  int numbands;
+  int numbits;
+  int fringerotationorder;
+  Configuration::xmacmode xmacmode;
+} benchpoint;
+
+void usage(const char *pgm)
+{
+  cerr << "Usage: " << pgm << " [options]" << endl;
+  cerr << endl;
+  cerr << "Times Mode::process and the per-baseline or tiled cross-multiply on synthetic VDIF data, without MPI." << endl;
+  cerr << "Every combination of the swept parameters is run; results are in Msamples/s summed over stations." << endl;
+  cerr << endl;
+  cerr << "Options can be:" << endl;
+  cerr << "  -h          : print help info" << endl;
+  cerr << "  -c <list>   : comma separated numbers of channels per band (FFT size/2) [256,1024,4096]" << endl;
+  cerr << "  -b <list>   : comma separated numbers of bands (powers of 2) [2,8]" << endl;
+  cerr << "  -q <list>   : comma separated bits per sample [2,8]" << endl;
+  cerr << "  -r <list>   : comma separated fringe rotation orders (0, 1 or 2) [0,1]" << endl;
+  cerr << "  -x <list>   : comma separated xmac modes (0 per-baseline, 1 tiled) [0,1]" << endl;
+  cerr << "  -s <n>      : number of stations [4]" << endl;
+  cerr << "  -n <n>      : number of subintegrations (of ~8 ms) to time per point [10]" << endl;
+  cerr << "  -d <dir>    : directory for the synthetic job files [.]" << endl;
+  cerr << "  -k          : keep the synthetic job files" << endl;
+  cerr << endl;
+}
+
+static bool parselist(const char * arg, vector<int> & values)
+{
+  stringstream ss(arg);
+  string item;
+
+  values.clear();
+  while(getline(ss, item, ','))
+  {
+    if(item.empty())
+      continue;
+    values.push_back(atoi(item.c_str()));
+  }
+
+  return !values.empty();
+}
+
+static string stationname(int s)
+{
+  char name[4];
+
+  snprintf(name, 4, "B%c", 'A' + s);
+
+  return string(name);
+}
+
+static int getnumblocks(const benchpoint & p)
+{
+  double fftns = 1000.0*p.numchannels/BENCH_BANDWIDTH_MHZ;
+  int blocks = (int)(BENCH_SUBINT_NS/fftns + 0.5);
+
+  return (blocks < 1)?1:blocks;
+}
+
+//writes the .input, .calc, .im and .threads files of a job with one scan of one source
+static bool writejob(const string & base, const benchpoint & p, int numstations)
+{
+  int numbaselines = numstations*(numstations-1)/2;
+  int blocks = getnumblocks(p);
+  long long fftns = (long long)(1000.0*p.numchannels/BENCH_BANDWIDTH_MHZ + 0.5);
+  int b;
+  char line[256];
+
+  ofstream input((base + ".input").c_str());
+  input << "# COMMON SETTINGS ##!" << endl;
+  input << "CALC FILENAME:      " << base << ".calc" << endl;
+  input << "CORE CONF FILENAME: " << base << ".threads" << endl;
+  input << "EXECUTE TIME (SEC): 10" << endl;
+  input << "START MJD:          " << BENCH_START_MJD << endl;
+  input << "START SECONDS:      0" << endl;
+  input << "ACTIVE DATASTREAMS: " << numstations << endl;
+  input << "ACTIVE BASELINES:   " << numbaselines << endl;
+  input << "VIS BUFFER LENGTH:  80" << endl;
+  input << "OUTPUT FORMAT:      SWIN" << endl;
+  input << "OUTPUT FILENAME:    " << base << ".difx" << endl << endl;
+  input << "# CONFIGURATIONS ###!" << endl;
+  input << "NUM CONFIGURATIONS: 1" << endl;
+  input << "CONFIG NAME:        bench" << endl;
+  snprintf(line, 256, "%.9f", (100*blocks*fftns)/1.0e9);
+  input << "INT TIME (SEC):     " << line << endl;
+  input << "SUBINT NANOSECONDS: " << blocks*fftns << endl;
+  input << "GUARD NANOSECONDS:  " << fftns << endl;
+  input << "FRINGE ROTN ORDER:  " << p.fringerotationorder << endl;
+  input << "ARRAY STRIDE LENGTH:0" << endl;
+  input << "XMAC STRIDE LENGTH: 0" << endl;
+  input << "NUM BUFFERED FFTS:  " << ((blocks < BENCH_MAX_BUFFERED_FFTS)?blocks:BENCH_MAX_BUFFERED_FFTS) << endl;
+  input << "XMAC MODE:          " << ((p.xmacmode == Configuration::TILEDXMAC)?"TILED":"BASELINE") << endl;
+  input << "WRITE AUTOCORRS:    TRUE" << endl;
+  input << "PULSAR BINNING:     FALSE" << endl;
+  input << "PHASED ARRAY:       FALSE" << endl;
+  for(int s=0;s<numstations;s++)
+    input << "DATASTREAM " << s << " INDEX: " << s << endl;
+  for(int i=0;i<numbaselines;i++)
+    input << "BASELINE " << i << " INDEX:   " << i << endl;
+  input << endl;
+  input << "# RULES ############!" << endl;
+  input << "NUM RULES:          1" << endl;
+  input << "RULE 0 CONFIG NAME: bench" << endl << endl;
+  input << "# FREQ TABLE #######!" << endl;
+  input << "FREQ ENTRIES:       " << p.numbands << endl;
+  for(int f=0;f<p.numbands;f++)
+  {
+    input << "FREQ (MHZ) " << f << ":       " << 8000.0 + f*BENCH_BANDWIDTH_MHZ << endl;
+    input << "BW (MHZ) " << f << ":         " << BENCH_BANDWIDTH_MHZ << endl;
+    input << "SIDEBAND " << f << ":         U" << endl;
+    input << "NUM CHANNELS " << f << ":     " << p.numchannels << endl;
+    input << "CHANS TO AVG " << f << ":     1" << endl;
+    input << "OVERSAMPLE FAC. " << f << ":  1" << endl;
+    input << "DECIMATION FAC. " << f << ":  1" << endl;
+    input << "PHASE CALS " << f << " OUT:   0" << endl;
+  }
+  input << endl;
+  input << "# TELESCOPE TABLE ##!" << endl;
+  input << "TELESCOPE ENTRIES:  " << numstations << endl;
+  for(int s=0;s<numstations;s++)
+  {
+    input << "TELESCOPE NAME " << s << ":   " << stationname(s) << endl;
+    input << "CLOCK REF MJD " << s << ":    " << BENCH_START_MJD << endl;
+    input << "CLOCK POLY ORDER " << s << ": 1" << endl;
+    input << "CLOCK COEFF " << s << "/0:    0.0" << endl;
+    input << "CLOCK COEFF " << s << "/1:    0.0" << endl;
+  }
+  input << endl;
+  input << "# DATASTREAM TABLE #!" << endl;
+  input << "DATASTREAM ENTRIES: " << numstations << endl;
+  input << "DATA BUFFER FACTOR: 32" << endl;
+  input << "NUM DATA SEGMENTS:  8" << endl;
+  for(int s=0;s<numstations;s++)
+  {
+    input << "TELESCOPE INDEX:    " << s << endl;
+    input << "TSYS:               0.000000" << endl;
+    input << "DATA FORMAT:        VDIF" << endl;
+    input << "QUANTISATION BITS:  " << p.numbits << endl;
+    input << "DATA FRAME SIZE:    " << BENCH_FRAME_PAYLOAD_BYTES + VDIF_HEADER_BYTES << endl;
+    input << "DATA SAMPLING:      REAL" << endl;
+    input << "DATA SOURCE:        FAKE" << endl;
+    input << "FILTERBANK USED:    FALSE" << endl;
+    input << "PHASE CAL INT (MHZ):0" << endl;
+    input << "NUM RECORDED FREQS: " << p.numbands << endl;
+    for(int f=0;f<p.numbands;f++)
+    {
+      input << "REC FREQ INDEX " << f << ":   " << f << endl;
+      input << "CLK OFFSET " << f << " (us):  0.000000" << endl;
+      input << "FREQ OFFSET " << f << " (Hz): 0.000000" << endl;
+      input << "NUM REC POLS " << f << ":     1" << endl;
+    }
+    for(int f=0;f<p.numbands;f++)
+    {
+      input << "REC BAND " << f << " POL:     R" << endl;
+      input << "REC BAND " << f << " INDEX:   " << f << endl;
+    }
+    input << "NUM ZOOM FREQS:     0" << endl;
+  }
+  input << endl;
+  input << "# BASELINE TABLE ###!" << endl;
+  input << "BASELINE ENTRIES:   " << numbaselines << endl;
+  b = 0;
+  for(int s1=0;s1<numstations;s1++)
+  {
+    for(int s2=s1+1;s2<numstations;s2++)
+    {
+      input << "D/STREAM A INDEX " << b << ": " << s1 << endl;
+      input << "D/STREAM B INDEX " << b << ": " << s2 << endl;
+      input << "NUM FREQS " << b << ":        " << p.numbands << endl;
+      for(int f=0;f<p.numbands;f++)
+      {
+        input << "POL PRODUCTS " << b << "/" << f << ":   1" << endl;
+        input << "D/STREAM A BAND 0:  " << f << endl;
+        input << "D/STREAM B BAND 0:  " << f << endl;
+      }
+      b++;
+    }
+  }
+  input << endl;
+  input << "# DATA TABLE #######!" << endl;
+  for(int s=0;s<numstations;s++)
+    input << "D/STREAM " << s << " FILES:   0" << endl;
+  input.close();
+
+  ofstream threads((base + ".threads").c_str());
+  threads << "NUMBER OF CORES:    1" << endl;
+  threads << "1" << endl;
+  threads.close();
+
+  //MJD 58000 is 2017-09-04
+  ofstream calc((base + ".calc").c_str());
+  calc << "JOB ID:             1" << endl;
+  calc << "JOB START TIME:     " << BENCH_START_MJD << ".0000000" << endl;
+  calc << "JOB STOP TIME:      " << BENCH_START_MJD << ".0001157" << endl;
+  calc << "DUTY CYCLE:         1.000" << endl;
+  calc << "OBSCODE:            BENCH" << endl;
+  calc << "DIFX VERSION:       " << VERSION << endl;
+  calc << "SUBJOB ID:          0" << endl;
+  calc << "SUBARRAY ID:        0" << endl;
+  calc << "START MJD:          " << BENCH_START_MJD << ".0000000" << endl;
+  calc << "START YEAR:         2017" << endl;
+  calc << "START MONTH:        9" << endl;
+  calc << "START DAY:          4" << endl;
+  calc << "START HOUR:         0" << endl;
+  calc << "START MINUTE:       0" << endl;
+  calc << "START SECOND:       0" << endl;
+  calc << "SPECTRAL AVG:       1" << endl;
+  calc << "TAPER FUNCTION:     UNIFORM" << endl;
+  calc << "NUM TELESCOPES:     " << numstations << endl;
+  for(int s=0;s<numstations;s++)
+  {
+    calc << "TELESCOPE " << s << " NAME:   " << stationname(s) << endl;
+    calc << "TELESCOPE " << s << " MOUNT:  AZEL" << endl;
+    calc << "TELESCOPE " << s << " OFFSET (m):0.000000" << endl;
+    calc << "TELESCOPE " << s << " X (m):  " << -2000000.0 + 100000.0*s << endl;
+    calc << "TELESCOPE " << s << " Y (m):  -4000000.000000" << endl;
+    calc << "TELESCOPE " << s << " Z (m):  4000000.000000" << endl;
+    calc << "TELESCOPE " << s << " SHELF:  NONE" << endl;
+  }
+  calc << "NUM SOURCES:        1" << endl;
+  calc << "SOURCE 0 NAME:      BENCHSRC" << endl;
+  calc << "SOURCE 0 RA:        1.0000000000000000" << endl;
+  calc << "SOURCE 0 DEC:       0.5000000000000000" << endl;
+  calc << "SOURCE 0 CALCODE:   " << endl;
+  calc << "SOURCE 0 QUAL:      0" << endl;
+  calc << "NUM SCANS:          1" << endl;
+  calc << "SCAN 0 IDENTIFIER:  No0001" << endl;
+  calc << "SCAN 0 START (S):   0" << endl;
+  calc << "SCAN 0 DUR (S):     10" << endl;
+  calc << "SCAN 0 OBS MODE NAME:bench" << endl;
+  calc << "SCAN 0 UVSHIFT INTERVAL (NS):2000000000" << endl;
+  calc << "SCAN 0 AC AVG INTERVAL (NS):2000000" << endl;
+  calc << "SCAN 0 POINTING SRC:0" << endl;
+  calc << "SCAN 0 NUM PHS CTRS:1" << endl;
+  calc << "SCAN 0 PHS CTR 0:   0" << endl;
+  calc << "NUM EOPS:           0" << endl;
+  calc << "NUM SPACECRAFT:     0" << endl;
+  calc << "IM FILENAME:        " << base << ".im" << endl;
+  calc.close();
+
+  //small delays and rates, so that fringe rotation does real work but the data always cover the subint
+  ofstream im((base + ".im").c_str());
+  im << "CALC SERVER:        NONE" << endl;
+  im << "CALC PROGRAM:       -1" << endl;
+  im << "CALC VERSION:       -1" << endl;
+  im << "START YEAR:         2017" << endl;
+  im << "START MONTH:        9" << endl;
+  im << "START DAY:          4" << endl;
+  im << "START HOUR:         0" << endl;
+  im << "START MINUTE:       0" << endl;
+  im << "START SECOND:       0" << endl;
+  im << "POLYNOMIAL ORDER:   5" << endl;
+  im << "INTERVAL (SECS):    120" << endl;
+  im << "ABERRATION CORR:    EXACT" << endl;
+  im << "NUM TELESCOPES:     " << numstations << endl;
+  for(int s=0;s<numstations;s++)
+    im << "TELESCOPE " << s << " NAME:   " << stationname(s) << endl;
+  im << "NUM SCANS:          1" << endl;
+  im << "SCAN 0 POINTING SRC:BENCHSRC" << endl;
+  im << "SCAN 0 NUM PHS CTRS:1" << endl;
+  im << "SCAN 0 PHS CTR 0 SRC:BENCHSRC" << endl;
+  im << "SCAN 0 NUM POLY:    1" << endl;
+  im << "SCAN 0 POLY 0 MJD:  " << BENCH_START_MJD << endl;
+  im << "SCAN 0 POLY 0 SEC:  0" << endl;
+  for(int src=0;src<2;src++)
+  {
+    for(int s=0;s<numstations;s++)
+    {
+      snprintf(line, 256, "%.16e\t %.16e\t 0\t 0\t 0\t 0", 1.0e-3*s, 1.0e-3*(s+1));
+      im << "SRC " << src << " ANT " << s << " DELAY (us): " << line << endl;
+      im << "SRC " << src << " ANT " << s << " U (m):  " << 100000.0*s << "\t 1.0\t 0\t 0\t 0\t 0" << endl;
+      im << "SRC " << src << " ANT " << s << " V (m):  " << 50000.0*s << "\t 1.0\t 0\t 0\t 0\t 0" << endl;
+      im << "SRC " << src << " ANT " << s << " W (m):  " << 1000.0*s << "\t 1.0\t 0\t 0\t 0\t 0" << endl;
+    }
+  }
+  im.close();
+
+  return input.good() && threads.good() && calc.good() && im.good();
+}
+
+static void removejob(const string & base)
+{
+  unlink((base + ".input").c_str());
+  unlink((base + ".threads").c_str());
+  unlink((base + ".calc").c_str());
+  unlink((base + ".im").c_str());
+}
+
+//fills a buffer with consecutive VDIF frames of random samples, as the FAKE data source would provide
+static void generatevdif(u8 * buffer, int numframes, const benchpoint & p, int station)
+{
+  vdif_header header;
+  char stationid[3];
+  int framespersecond = (int)(2.0*BENCH_BANDWIDTH_MHZ*1000000.0*p.numbits*p.numbands/(8.0*BENCH_FRAME_PAYLOAD_BYTES) + 0.5);
+  u32 * payload;
+
+  snprintf(stationid, 3, "%s", stationname(station).c_str());
+  createVDIFHeader(&header, BENCH_FRAME_PAYLOAD_BYTES, 0, p.numbits, p.numbands, 0, stationid);
+  setVDIFEpochMJD(&header, BENCH_START_MJD);
+  setVDIFFrameMJDSec(&header, ((uint64_t)BENCH_START_MJD)*86400);
+  setVDIFFrameNumber(&header, 0);
+  srand(station + 1);
+  for(int i=0;i<numframes;i++)
+  {
+    memcpy(buffer + i*(BENCH_FRAME_PAYLOAD_BYTES + VDIF_HEADER_BYTES), &header, VDIF_HEADER_BYTES);
+    payload = (u32*)(buffer + i*(BENCH_FRAME_PAYLOAD_BYTES + VDIF_HEADER_BYTES) + VDIF_HEADER_BYTES);
+    for(int j=0;j<BENCH_FRAME_PAYLOAD_BYTES/4;j++)
+      payload[j] = ((u32)rand() << 16) ^ (u32)rand();
+    nextVDIFHeader(&header, framespersecond);
+  }
+}
+
+//runs one sweep point; returns false if the job could not be set up
+static bool runpoint(const benchpoint & p, int numstations, int numsubints, const string & dir, bool keepfiles)
+{
+  Configuration * config;
+  Mode ** modes;
+  u8 ** databuffers;
+  s32 * validflags;
+  cf32 * results;
+  StageProfile profile(true);
+  long long counts[StageProfile::NUMSTAGES];
+  long long totalns[StageProfile::NUMSTAGES];
+  long long histogram[StageProfile::NUMSTAGES*StageProfile::NUM_HISTOGRAM_BINS];
+  unsigned long long starttime, elapsedns, xmactime;
+  int blocks, numbufferedffts, chunkffts, flaglength, numframes, framebytes, resultindex;
+  int * databytes;
+  double stationsamples;
+  struct mark5_format_generic * mk5format;
+  char base[256];
+  char formatname[64];
+  bool ok = true;
+
+  snprintf(base, 256, "%s/bench_%d_%d_%d_%d_%d", dir.c_str(), p.numchannels, p.numbands, p.numbits, p.fringerotationorder, (int)p.xmacmode);
+  if(!writejob(base, p, numstations))
+  {
+    cerr << "Could not write synthetic job files " << base << ".*" << endl;
+    return false;
+  }
+  config = new Configuration((string(base) + ".input").c_str(), 0);
+  if(!keepfiles)
+    removejob(base);
+  if(!config->consistencyOK())
+  {
+    cerr << "Synthetic job for " << p.numchannels << " channels, " << p.numbands << " bands, " << p.numbits << " bits, order " << p.fringerotationorder << ", xmac mode " << p.xmacmode << " is inconsistent - skipping" << endl;
+    delete config;
+    return false;
+  }
+
+  blocks = config->getBlocksPerSend(0);
+  numbufferedffts = config->getNumBufferedFFTs(0);
+  framebytes = BENCH_FRAME_PAYLOAD_BYTES + VDIF_HEADER_BYTES;
+
+  //not every combination of bands and bits has a mark5access decoder (e.g. 8 bands of 8 bits)
+  config->genMk5FormatName(Configuration::VDIF, p.numbands, BENCH_BANDWIDTH_MHZ, p.numbits, Configuration::REAL, framebytes, config->getDDecimationFactor(0, 0), config->getDAlignmentSeconds(0, 0), config->getDNumMuxThreads(0, 0), formatname);
+  mk5format = new_mark5_format_generic_from_string(formatname);
+  if(mk5format == 0)
+  {
+    printf("# skipping %d channels, %d bands, %d bits: mark5access cannot decode %s\n", p.numchannels, p.numbands, p.numbits, formatname);
+    fflush(stdout);
+    delete config;
+    return true;
+  }
+  delete_mark5_format_generic(mk5format);
+
+  flaglength = blocks/FLAGS_PER_INT + 1;
+  validflags = vectorAlloc_s32(flaglength);
+  for(int i=0;i<flaglength;i++)
+    validflags[i] = ~0;
+  results = vectorAlloc_cf32(config->getThreadResultLength(0));
+  modes = new Mode*[numstations];
+  databuffers = new u8*[numstations];
+  databytes = new int[numstations];
+  for(int s=0;s<numstations;s++)
+  {
+    modes[s] = config->getMode(0, s);
+    if(modes[s] == NULL || !modes[s]->initialisedOK())
+    {
+      cerr << "Could not create Mode for datastream " << s << endl;
+      ok = false;
+    }
+    numframes = config->getDataBytes(0, s)/framebytes + 1;
+    databytes[s] = numframes*framebytes;
+    databuffers[s] = vectorAlloc_u8(databytes[s]);
+    generatevdif(databuffers[s], numframes, p, s);
+  }
+
+  //one untimed subint to warm the caches and finish any lazy FFT planning, then the timed ones
+  for(int iter=0;ok && iter<=numsubints;iter++)
+  {
+    if(iter == 1)
+    {
+      for(int s=0;s<numstations;s++)
+        modes[s]->setProfile(&profile);
+      starttime = StageProfile::now();
+    }
+    for(int s=0;s<numstations;s++)
+    {
+      modes[s]->zeroAutocorrelations();
+      modes[s]->setValidFlags(validflags);
+      modes[s]->setData(databuffers[s], databytes[s], 0, 0, 0);
+      modes[s]->setOffsets(0, 0, 0);
+    }
+    vectorZero_cf32(results, config->getThreadResultLength(0));
+    for(int chunkstart=0;chunkstart<blocks;chunkstart+=numbufferedffts)
+    {
+      chunkffts = (blocks - chunkstart < numbufferedffts)?blocks - chunkstart:numbufferedffts;
+      for(int s=0;s<numstations;s++)
+      {
+        for(int fftsubloop=0;fftsubloop<chunkffts;fftsubloop++)
+          modes[s]->process(chunkstart + fftsubloop, fftsubloop);
+      }
+      xmactime = (iter > 0)?profile.start():0;
+      if(config->getXmacMode(0) == Configuration::TILEDXMAC)
+        Core::crossMultiplyTiled(config, 0, chunkffts, modes, results);
+      else
+      {
+        resultindex = 0;
+        for(int f=0;f<config->getFreqTableLength();f++)
+        {
+          if(config->isFrequencyUsed(0, f))
+            resultindex = Core::crossMultiplyBaselines(config, 0, f, chunkffts, modes, results, resultindex);
+        }
+      }
+      if(iter > 0)
+        profile.record(StageProfile::XMAC, xmactime);
+    }
+  }
+
+  if(ok)
+  {
+    elapsedns = StageProfile::now() - starttime;
+    memset(counts, 0, sizeof(counts));
+    memset(totalns, 0, sizeof(totalns));
+    memset(histogram, 0, sizeof(histogram));
+    profile.addTo(counts, totalns, histogram);
+    stationsamples = ((double)numsubints)*blocks*2.0*p.numchannels*p.numbands*numstations;
+    printf("%8d %5d %4d %5d %4s", p.numchannels, p.numbands, p.numbits, p.fringerotationorder, (config->getXmacMode(0) == Configuration::TILEDXMAC)?"T":"B");
+    for(int i=0;i<NUM_REPORTED_STAGES;i++)
+    {
+      if(totalns[REPORTED_STAGES[i]] > 0)
+        printf(" %12.1f", stationsamples*1000.0/totalns[REPORTED_STAGES[i]]);
+      else
+        printf(" %12s", "-");
+    }
+    printf(" %12.1f\n", stationsamples*1000.0/elapsedns);
+    fflush(stdout);
+  }
+
+  for(int s=0;s<numstations;s++)
+  {
+    delete modes[s];
+    vectorFree(databuffers[s]);
+  }
+  delete [] modes;
+  delete [] databuffers;
+  delete [] databytes;
+  vectorFree(validflags);
+  vectorFree(results);
+  delete config;
+
+  return ok;
+}
+
+int main(int argc, char *argv[])
+{
+  vector<int> channels, bands, bits, orders, xmacmodes;
+  int numstations = 4;
+  int numsubints = 10;
+  int nBad = 0;
+  bool keepfiles = false;
+  string dir = ".";
+  benchpoint p;
+
+  parselist("256,1024,4096", channels);
+  parselist("2,8", bands);
+  parselist("2,8", bits);
+  parselist("0,1", orders);
+  parselist("0,1", xmacmodes);
+
+  for(int a = 1; a < argc; ++a)
+  {
+    if(strcmp(argv[a], "-h") == 0)
+    {
+      usage(argv[0]);
+
+      return EXIT_SUCCESS;
+    }
+    else if(strcmp(argv[a], "-k") == 0)
+    {
+      keepfiles = true;
+    }
+    else if(a+1 < argc)
+    {
+      if(strcmp(argv[a], "-c") == 0 && parselist(argv[a+1], channels))
+        ++a;
+      else if(strcmp(argv[a], "-b") == 0 && parselist(argv[a+1], bands))
+        ++a;
+      else if(strcmp(argv[a], "-q") == 0 && parselist(argv[a+1], bits))
+        ++a;
+      else if(strcmp(argv[a], "-r") == 0 && parselist(argv[a+1], orders))
+        ++a;
+      else if(strcmp(argv[a], "-x") == 0 && parselist(argv[a+1], xmacmodes))
+        ++a;
+      else if(strcmp(argv[a], "-s") == 0)
+        numstations = atoi(argv[++a]);
+      else if(strcmp(argv[a], "-n") == 0)
+        numsubints = atoi(argv[++a]);
+      else if(strcmp(argv[a], "-d") == 0)
+        dir = argv[++a];
+      else
+      {
+        usage(argv[0]);
+
+        return EXIT_FAILURE;
+      }
+    }
+    else
+    {
+      usage(argv[0]);
+
+      return EXIT_FAILURE;
+    }
+  }
+  if(numstations < 2 || numstations > 26 || numsubints < 1)
+  {
+    cerr << "Need 2 to 26 stations and at least one subintegration" << endl;
+
+    return EXIT_FAILURE;
+  }
+  for(size_t x=0;x<xmacmodes.size();x++)
+  {
+    if(xmacmodes[x] != 0 && xmacmodes[x] != 1)
+    {
+      cerr << "xmac modes must be 0 (per-baseline) or 1 (tiled)" << endl;
+
+      return EXIT_FAILURE;
+    }
+  }
+
+  //keep the alert streams local, and no difxmessages
+  csevere.setAlertLevel(DIFX_ALERT_LEVEL_DO_NOT_SEND);
+  cerror.setAlertLevel(DIFX_ALERT_LEVEL_DO_NOT_SEND);
+  cwarn.setAlertLevel(DIFX_ALERT_LEVEL_DO_NOT_SEND);
+  cinfo.setAlertLevel(DIFX_ALERT_LEVEL_DO_NOT_SEND);
+  cverbose.setAlertLevel(DIFX_ALERT_LEVEL_DO_NOT_SEND);
+  cdebug.setAlertLevel(DIFX_ALERT_LEVEL_DO_NOT_SEND);
+  difxMessagePort = -1;
+
+#ifdef HAVE_IPP
+  printf("# mpifxcorr %s benchmark, IPP build, %d stations, %d x %.0f ms per point\n", VERSION, numstations, numsubints, BENCH_SUBINT_NS/1.0e6);
+#else
+  printf("# mpifxcorr %s benchmark, FFTW build (%s vector kernels), %d stations, %d x %.0f ms per point\n", VERSION, genericSimdLevelName(genericSimdGetKernels().level), numstations, numsubints, BENCH_SUBINT_NS/1.0e6);
+#endif
+  printf("# Throughput in Msamples/s summed over all stations (%.0f MHz bands, real sampled VDIF)\n", BENCH_BANDWIDTH_MHZ);
+  printf("#  nchan nband nbit order xmac %12s %12s %12s %12s %12s %12s %12s\n", "UNPACK", "FRINGEROTATE", "FFT", "FRACSAMPLE", "AUTOCORR", "XMAC", "TOTAL");
+  for(size_t c=0;c<channels.size();c++)
+  {
+    for(size_t b=0;b<bands.size();b++)
+    {
+      for(size_t q=0;q<bits.size();q++)
+      {
+        for(size_t r=0;r<orders.size();r++)
+        {
+          p.numchannels = channels[c];
+          p.numbands = bands[b];
+          p.numbits = bits[q];
+          p.fringerotationorder = orders[r];
+          for(size_t x=0;x<xmacmodes.size();x++)
+          {
+            p.xmacmode = (xmacmodes[x] == 1)?Configuration::TILEDXMAC:Configuration::BASELINEXMAC;
+            if(!runpoint(p, numstations, numsubints, dir, keepfiles))
+              ++nBad;
+          }
+        }
+      }
+    }
+  }
+
+  if(nBad == 0)
+  {
+    return EXIT_SUCCESS;
+  }
+  else
+  {
+    return EXIT_FAILURE;
+  }
+}
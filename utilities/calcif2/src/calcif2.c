@@ -66,6 +66,7 @@ typedef struct
 	int allowNegDelay;
 	char *files[MAX_FILES];
 	int overrideVersion;
+	int nClient;
 	enum AberCorr aberCorr;
 } CommandLineOptions;
 
@@ -114,6 +115,10 @@ static void usage()
 	fprintf(stderr, "\n");
 	fprintf(stderr, "  --override-version      Ignore difx versions\n");
 	fprintf(stderr, "\n");
+	fprintf(stderr, "  --clients <n>\n");
+	fprintf(stderr, "  -c        <n>           Keep <n> calc server requests in flight, each over its\n");
+	fprintf(stderr, "                          own connection; antenna models are computed in parallel [1]\n");
+	fprintf(stderr, "\n");
 	fprintf(stderr, "  --server <servername>\n");
 	fprintf(stderr, "  -s       <servername>   Use <servername> as calcserver\n\n");
 	fprintf(stderr, "      By default 'localhost' will be the calcserver.  An environment\n");
@@ -154,6 +159,7 @@ static CommandLineOptions *newCommandLineOptions(int argc, char **argv)
 	opts->polyInterval = 120;
 	opts->interpol = 0;	/* usual solve */
 	opts->aberCorr = AberCorrExact;
+	opts->nClient = 1;
 
 	for(i = 1; i < argc; ++i)
 	{
@@ -244,6 +250,17 @@ static CommandLineOptions *newCommandLineOptions(int argc, char **argv)
 					++i;
 					opts->polyInterval = atoi(argv[i]);
 				}
+				else if(strcmp(argv[i], "--clients") == 0 ||
+					strcmp(argv[i], "-c") == 0)
+				{
+					++i;
+					opts->nClient = atoi(argv[i]);
+					if(opts->nClient < 1 || opts->nClient > MAX_CALC_CLIENTS)
+					{
+						fprintf(stderr, "Error: calcif2: number of clients must be in range 1 to %d\n", MAX_CALC_CLIENTS);
+						++die;
+					}
+				}
 				else if(argv[i][0] == '-')
 				{
 					printf("Error: calcif2: Illegal option : %s\n", argv[i]);
@@ -483,6 +500,12 @@ static void tweakDelays(DifxInput *D, const char *tweakFile, int verbose)
 
 void deleteCalcParams(CalcParams *p)
 {
+	int i;
+
+	for(i = 1; i < p->nClient; ++i)
+	{
+		clnt_destroy(p->clntPool[i]);
+	}
 	if(p->clnt)
 	{
 		clnt_destroy(p->clnt);
@@ -518,9 +541,23 @@ CalcParams *newCalcParams(const CommandLineOptions *opts)
 
 		return 0;
 	}
+	p->clntPool[0] = p->clnt;
+	p->nClient = 1;
+	while(p->nClient < opts->nClient)
+	{
+		p->clntPool[p->nClient] = clnt_create(p->calcServer, p->calcProgram, p->calcVersion, "tcp");
+		if(!p->clntPool[p->nClient])
+		{
+			clnt_pcreateerror(p->calcServer);
+			fprintf(stderr, "Warning: calcif2: only %d of %d RPC clients could be created\n", p->nClient, opts->nClient);
+
+			break;
+		}
+		++p->nClient;
+	}
 	if(opts->verbose > 1)
 	{
-		printf("RPC client created\n");
+		printf("%d RPC client%s created\n", p->nClient, (p->nClient > 1) ? "s" : "");
 	}
 
 	return p;
@@ -31,6 +31,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <pthread.h>
 #include "MATHCNST.H"
 #include "difxcalc.h"
 #include "externaldelay.h"
@@ -63,6 +64,35 @@ struct CalcResults
 	struct getCALC_res res[3];
 };
 
+/* one antenna model (one antenna, scan and phase centre) to compute */
+struct CalcJob
+{
+	int scanId;
+	int antId;
+	int phasecentre;
+};
+
+/* shared state for computing models with several calc server connections at once */
+struct CalcJobQueue
+{
+	const DifxInput *D;
+	const char *prefix;
+	const CalcParams *p;
+	int verbose;
+	struct CalcJob *jobs;
+	int nJob;
+	int nextJob;
+	int nFail;
+	pthread_mutex_t lock;
+};
+
+struct CalcWorker
+{
+	struct CalcJobQueue *queue;
+	CLIENT *clnt;
+	pthread_t thread;
+};
+
 int difxCalcInit(const DifxInput *D, CalcParams *p)
 {
 	struct getCALC_arg *request;
@@ -186,7 +216,7 @@ static int calcSpacecraftPosition(const DifxInput *D, struct getCALC_arg *reques
 	return 0;
 }
 
-static int callCalc(struct getCALC_arg *request, struct CalcResults *results, const CalcParams *p)
+static int callCalc(CLIENT *clnt, struct getCALC_arg *request, struct CalcResults *results, const CalcParams *p)
 {
 	double ra, dec;
 	int i;
@@ -208,7 +238,7 @@ static int callCalc(struct getCALC_arg *request, struct CalcResults *results, co
 	{
 		memset(results->res+i, 0, sizeof(struct getCALC_res));
 	}
-	clnt_stat = clnt_call(p->clnt, GETCALC,
+	clnt_stat = clnt_call(clnt, GETCALC,
 		(xdrproc_t)xdr_getCALC_arg, 
 		(caddr_t)request,
 		(xdrproc_t)xdr_getCALC_res, 
@@ -235,7 +265,7 @@ static int callCalc(struct getCALC_arg *request, struct CalcResults *results, co
 		/* calculate delay offset in RA */
 		request->ra  = ra - p->delta/cos(dec);
 		request->dec = dec;
-		clnt_stat = clnt_call(p->clnt, GETCALC,
+		clnt_stat = clnt_call(clnt, GETCALC,
 			(xdrproc_t)xdr_getCALC_arg, 
 			(caddr_t)request,
 			(xdrproc_t)xdr_getCALC_res, 
@@ -257,7 +287,7 @@ static int callCalc(struct getCALC_arg *request, struct CalcResults *results, co
 		/* calculate delay offset in Dec */
 		request->ra  = ra;
 		request->dec = dec + p->delta;
-		clnt_stat = clnt_call(p->clnt, GETCALC,
+		clnt_stat = clnt_call(clnt, GETCALC,
 			(xdrproc_t)xdr_getCALC_arg, 
 			(caddr_t)request,
 			(xdrproc_t)xdr_getCALC_res, 
@@ -410,8 +440,10 @@ static double computePolyModel(DifxPolyModel *im, const struct modelTemp *mod, d
 }
 
 /* antenna here is a pointer to a particular antenna object */
-static int antennaCalc(int scanId, int antId, const DifxInput *D, const char *prefix, CalcParams *p, int phasecentre, int verbose)
+/* Only reads p and writes scan->im[antId][phasecentre], so separate models may be computed concurrently over different clnt */
+static int antennaCalc(int scanId, int antId, const DifxInput *D, const char *prefix, const CalcParams *p, CLIENT *clnt, int phasecentre, int verbose)
 {
+	struct getCALC_arg requestCopy;
 	struct getCALC_arg *request;
 	struct CalcResults results;
 	struct modelTemp mod;
@@ -444,7 +476,8 @@ static int antennaCalc(int scanId, int antId, const DifxInput *D, const char *pr
 	}
 	source = D->source + sourceId;
 	subInc = p->increment/(double)(p->order*p->oversamp);
-	request = &(p->request);
+	requestCopy = p->request;
+	request = &requestCopy;
 	spacecraftId = source->spacecraftId;
 
 	/* this is needed to get around xdr_string not coping well with const strings */
@@ -509,7 +542,7 @@ static int antennaCalc(int scanId, int antId, const DifxInput *D, const char *pr
 						return -1;
 					}
 				}
-				v = callCalc(request, &results, p);
+				v = callCalc(clnt, request, &results, p);
 				if(v < 0)
 				{
 					printf("Error: antennaCalc: callCalc = %d\n", v);
@@ -574,7 +607,8 @@ static int antennaCalc(int scanId, int antId, const DifxInput *D, const char *pr
 	return nError;
 }
 
-static int scanCalc(int scanId, const DifxInput *D, const char *prefix, CalcParams *p, int isLast, int verbose)
+/* set up the polynomial intervals of all models for a scan */
+static int scanSetup(int scanId, const DifxInput *D, const CalcParams *p, int isLast)
 {
 	DifxPolyModel *im;
 	int antId;
@@ -583,7 +617,7 @@ static int scanCalc(int scanId, const DifxInput *D, const char *prefix, CalcPara
 	int jobStart;	/* seconds since last midnight */
 	int int1, int2;	/* polynomial intervals */
 	int nInt;
-	int i, v, k;
+	int i, k;
 	DifxJob *job;
 	DifxScan *scan;
 
@@ -633,9 +667,26 @@ static int scanCalc(int scanId, const DifxInput *D, const char *prefix, CalcPara
 				im[i].validDuration = p->increment;
 				sec += p->increment;
 			}
+		}
+	}
+
+	return 0;
+}
+
+static int scanCalc(int scanId, const DifxInput *D, const char *prefix, CalcParams *p, int verbose)
+{
+	int antId;
+	int v, k;
+	DifxScan *scan;
 
+	scan = D->scan + scanId;
+
+	for(antId = 0; antId < scan->nAntenna; ++antId)
+	{
+		for(k = 0; k < scan->nPhaseCentres + 1; ++k)
+		{
 			/* call calc to derive delay, etc... polys */
-			v = antennaCalc(scanId, antId, D, prefix, p, k, verbose);
+			v = antennaCalc(scanId, antId, D, prefix, p, p->clnt, k, verbose);
 			if(v < 0)
 			{
 				return -1;
@@ -646,6 +697,114 @@ static int scanCalc(int scanId, const DifxInput *D, const char *prefix, CalcPara
 	return 0;
 }
 
+static void *calcWorkerRun(void *arg)
+{
+	struct CalcWorker *w = (struct CalcWorker *)arg;
+	struct CalcJobQueue *q = w->queue;
+	const struct CalcJob *job;
+	int v;
+
+	for(;;)
+	{
+		pthread_mutex_lock(&q->lock);
+		if(q->nFail > 0 || q->nextJob >= q->nJob)
+		{
+			pthread_mutex_unlock(&q->lock);
+
+			break;
+		}
+		job = q->jobs + q->nextJob;
+		++q->nextJob;
+		pthread_mutex_unlock(&q->lock);
+
+		v = antennaCalc(job->scanId, job->antId, q->D, q->prefix, q->p, w->clnt, job->phasecentre, q->verbose);
+		if(v < 0)
+		{
+			pthread_mutex_lock(&q->lock);
+			++q->nFail;
+			pthread_mutex_unlock(&q->lock);
+		}
+	}
+
+	return 0;
+}
+
+/* Compute the models of all scans, keeping up to p->nClient calc server requests in flight.
+ * Each worker thread owns one client connection and takes whole antenna models off a shared
+ * queue, so each polynomial is still assembled from its own sequence of calls.
+ */
+static int calcAllScans(const DifxInput *D, const char *prefix, CalcParams *p, int verbose)
+{
+	struct CalcJobQueue queue;
+	struct CalcWorker workers[MAX_CALC_CLIENTS];
+	int nWorker, scanId, antId, k, i, v;
+	const DifxScan *scan;
+
+	queue.nJob = 0;
+	for(scanId = 0; scanId < D->nScan; ++scanId)
+	{
+		queue.nJob += D->scan[scanId].nAntenna*(D->scan[scanId].nPhaseCentres + 1);
+	}
+	queue.jobs = (struct CalcJob *)malloc(queue.nJob*sizeof(struct CalcJob));
+	if(!queue.jobs)
+	{
+		fprintf(stderr, "Error: calcAllScans: cannot allocate %d jobs\n", queue.nJob);
+
+		return -1;
+	}
+	queue.nJob = 0;
+	for(scanId = 0; scanId < D->nScan; ++scanId)
+	{
+		scan = D->scan + scanId;
+		for(antId = 0; antId < scan->nAntenna; ++antId)
+		{
+			for(k = 0; k < scan->nPhaseCentres + 1; ++k)
+			{
+				queue.jobs[queue.nJob].scanId = scanId;
+				queue.jobs[queue.nJob].antId = antId;
+				queue.jobs[queue.nJob].phasecentre = k;
+				++queue.nJob;
+			}
+		}
+	}
+	queue.D = D;
+	queue.prefix = prefix;
+	queue.p = p;
+	queue.verbose = verbose;
+	queue.nextJob = 0;
+	queue.nFail = 0;
+	pthread_mutex_init(&queue.lock, 0);
+
+	/* worker 0 runs in this thread */
+	nWorker = 1;
+	for(i = 0; i < p->nClient && i < MAX_CALC_CLIENTS; ++i)
+	{
+		workers[i].queue = &queue;
+		workers[i].clnt = p->clntPool[i];
+		if(i > 0)
+		{
+			v = pthread_create(&workers[i].thread, 0, calcWorkerRun, workers + i);
+			if(v != 0)
+			{
+				fprintf(stderr, "Warning: calcAllScans: cannot start calc thread %d (error %d); continuing with %d\n", i, v, nWorker);
+
+				break;
+			}
+			++nWorker;
+		}
+	}
+	calcWorkerRun(workers);
+	for(i = 1; i < nWorker; ++i)
+	{
+		pthread_join(workers[i].thread, 0);
+	}
+
+	pthread_mutex_destroy(&queue.lock);
+	free(queue.jobs);
+
+	return (queue.nFail > 0) ? -1 : 0;
+}
+
 int difxCalc(DifxInput *D, CalcParams *p, const char *prefix, int verbose)
 {
 	int scanId;
@@ -681,7 +840,20 @@ int difxCalc(DifxInput *D, CalcParams *p, const char *prefix, int verbose)
 		{
 			isLast = 0;
 		}
-		v = scanCalc(scanId, D, prefix, p, isLast, verbose);
+		scanSetup(scanId, D, p, isLast);
+		if(p->nClient <= 1)
+		{
+			v = scanCalc(scanId, D, prefix, p, verbose);
+			if(v < 0)
+			{
+				return -1;
+			}
+		}
+	}
+
+	if(p->nClient > 1)
+	{
+		v = calcAllScans(D, prefix, p, verbose);
 		if(v < 0)
 		{
 			return -1;
@@ -34,6 +34,7 @@
 #include "CALCServer.h"
 
 #define MAX_MODEL_OVERSAMP 5
+#define MAX_CALC_CLIENTS 32
 
 typedef struct
 {
@@ -49,6 +50,8 @@ typedef struct
 	struct getCALC_arg request;
 	enum AberCorr aberCorr;
 	CLIENT *clnt;
+	int nClient;	/* if > 1, this many antenna models are computed at once, each over its own connection */
+	CLIENT *clntPool[MAX_CALC_CLIENTS];	/* clntPool[0] is clnt */
 } CalcParams;
 
 int difxCalcInit(const DifxInput *D, CalcParams *p);
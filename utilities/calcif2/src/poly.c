@@ -90,8 +90,7 @@ void computePoly(double *p, int n, double d)
 */
 void fitPoly(double *p, const double *q, int n, int oversamp, double d)
 {
-	static int binomial[MAX_MODEL_ORDER+1][MAX_MODEL_ORDER+1];
-	static int first = 1;
+	int binomial[MAX_MODEL_ORDER+1][MAX_MODEL_ORDER+1];
 	gsl_multifit_linear_workspace * work;
 	gsl_matrix *X, *cov;
 	gsl_vector *y, *w, *c;
@@ -103,31 +102,28 @@ void fitPoly(double *p, const double *q, int n, int oversamp, double d)
 	double dfac;
 	int i, j, k;
 
-	if(first)
+	/* built on each call (it is tiny) so that concurrent calls are safe */
+	for(j = 0; j <= MAX_MODEL_ORDER; ++j)
 	{
-		first = 0;
-		for(j = 0; j <= MAX_MODEL_ORDER; ++j)
+		for(i = 0; i <= MAX_MODEL_ORDER; ++i)
 		{
-			for(i = 0; i <= MAX_MODEL_ORDER; ++i)
+			if(i == 0)
 			{
-				if(i == 0)
-				{
-					binomial[j][i] = 1;
-				}
-				else
-				{
-					binomial[j][i] = 0;
-				}
+				binomial[j][i] = 1;
 			}
-		}
-		for(j = 1; j <= MAX_MODEL_ORDER; ++j)
-		{
-			for(i = 1; i <= j; ++i)
+			else
 			{
-				binomial[j][i] = binomial[j-1][i-1] + binomial[j-1][i];
+				binomial[j][i] = 0;
 			}
 		}
 	}
+	for(j = 1; j <= MAX_MODEL_ORDER; ++j)
+	{
+		for(i = 1; i <= j; ++i)
+		{
+			binomial[j][i] = binomial[j-1][i-1] + binomial[j-1][i];
+		}
+	}
 
 	delta = d*(nData+1);
 
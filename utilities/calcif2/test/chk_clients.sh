@@ -0,0 +1,63 @@
+#!/bin/bash
+#
+# Checks that calcif2 writes the same .im file with several calc server
+# clients (--clients) as it does serially.
+#
+# A calc server must be reachable: $CALC_SERVER (default localhost), or a
+# calcserver found in $PATH, which is then started here for the test and
+# needs rpcbind running.  Without one the test is skipped.
+#
+
+[ -d "$srcdir" ] || { echo srcdir not set; exit 1; }
+calcif2=${CALCIF2-`cd ../src; pwd`/calcif2}
+server=${CALC_SERVER-localhost}
+clients="2 4"
+calcprog=0x20000340
+started=
+
+calcserver_up()
+{
+	rpcinfo -t $server $calcprog > /dev/null 2>&1
+}
+
+cleanup()
+{
+	[ -n "$started" ] && kill $started 2> /dev/null
+	rm -rf "$work"
+}
+
+work=`mktemp -d $PWD/chk_clients.XXXXXX` || exit 1
+trap cleanup EXIT
+
+if ! calcserver_up; then
+	if [ "$server" = "localhost" ] && which calcserver > /dev/null 2>&1; then
+		calcserver > "$work/calcserver.log" 2>&1 &
+		started=$!
+		for t in 1 2 3 4 5 6 7 8 9 10; do
+			calcserver_up && break
+			sleep 1
+		done
+	fi
+	if ! calcserver_up; then
+		echo "No calc server reachable on $server; skipping"
+		exit 77
+	fi
+fi
+
+cp $srcdir/ma008_1.calc "$work"
+cd "$work" || exit 1
+
+$calcif2 -q -f --override-version -s $server --clients 1 ma008_1.calc || { echo calcif2 failed with 1 client; exit 1; }
+mv ma008_1.im serial.im
+
+for n in $clients; do
+	$calcif2 -q -f --override-version -s $server --clients $n ma008_1.calc || { echo calcif2 failed with $n clients; exit 1; }
+	cmp serial.im ma008_1.im || { echo .im differs between 1 and $n clients; exit 1; }
+	rm -f ma008_1.im
+done
+
+exit 0
+
+#
+# eof
+#